@@ -55,7 +55,7 @@ namespace cinder {
 	btBvhTriangleMeshShape* createStaticConcaveMeshShape(TriMesh mesh, Vec3f scale, float margin=0.05f)
 	{
 		std::vector<Vec3f> vertices = mesh.getVertices();
-		std::vector<size_t> indices = mesh.getIndices();
+		std::vector<uint32_t> indices = mesh.getIndices();
 		
 		btTriangleMesh *tmesh = new btTriangleMesh(true, false);
 		
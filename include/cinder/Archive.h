@@ -0,0 +1,129 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/Buffer.h"
+#include "cinder/Stream.h"
+#include "cinder/DataSource.h"
+#include "cinder/Exception.h"
+
+namespace cinder {
+
+//! A pointer to an instance of an Archive. Can be created using Archive::createRef() or loadArchive()
+typedef shared_ptr<class Archive>	ArchiveRef;
+
+/** \brief A read-only pack of named assets, as written by tools/packAssets.py.
+ * The pack is memory-mapped, and its index is a table of fixed-size records sorted by name which is searched in place, so opening a pack
+ * reads nothing but its header and finding an entry is a binary search. Stored entries are returned as views into the mapping without
+ * copying; compressed entries are decompressed into a new Buffer.
+ *
+ * Layout, all little endian:
+ * - header: "CiPk", uint32 version, uint32 entry count, uint32 reserved, uint64 index offset, uint64 names offset
+ * - index: per entry, sorted by the bytes of its name: uint64 data offset, uint64 stored size, uint64 size, uint32 name offset, uint16 name length, uint8 codec, uint8 reserved
+ * - names: UTF-8 entry names, relative paths using '/' as the separator, each at its name offset from the names offset
+ * - data: each entry's payload, aligned to 16 bytes **/
+class Archive {
+  public:
+	enum Codec { CODEC_STORED = 0, CODEC_ZLIB = 1, CODEC_LZ4 = 2 };
+
+	//! Opens the pack at \a path. Throws ArchiveExc if it can't be mapped or isn't a valid pack.
+	static ArchiveRef	createRef( const std::string &path );
+	//! Opens a pack held in \a buffer, such as one loaded as a resource. The Buffer is kept alive by the Archive.
+	static ArchiveRef	createRef( const Buffer &buffer );
+
+	size_t			getNumEntries() const { return mNumEntries; }
+	//! Returns the name of entry \a index, in sorted order. Throws ArchiveExc if \a index is out of range.
+	std::string		getEntryName( size_t index ) const;
+	//! Returns the uncompressed size of entry \a index. Throws ArchiveExc if \a index is out of range.
+	uint64_t		getEntrySize( size_t index ) const;
+	//! Returns the index of the entry named \a name, or -1 if there is none. '\\' is treated as '/'.
+	int32_t			findEntry( const std::string &name ) const;
+	bool			contains( const std::string &name ) const { return findEntry( name ) >= 0; }
+
+	//! Returns the contents of the entry named \a name. Throws ArchiveExc if there is no such entry.
+	Buffer			getBuffer( const std::string &name ) const;
+	//! Returns the contents of entry \a index. Throws ArchiveExc if \a index is out of range.
+	Buffer			getBuffer( size_t index ) const;
+	//! Returns a stream over the contents of the entry named \a name. Throws ArchiveExc if there is no such entry.
+	IStreamMemRef	getStream( const std::string &name ) const;
+
+  protected:
+	Archive( const Buffer &buffer );
+
+	//! Throws ArchiveExc if \a index is out of range
+	const uint8_t*	getIndexRecord( size_t index ) const;
+
+	static const size_t		HEADER_SIZE = 32;
+	static const size_t		INDEX_RECORD_SIZE = 32;
+
+	Buffer				mData;		// the whole pack; for a mapped file this keeps the mapping alive
+	shared_ptr<void>	mOwner;		// shared by the Buffers returned for stored entries
+	const uint8_t		*mBase, *mIndex, *mNames;
+	size_t				mSize, mNamesSize;
+	uint32_t			mNumEntries;
+};
+
+class ArchiveExc : public Exception {
+  public:
+	ArchiveExc( const std::string &message ) throw() : mMessage( message ) {}
+	virtual ~ArchiveExc() throw() {}
+	virtual const char* what() const throw() { return mMessage.c_str(); }
+
+  private:
+	std::string		mMessage;
+};
+
+//! Opens the pack at \a path. Throws ArchiveExc on failure.
+ArchiveRef	loadArchive( const std::string &path );
+
+
+typedef shared_ptr<class DataSourceArchive>	DataSourceArchiveRef;
+
+//! A DataSource for one entry of an Archive. The entry's name serves as the file path hint, so loadImage() and friends can use its extension.
+class DataSourceArchive : public DataSource {
+  public:
+	//! Creates a DataSourceArchive for the entry \a name of \a archive. Throws ArchiveExc if there is no such entry.
+	static DataSourceArchiveRef	createRef( ArchiveRef archive, const std::string &name );
+
+	virtual bool	isFilePath() { return false; }
+	virtual bool	isUrl() { return false; }
+
+	virtual IStreamRef	getStream();
+
+	ArchiveRef		getArchive() const { return mArchive; }
+
+  protected:
+	DataSourceArchive( ArchiveRef archive, int32_t index, const std::string &name );
+
+	virtual	void	createBuffer();
+
+	ArchiveRef		mArchive;
+	int32_t			mIndex;
+	IStreamMemRef	mStream;
+};
+
+//! Returns a DataSource for the entry \a name of \a archive. Throws ArchiveExc if there is no such entry.
+DataSourceArchiveRef	loadFile( ArchiveRef archive, const std::string &name );
+
+} // namespace cinder
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "cinder/Cinder.h"
+#include "cinder/Exception.h"
 
 #define DEFAULT_COMPRESSION_LEVEL 6
 
@@ -38,11 +39,15 @@ class Buffer {
 		size_t	mAllocatedSize;
 		size_t	mDataSize;
 		bool	mOwnsData;
+		shared_ptr<void>	mOwner;
 	};
 
  public:
 	Buffer() {}
 	Buffer( void * aBuffer, size_t aSize );
+	//! Wraps \a aBuffer without copying it. \a owner is kept alive for as long as the Buffer (or any copy of it) exists, such as a memory-mapped file backing the data.
+	Buffer( void * aBuffer, size_t aSize, shared_ptr<void> owner );
+	//! Allocates \a size bytes, throwing std::bad_alloc if they aren't available
 	Buffer( size_t size );
 	
 	size_t getAllocatedSize() const { return mObj->mAllocatedSize; }
@@ -55,6 +60,7 @@ class Buffer {
 	//! Returns a shared_ptr for the data and gives up ownership of the data
 	shared_ptr<uint8_t>	convertToSharedPtr();
 	
+	//! Reallocates the data to \a newSize bytes, which also becomes the data size. Throws std::bad_alloc if the memory isn't available, leaving the Buffer unchanged.
 	void resize( size_t newSize );
 	
 	void copyFrom( const void * aData, size_t length );
@@ -72,7 +78,20 @@ class Buffer {
 	//@}
 };
 
+//! Codecs available to compressBuffer(). CODEC_LZ4 trades compression ratio for much higher speed, and CODEC_LZ4_HC spends more time compressing for a better ratio while decompressing just as quickly.
+enum CompressionCodec { CODEC_ZLIB, CODEC_LZ4, CODEC_LZ4_HC };
+
+//! Compresses \a aBuffer with zlib, as a bare zlib stream without a header
 Buffer compressBuffer( const Buffer &aBuffer, int8_t compressionLevel = DEFAULT_COMPRESSION_LEVEL, bool resizeResult = true );
+//! Compresses \a aBuffer with \a codec, preceded by a small header recording the codec and the original size. \a compressionLevel is ignored by CODEC_LZ4. Throws BufferCompressionExc on failure.
+Buffer compressBuffer( const Buffer &aBuffer, CompressionCodec codec, int8_t compressionLevel = DEFAULT_COMPRESSION_LEVEL, bool resizeResult = true );
+//! Decompresses the output of either compressBuffer(). The codec and size are read from the header when present; otherwise the data is treated as a bare zlib stream.
 Buffer decompressBuffer( const Buffer &aBuffer, bool resizeResult = true );
 
+class BufferCompressionExc : public Exception {
+};
+
+class BufferDecompressionExc : public Exception {
+};
+
 } //namespace
\ No newline at end of file
@@ -24,6 +24,7 @@
 
 #include "cinder/Cinder.h"
 #include "cinder/Url.h"
+#include "cinder/UrlCache.h"
 #include "cinder/Buffer.h"
 #include "cinder/Stream.h"
 
@@ -75,7 +76,8 @@ class DataSourcePath : public DataSource {
 	
 	virtual	void	createBuffer();
 	
-	IStreamFileRef	mStream;	
+	IStreamRef		mStream;
+	IStreamMmapRef	mMmapStream;
 };
 
 DataSourcePathRef	loadFile( const std::string &path );
@@ -85,7 +87,10 @@ typedef shared_ptr<class DataSourceUrl>	DataSourceUrlRef;
 
 class DataSourceUrl : public DataSource {
   public:
+	//! Creates a DataSourceUrl which reads through UrlCache::getDefault(), if there is one
 	static DataSourceUrlRef	createRef( const Url &Url );
+	//! Creates a DataSourceUrl which reads through \a cache, or straight from the network if \a cache is null
+	static DataSourceUrlRef	createRef( const Url &Url, UrlCacheRef cache );
 
 	virtual bool	isFilePath() { return false; }
 	virtual bool	isUrl() { return true; }
@@ -93,14 +98,16 @@ class DataSourceUrl : public DataSource {
 	virtual IStreamRef	getStream();
 
   protected:
-	DataSourceUrl( const Url &Url );
+	DataSourceUrl( const Url &Url, UrlCacheRef cache );
 	
 	virtual	void	createBuffer();
 
-	IStreamUrlRef	mStream;
+	IStreamRef		mStream;
+	UrlCacheRef		mCache;
 };
 
 DataSourceUrlRef	loadUrl( const Url &Url );
+DataSourceUrlRef	loadUrl( const Url &Url, UrlCacheRef cache );
 #endif
 
 typedef shared_ptr<class DataSourceBuffer>	DataSourceBufferRef;
@@ -131,7 +131,34 @@ class ImageTarget : public ImageIo {
 	virtual void	finalize() { }
 	
   protected:
-	ImageTarget() {}	
+	ImageTarget() {}
+};
+
+typedef shared_ptr<class ImageTargetMemory>	ImageTargetMemoryRef;
+
+/** \brief ImageTarget which decodes directly into caller-owned memory, such as a mapped pixel buffer or a preallocated Surface.
+ * Rows are \a rowBytes apart, which may be larger than width * pixel size. The memory must outlive the load(). **/
+class ImageTargetMemory : public ImageTarget {
+  public:
+	static ImageTargetMemoryRef	createRef( void *data, int32_t width, int32_t height, int32_t rowBytes, DataType dataType, ColorModel colorModel, ChannelOrder channelOrder );
+	//! Targets the existing pixels of \a surface, which must already be sized to match the ImageSource
+	template<typename T>
+	static ImageTargetMemoryRef	createRef( SurfaceT<T> &surface )
+	{
+		return createRef( surface.getData(), surface.getWidth(), surface.getHeight(), surface.getRowBytes(), ( sizeof(T) == 1 ) ? UINT8 : FLOAT32, CM_RGB,
+							ChannelOrder( surface.getChannelOrder().getImageIoChannelOrder() ) );
+	}
+
+	virtual void*	getRowPointer( int32_t row ) { return mData + row * mRowBytes; }
+
+	uint8_t*		getData() const { return mData; }
+	int32_t			getRowBytes() const { return mRowBytes; }
+
+  protected:
+	ImageTargetMemory( void *data, int32_t width, int32_t height, int32_t rowBytes, DataType dataType, ColorModel colorModel, ChannelOrder channelOrder );
+
+	uint8_t			*mData;
+	int32_t			mRowBytes;
 };
 
 //! Loads an image from the file path \a path. Optional \a extension parameter allows specification of a file type. For example, "jpg" would force the file to load as a JPEG
@@ -0,0 +1,77 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Exception.h"
+
+namespace cinder {
+
+struct ci_jpeg_source_info;
+
+typedef shared_ptr<class ImageSourceFileJpeg>	ImageSourceFileJpegRef;
+
+//! libjpeg-based JPEG loader, registered for "jpg", "jpeg" and "jpe"
+class ImageSourceFileJpeg : public ImageSource {
+  public:
+	class Options {
+	  public:
+		Options() : mScaleDenom( 1 ), mFastIdct( false ) {}
+
+		//! Decodes at 1 / \a denom of the full resolution in the DCT domain, which is much cheaper than decoding and then resizing. Legal values are 1, 2, 4 and 8.
+		Options&	scale( int32_t denom ) { mScaleDenom = denom; return *this; }
+		//! Trades a small amount of accuracy for a faster inverse DCT and cheaper chroma upsampling
+		Options&	fastIdct( bool fast = true ) { mFastIdct = fast; return *this; }
+
+		int32_t		getScaleDenom() const { return mScaleDenom; }
+		bool		isFastIdct() const { return mFastIdct; }
+
+	  protected:
+		int32_t		mScaleDenom;
+		bool		mFastIdct;
+	};
+
+	static ImageSourceFileJpegRef	createRef( DataSourceRef dataSourceRef, const Options &options = Options() );
+	static ImageSourceRef			createSourceRef( DataSourceRef dataSourceRef ) { return createRef( dataSourceRef ); }
+	~ImageSourceFileJpeg();
+
+	virtual void	load( ImageTargetRef target );
+
+	static void		registerSelf();
+
+  protected:
+	ImageSourceFileJpeg( DataSourceRef dataSourceRef, const Options &options );
+	bool		loadHeader( const Options &options );
+	bool		decode( ImageTargetRef target, RowFunc func, uint8_t *rowData, uint8_t *convertedData );
+
+	shared_ptr<ci_jpeg_source_info>		mInfo;
+	bool								mIsCmyk;
+};
+
+REGISTER_IMAGE_IO_FILE_HANDLER( ImageSourceFileJpeg )
+
+class ImageSourceFileJpegException : public ImageIoException {
+};
+
+} // namespace cinder
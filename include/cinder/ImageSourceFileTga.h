@@ -0,0 +1,57 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Buffer.h"
+
+namespace cinder {
+
+typedef shared_ptr<class ImageSourceFileTga>	ImageSourceFileTgaRef;
+
+//! Loads uncompressed 8 bit gray, 24 bit BGR and 32 bit BGRA TGA files, reading rows straight out of the DataSource's Buffer
+class ImageSourceFileTga : public ImageSource {
+  public:
+	static ImageSourceFileTgaRef	createRef( DataSourceRef dataSourceRef );
+	static ImageSourceRef			createSourceRef( DataSourceRef dataSourceRef ) { return createRef( dataSourceRef ); }
+
+	virtual void	load( ImageTargetRef target );
+
+	static void		registerSelf();
+
+  protected:
+	ImageSourceFileTga( DataSourceRef dataSourceRef );
+
+	Buffer			mBuffer;
+	size_t			mDataOffset;
+	size_t			mRowBytes;
+	bool			mIsBottomUp;
+};
+
+REGISTER_IMAGE_IO_FILE_HANDLER( ImageSourceFileTga )
+
+class ImageSourceFileTgaException : public ImageIoException {
+};
+
+} // namespace cinder
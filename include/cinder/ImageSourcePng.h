@@ -52,6 +52,7 @@ class ImageSourcePng : public ImageSource {
 	shared_ptr<ci_png_info>		mCiInfoPtr;
 	png_struct_def				*mPngPtr;
 	png_info_struct				*mInfoPtr;
+	int32_t						mNumPasses;
 };
 
 REGISTER_IMAGE_IO_FILE_HANDLER( ImageSourcePng )
@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Stream.h"
+
+#include <boost/function.hpp>
+#include <algorithm>
+
+struct png_struct_def;
+struct png_info_struct;
+
+namespace cinder {
+
+typedef shared_ptr<class ImageSourcePngProgressive>	ImageSourcePngProgressiveRef;
+
+/** \brief Incremental PNG loader built on libpng's progressive reader.
+ * Only the header is read at construction. load() then consumes the stream in small chunks as data arrives (from an IStreamUrl for example),
+ * converting rows into the target as soon as they are decoded and reporting them through the optional RowsCallback, so the image can be displayed
+ * before it has finished downloading. Non-interlaced images never hold more than a row; interlaced images keep one decoded copy of the image between passes.
+ * Not registered with ImageIoRegistrar; ImageSourcePng remains the default for "png". **/
+class ImageSourcePngProgressive : public ImageSource {
+  public:
+	//! Called as rows [\a rowBegin, \a rowEnd) of pass \a pass have been written to the target. Passes are numbered from 0 and only interlaced images have more than one.
+	typedef boost::function<void ( int32_t rowBegin, int32_t rowEnd, int32_t pass )>	RowsCallback;
+
+	static ImageSourcePngProgressiveRef	createRef( DataSourceRef dataSourceRef, size_t chunkSize = 8192 );
+	static ImageSourcePngProgressiveRef	createRef( IStreamRef stream, size_t chunkSize = 8192 );
+	~ImageSourcePngProgressive();
+
+	//! Sets \a callback to be called every \a rowsPerBlock rows, and at the end of each pass
+	void			setRowsCallback( const RowsCallback &callback, int32_t rowsPerBlock = 16 ) { mRowsCallback = callback; mRowsPerBlock = std::max<int32_t>( 1, rowsPerBlock ); }
+	//! Returns the number of passes load() will make over the image, which is 7 for Adam7 interlaced images and 1 otherwise
+	int32_t			getNumPasses() const { return mNumPasses; }
+
+	virtual void	load( ImageTargetRef target );
+
+  protected:
+	ImageSourcePngProgressive( IStreamRef stream, size_t chunkSize );
+
+	bool		readHeader();
+	bool		processData( uint8_t *data, size_t size );
+	void		infoCallback();
+	void		rowCallback( uint8_t *newRow, uint32_t rowNum, int32_t pass );
+	void		flushBlock( int32_t pass );
+
+	IStreamRef					mStream;
+	size_t						mChunkSize;
+	png_struct_def				*mPngPtr;
+	png_info_struct				*mInfoPtr;
+
+	int32_t						mNumPasses;
+	size_t						mRowBytes;
+	shared_ptr<uint8_t>			mImage;			// only allocated for interlaced images
+	bool						mHeaderRead, mFinished, mCallbackFailed;
+
+	ImageTargetRef				mTarget;
+	RowFunc						mRowFunc;
+	RowsCallback				mRowsCallback;
+	int32_t						mRowsPerBlock;
+	int32_t						mBlockBegin, mBlockEnd, mBlockPass;
+
+	friend struct ImageSourcePngProgressiveCallbacks;
+};
+
+class ImageSourcePngProgressiveException : public ImageIoException {
+};
+
+} // namespace cinder
@@ -0,0 +1,61 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/ImageIo.h"
+
+namespace cinder {
+
+typedef shared_ptr<class ImageTargetFileJpeg>	ImageTargetFileJpegRef;
+
+//! libjpeg-based JPEG writer, registered for "jpg", "jpeg" and "jpe". Alpha is discarded.
+class ImageTargetFileJpeg : public ImageTarget {
+  public:
+	static ImageTargetRef			createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData );
+	//! Creates a target directly, for use with writeImage( ImageTargetRef, ImageSourceRef ). \a quality is in the range [1,100]
+	static ImageTargetFileJpegRef	createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, int32_t quality );
+
+	virtual void*	getRowPointer( int32_t row );
+	virtual void	finalize();
+
+	//! Sets the compression quality in the range [1,100]. Default is \c DEFAULT_QUALITY
+	void			setQuality( int32_t quality ) { mQuality = quality; }
+	int32_t			getQuality() const { return mQuality; }
+
+	static void		registerSelf();
+
+	static const int32_t	DEFAULT_QUALITY = 90;
+
+  protected:
+	ImageTargetFileJpeg( DataTargetRef dataTarget, ImageSourceRef imageSource, int32_t quality );
+
+	shared_ptr<uint8_t>		mData;
+	int32_t					mRowBytes;
+	int32_t					mQuality;
+	DataTargetRef			mDataTarget;
+};
+
+REGISTER_IMAGE_IO_FILE_HANDLER( ImageTargetFileJpeg )
+
+} // namespace cinder
@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/ImageIo.h"
+
+#include <vector>
+
+namespace cinder {
+
+typedef shared_ptr<class ImageTargetFilePng>	ImageTargetFilePngRef;
+
+/** \brief zlib-based PNG writer which can filter and deflate on several threads.
+ * The image is split into row strips which are deflated independently, each primed with the previous strip's last 32k as a preset
+ * dictionary and ended on a byte boundary with a sync flush. The strips are then stitched into a single zlib stream so the file is
+ * an ordinary PNG, and compresses nearly as well as a serial encode. **/
+class ImageTargetFilePng : public ImageTarget {
+  public:
+	enum Filter { FILTER_NONE, FILTER_SUB, FILTER_UP, FILTER_AVERAGE, FILTER_PAETH, FILTER_ADAPTIVE };
+
+	class Options {
+	  public:
+		Options() : mCompressionLevel( 6 ), mNumThreads( 0 ), mFilter( FILTER_ADAPTIVE ) {}
+
+		//! zlib compression level, from 0 (store) to 9. Default is 6.
+		Options&	compressionLevel( int32_t level ) { mCompressionLevel = level; return *this; }
+		//! Number of threads used for filtering and deflating. 0, the default, uses one per hardware thread; 1 encodes serially.
+		Options&	numThreads( int32_t numThreads ) { mNumThreads = numThreads; return *this; }
+		//! Row filter. The default, FILTER_ADAPTIVE, picks the filter per row which minimizes the sum of absolute differences.
+		Options&	filter( Filter filter ) { mFilter = filter; return *this; }
+
+		int32_t		getCompressionLevel() const { return mCompressionLevel; }
+		int32_t		getNumThreads() const { return mNumThreads; }
+		Filter		getFilter() const { return mFilter; }
+
+	  protected:
+		int32_t		mCompressionLevel;
+		int32_t		mNumThreads;
+		Filter		mFilter;
+	};
+
+	static ImageTargetRef			createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData );
+	static ImageTargetFilePngRef	createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const Options &options );
+
+	virtual void*	getRowPointer( int32_t row );
+	virtual void	finalize();
+
+	static void		registerSelf();
+
+  protected:
+	ImageTargetFilePng( DataTargetRef dataTarget, ImageSourceRef imageSource, const Options &options );
+
+	struct Strip {
+		int32_t					mRowBegin, mRowEnd;
+		std::vector<uint8_t>	mDeflated;
+		uint32_t				mAdler;
+		bool					mFailed;
+	};
+
+	void		filterStrips( size_t threadIndex, size_t numThreads );
+	void		deflateStrips( size_t threadIndex, size_t numThreads );
+	void		runThreads( void (ImageTargetFilePng::*fn)( size_t, size_t ), size_t numThreads );
+	void		filterRow( int32_t row, uint8_t *scratch );
+	void		deflateStrip( size_t stripIndex );
+	static void	writeChunk( OStreamRef stream, const char *type, const uint8_t *data, size_t size );
+
+	shared_ptr<uint8_t>		mData;
+	int32_t					mRowBytes;
+	uint8_t					mBytesPerPixel;
+	Options					mOptions;
+	DataTargetRef			mDataTarget;
+
+	std::vector<uint8_t>	mFiltered;		// each row prefixed with its filter type byte
+	std::vector<Strip>		mStrips;
+};
+
+REGISTER_IMAGE_IO_FILE_HANDLER( ImageTargetFilePng )
+
+} // namespace cinder
@@ -0,0 +1,55 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/ImageIo.h"
+
+namespace cinder {
+
+typedef shared_ptr<class ImageTargetFilePnm>	ImageTargetFilePnmRef;
+
+/** Writes binary Netpbm images. "pgm" and "ppm" write 8 or 16 bit gray and RGB respectively, "pnm" picks based on the source, and "pfm" writes 32 bit float.
+ * The header and raster are assembled in one allocation and written with a single OStream::writeData(). Alpha is discarded. **/
+class ImageTargetFilePnm : public ImageTarget {
+  public:
+	static ImageTargetRef	createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData );
+
+	virtual void*	getRowPointer( int32_t row );
+	virtual void	finalize();
+
+	static void		registerSelf();
+
+  protected:
+	ImageTargetFilePnm( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData );
+
+	shared_ptr<uint8_t>		mData;
+	size_t					mHeaderSize;
+	int32_t					mRowBytes;
+	bool					mIsPfm;
+	DataTargetRef			mDataTarget;
+};
+
+REGISTER_IMAGE_IO_FILE_HANDLER( ImageTargetFilePnm )
+
+} // namespace cinder
@@ -0,0 +1,40 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+
+namespace cinder { namespace lz4 {
+
+/** A small implementation of the LZ4 block format, for when compression speed matters more than ratio.
+ * The output is compatible with LZ4_decompress_safe(), but blocks carry no size information; callers need to store the decompressed size themselves. **/
+
+//! Returns the largest size compress() can produce for \a srcSize bytes of input
+size_t	compressBound( size_t srcSize );
+//! Compresses \a srcSize bytes from \a src into \a dst, returning the compressed size, or 0 if \a dstCapacity is too small.
+//! A \a searchDepth above 0 selects the high compression mode, which follows hash chains up to \a searchDepth candidates deep per position.
+size_t	compress( const void *src, size_t srcSize, void *dst, size_t dstCapacity, int searchDepth = 0 );
+//! Decompresses \a srcSize bytes from \a src into exactly \a dstSize bytes at \a dst. Returns \c false if the data is malformed or does not decompress to \a dstSize bytes.
+bool	decompress( const void *src, size_t srcSize, void *dst, size_t dstSize );
+
+} } // namespace cinder::lz4
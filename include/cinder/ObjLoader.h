@@ -26,8 +26,6 @@
 #include "cinder/Stream.h"
 
 #include <boost/logic/tribool.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
-#include <map>
 
 namespace cinder {
 
@@ -46,8 +44,9 @@ class ObjLoader {
  public:
 	/**Constructs and does the parsing of the file
 	 * \param includeUVs  if false UV coordinates will be skipped, which can provide a faster load time
+	 * \param parallelParse  if true large files are split into chunks which are parsed on multiple threads
 	**/
-	 ObjLoader( shared_ptr<IStream> aStream, bool includeUVs = true );
+	 ObjLoader( shared_ptr<IStream> aStream, bool includeUVs = true, bool parallelParse = true );
 	~ObjLoader();
 
 	/**Loads all the groups present in the file into a single TriMesh
@@ -62,31 +61,36 @@ class ObjLoader {
 	 * \param optimizeVertices  should the loader minimize the vertices by identifying shared vertices between faces.*/
 	void	load( size_t groupIndex, TriMesh *destTriMesh, boost::tribool loadNormals = boost::logic::indeterminate, boost::tribool loadTexCoords = boost::logic::indeterminate, bool optimizeVertices = true );
 	
+	//! Returns the number of groups in the file
+	size_t	getNumGroups() const { return mGroups.size(); }
+
+	//! A face's indices live in its Group's index arrays, starting at \a mFirstIndex. Missing texture coordinate and normal indices are stored as -1.
 	struct Face {
 		int					mNumVertices;
-		std::vector<int>	mVertexIndices;
-		std::vector<int>	mTexCoordIndices;
-		std::vector<int>	mNormalIndices;
+		size_t				mFirstIndex;
+		bool				mHasTexCoords;
+		bool				mHasNormals;
 	};
 
 	struct Group {
 		std::string				mName;
 		int						mBaseVertexOffset, mBaseTexCoordOffset, mBaseNormalOffset;
 		std::vector<Face>		mFaces;
+		std::vector<int>		mVertexIndices, mTexCoordIndices, mNormalIndices;
 		bool					mHasTexCoords;
 		bool					mHasNormals;
 	};
 	
  private:
-	typedef boost::tuple<int,int> VertexPair;
-	typedef boost::tuple<int,int,int> VertexTriple;
+	class VertexWelder;
 
- 	void	parseFace( Group *group, const std::string &s, bool includeUVs );
+	void	parse( const char *data, size_t dataSize, bool includeUVs, bool parallelParse );
+	size_t	estimateUniqueVertices( size_t numIndices ) const;
 	void	loadInternalNoOptimize( const Group &group, TriMesh *destTriMesh, bool texCoords, bool normals );
-	void	loadInternalNormalsTextures( const Group &group, std::map<boost::tuple<int,int,int>,int> &uniqueVerts, TriMesh *destTriMesh );
-	void	loadInternalNormals( const Group &group, std::map<boost::tuple<int,int>,int> &uniqueVerts, TriMesh *destTriMesh );
-	void	loadInternalTextures( const Group &group, std::map<boost::tuple<int,int>,int> &uniqueVerts, TriMesh *destTriMesh );
-	void	loadInternal( const Group &group, std::map<int,int> &uniqueVerts, TriMesh *destTriMesh );	
+	void	loadInternalNormalsTextures( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh );
+	void	loadInternalNormals( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh );
+	void	loadInternalTextures( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh );
+	void	loadInternal( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh );	
  
 	shared_ptr<IStream>		mStream;
 	std::vector<Vec3f>		mVertices, mNormals;
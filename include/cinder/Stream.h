@@ -29,6 +29,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <string>
+#include <vector>
 #ifndef __OBJC__
 #	include <boost/iostreams/concepts.hpp>
 #	include <boost/iostreams/stream.hpp>
@@ -84,6 +85,18 @@ class OStream : public virtual StreamBase {
 	template<typename T>
 	void		writeLittle( T t );
 
+	//! Writes \a count elements of type \a T from \a t with a single write
+	template<typename T>
+	void		write( const T *t, size_t count );
+	template<typename T>
+	void		writeEndian( const T *t, size_t count, uint8_t endian ) { if ( endian == STREAM_BIG_ENDIAN ) writeBig( t, count ); else writeLittle( t, count ); }
+	//! Writes \a count elements of type \a T from \a t as big endian, swapping them in blocks when necessary
+	template<typename T>
+	void		writeBig( const T *t, size_t count );
+	//! Writes \a count elements of type \a T from \a t as little endian, swapping them in blocks when necessary
+	template<typename T>
+	void		writeLittle( const T *t, size_t count );
+
 	void		write( const Buffer &buffer );
 	void		writeData( const void *src, size_t size );
 
@@ -108,10 +121,23 @@ class IStream : public virtual StreamBase {
 	void		readBig( T *t );
 	template<typename T>
 	void		readLittle( T *t );
+
+	//! Reads \a count elements of type \a T into \a t with a single read
+	template<typename T>
+	void		read( T *t, size_t count );
+	template<typename T>
+	void		readEndian( T *t, size_t count, uint8_t endian ) { if ( endian == STREAM_BIG_ENDIAN ) readBig( t, count ); else readLittle( t, count ); }
+	//! Reads \a count big endian elements of type \a T into \a t, swapping them in place when necessary
+	template<typename T>
+	void		readBig( T *t, size_t count );
+	//! Reads \a count little endian elements of type \a T into \a t, swapping them in place when necessary
+	template<typename T>
+	void		readLittle( T *t, size_t count );
 	
 	void		readFixedString( char *t, size_t maxSize, bool nullTerminate );
 	void		readFixedString( std::string *t, size_t size );
-	std::string	readLine();
+	//! Reads up to the next line ending, which may be LF, CRLF or CR, and returns the line without it
+	virtual std::string	readLine();
 	
 	void			readData( void *dest, size_t size );
 	virtual size_t	readDataAvailable( void *dest, size_t maxSize ) = 0;
@@ -142,10 +168,11 @@ typedef shared_ptr<class IStreamFile>	IStreamFileRef;
 class IStreamFile : public IStream {
  public:
 	//! Creates a new IStreamFileRef from a C-style file pointer \a FILE as returned by fopen(). If \a ownsFile the returned stream will destroy the stream upon its own destruction.
-	static IStreamFileRef createRef( FILE *file, bool ownsFile = true, int32_t defaultBufferSize = 2048 );
+	static IStreamFileRef createRef( FILE *file, bool ownsFile = true, int32_t defaultBufferSize = DEFAULT_BUFFER_SIZE );
 	~IStreamFile();
 
 	size_t		readDataAvailable( void *dest, size_t maxSize );
+	std::string	readLine();
 	
 	void		seekAbsolute( off_t absoluteOffset );
 	void		seekRelative( off_t relativeOffset );
@@ -156,19 +183,35 @@ class IStreamFile : public IStream {
 	
 	FILE*		getFILE() { return mFile; }
 
+	//! Enables reading the next block of the file on a background thread while the current one is consumed. Most useful for parsers reading large files front to back.
+	void		setReadAhead( bool readAhead = true );
+	bool		getReadAhead() const { return mReadAhead.get() != 0; }
+
+	//! The buffer starts at the default size and doubles with each sequential refill up to this size
+	static const size_t	MAX_BUFFER_SIZE = 1024 * 1024;
+	static const int32_t DEFAULT_BUFFER_SIZE = 8192;
+
  protected:
-	IStreamFile( FILE *aFile, bool aOwnsFile = true, int32_t aDefaultBufferSize = 2048 );
+	IStreamFile( FILE *aFile, bool aOwnsFile = true, int32_t aDefaultBufferSize = DEFAULT_BUFFER_SIZE );
 
 	virtual void		IORead( void *t, size_t size );
+
+	//! Refills the buffer starting at mBufferOffset. Returns \c false at the end of the file.
+	bool				fillBuffer();
+	void				waitForReadAhead() const;
  
+	struct ReadAhead;
+
 	FILE					*mFile;
 	bool					mOwnsFile;
 	size_t					mBufferSize, mDefaultBufferSize;
+	size_t					mBufferCapacity, mBufferAllocatedSize;
 	shared_ptr<uint8_t>	mBuffer;
 	off_t					mBufferOffset; // actual offset to do IO from; incremented by IO
 	off_t					mBufferFileOffset; // beginning of the buffer in the file
 	mutable off_t			mSize;
 	mutable bool			mSizeCached;
+	shared_ptr<ReadAhead>	mReadAhead;
 };
 
 
@@ -202,7 +245,7 @@ typedef shared_ptr<class IoStreamFile>		IoStreamFileRef;
 class IoStreamFile : public IoStream {
  public:
 	//! Creates a new IoStreamFileRef from a C-style file pointer \a FILE as returned by fopen(). If \a ownsFile the returned stream will destroy the stream upon its own destruction.
-	static IoStreamFileRef createRef( FILE *file, bool ownsFile = true, int32_t defaultBufferSize = 2048 );
+	static IoStreamFileRef createRef( FILE *file, bool ownsFile = true, int32_t defaultBufferSize = IStreamFile::DEFAULT_BUFFER_SIZE );
 	~IoStreamFile();
 
 	size_t		readDataAvailable( void *dest, size_t maxSize );
@@ -217,7 +260,7 @@ class IoStreamFile : public IoStream {
 	FILE*		getFILE() { return mFile; }
 
  protected:
-	IoStreamFile( FILE *aFile, bool aOwnsFile = true, int32_t aDefaultBufferSize = 2048 );
+	IoStreamFile( FILE *aFile, bool aOwnsFile = true, int32_t aDefaultBufferSize = IStreamFile::DEFAULT_BUFFER_SIZE );
 	
 	virtual void		IORead( void *t, size_t size );
 	virtual void		IOWrite( const void *t, size_t size );
@@ -238,9 +281,12 @@ class IStreamMem : public IStream {
  public:
 	//! Creates a new IStreamMemRef from the memory pointed to by \a data which is of size \a size bytes.
 	static IStreamMemRef		createRef( const void *data, size_t size );
+	//! Creates a new IStreamMemRef which reads the data of \a buffer without copying it, keeping \a buffer alive for as long as the stream exists
+	static IStreamMemRef		createRef( const Buffer &buffer );
 	~IStreamMem();
 
 	size_t		readDataAvailable( void *dest, size_t maxSize );
+	std::string	readLine();
 	
 	void		seekAbsolute( off_t absoluteOffset );
 	void		seekRelative( off_t relativeOffset );
@@ -263,30 +309,126 @@ class IStreamMem : public IStream {
 	const uint8_t	*mData;
 	size_t			mDataSize;
 	size_t			mOffset;
+	Buffer			mBuffer;	// keeps the data alive when created from a Buffer
 };
 
 
+typedef shared_ptr<class IStreamMmap>	IStreamMmapRef;
+
+//! Read-only stream over a memory-mapped file. Reads are served directly from the mapping, and getBuffer() exposes the file's contents without copying them.
+class IStreamMmap : public IStream {
+ public:
+	enum AccessHint { ACCESS_NORMAL, ACCESS_SEQUENTIAL, ACCESS_RANDOM };
+
+	//! Maps the file located at \a path for read access. Returns a NULL ref if the file can't be opened or mapped, which includes empty files.
+	static IStreamMmapRef	createRef( const std::string &path, AccessHint hint = ACCESS_SEQUENTIAL );
+	~IStreamMmap();
+
+	size_t		readDataAvailable( void *dest, size_t maxSize );
+	std::string	readLine();
+
+	void		seekAbsolute( off_t absoluteOffset );
+	void		seekRelative( off_t relativeOffset );
+	//! Returns the current offset into the stream in bytes. Throws StreamExc if it doesn't fit in an \c off_t, which is 32 bits on Windows; use getOffset() instead for large files.
+	off_t		tell() const;
+	//! Returns the total length of stream in bytes. Throws StreamExc if it doesn't fit in an \c off_t; use getDataSize() instead for large files.
+	off_t		size() const;
+
+	//! Returns the current offset into the mapping in bytes. Unlike tell() this is not limited by the width of \c off_t.
+	uint64_t	getOffset() const { return mOffset; }
+	//! Moves to \a offset bytes from the beginning of the mapping. Unlike seekAbsolute() this is not limited by the width of \c off_t.
+	void		setOffset( uint64_t offset );
+
+	//! Returns whether the stream is currently pointed at the end of the file
+	bool		isEof() const;
+
+	//! Returns a pointer to the mapped contents of the file
+	const void*	getData() const { return reinterpret_cast<const void*>( mData ); }
+	//! Returns the size of the mapping in bytes. Unlike size() this is not limited by the width of \c off_t.
+	uint64_t	getDataSize() const { return mDataSize; }
+	//! Returns a Buffer wrapping the mapping without a copy. The mapping stays valid for the lifetime of the Buffer, even once the stream is destroyed.
+	Buffer		getBuffer();
+
+	//! Advises the OS how the mapping will be accessed, which controls its read-ahead. Ignored on Windows, where the hint is only honored at creation.
+	void		setAccessHint( AccessHint hint );
+	//! Asks the OS to start paging in \a length bytes beginning at \a offset ahead of their use. A no-op where unsupported.
+	void		prefetch( uint64_t offset, uint64_t length );
+
+ protected:
+	struct Mapping;
+
+	IStreamMmap( shared_ptr<Mapping> mapping );
+
+	virtual void	IORead( void *t, size_t size );
+
+	shared_ptr<Mapping>	mMapping;
+	const uint8_t		*mData;
+	uint64_t			mDataSize;
+	uint64_t			mOffset;
+};
+
+
+typedef shared_ptr<class OStreamMem>		OStreamMemRef;
+
+/** \brief An OStream which writes to memory.
+ * Data is stored in a list of chunks which grow geometrically, so written data is never moved or copied as the stream grows. getBuffer()
+ * flattens the chunks into one the first time contiguous data is needed, and createBuffer() and createIStream() then share that memory
+ * without copying. reserve() and patch() fill in headers whose contents are only known once the data following them has been written. **/
 class OStreamMem : public OStream {
  public:
+	//! Creates a new OStreamMemRef whose first chunk is \a bufferSizeHint bytes
+	static OStreamMemRef	createRef( size_t bufferSizeHint = DEFAULT_CHUNK_SIZE );
 	~OStreamMem();
 
 	virtual off_t		tell() const { return static_cast<off_t>( mOffset ); }
+	//! Seeking past the end is allowed. The gap reads as zeros once anything is written after it.
 	virtual void		seekAbsolute( off_t absoluteOffset );
 	virtual void		seekRelative( off_t relativeOffset );
 
-	void*				getBuffer() { return mBuffer; }
-	
+	//! Returns the size of the data written so far
+	size_t				getDataSize() const { return mDataSize; }
+	//! Returns the data written so far as a single contiguous block, flattening the chunks first if necessary. Calling it again after further writes may flatten anew, freeing the previous block unless a Buffer shares it.
+	void*				getBuffer();
+	//! Returns the data written so far as a Buffer which shares the stream's memory, flattening the chunks first if necessary
+	Buffer				createBuffer();
+	//! Returns an IStreamMem which reads the data written so far, sharing the stream's memory
+	IStreamMemRef		createIStream();
+
+	//! Skips \a size bytes at the current position to be filled in later with patch(), and returns their offset
+	off_t				reserve( size_t size );
+	//! Overwrites \a size bytes at \a offset, which must be within the data written so far, with \a data. The stream's position is unchanged.
+	void				patch( off_t offset, const void *data, size_t size );
+	//! Overwrites the value at \a offset with \a t, as with patch()
+	template<typename T>
+	void				patch( off_t offset, T t ) { patch( offset, &t, sizeof(T) ); }
+
+	static const size_t	DEFAULT_CHUNK_SIZE = 4096;
+	static const size_t	MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+
  protected:
 	OStreamMem( size_t bufferSizeHint );
 
 	virtual void		IOWrite( const void *t, size_t size );
 
-	void			*mBuffer;
-	size_t			mDataSize;
-	size_t			mOffset;
+	struct Chunk {
+		shared_ptr<uint8_t>	mData;
+		size_t				mStart, mSize;
+	};
+
+	//! Copies \a size bytes from \a src to \a offset, or zeros them if \a src is NULL, spanning chunks as needed
+	void				copyIn( size_t offset, const uint8_t *src, size_t size );
+	void				addChunk( size_t minSize );
+	size_t				findChunk( size_t offset );
+	void				flatten();
+
+	std::vector<Chunk>	mChunks;
+	size_t				mCapacity;		// total size of all chunks
+	size_t				mDataSize;		// furthest extent of any write
+	size_t				mOffset;
+	size_t				mLastChunk;		// chunk of the most recent write, checked first by findChunk()
+	size_t				mFirstChunkSize;
 };
 
-typedef shared_ptr<OStreamMem>		OStreamMemRef;
 
 
 // This class is a utility to save and restore a stream's state
@@ -304,6 +446,8 @@ class IStreamStateRestore {
 
 //! Opens the file lcoated at \a path for read access as a stream.
 IStreamFileRef	loadFileStream( const std::string &path );
+//! Opens the file located at \a path as a memory-mapped stream. Returns a NULL ref if the file can't be mapped, in which case loadFileStream() is the fallback.
+IStreamMmapRef	loadFileStreamMmap( const std::string &path, IStreamMmap::AccessHint hint = IStreamMmap::ACCESS_SEQUENTIAL );
 //! Opens the file located at \a path for write access as a stream, and creates it if it does not exist. Optionally creates any intermediate directories when \a createParents is true.
 OStreamFileRef	writeFileStream( const std::string &path, bool createParents = true );
 //! Opens a path for read-write access as a stream.
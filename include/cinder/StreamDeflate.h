@@ -0,0 +1,118 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/Stream.h"
+
+struct z_stream_s;
+
+namespace cinder {
+
+//! The header and trailer wrapped around deflate data. Matches zlib's windowBits conventions.
+enum DeflateFraming { DEFLATE_FRAMING_ZLIB, DEFLATE_FRAMING_GZIP, DEFLATE_FRAMING_RAW, 
+						//! Only valid for reading; detects zlib or gzip from the header
+						DEFLATE_FRAMING_AUTO };
+
+typedef shared_ptr<class IStreamDeflate>	IStreamDeflateRef;
+
+/** \brief Decompresses deflate data incrementally as it is read from another stream.
+ * Memory use is bounded by two fixed-size chunks regardless of the size of the data. Concatenated gzip members are read as one stream.
+ * Seeking forward decompresses and discards; seeking backward restarts decompression from the beginning, so random access is slow. **/
+class IStreamDeflate : public IStream {
+ public:
+	//! Creates a stream decompressing from \a source, beginning at its current position
+	static IStreamDeflateRef	createRef( IStreamRef source, DeflateFraming framing = DEFLATE_FRAMING_AUTO, size_t chunkSize = 16384 );
+	~IStreamDeflate();
+
+	size_t		readDataAvailable( void *dest, size_t maxSize );
+
+	void		seekAbsolute( off_t absoluteOffset );
+	void		seekRelative( off_t relativeOffset );
+	//! Returns the current offset into the decompressed data in bytes
+	off_t		tell() const { return mOffset; }
+	//! Returns the decompressed size in bytes. The first call decompresses all of the data to find it.
+	off_t		size() const;
+	bool		isEof() const;
+
+ protected:
+	IStreamDeflate( IStreamRef source, DeflateFraming framing, size_t chunkSize );
+
+	virtual void	IORead( void *t, size_t size );
+
+	//! Decompresses the next chunk into mOut. Returns \c false at the end of the data.
+	bool		fillOutput();
+	void		restart();
+
+	IStreamRef					mSource;
+	off_t						mSourceStart;
+	DeflateFraming				mFraming;
+	shared_ptr<z_stream_s>		mZStream;
+	size_t						mChunkSize;
+	shared_ptr<uint8_t>			mIn, mOut;
+	size_t						mOutPos, mOutSize;
+	bool						mStreamEnd;
+	off_t						mOffset;
+	mutable off_t				mSize;
+	mutable bool				mSizeCached;
+};
+
+typedef shared_ptr<class OStreamDeflate>	OStreamDeflateRef;
+
+/** \brief Compresses data incrementally as it is written, passing it on to another stream.
+ * The trailer is written by finish(), or by the destructor if finish() was never called. Call finish() explicitly to be notified of errors. **/
+class OStreamDeflate : public OStream {
+ public:
+	//! Creates a stream compressing into \a sink. \a compressionLevel ranges from 0 (none) to 9 (smallest).
+	static OStreamDeflateRef	createRef( OStreamRef sink, DeflateFraming framing = DEFLATE_FRAMING_ZLIB, int compressionLevel = DEFAULT_COMPRESSION_LEVEL, size_t chunkSize = 16384 );
+	~OStreamDeflate();
+
+	//! Writes everything compressed so far to the sink, so a reader can decompress up to this point. Costs a few bytes of compression each call.
+	void		flush();
+	//! Completes the compressed data and writes its trailer. No writes are allowed afterwards.
+	void		finish();
+
+	//! Returns the number of uncompressed bytes written
+	off_t		tell() const { return mOffset; }
+	//! Compressed streams can't seek. Throws StreamExc unless the seek is a no-op.
+	void		seekAbsolute( off_t absoluteOffset );
+	void		seekRelative( off_t relativeOffset );
+
+ protected:
+	OStreamDeflate( OStreamRef sink, DeflateFraming framing, int compressionLevel, size_t chunkSize );
+
+	virtual void	IOWrite( const void *t, size_t size );
+	void			deflateAndWrite( const void *data, size_t size, int flush );
+
+	OStreamRef					mSink;
+	shared_ptr<z_stream_s>		mZStream;
+	size_t						mChunkSize;
+	shared_ptr<uint8_t>			mOut;
+	bool						mFinished;
+	off_t						mOffset;
+};
+
+class StreamDeflateExc : public StreamExc {
+};
+
+} // namespace cinder
@@ -24,26 +24,59 @@
 
 #include <vector>
 #include "cinder/Vector.h"
+#include "cinder/Color.h"
 #include "cinder/AxisAlignedBox.h"
 #include "cinder/Stream.h"
+#include "cinder/Buffer.h"
+#include "cinder/Exception.h"
 
 namespace cinder {
 
 class TriMesh {
  public:
+	//! Options for write()
+	class WriteOptions {
+	  public:
+		WriteOptions() : mVersion( 2 ), mCompressed( false ), mCodec( CODEC_LZ4 ) {}
+
+		//! Writes the file format \a version, either 2 (the default) or 1, which older code can read but which can't store colors
+		WriteOptions&	version( uint8_t version ) { mVersion = version; return *this; }
+		//! Compresses each section of a version 2 file with \a codec. Uncompressed sections, the default, are read with a single copy each.
+		WriteOptions&	compression( CompressionCodec codec ) { mCompressed = true; mCodec = codec; return *this; }
+
+		uint8_t				getVersion() const { return mVersion; }
+		bool				isCompressed() const { return mCompressed; }
+		CompressionCodec	getCodec() const { return mCodec; }
+
+	  private:
+		uint8_t				mVersion;
+		bool				mCompressed;
+		CompressionCodec	mCodec;
+	};
+
+	//! Attributes of the interleaved vertex buffer built by interleave()
+	enum { INTERLEAVE_POSITIONS = 1, INTERLEAVE_NORMALS = 2, INTERLEAVE_COLORS_RGB = 4, INTERLEAVE_COLORS_RGBA = 8, INTERLEAVE_TEXCOORDS = 16, INTERLEAVE_TANGENTS = 32 };
+
+	TriMesh() : mInterleavedAttributes( 0 ), mInterleavedStride( 0 ) {}
 
 	void		clear();
 	
 	bool		hasNormals() const { return ! mNormals.empty(); }
 	bool		hasTexCoords() const { return ! mTexCoords.empty(); }
+	bool		hasColorsRGB() const { return ! mColorsRGB.empty(); }
+	bool		hasColorsRGBA() const { return ! mColorsRGBA.empty(); }
+	bool		hasTangents() const { return ! mTangents.empty(); }
 
-	void		appendVertex( const Vec3f &v ) { mVertices.push_back( v ); }
+	void		appendVertex( const Vec3f &v ) { mVertices.push_back( v ); discardInterleaved(); }
 	void		appendVertices( const Vec4d *verts, size_t num );
-	void		appendNormal( const Vec3f &v ) { mNormals.push_back( v ); }
+	void		appendNormal( const Vec3f &v ) { mNormals.push_back( v ); discardInterleaved(); }
 	void		appendNormals( const Vec4d *normals, size_t num );
-	void		appendTexCoord( const Vec2f &v ) { mTexCoords.push_back( v ); }
+	void		appendTexCoord( const Vec2f &v ) { mTexCoords.push_back( v ); discardInterleaved(); }
+	void		appendColorRGB( const Color &c ) { mColorsRGB.push_back( c ); discardInterleaved(); }
+	void		appendColorRGBA( const ColorA &c ) { mColorsRGBA.push_back( c ); discardInterleaved(); }
+	void		appendTangent( const Vec4f &t ) { mTangents.push_back( t ); discardInterleaved(); }
 	void		appendTriangle( size_t v0, size_t v1, size_t v2 )
-	{ mIndices.push_back( v0 ); mIndices.push_back( v1 ); mIndices.push_back( v2 ); }
+	{ mIndices.push_back( static_cast<uint32_t>( v0 ) ); mIndices.push_back( static_cast<uint32_t>( v1 ) ); mIndices.push_back( static_cast<uint32_t>( v2 ) ); }
 
 	size_t		getNumIndices() const { return mIndices.size(); }
 	size_t		getNumTriangles() const { return mIndices.size() / 3; }
@@ -52,18 +85,83 @@ class TriMesh {
 	const std::vector<Vec3f>&	getVertices() const { return mVertices; }
 	const std::vector<Vec3f>&	getNormals() const { return mNormals; }
 	const std::vector<Vec2f>&	getTexCoords() const { return mTexCoords; }	
-	const std::vector<size_t>&		getIndices() const { return mIndices; }		
+	const std::vector<Color>&	getColorsRGB() const { return mColorsRGB; }
+	const std::vector<ColorA>&	getColorsRGBA() const { return mColorsRGBA; }
+	//! Each tangent's \a w is the handedness of the texture space, 1 or -1. The bitangent is the normal crossed with the tangent's \a xyz, times \a w.
+	const std::vector<Vec4f>&	getTangents() const { return mTangents; }
+	//! Indices are always 32 bits wide, which matches GL_UNSIGNED_INT regardless of the platform's pointer size
+	const std::vector<uint32_t>&	getIndices() const { return mIndices; }		
+	//! Returns whether every index fits in 16 bits, which allows them to be drawn as GL_UNSIGNED_SHORT
+	bool		hasShortIndices() const { return mVertices.size() <= 65536; }
 
 	AxisAlignedBox3f	calcBoundingBox() const;
+	//! Returns the average number of post-transform cache misses per triangle (ACMR) for a FIFO cache of \a cacheSize vertices. 3 is the worst case; a regular grid can approach 0.5.
+	float				calcAcmr( size_t cacheSize = 16 ) const;
+
+	//! Reorders the triangles for the post-transform vertex cache, using Tom Forsyth's linear-speed algorithm tuned for an LRU cache of \a cacheSize vertices
+	void		optimizeVertexCache( size_t cacheSize = 32 );
+	//! Sorts clusters of triangles so that those facing outward from the mesh's center are drawn first, which reduces overdraw. Clusters are split wherever that costs at most a factor of \a threshold in ACMR. Expects triangles already ordered by optimizeVertexCache().
+	void		optimizeOverdraw( float threshold = 1.05f );
+	//! Renumbers the vertices in the order the indices first reference them, so vertex fetch walks memory sequentially. Unreferenced vertices move to the end.
+	void		optimizeVertexFetch();
+	//! Runs optimizeVertexCache(), optimizeOverdraw() and optimizeVertexFetch() with their defaults
+	void		optimize();
+
+	/** Replaces the normals with the sum of the normals of each vertex's triangles, weighted by the triangles' areas, or by the angles at the vertex if \a angleWeighted.
+	 *  Vertices are treated individually, so those duplicated along a texture seam keep a hard edge. If \a parallel, large meshes are processed on multiple threads. **/
+	void		recalculateNormals( bool angleWeighted = false, bool parallel = true );
+	/** Replaces the tangents with the area-weighted sum of each vertex's triangles' texture space directions, made orthogonal to the vertex's normal.
+	 *  Throws TriMeshExcMissingAttribute unless every vertex has a normal and a texture coordinate. If \a parallel, large meshes are processed on multiple threads. **/
+	void		recalculateTangents( bool parallel = true );
+
+	/** Packs \a attributes, those of them the mesh has for every vertex, into a single interleaved vertex buffer. Colors are RGB if the mesh has both kinds.
+	 *  Attributes are in the order positions, normals, colors, texture coordinates and tangents, which is the order VboMesh::Layout interleaves
+	 *  static data in, with tangents as the first static custom Vec4f. A VboMesh made from the mesh with a matching layout uploads the buffer with a single copy.
+	 *  The buffer is a read-only upload cache alongside the separate attributes, which remain authoritative: changing the mesh's vertices or their attributes discards it. **/
+	void		interleave( uint32_t attributes = INTERLEAVE_POSITIONS | INTERLEAVE_NORMALS | INTERLEAVE_COLORS_RGB | INTERLEAVE_COLORS_RGBA | INTERLEAVE_TEXCOORDS );
+	bool		isInterleaved() const { return mInterleavedAttributes != 0; }
+	//! Returns which attributes the interleaved vertex buffer holds, or 0 if there isn't one
+	uint32_t	getInterleavedAttributes() const { return mInterleavedAttributes; }
+	//! Returns the size in bytes of an interleaved vertex
+	size_t		getInterleavedStride() const { return mInterleavedStride; }
+	//! Returns the offset in bytes of \a attribute within an interleaved vertex
+	size_t		getInterleavedOffset( uint32_t attribute ) const;
+	//! Returns the interleaved vertex buffer built by interleave(), or NULL if there isn't one
+	const float*	getInterleavedData() const { return mInterleaved.empty() ? 0 : &mInterleaved[0]; }
 
+	//! Reads a TriMesh written by write() in either version of the format, replacing the current contents. Reading from an IStreamMmap avoids an intermediate copy of compressed sections.
 	void		read( IStream *in );
-	void		write( OStream *out ) const;
+	void		write( OStream *out, const WriteOptions &options = WriteOptions() ) const;
 	
  private:
+	void		readVersion1( IStream *in );
+	void		readVersion2( IStream *in, off_t start );
+	void		writeVersion1( OStream *out ) const;
+	void		writeVersion2( OStream *out, const WriteOptions &options ) const;
+	void		discardInterleaved() { mInterleaved.clear(); mInterleavedAttributes = 0; mInterleavedStride = 0; }
+
 	std::vector<Vec3f>		mVertices;
 	std::vector<Vec3f>		mNormals;
 	std::vector<Vec2f>		mTexCoords;
-	std::vector<size_t>		mIndices;
+	std::vector<Color>		mColorsRGB;
+	std::vector<ColorA>		mColorsRGBA;
+	std::vector<Vec4f>		mTangents;
+	std::vector<uint32_t>	mIndices;
+
+	std::vector<float>		mInterleaved;
+	uint32_t				mInterleavedAttributes;
+	size_t					mInterleavedStride;
+};
+
+class TriMeshExc : public Exception {
+};
+
+//! Thrown by TriMesh::read() for data that isn't a TriMesh, or is from an unsupported version
+class TriMeshExcInvalidData : public TriMeshExc {
+};
+
+//! Thrown by TriMesh::recalculateTangents() for a mesh without a normal and a texture coordinate for every vertex
+class TriMeshExcMissingAttribute : public TriMeshExc {
 };
 
 } // namespace cinder
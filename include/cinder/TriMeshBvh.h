@@ -0,0 +1,73 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/TriMesh.h"
+#include "cinder/Ray.h"
+
+#include <vector>
+#include <limits>
+
+namespace cinder {
+
+/** \brief A bounding volume hierarchy over a TriMesh's triangles, for ray casts and nearest point queries that visit a few dozen triangles rather than all of them.
+ * The tree is split by the surface area heuristic, evaluated over a fixed number of bins per axis, and large meshes are built on multiple threads.
+ * Nodes are stored depth first, each with its first child immediately after it, and each leaf's triangles are copied contiguously alongside.
+ * The BVH holds its own copy of the triangles, so the mesh can be discarded afterwards but later changes to it aren't reflected. **/
+class TriMeshBvh {
+  public:
+	//! Where a query met the mesh
+	struct Hit {
+		//! The index of the triangle in the source mesh
+		size_t		mTriangle;
+		//! The distance along the ray, in multiples of its direction, or from the query point
+		float		mDistance;
+		//! The barycentric coordinates of the point, which is the triangle's first vertex * ( 1 - u - v ) + its second * u + its third * v
+		float		mU, mV;
+		Vec3f		mPosition;
+	};
+
+	//! Builds the hierarchy over \a mesh's triangles. If \a parallel, large meshes are built on multiple threads, which produces the same tree.
+	TriMeshBvh( const TriMesh &mesh, bool parallel = true );
+
+	//! Finds the first triangle \a ray hits, from either side, within \a maxDistance along it. Returns false if there's none, leaving \a result untouched.
+	bool		intersect( const Ray &ray, Hit *result, float maxDistance = std::numeric_limits<float>::max() ) const;
+	//! Returns whether \a ray hits any triangle within \a maxDistance along it, which stops at the first one found rather than the nearest
+	bool		intersects( const Ray &ray, float maxDistance = std::numeric_limits<float>::max() ) const;
+	//! Replaces \a result with every triangle \a ray hits within \a maxDistance along it, sorted by distance. Returns their number.
+	size_t		intersectAll( const Ray &ray, std::vector<Hit> *result, float maxDistance = std::numeric_limits<float>::max() ) const;
+	//! Finds the point on the mesh closest to \a point, if any lies within \a maxDistance of it. Returns false if there's none, leaving \a result untouched.
+	bool		calcClosestPoint( const Vec3f &point, Hit *result, float maxDistance = std::numeric_limits<float>::max() ) const;
+
+	size_t				getNumTriangles() const;
+	size_t				getNumNodes() const;
+	AxisAlignedBox3f	getBoundingBox() const;
+
+  protected:
+	struct Obj;
+
+	shared_ptr<Obj>		mObj;
+};
+
+} // namespace cinder
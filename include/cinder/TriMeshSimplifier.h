@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/TriMesh.h"
+
+#include <vector>
+#include <limits>
+
+namespace cinder {
+
+/** \brief Reduces a TriMesh by quadric error metric edge collapses, after Garland and Heckbert's "Surface Simplification Using Quadric Error Metrics".
+ * Each collapse moves a vertex onto one of its neighbors, so every simplified mesh uses a subset of the source's vertices and can share its vertex buffer.
+ * Vertices that share a position but differ in their normals, texture coordinates or colors form seams. Seams and open borders are only collapsed
+ * along their own length, so neither tears open nor loses its shape. Vertices where that can't be guaranteed are never moved. **/
+class TriMeshSimplifier {
+  public:
+	TriMeshSimplifier( const TriMesh &mesh );
+
+	//! Collapses edges until at most \a targetTriangles remain, or until the next collapse would move the surface by more than \a maxError. Returns the number of triangles remaining.
+	//! Calling this again with a lower target continues from the current state, which is how a chain of LODs is best built.
+	size_t		simplify( size_t targetTriangles, float maxError = std::numeric_limits<float>::max() );
+
+	size_t		getNumTriangles() const;
+	//! Returns the largest error of any collapse so far, as an approximate distance from the source surface
+	float		getError() const;
+	//! Returns the current triangles as indices into the source mesh's vertices
+	std::vector<uint32_t>	getIndices() const;
+	//! Returns the current triangles as a standalone TriMesh, holding only the vertices they use
+	TriMesh		getMesh() const;
+
+	//! Returns a simplified copy of \a mesh for each entry of \a targetTriangles, which should be decreasing. Each level is simplified from the one before it.
+	static std::vector<TriMesh>		generateLods( const TriMesh &mesh, const std::vector<size_t> &targetTriangles );
+
+  protected:
+	struct Obj;
+
+	shared_ptr<Obj>		mObj;
+};
+
+} // namespace cinder
@@ -24,9 +24,22 @@
 
 #include "cinder/Cinder.h"
 #include "cinder/Stream.h"
+#include "cinder/Buffer.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <map>
+#include <vector>
+#include <utility>
 
 typedef void CURL;
 typedef void CURLM;
+struct curl_slist;
 
 namespace cinder {
 
@@ -42,60 +55,279 @@ class Url {
 	std::string		mStr;
 };
 
+class UrlTransferExc : public StreamExc {
+  public:
+	UrlTransferExc( const std::string &message ) throw() : mMessage( message ) {}
+	virtual ~UrlTransferExc() throw() {}
+	virtual const char* what() const throw() { return mMessage.c_str(); }
+
+  private:
+	std::string		mMessage;
+};
+
+//! A pointer to an instance of a UrlTransfer. Created by fetchUrl() and fetchUrlStream()
+typedef shared_ptr<class UrlTransfer>	UrlTransferRef;
+
+/** \brief A single background transfer run by the UrlFetcher.
+ * A UrlTransfer acts as a future for its result. A buffered transfer collects the whole response for getBuffer(), while a streaming
+ * transfer holds at most Options::maxBufferedBytes() which are consumed with read(), pausing the download whenever the reader falls behind.
+ * All methods are safe to call from any thread. **/
+class UrlTransfer : private boost::noncopyable, public boost::enable_shared_from_this<UrlTransfer> {
+  public:
+	class Options {
+	  public:
+		Options() : mOffset( 0 ), mLength( 0 ), mTimeout( 0 ), mConnectTimeout( 0 ), mFollowRedirects( true ), mMaxBufferedBytes( 1024 * 1024 ) {}
+
+		//! Authenticates as \a user with \a password
+		Options&	user( const std::string &user, const std::string &password ) { mUser = user; mPassword = password; return *this; }
+		//! Adds a request header such as \c "If-None-Match: \"abc\"". May be called repeatedly.
+		Options&	header( const std::string &headerLine ) { mHeaders.push_back( headerLine ); return *this; }
+		//! Requests only \a length bytes starting at \a offset, using an HTTP Range request. A \a length of 0 reads to the end of the resource.
+		Options&	range( uint64_t offset, uint64_t length = 0 ) { mOffset = offset; mLength = length; return *this; }
+		//! Fails the transfer if it takes longer than \a seconds in total. 0, the default, never times out.
+		Options&	timeout( float seconds ) { mTimeout = seconds; return *this; }
+		//! Fails the transfer if connecting takes longer than \a seconds. 0, the default, uses curl's default.
+		Options&	connectTimeout( float seconds ) { mConnectTimeout = seconds; return *this; }
+		//! Follows HTTP redirects. Default is \c true.
+		Options&	followRedirects( bool follow = true ) { mFollowRedirects = follow; return *this; }
+		//! The most data a streaming transfer holds before the download is paused for the reader to catch up. Default is 1MB.
+		Options&	maxBufferedBytes( size_t bytes ) { mMaxBufferedBytes = bytes; return *this; }
+
+		const std::string&					getUser() const { return mUser; }
+		const std::string&					getPassword() const { return mPassword; }
+		const std::vector<std::string>&		getHeaders() const { return mHeaders; }
+		uint64_t							getRangeOffset() const { return mOffset; }
+		uint64_t							getRangeLength() const { return mLength; }
+		bool								hasRange() const { return ( mOffset > 0 ) || ( mLength > 0 ); }
+		float								getTimeout() const { return mTimeout; }
+		float								getConnectTimeout() const { return mConnectTimeout; }
+		bool								getFollowRedirects() const { return mFollowRedirects; }
+		size_t								getMaxBufferedBytes() const { return mMaxBufferedBytes; }
+
+	  protected:
+		std::string					mUser, mPassword;
+		std::vector<std::string>	mHeaders;
+		uint64_t					mOffset, mLength;
+		float						mTimeout, mConnectTimeout;
+		bool						mFollowRedirects;
+		size_t						mMaxBufferedBytes;
+	};
+
+	//! Called on the fetch thread once a transfer has finished, failed or been cancelled
+	typedef boost::function<void (UrlTransferRef)>	Callback;
+
+	enum State { STATE_QUEUED, STATE_RUNNING, STATE_DONE, STATE_FAILED, STATE_CANCELLED };
+
+	~UrlTransfer();
+
+	const Url&		getUrl() const { return mUrl; }
+	const Options&	getOptions() const { return mOptions; }
+	bool			isStreaming() const { return mStreaming; }
+
+	State			getState() const;
+	//! Returns whether the transfer has finished, failed or been cancelled
+	bool			isDone() const;
+	//! Returns whether the transfer has failed or been cancelled
+	bool			hasFailed() const;
+	//! Returns a description of the failure, or an empty string
+	std::string		getError() const;
+
+	//! Blocks until the transfer has finished, failed or been cancelled
+	void			wait() const;
+	//! Blocks until the response headers have arrived or the transfer is over. Returns whether headers were received.
+	bool			waitForHeaders() const;
+	//! Blocks until the transfer is done and returns the response body. Throws UrlTransferExc if the transfer failed, was cancelled or is streaming.
+	Buffer			getBuffer() const;
+
+	//! Blocks until at least one byte is available or the transfer is over, then reads up to \a maxSize bytes into \a dest. Returns 0 once all data has been read. Streaming transfers only.
+	size_t			read( void *dest, size_t maxSize );
+	//! Returns the number of bytes read() can return without blocking. Streaming transfers only.
+	size_t			getBytesAvailable() const;
+
+	//! Waits for the headers and returns the HTTP response code
+	long			getResponseCode() const;
+	//! Waits for the headers and returns the final URL after any redirects
+	std::string		getEffectiveUrl() const;
+	//! Waits for the headers and returns the Content-Length of the response, or -1 when unknown
+	int64_t			getContentLength() const;
+	//! Waits for the headers and returns the value of the response header \a name, compared case-insensitively, or an empty string
+	std::string		getHeader( const std::string &name ) const;
+	//! Returns the number of body bytes received so far
+	uint64_t		getBytesReceived() const;
+
+	//! Aborts the transfer. Blocked calls return and the callback is invoked with a state of STATE_CANCELLED.
+	void			cancel();
+
+  protected:
+	UrlTransfer( const Url &url, const Options &options, bool streaming, const Callback &callback );
+
+	bool			isOverLocked() const { return mState >= STATE_DONE; }
+	void			captureHeaderInfoLocked();
+	void			finish( State state, const std::string &error );
+
+	static size_t	writeCallback( char *buffer, size_t size, size_t nitems, void *userp );
+	static size_t	headerCallback( char *buffer, size_t size, size_t nitems, void *userp );
+
+	const Url			mUrl;
+	const Options		mOptions;
+	const bool			mStreaming;
+	Callback			mCallback;
+
+	CURL				*mCurl;
+	curl_slist			*mHeaderList;
+	std::string			mUserColonPassword, mRangeString;
+
+	mutable boost::mutex				mMutex;
+	mutable boost::condition_variable	mCond;
+	State				mState;
+	bool				mCancelRequested;
+	std::string			mError;
+	bool				mHeadersReceived;
+	long				mResponseCode;
+	std::string			mEffectiveUrl;
+	int64_t				mContentLength;
+	uint64_t			mBytesReceived;
+	std::vector<std::pair<std::string,std::string> >	mHeaders;
+
+	// buffered transfers
+	Buffer					mBuffer;
+	// streaming transfers
+	std::vector<uint8_t>	mStreamData;
+	size_t					mStreamReadOffset;
+	bool					mPaused;
+
+	friend class UrlFetcher;
+};
+
+/** \brief The process-wide engine behind fetchUrl() and fetchUrlStream().
+ * Runs a single curl multi handle on a background thread, so any number of transfers proceed concurrently and share its connection cache.
+ * The thread sleeps whenever there are no transfers. **/
+class UrlFetcher : private boost::noncopyable {
+  public:
+	//! Returns the UrlFetcher, starting its thread on first use. Returns NULL after shutdown().
+	static UrlFetcher*	instance();
+	//! Cancels every queued and running transfer, then stops and joins the fetch thread. Called automatically at exit; nothing can be fetched afterwards.
+	static void			shutdown();
+
+	//! Starts a transfer which collects the whole response into a Buffer. \a callback, if provided, is called on the fetch thread when it's over.
+	UrlTransferRef	fetch( const Url &url, const UrlTransfer::Options &options = UrlTransfer::Options(), const UrlTransfer::Callback &callback = UrlTransfer::Callback() );
+	//! Starts a transfer whose response is consumed incrementally with UrlTransfer::read()
+	UrlTransferRef	fetchStream( const Url &url, const UrlTransfer::Options &options = UrlTransfer::Options(), const UrlTransfer::Callback &callback = UrlTransfer::Callback() );
+
+	//! Sets the most transfers run at once; the rest wait in a queue. Default is 16.
+	void			setMaxConcurrentTransfers( size_t maxTransfers );
+	size_t			getMaxConcurrentTransfers() const;
+
+  protected:
+	UrlFetcher();
+	~UrlFetcher();
+	static void		createInstance();
+
+	void			enqueue( UrlTransferRef transfer );
+	void			requestCancel( UrlTransferRef transfer );
+	void			requestUnpause( UrlTransferRef transfer );
+
+	void			threadFn();
+	void			processCompletions();
+	void			waitForActivity();
+
+	CURLM								*mMulti;
+	shared_ptr<boost::thread>			mThread;
+	mutable boost::mutex				mMutex;
+	boost::condition_variable			mWake;
+	size_t								mMaxConcurrentTransfers;
+	bool								mShutdown;
+	std::deque<UrlTransferRef>			mQueued;
+	std::vector<UrlTransferRef>			mCancels, mUnpauses;
+	// only touched by the fetch thread
+	std::map<CURL*,UrlTransferRef>		mActive;
+
+	static UrlFetcher	*sInstance;
+
+	friend class UrlTransfer;
+};
+
+//! Starts fetching \a url in the background, collecting the response into a Buffer. \a callback, if provided, is called on the fetch thread when the transfer is over.
+UrlTransferRef		fetchUrl( const Url &url, const UrlTransfer::Options &options = UrlTransfer::Options(), const UrlTransfer::Callback &callback = UrlTransfer::Callback() );
+//! Starts fetching \a url in the background for reading incrementally, either through UrlTransfer::read() or an IStreamUrl
+UrlTransferRef		fetchUrlStream( const Url &url, const UrlTransfer::Options &options = UrlTransfer::Options() );
+
 //! A pointer to an instance of an IStreamUrl. Can be created using IStreamUrl::createRef()
 typedef shared_ptr<class IStreamUrl>	IStreamUrlRef;
 
-/** \warning IStreamUrl does not currently support proper random access **/
+/** \brief An IStream which reads a URL through a small cache of fixed-size blocks.
+ * Data is downloaded with HTTP Range requests which start at a single block and double for as long as reads stay sequential. Reading anywhere
+ * that isn't cached and isn't just ahead of the current transfer starts a new request there, so random access downloads roughly what is
+ * actually read. Servers which ignore Range requests send the whole resource, which is skipped through, and restarted to move backwards. **/
 class IStreamUrl : public IStream {
   public:
-	//! Creates a new IStreamUrlRef from the memory pointed to by \a data which is of size \a size bytes.
+	//! Creates a new IStreamUrlRef which downloads \a url, authenticating with \a user and \a password if they're not empty
 	static IStreamUrlRef	createRef( const std::string &url, const std::string &user, const std::string &password );
+	//! Creates a new IStreamUrlRef which downloads \a url using \a options. Any range in \a options is ignored.
+	static IStreamUrlRef	createRef( const Url &url, const UrlTransfer::Options &options = UrlTransfer::Options() );
 	~IStreamUrl();
 
 	virtual size_t		readDataAvailable( void *dest, size_t maxSize );
 	virtual void		seekAbsolute( off_t absoluteOffset );
 	virtual void		seekRelative( off_t relativeOffset );
-	virtual off_t		tell() const { return mBufferFileOffset + mBufferOffset; }
+	virtual off_t		tell() const { return (off_t)mPosition; }
 	virtual off_t		size() const;
 	
 	virtual bool		isEof() const;
 
-	std::string			getUser() const { return mUser; }
-	std::string			getPassword() const { return mPassword; }
+	std::string			getUser() const { return mOptions.getUser(); }
+	std::string			getPassword() const { return mOptions.getPassword(); }
+	/** Returns the response code of the first response, which is 206 if that was a Range request. Reads throw UrlTransferExc for HTTP responses other than
+	 *  200 and 206, except for a 416 to a Range request, which marks the end of the resource. **/
 	long				getResponseCode() const;
 	std::string			getEffectiveUrl() const;
-	
+	//! Returns the UrlTransfer currently feeding this stream
+	UrlTransferRef		getTransfer() const { return mTransfer; }
+
+	static const size_t		BLOCK_SIZE = 32 * 1024;
+	static const size_t		MAX_BLOCKS = 32;
 
   protected:
-	IStreamUrl( const std::string &url, const std::string &user, const std::string &password );
+	IStreamUrl( const Url &url, const UrlTransfer::Options &options );
 
 	virtual void		IORead( void *t, size_t size );
 	virtual void		IOWrite( const void *t, size_t size ) {}
 
-	int					bufferRemaining() const { return mBufferedBytes - mBufferOffset; }
-	void				fillBuffer( int wantBytes ) const;
-	
-	static size_t		writeCallback( char *buffer, size_t size, size_t nitems, void *userp ); 
-	
+	struct Block {
+		std::vector<uint8_t>	mData;		// always a prefix of the block, so a block at index i holds [i * BLOCK_SIZE, i * BLOCK_SIZE + mData.size())
+		uint64_t				mLastUse;
+	};
+
+	//! Returns the number of bytes cached contiguously from \a offset, downloading if there are none. 0 means \a offset is at or past the end.
+	size_t				fillAt( uint64_t offset ) const;
+	size_t				cachedAt( uint64_t offset ) const;
+	void				startTransfer( uint64_t offset, bool sequential ) const;
+	bool				receive() const;
+	void				checkHeaders() const;
+	Block&				getBlock( uint64_t blockIndex ) const;
+
+	enum RangeSupport { RANGES_UNKNOWN, RANGES_SUPPORTED, RANGES_UNSUPPORTED };
+
   private:
-	CURL					*mCurl;
-	CURLM					*mMulti;
-	const std::string		mUser, mPassword;
-	std::string				mUserColonPassword;
-	
-	mutable int still_running;				// Is background url fetch still in progress
-	mutable bool			mStartedRead;
+	const Url						mUrl;
+	UrlTransfer::Options			mOptions;
 
-	mutable off_t			mSize;
-	mutable bool			mSizeCached;
-	mutable long			mResponseCode;
-	mutable char			*mEffectiveUrl;
-	
-	mutable uint8_t		*mBuffer;
-	mutable int			mBufferSize;
-	mutable int			mBufferOffset, mBufferedBytes;
-	mutable off_t		mBufferFileOffset;	// where in the file the buffer starts
-	static const int	DEFAULT_BUFFER_SIZE = 4096;
+	mutable UrlTransferRef			mTransfer;
+	mutable uint64_t				mTransferOffset;	// absolute offset of the next byte mTransfer delivers
+	mutable uint64_t				mTransferEnd;		// one past the last byte requested, or TRANSFER_OPEN
+	mutable bool					mTransferRanged, mHeadersChecked;
+	mutable std::string				mTransferError;		// set for an HTTP error response, whose body mustn't be mistaken for data
+	mutable uint64_t				mNextRangeLength;
+	mutable RangeSupport			mRangeSupport;
+
+	mutable int64_t					mSize;				// -1 until known
+	mutable long					mResponseCode;
+	mutable std::string				mEffectiveUrl;
+
+	uint64_t						mPosition;
+	mutable std::map<uint64_t,Block>	mBlocks;
+	mutable uint64_t				mUseCounter;
+	mutable std::vector<uint8_t>	mScratch;
 };
 
 IStreamUrlRef		loadUrlStream( const Url &url );
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/Url.h"
+#include "cinder/Buffer.h"
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <vector>
+
+namespace cinder {
+
+//! A pointer to an instance of a UrlCache. Can be created using UrlCache::createRef()
+typedef shared_ptr<class UrlCache>	UrlCacheRef;
+
+/** \brief A size-bounded on-disk cache of URL contents.
+ * Each response is stored in its own file under the cache directory, and cached entries are revalidated with the server using their
+ * ETag and Last-Modified headers, so an unchanged resource costs a single 304 response rather than a download. Cached contents are
+ * returned as memory-mapped Buffers. Once the cache exceeds its maximum size the least recently used entries are evicted.
+ * If the server can't be reached a cached copy is returned as-is. A UrlCache may be used from several threads at once. **/
+class UrlCache : private boost::noncopyable {
+  public:
+	//! Creates a cache in \a directory, which is created if necessary, holding at most \a maxSize bytes
+	static UrlCacheRef	createRef( const std::string &directory, uint64_t maxSize = 256 * 1024 * 1024 );
+	~UrlCache();
+
+	//! Returns the contents of \a url, from the cache when they're still current and otherwise downloading them into the cache. Responses other than 200 aren't cached. Throws UrlTransferExc on failure.
+	Buffer			fetchBuffer( const Url &url );
+
+	//! Returns whether the cache holds a copy of \a url, current or not
+	bool			contains( const Url &url ) const;
+	//! Removes \a url from the cache
+	void			remove( const Url &url );
+	//! Removes every entry from the cache
+	void			clear();
+
+	const std::string&	getDirectory() const { return mDirectory; }
+	//! Returns the total size of the cached contents in bytes
+	uint64_t		getSize() const;
+	uint64_t		getMaxSize() const;
+	//! Sets the most bytes the cache holds, evicting least recently used entries immediately if necessary
+	void			setMaxSize( uint64_t maxSize );
+	double			getMaxAge() const;
+	//! Entries validated within the last \a seconds are used without asking the server. Default is 0, which revalidates on every fetch.
+	void			setMaxAge( double seconds );
+
+	//! Sets the cache used by DataSourceUrl, and so by loadUrl(). Caching is disabled by default; a null \a cache disables it again.
+	static void			setDefault( UrlCacheRef cache );
+	static UrlCacheRef	getDefault();
+
+  protected:
+	UrlCache( const std::string &directory, uint64_t maxSize );
+
+	struct Entry {
+		std::string		mFileName;
+		std::string		mETag, mLastModified;
+		uint64_t		mSize;
+		uint64_t		mLastAccess;	// mAccessCounter at the last fetch, for LRU ordering
+		int64_t			mValidatedTime;	// time() of the last download or revalidation
+	};
+
+	Buffer			mapEntryLocked( const std::string &url, Entry *entry );
+	void			removeEntryLocked( std::map<std::string,Entry>::iterator entryIt );
+	void			evictLocked( uint64_t maxSize, const std::string &keepUrl );
+	void			deleteFileLocked( const std::string &fileName );
+	std::string		getPath( const std::string &fileName ) const;
+	void			loadIndex();
+	void			saveIndexLocked();
+
+	const std::string			mDirectory;
+	mutable boost::mutex		mMutex;
+	std::map<std::string,Entry>	mEntries;
+	std::vector<std::string>	mPendingDeletes;	// files which couldn't be deleted yet, such as those still mapped on Windows
+	uint64_t					mTotalSize, mMaxSize;
+	double						mMaxAge;
+	uint64_t					mAccessCounter, mNextFileId;
+	bool						mIndexDirty;
+
+	static UrlCacheRef			sDefault;
+	static boost::mutex			sDefaultMutex;
+};
+
+} // namespace cinder
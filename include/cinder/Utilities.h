@@ -74,10 +74,21 @@ extern int16_t	swapEndian( int16_t val );
 extern uint16_t	swapEndian( uint16_t val );
 extern int32_t	swapEndian( int32_t val );
 extern uint32_t swapEndian( uint32_t val );
+extern int64_t	swapEndian( int64_t val );
+extern uint64_t swapEndian( uint64_t val );
 extern float	swapEndian( float val );
 extern double	swapEndian( double val );
 
+//! Swaps the endianness of every element in \a blockPtr in place. The loops are written so that the compiler can vectorize them.
+inline void swapEndianBlock( int8_t * /*blockPtr*/, size_t /*blockSizeInBytes*/ ) {}
+inline void swapEndianBlock( uint8_t * /*blockPtr*/, size_t /*blockSizeInBytes*/ ) {}
+extern void swapEndianBlock( int16_t *blockPtr, size_t blockSizeInBytes );
 extern void swapEndianBlock( uint16_t *blockPtr, size_t blockSizeInBytes );
+extern void swapEndianBlock( int32_t *blockPtr, size_t blockSizeInBytes );
+extern void swapEndianBlock( uint32_t *blockPtr, size_t blockSizeInBytes );
+extern void swapEndianBlock( int64_t *blockPtr, size_t blockSizeInBytes );
+extern void swapEndianBlock( uint64_t *blockPtr, size_t blockSizeInBytes );
 extern void swapEndianBlock( float *blockPtr, size_t blockSizeInBytes );
+extern void swapEndianBlock( double *blockPtr, size_t blockSizeInBytes );
 
 } // namespace cinder
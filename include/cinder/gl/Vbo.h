@@ -135,6 +135,10 @@ class VboMesh {
 		void	addDynamicCustomVec2f() { mCustomDynamic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT2, 0 ) ); }
 		void	addDynamicCustomVec3f() { mCustomDynamic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT3, 0 ) ); }
 		void	addDynamicCustomVec4f() { mCustomDynamic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT4, 0 ) ); }
+		void	addStaticCustomFloat() { mCustomStatic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT, 0 ) ); }
+		void	addStaticCustomVec2f() { mCustomStatic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT2, 0 ) ); }
+		void	addStaticCustomVec3f() { mCustomStatic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT3, 0 ) ); }
+		void	addStaticCustomVec4f() { mCustomStatic.push_back( std::make_pair( CUSTOM_ATTR_FLOAT4, 0 ) ); }
 
 		int												mAttributes[ATTR_TOTAL];
 		std::vector<std::pair<CustomAttr,size_t> >		mCustomDynamic, mCustomStatic; // pair of <types,offset>
@@ -148,6 +152,7 @@ class VboMesh {
   protected:
 	struct Obj {
 		size_t			mNumIndices, mNumVertices;	
+		GLenum			mIndexType;
 
 		Vbo				mBuffers[TOTAL_BUFFERS];
 		size_t			mPositionOffset;
@@ -165,15 +170,22 @@ class VboMesh {
 	class VertexIter;
  
 	VboMesh() {}
+	/*** Creates a VboMesh from \a triMesh, with static data interleaved. A default \a layout holds all of the mesh's attributes, or those in its interleaved buffer if it has one.
+	 * If the first static custom attribute is a Vec4f, it receives the mesh's tangents. If the static attributes match TriMesh::interleave()'s, they're uploaded with a single copy. **/
 	explicit VboMesh( const TriMesh &triMesh, Layout layout = Layout() );
 	/*** Creates a VboMesh with \a numVertices vertices and \a numIndices indices. Dynamic data is stored interleaved and static data is planar. **/
 	VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum primitiveType );
-	/*** Creates a VboMesh with \a numVertices vertices and \a numIndices indices. Accepts pointers to preexisting buffers, which may be NULL to request allocation **/
-	VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum primitiveType, Vbo *indexBuffer, Vbo *staticBuffer, Vbo *dynamicBuffer );
+	/*** Creates a VboMesh with \a numVertices vertices and \a numIndices indices. Accepts pointers to preexisting buffers, which may be NULL to request allocation.
+	 * \a indexType, either \c GL_UNSIGNED_SHORT or \c GL_UNSIGNED_INT, must match the contents of \a indexBuffer; pass another VboMesh's getIndexType() when sharing its buffers. **/
+	VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum primitiveType, Vbo *indexBuffer, Vbo *staticBuffer, Vbo *dynamicBuffer, GLenum indexType = GL_UNSIGNED_INT );
 
 	size_t	getNumIndices() const { return mObj->mNumIndices; }
 	size_t	getNumVertices() const { return mObj->mNumVertices; }
 	GLenum	getPrimitiveType() const { return mObj->mPrimitiveType; }
+	//! Returns the type of the index buffer's contents, either \c GL_UNSIGNED_SHORT or \c GL_UNSIGNED_INT. A VboMesh made from a TriMesh with 65536 or fewer vertices uses 16-bit indices.
+	GLenum	getIndexType() const { return mObj->mIndexType; }
+	//! Returns the size in bytes of a single index
+	size_t	getIndexSize() const { return ( mObj->mIndexType == GL_UNSIGNED_SHORT ) ? sizeof(uint16_t) : sizeof(uint32_t); }
 	
 	const Layout&	getLayout() const { return mObj->mLayout; }
 
@@ -183,6 +195,7 @@ class VboMesh {
 	void			bindAllData() const;
 	static void		unbindBuffers();
 
+	//! Uploads \a indices, narrowing them to 16 bits first if that's what getIndexType() calls for
 	void						bufferIndices( const std::vector<uint32_t> &indices );
 	void						bufferPositions( const std::vector<Vec3f> &normals );
 	void						bufferNormals( const std::vector<Vec3f> &normals );
@@ -268,10 +281,67 @@ class VboMesh {
 
  protected:
 	void	initializeBuffers( bool staticDataPlanar );
+	bool	matchesInterleaved( const TriMesh &triMesh ) const;
 
 	shared_ptr<Obj>		mObj;
 };
 
+/** \brief Draws many small meshes from a few shared buffers, rather than each binding its own as a VboMesh does.
+ * Meshes are suballocated from pages, each a static buffer of interleaved vertices and an index buffer. Pages hold up to 65536 vertices by default,
+ * so their indices are 16 bits, and a mesh too large for one gets a page to itself. Every mesh shares the batch's layout, which may only hold static positions,
+ * normals, colors and 2D texture coordinates for the first unit. Between bind() and unbind() each page's pointers are set up only when drawing switches to it,
+ * so nothing else may bind buffers or change client states in between. **/
+class VboMeshBatch {
+  public:
+	//! Counts the GL calls the batch has made drawing since resetStats(), to measure what batching saves
+	struct Stats {
+		Stats() : mBufferBinds( 0 ), mClientStateChanges( 0 ), mPointerSetups( 0 ), mDrawCalls( 0 ) {}
+
+		size_t	mBufferBinds;
+		size_t	mClientStateChanges;
+		size_t	mPointerSetups;
+		size_t	mDrawCalls;
+	};
+
+	VboMeshBatch() {}
+	//! Creates an empty batch whose meshes will have \a layout's attributes. Throws VboMeshBatchInvalidLayoutExc for any other than those above.
+	explicit VboMeshBatch( const VboMesh::Layout &layout, size_t verticesPerPage = 65536, size_t indicesPerPage = 6 * 65536 );
+
+	//! Uploads \a triMesh's triangles and those of its attributes the layout holds. Returns the index to draw it by.
+	size_t		add( const TriMesh &triMesh );
+	size_t		getNumMeshes() const;
+	size_t		getNumPages() const;
+	//! Removes every mesh and releases the pages
+	void		clear();
+
+	//! Enables the layout's client states for the draws that follow
+	void		bind();
+	//! Disables the client states bind() enabled and unbinds the current page
+	void		unbind();
+	//! Draws \a mesh, binding its page first unless it's the current one. Outside of bind() and unbind(), the draw is wrapped in them.
+	void		draw( size_t mesh );
+	//! Draws \a meshes a page at a time, merging those that are adjacent in their page into a single call
+	void		draw( const std::vector<size_t> &meshes );
+	//! Draws every mesh, with a single call per page
+	void		drawAll();
+
+	const Stats&	getStats() const;
+	void			resetStats();
+
+  protected:
+	struct Obj;
+
+	shared_ptr<Obj>		mObj;
+
+  public:
+	//@{
+	//! Emulates shared_ptr-like behavior
+	typedef shared_ptr<Obj> VboMeshBatch::*unspecified_bool_type;
+	operator unspecified_bool_type() { return ( mObj.get() == 0 ) ? 0 : &VboMeshBatch::mObj; }
+	void reset() { mObj.reset(); }
+	//@}
+};
+
 class VboExc : public std::exception {
  public:
 	virtual const char* what() const throw() { return "OpenGL Vbo exception"; }
@@ -292,4 +362,14 @@ class VboFailedUnmapExc : public VboExc {
 	virtual const char* what() const throw() { return "OpenGL Vbo exception: Unmap failure"; } 
 };
 
+class VboInvalidIndexTypeExc : public VboExc {
+ public:
+	virtual const char* what() const throw() { return "OpenGL Vbo exception: Index type must be GL_UNSIGNED_SHORT or GL_UNSIGNED_INT"; }
+};
+
+class VboMeshBatchInvalidLayoutExc : public VboExc {
+ public:
+	virtual const char* what() const throw() { return "OpenGL Vbo exception: Layout unsupported by VboMeshBatch"; }
+};
+
 } } // namespace cinder::gl
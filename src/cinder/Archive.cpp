@@ -0,0 +1,235 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/Archive.h"
+#include "cinder/Lz4.h"
+#include "cinder/Utilities.h"
+
+#include <zlib.h>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+
+namespace cinder {
+
+namespace {
+const uint8_t	ARCHIVE_MAGIC[4] = { 'C', 'i', 'P', 'k' };
+const uint32_t	ARCHIVE_VERSION = 1;
+// neither codec can expand its input by more than this, so an entry claiming more is corrupt; the slack covers tiny entries
+const uint64_t	ZLIB_MAX_RATIO = 1032, LZ4_MAX_RATIO = 255, MAX_RATIO_SLACK = 64;
+
+template<typename T>
+T readLittle( const uint8_t *src )
+{
+	T result;
+	memcpy( &result, src, sizeof(T) );
+#if ! defined( CINDER_LITTLE_ENDIAN )
+	result = swapEndian( result );
+#endif
+	return result;
+}
+} // anonymous namespace
+
+ArchiveRef Archive::createRef( const std::string &path )
+{
+	IStreamMmapRef stream = loadFileStreamMmap( path, IStreamMmap::ACCESS_RANDOM );
+	if( ! stream )
+		throw ArchiveExc( "Unable to map archive " + path );
+	return ArchiveRef( new Archive( stream->getBuffer() ) );
+}
+
+ArchiveRef Archive::createRef( const Buffer &buffer )
+{
+	return ArchiveRef( new Archive( buffer ) );
+}
+
+Archive::Archive( const Buffer &buffer )
+	: mData( buffer ), mOwner( new Buffer( buffer ) )
+{
+	mBase = reinterpret_cast<const uint8_t*>( mData.getData() );
+	mSize = mData.getDataSize();
+	if( ( mSize < HEADER_SIZE ) || ( memcmp( mBase, ARCHIVE_MAGIC, 4 ) != 0 ) )
+		throw ArchiveExc( "Not an archive" );
+	if( readLittle<uint32_t>( mBase + 4 ) != ARCHIVE_VERSION )
+		throw ArchiveExc( "Unsupported archive version" );
+
+	mNumEntries = readLittle<uint32_t>( mBase + 8 );
+	uint64_t indexOffset = readLittle<uint64_t>( mBase + 16 );
+	uint64_t namesOffset = readLittle<uint64_t>( mBase + 24 );
+	if( ( indexOffset > mSize ) || ( (uint64_t)mNumEntries * INDEX_RECORD_SIZE > mSize - indexOffset ) || ( namesOffset > mSize ) )
+		throw ArchiveExc( "Corrupt archive index" );
+
+	mIndex = mBase + indexOffset;
+	mNames = mBase + namesOffset;
+	mNamesSize = mSize - (size_t)namesOffset;
+}
+
+const uint8_t* Archive::getIndexRecord( size_t index ) const
+{
+	if( index >= mNumEntries )
+		throw ArchiveExc( "Archive entry index out of range" );
+	return mIndex + index * INDEX_RECORD_SIZE;
+}
+
+std::string Archive::getEntryName( size_t index ) const
+{
+	const uint8_t *record = getIndexRecord( index );
+	uint32_t nameOffset = readLittle<uint32_t>( record + 24 );
+	uint16_t nameLength = readLittle<uint16_t>( record + 28 );
+	if( (uint64_t)nameOffset + nameLength > mNamesSize )
+		throw ArchiveExc( "Corrupt archive index" );
+	return std::string( reinterpret_cast<const char*>( mNames + nameOffset ), nameLength );
+}
+
+uint64_t Archive::getEntrySize( size_t index ) const
+{
+	return readLittle<uint64_t>( getIndexRecord( index ) + 16 );
+}
+
+int32_t Archive::findEntry( const std::string &name ) const
+{
+	std::string key( name );
+	std::replace( key.begin(), key.end(), '\\', '/' );
+
+	// the records are sorted by the bytes of their names, so this is a plain binary search through the mapping
+	size_t low = 0, high = mNumEntries;
+	while( low < high ) {
+		size_t mid = ( low + high ) / 2;
+		const uint8_t *record = getIndexRecord( mid );
+		uint32_t nameOffset = readLittle<uint32_t>( record + 24 );
+		uint16_t nameLength = readLittle<uint16_t>( record + 28 );
+		if( (uint64_t)nameOffset + nameLength > mNamesSize )
+			throw ArchiveExc( "Corrupt archive index" );
+
+		int order = memcmp( mNames + nameOffset, key.data(), std::min<size_t>( nameLength, key.size() ) );
+		if( order == 0 )
+			order = ( nameLength < key.size() ) ? -1 : ( ( nameLength > key.size() ) ? 1 : 0 );
+		if( order == 0 )
+			return (int32_t)mid;
+		else if( order < 0 )
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return -1;
+}
+
+Buffer Archive::getBuffer( const std::string &name ) const
+{
+	int32_t index = findEntry( name );
+	if( index < 0 )
+		throw ArchiveExc( "No archive entry named " + name );
+	return getBuffer( (size_t)index );
+}
+
+Buffer Archive::getBuffer( size_t index ) const
+{
+	const uint8_t *record = getIndexRecord( index );
+	uint64_t dataOffset = readLittle<uint64_t>( record );
+	uint64_t storedSize = readLittle<uint64_t>( record + 8 );
+	uint64_t size = readLittle<uint64_t>( record + 16 );
+	uint8_t codec = record[30];
+	if( ( dataOffset > mSize ) || ( storedSize > mSize - dataOffset ) || ( size > std::numeric_limits<size_t>::max() ) )
+		throw ArchiveExc( "Corrupt archive entry " + getEntryName( index ) );
+
+	const uint8_t *src = mBase + dataOffset;
+	if( codec == CODEC_STORED ) {
+		if( storedSize != size )
+			throw ArchiveExc( "Corrupt archive entry " + getEntryName( index ) );
+		// a view into the pack, which mOwner keeps alive
+		return Buffer( const_cast<uint8_t*>( src ), (size_t)size, mOwner );
+	}
+
+	// the size comes from the index, so it's bounded by what the stored data could decompress to before anything is allocated
+	if( ( codec == CODEC_ZLIB ) || ( codec == CODEC_LZ4 ) ) {
+		const uint64_t maxRatio = ( codec == CODEC_ZLIB ) ? ZLIB_MAX_RATIO : LZ4_MAX_RATIO;
+		if( size > storedSize * maxRatio + MAX_RATIO_SLACK )
+			throw ArchiveExc( "Corrupt archive entry " + getEntryName( index ) );
+	}
+
+	Buffer result( std::max<size_t>( (size_t)size, 1 ) );
+	bool succeeded = false;
+	if( codec == CODEC_ZLIB ) {
+		uLongf destLength = (uLongf)size;
+		succeeded = ( uncompress( reinterpret_cast<Bytef*>( result.getData() ), &destLength, src, (uLong)storedSize ) == Z_OK ) && ( destLength == size );
+	}
+	else if( codec == CODEC_LZ4 )
+		succeeded = lz4::decompress( src, (size_t)storedSize, result.getData(), (size_t)size );
+	else
+		throw ArchiveExc( "Unsupported codec in archive entry " + getEntryName( index ) );
+
+	if( ! succeeded )
+		throw ArchiveExc( "Corrupt archive entry " + getEntryName( index ) );
+	result.setDataSize( (size_t)size );
+	return result;
+}
+
+IStreamMemRef Archive::getStream( const std::string &name ) const
+{
+	IStreamMemRef result = IStreamMem::createRef( getBuffer( name ) );
+	result->setFileName( name );
+	return result;
+}
+
+ArchiveRef loadArchive( const std::string &path )
+{
+	return Archive::createRef( path );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// DataSourceArchive
+DataSourceArchiveRef DataSourceArchive::createRef( ArchiveRef archive, const std::string &name )
+{
+	int32_t index = archive->findEntry( name );
+	if( index < 0 )
+		throw ArchiveExc( "No archive entry named " + name );
+	return DataSourceArchiveRef( new DataSourceArchive( archive, index, name ) );
+}
+
+DataSourceArchive::DataSourceArchive( ArchiveRef archive, int32_t index, const std::string &name )
+	: DataSource( "", Url() ), mArchive( archive ), mIndex( index )
+{
+	setFilePathHint( name );
+}
+
+void DataSourceArchive::createBuffer()
+{
+	mBuffer = mArchive->getBuffer( (size_t)mIndex );
+}
+
+IStreamRef DataSourceArchive::getStream()
+{
+	if( ! mStream ) {
+		mStream = IStreamMem::createRef( getBuffer() );
+		mStream->setFileName( getFilePathHint() );
+	}
+
+	return mStream;
+}
+
+DataSourceArchiveRef loadFile( ArchiveRef archive, const std::string &name )
+{
+	return DataSourceArchive::createRef( archive, name );
+}
+
+} // namespace cinder
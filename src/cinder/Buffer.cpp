@@ -21,10 +21,14 @@
 */
 
 #include "cinder/Buffer.h"
+#include "cinder/Lz4.h"
 #include <zlib.h>
 #include <cmath>
 #include <iostream>
 #include <cstring>
+#include <limits>
+#include <algorithm>
+#include <new>
 
 namespace cinder {
 
@@ -45,16 +49,28 @@ Buffer::Buffer( void * aData, size_t aSize )
 {	
 }
 
+Buffer::Buffer( void * aData, size_t aSize, shared_ptr<void> owner )
+	: mObj( new Obj( aData, aSize, false ) )
+{
+	mObj->mOwner = owner;
+}
+
 Buffer::Buffer( size_t aSize ) 
-	: mObj( new Obj( malloc( aSize ), aSize, true ) )
 {
+	void *data = malloc( aSize );
+	if( ( ! data ) && ( aSize > 0 ) )
+		throw std::bad_alloc();
+	mObj = shared_ptr<Obj>( new Obj( data, aSize, true ) );
 }
 
 void Buffer::resize( size_t newSize )
 {
 	if( ! mObj->mOwnsData ) return;
 	
-	mObj->mData = realloc( mObj->mData, newSize );
+	void *data = realloc( mObj->mData, newSize );
+	if( ( ! data ) && ( newSize > 0 ) )
+		throw std::bad_alloc(); // the original data is still intact
+	mObj->mData = data;
 	mObj->mDataSize = newSize;
 	mObj->mAllocatedSize = newSize;
 }
@@ -89,8 +105,95 @@ Buffer compressBuffer( const Buffer &aBuffer, int8_t compressionLevel, bool resi
 	return outBuffer;
 }
 
+// Header written by the codec version of compressBuffer(); a bare zlib stream can't start with 'C'
+static const uint8_t	CODEC_HEADER_MAGIC[4] = { 'C', 'i', 'B', 'f' };
+static const uint8_t	CODEC_HEADER_VERSION = 1;
+static const size_t		CODEC_HEADER_SIZE = 16; // magic, version, codec, 2 reserved bytes, little endian uint64 decompressed size
+// neither codec can expand its input by more than this, so a header claiming more is corrupt; the slack covers tiny inputs
+static const uint64_t	ZLIB_MAX_RATIO = 1032, LZ4_MAX_RATIO = 255, MAX_RATIO_SLACK = 64;
+
+Buffer compressBuffer( const Buffer &aBuffer, CompressionCodec codec, int8_t compressionLevel, bool resizeResult )
+{
+	const size_t srcSize = aBuffer.getDataSize();
+	size_t bound;
+	if( codec == CODEC_ZLIB )
+		bound = compressBound( static_cast<uLong>( srcSize ) );
+	else
+		bound = lz4::compressBound( srcSize );
+	Buffer outBuffer( CODEC_HEADER_SIZE + bound );
+
+	uint8_t *header = reinterpret_cast<uint8_t*>( outBuffer.getData() );
+	memcpy( header, CODEC_HEADER_MAGIC, 4 );
+	header[4] = CODEC_HEADER_VERSION;
+	header[5] = static_cast<uint8_t>( codec );
+	header[6] = header[7] = 0;
+	for( int b = 0; b < 8; ++b )
+		header[8 + b] = static_cast<uint8_t>( static_cast<uint64_t>( srcSize ) >> ( b * 8 ) );
+
+	size_t outSize;
+	if( codec == CODEC_ZLIB ) {
+		uLongf zlibSize = static_cast<uLongf>( bound );
+		if( compress2( header + CODEC_HEADER_SIZE, &zlibSize, (const Bytef *)aBuffer.getData(), static_cast<uLong>( srcSize ), compressionLevel ) != Z_OK )
+			throw BufferCompressionExc();
+		outSize = zlibSize;
+	}
+	else {
+		// levels 1-9 map to search depths of 4 through 1024 candidates
+		int searchDepth = ( codec == CODEC_LZ4_HC ) ? ( 1 << ( std::max<int>( 1, std::min<int>( compressionLevel, 9 ) ) + 1 ) ) : 0;
+		outSize = lz4::compress( aBuffer.getData(), srcSize, header + CODEC_HEADER_SIZE, bound, searchDepth );
+	}
+
+	outBuffer.setDataSize( CODEC_HEADER_SIZE + outSize );
+	if( resizeResult ) {
+		outBuffer.resize( CODEC_HEADER_SIZE + outSize );
+	}
+
+	return outBuffer;
+}
+
+static Buffer decompressBufferWithHeader( const Buffer &aBuffer )
+{
+	const uint8_t *header = reinterpret_cast<const uint8_t*>( aBuffer.getData() );
+	if( header[4] != CODEC_HEADER_VERSION )
+		throw BufferDecompressionExc();
+
+	uint64_t dstSize = 0;
+	for( int b = 0; b < 8; ++b )
+		dstSize |= static_cast<uint64_t>( header[8 + b] ) << ( b * 8 );
+	if( dstSize > std::numeric_limits<size_t>::max() )
+		throw BufferDecompressionExc();
+	const uint8_t *src = header + CODEC_HEADER_SIZE;
+	const size_t srcSize = aBuffer.getDataSize() - CODEC_HEADER_SIZE;
+	const uint64_t maxRatio = ( header[5] == CODEC_ZLIB ) ? ZLIB_MAX_RATIO : LZ4_MAX_RATIO;
+	if( dstSize > static_cast<uint64_t>( srcSize ) * maxRatio + MAX_RATIO_SLACK )
+		throw BufferDecompressionExc();
+
+	// the output size is known up front, so there's no need to guess and grow
+	Buffer outBuffer( static_cast<size_t>( dstSize ) );
+	switch( header[5] ) {
+		case CODEC_ZLIB: {
+			uLongf zlibSize = static_cast<uLongf>( dstSize );
+			if( ( uncompress( (Bytef *)outBuffer.getData(), &zlibSize, src, static_cast<uLong>( srcSize ) ) != Z_OK ) || ( zlibSize != dstSize ) )
+				throw BufferDecompressionExc();
+		}
+		break;
+		case CODEC_LZ4:
+		case CODEC_LZ4_HC:
+			if( ! lz4::decompress( src, srcSize, outBuffer.getData(), static_cast<size_t>( dstSize ) ) )
+				throw BufferDecompressionExc();
+		break;
+		default:
+			throw BufferDecompressionExc();
+	}
+
+	return outBuffer;
+}
+
 Buffer decompressBuffer( const Buffer &aBuffer, bool resizeResult )
 {
+	if( ( aBuffer.getDataSize() >= CODEC_HEADER_SIZE ) && ( memcmp( aBuffer.getData(), CODEC_HEADER_MAGIC, 4 ) == 0 ) )
+		return decompressBufferWithHeader( aBuffer );
+
 	int err;
 	z_stream strm;
 
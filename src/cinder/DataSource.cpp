@@ -68,15 +68,28 @@ DataSourcePath::DataSourcePath( const std::string &path )
 
 void DataSourcePath::createBuffer()
 {
-	// no-op - we already supplied the buffer in the constructor
-	IStreamFileRef stream = loadFileStream( mFilePath );
-	mBuffer = loadStreamBuffer( stream );
+	// map the file and hand out a view of it rather than copying its contents
+	if( ! mMmapStream )
+		mMmapStream = loadFileStreamMmap( mFilePath );
+	if( mMmapStream ) {
+		mBuffer = mMmapStream->getBuffer();
+	}
+	else {
+		IStreamFileRef stream = loadFileStream( mFilePath );
+		mBuffer = loadStreamBuffer( stream );
+	}
 }
 
 IStreamRef DataSourcePath::getStream()
 {
-	if( ! mStream )
-		mStream = loadFileStream( mFilePath );
+	if( ! mStream ) {
+		if( ! mMmapStream )
+			mMmapStream = loadFileStreamMmap( mFilePath );
+		if( mMmapStream )
+			mStream = mMmapStream;
+		else // mapping fails for empty files and some special files; fall back to buffered I/O
+			mStream = loadFileStream( mFilePath );
+	}
 		
 	return mStream;
 }
@@ -91,24 +104,35 @@ DataSourcePathRef loadFile( const std::string &path )
 #if ! defined( CINDER_COCOA_TOUCH )
 DataSourceUrlRef DataSourceUrl::createRef( const Url &Url )
 {
-	return DataSourceUrlRef( new DataSourceUrl( Url ) );
+	return DataSourceUrlRef( new DataSourceUrl( Url, UrlCache::getDefault() ) );
+}
+
+DataSourceUrlRef DataSourceUrl::createRef( const Url &Url, UrlCacheRef cache )
+{
+	return DataSourceUrlRef( new DataSourceUrl( Url, cache ) );
 }
 
-DataSourceUrl::DataSourceUrl( const Url &Url )
-	: DataSource( "", Url )
+DataSourceUrl::DataSourceUrl( const Url &Url, UrlCacheRef cache )
+	: DataSource( "", Url ), mCache( cache )
 {
 }
 
 void DataSourceUrl::createBuffer()
 {
-	IStreamUrlRef stream = loadUrlStream( mUrl );
-	mBuffer = loadStreamBuffer( stream );
+	if( mCache )
+		mBuffer = mCache->fetchBuffer( mUrl );
+	else
+		mBuffer = fetchUrl( mUrl )->getBuffer();
 }
 
 IStreamRef DataSourceUrl::getStream()
 {
-	if( ! mStream )
-		mStream = loadUrlStream( mUrl );
+	if( ! mStream ) {
+		if( mCache ) // the cached copy is memory-mapped, so reading it in place beats any network stream
+			mStream = IStreamMem::createRef( getBuffer().getData(), getBuffer().getDataSize() );
+		else
+			mStream = loadUrlStream( mUrl );
+	}
 		
 	return mStream;
 }
@@ -117,6 +141,11 @@ DataSourceUrlRef loadUrl( const Url &Url )
 {
 	return DataSourceUrl::createRef( Url );
 }
+
+DataSourceUrlRef loadUrl( const Url &Url, UrlCacheRef cache )
+{
+	return DataSourceUrl::createRef( Url, cache );
+}
 #endif
 
 /////////////////////////////////////////////////////////////////////////////
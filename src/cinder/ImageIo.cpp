@@ -26,9 +26,22 @@
 #include <boost/type_traits/is_same.hpp>
 #include <cctype>
 
+// the uncompressed formats are available on every platform
+#include "cinder/ImageSourceFilePnm.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
+#include "cinder/ImageTargetFilePnm.h"
+#include "cinder/ImageSourceFileTga.h"
+#include "cinder/ImageTargetFileTga.h"
+#include "cinder/ImageSourceFileRaw.h"
+#include "cinder/ImageTargetFileRaw.h"
+
 #if defined( CINDER_MSW )
 	#include "cinder/ImageSourceFileWic.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
 	#include "cinder/ImageTargetFileWic.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
+#elif defined( CINDER_LINUX )
+	#include "cinder/ImageSourcePng.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
+	#include "cinder/ImageSourceFileJpeg.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
+	#include "cinder/ImageTargetFileJpeg.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
+	#include "cinder/ImageTargetFilePng.h" // this is necessary to force the instantiation of the IMAGEIO_REGISTER macro
 #endif
 
 using namespace std;
@@ -351,6 +364,25 @@ ImageSource::RowFunc ImageSource::setupRowFunc( ImageTargetRef target )
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// ImageTargetMemory
+ImageTargetMemoryRef ImageTargetMemory::createRef( void *data, int32_t width, int32_t height, int32_t rowBytes, DataType dataType, ColorModel colorModel, ChannelOrder channelOrder )
+{
+	return ImageTargetMemoryRef( new ImageTargetMemory( data, width, height, rowBytes, dataType, colorModel, channelOrder ) );
+}
+
+ImageTargetMemory::ImageTargetMemory( void *data, int32_t width, int32_t height, int32_t rowBytes, DataType dataType, ColorModel colorModel, ChannelOrder channelOrder )
+	: ImageTarget(), mData( reinterpret_cast<uint8_t*>( data ) ), mRowBytes( rowBytes )
+{
+	if( ( ! data ) || ( rowBytes < width * channelOrderNumChannels( channelOrder ) * dataTypeBytes( dataType ) ) )
+		throw ImageIoExceptionFailedLoad();
+
+	setSize( width, height );
+	setDataType( dataType );
+	setColorModel( colorModel );
+	setChannelOrder( channelOrder );
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ImageSourceRef loadImage( const std::string &path, std::string extension )
 {
@@ -0,0 +1,282 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageSourceFileJpeg.h"
+
+#include <stdio.h>
+#include <setjmp.h>
+extern "C" {
+	#include <jpeglib.h>
+}
+
+namespace cinder {
+
+static const size_t JPEG_SOURCE_BUFFER_SIZE = 16384;
+
+struct ci_jpeg_error_mgr {
+	jpeg_error_mgr		mPub;
+	jmp_buf				mJmpBuf;
+};
+
+struct ci_jpeg_source_mgr {
+	jpeg_source_mgr		mPub;
+	IStream				*mStream;
+	JOCTET				mBuffer[JPEG_SOURCE_BUFFER_SIZE];
+};
+
+struct ci_jpeg_source_info {
+	ci_jpeg_source_info() : mCreated( false ) {}
+	~ci_jpeg_source_info() { if( mCreated ) jpeg_destroy_decompress( &mDecompress ); }
+
+	jpeg_decompress_struct	mDecompress;
+	ci_jpeg_error_mgr		mErr;
+	ci_jpeg_source_mgr		mSrc;
+	IStreamRef				mStream;
+	bool					mCreated;
+};
+
+extern "C" {
+
+static void ci_jpeg_error_exit( j_common_ptr cinfo )
+{
+	longjmp( reinterpret_cast<ci_jpeg_error_mgr*>( cinfo->err )->mJmpBuf, 1 );
+}
+
+static void ci_jpeg_output_message( j_common_ptr cinfo )
+{
+}
+
+static void ci_jpeg_init_source( j_decompress_ptr cinfo )
+{
+}
+
+static boolean ci_jpeg_fill_input_buffer( j_decompress_ptr cinfo )
+{
+	ci_jpeg_source_mgr *src = reinterpret_cast<ci_jpeg_source_mgr*>( cinfo->src );
+	size_t bytesRead = 0;
+	bool failed = false;
+	try {
+		bytesRead = src->mStream->readDataAvailable( src->mBuffer, JPEG_SOURCE_BUFFER_SIZE );
+	}
+	catch( ... ) {
+		failed = true;
+	}
+	// jumping out of an active handler is undefined, so only longjmp once it has exited
+	if( failed )
+		longjmp( reinterpret_cast<ci_jpeg_error_mgr*>( cinfo->err )->mJmpBuf, 1 );
+
+	if( bytesRead == 0 ) { // premature end of data; insert a fake EOI marker and let libjpeg warn about it
+		src->mBuffer[0] = (JOCTET)0xFF;
+		src->mBuffer[1] = (JOCTET)JPEG_EOI;
+		bytesRead = 2;
+	}
+
+	src->mPub.next_input_byte = src->mBuffer;
+	src->mPub.bytes_in_buffer = bytesRead;
+	return TRUE;
+}
+
+static void ci_jpeg_skip_input_data( j_decompress_ptr cinfo, long numBytes )
+{
+	ci_jpeg_source_mgr *src = reinterpret_cast<ci_jpeg_source_mgr*>( cinfo->src );
+	if( numBytes <= 0 )
+		return;
+
+	if( static_cast<size_t>( numBytes ) <= src->mPub.bytes_in_buffer ) {
+		src->mPub.next_input_byte += numBytes;
+		src->mPub.bytes_in_buffer -= numBytes;
+	}
+	else {
+		bool failed = false;
+		try {
+			src->mStream->seekRelative( static_cast<off_t>( numBytes - src->mPub.bytes_in_buffer ) );
+		}
+		catch( ... ) {
+			failed = true;
+		}
+		if( failed )
+			longjmp( reinterpret_cast<ci_jpeg_error_mgr*>( cinfo->err )->mJmpBuf, 1 );
+		src->mPub.next_input_byte = src->mBuffer;
+		src->mPub.bytes_in_buffer = 0;
+	}
+}
+
+static void ci_jpeg_term_source( j_decompress_ptr cinfo )
+{
+}
+
+} // extern "C"
+
+namespace {
+
+// libjpeg won't convert CMYK or YCCK to RGB for us. Adobe writes CMYK inverted, which is all we are likely to see in practice.
+void cmykToRgb( const uint8_t *src, uint8_t *dst, int32_t width, bool inverted )
+{
+	for( int32_t x = 0; x < width; ++x, src += 4, dst += 3 ) {
+		int32_t c = src[0], m = src[1], y = src[2], k = src[3];
+		if( ! inverted ) {
+			c = 255 - c; m = 255 - m; y = 255 - y; k = 255 - k;
+		}
+		dst[0] = static_cast<uint8_t>( c * k / 255 );
+		dst[1] = static_cast<uint8_t>( m * k / 255 );
+		dst[2] = static_cast<uint8_t>( y * k / 255 );
+	}
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageSourceFileJpeg::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::SourceCreationFunc sourceFunc = ImageSourceFileJpeg::createSourceRef;
+	ImageIoRegistrar::registerSourceType( "jpg", sourceFunc, PRIORITY );
+	ImageIoRegistrar::registerSourceType( "jpeg", sourceFunc, PRIORITY );
+	ImageIoRegistrar::registerSourceType( "jpe", sourceFunc, PRIORITY );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageSourceFileJpeg
+ImageSourceFileJpegRef ImageSourceFileJpeg::createRef( DataSourceRef dataSourceRef, const Options &options )
+{
+	return ImageSourceFileJpegRef( new ImageSourceFileJpeg( dataSourceRef, options ) );
+}
+
+ImageSourceFileJpeg::ImageSourceFileJpeg( DataSourceRef dataSourceRef, const Options &options )
+	: ImageSource(), mIsCmyk( false )
+{
+	int32_t denom = options.getScaleDenom();
+	if( ( denom != 1 ) && ( denom != 2 ) && ( denom != 4 ) && ( denom != 8 ) )
+		throw ImageSourceFileJpegException();
+
+	mInfo = shared_ptr<ci_jpeg_source_info>( new ci_jpeg_source_info );
+	mInfo->mStream = dataSourceRef->getStream();
+
+	mInfo->mDecompress.err = jpeg_std_error( &mInfo->mErr.mPub );
+	mInfo->mErr.mPub.error_exit = ci_jpeg_error_exit;
+	mInfo->mErr.mPub.output_message = ci_jpeg_output_message;
+
+	if( ! loadHeader( options ) )
+		throw ImageSourceFileJpegException();
+}
+
+ImageSourceFileJpeg::~ImageSourceFileJpeg()
+{
+}
+
+// part of this being separated allows for us to play nicely with the setjmp of libjpeg
+bool ImageSourceFileJpeg::loadHeader( const Options &options )
+{
+	jpeg_decompress_struct *cinfo = &mInfo->mDecompress;
+	if( setjmp( mInfo->mErr.mJmpBuf ) )
+		return false;
+
+	jpeg_create_decompress( cinfo );
+	mInfo->mCreated = true;
+
+	ci_jpeg_source_mgr *src = &mInfo->mSrc;
+	src->mStream = mInfo->mStream.get();
+	src->mPub.init_source = ci_jpeg_init_source;
+	src->mPub.fill_input_buffer = ci_jpeg_fill_input_buffer;
+	src->mPub.skip_input_data = ci_jpeg_skip_input_data;
+	src->mPub.resync_to_restart = jpeg_resync_to_restart;
+	src->mPub.term_source = ci_jpeg_term_source;
+	src->mPub.next_input_byte = NULL;
+	src->mPub.bytes_in_buffer = 0;
+	cinfo->src = &src->mPub;
+
+	jpeg_read_header( cinfo, TRUE );
+
+	switch( cinfo->jpeg_color_space ) {
+		case JCS_GRAYSCALE:
+			cinfo->out_color_space = JCS_GRAYSCALE;
+			setColorModel( ImageIo::CM_GRAY );
+			setChannelOrder( ImageIo::Y );
+		break;
+		case JCS_CMYK:
+		case JCS_YCCK:
+			cinfo->out_color_space = JCS_CMYK;
+			mIsCmyk = true;
+			setColorModel( ImageIo::CM_RGB );
+			setChannelOrder( ImageIo::RGB );
+		break;
+		default:
+			cinfo->out_color_space = JCS_RGB;
+			setColorModel( ImageIo::CM_RGB );
+			setChannelOrder( ImageIo::RGB );
+		break;
+	}
+
+	cinfo->scale_num = 1;
+	cinfo->scale_denom = options.getScaleDenom();
+	if( options.isFastIdct() ) {
+		cinfo->dct_method = JDCT_IFAST;
+		cinfo->do_fancy_upsampling = FALSE;
+	}
+
+	jpeg_calc_output_dimensions( cinfo );
+	setSize( cinfo->output_width, cinfo->output_height );
+	setDataType( ImageIo::UINT8 );
+
+	return true;
+}
+
+void ImageSourceFileJpeg::load( ImageTargetRef target )
+{
+	// get a pointer to the ImageSource function appropriate for handling our data configuration
+	ImageSource::RowFunc func = setupRowFunc( target );
+
+	const jpeg_decompress_struct &cinfo( mInfo->mDecompress );
+	shared_ptr<uint8_t> rowData( new uint8_t[cinfo.output_width * cinfo.out_color_components], checked_array_deleter<uint8_t>() );
+	shared_ptr<uint8_t> convertedData;
+	if( mIsCmyk )
+		convertedData = shared_ptr<uint8_t>( new uint8_t[cinfo.output_width * 3], checked_array_deleter<uint8_t>() );
+
+	if( ! decode( target, func, rowData.get(), convertedData.get() ) )
+		throw ImageSourceFileJpegException();
+}
+
+bool ImageSourceFileJpeg::decode( ImageTargetRef target, RowFunc func, uint8_t *rowData, uint8_t *convertedData )
+{
+	jpeg_decompress_struct *cinfo = &mInfo->mDecompress;
+	if( setjmp( mInfo->mErr.mJmpBuf ) )
+		return false;
+
+	jpeg_start_decompress( cinfo );
+
+	JSAMPROW rowPointer = rowData;
+	for( int32_t row = 0; row < mHeight; ++row ) {
+		jpeg_read_scanlines( cinfo, &rowPointer, 1 );
+		if( mIsCmyk ) {
+			cmykToRgb( rowData, convertedData, mWidth, cinfo->saw_Adobe_marker != FALSE );
+			((*this).*func)( target, row, convertedData );
+		}
+		else
+			((*this).*func)( target, row, rowData );
+	}
+
+	jpeg_finish_decompress( cinfo );
+	return true;
+}
+
+} // namespace cinder
@@ -0,0 +1,187 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageSourceFilePnm.h"
+#include "cinder/Utilities.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace cinder {
+
+namespace {
+
+// Returns the next whitespace-delimited token of a Netpbm header, skipping '#' comments
+std::string nextHeaderToken( const uint8_t *data, size_t size, size_t *offset )
+{
+	size_t pos = *offset;
+	while( pos < size ) {
+		if( data[pos] == '#' ) {
+			while( ( pos < size ) && ( data[pos] != '\n' ) && ( data[pos] != '\r' ) )
+				++pos;
+		}
+		else if( isspace( data[pos] ) )
+			++pos;
+		else
+			break;
+	}
+
+	size_t start = pos;
+	while( ( pos < size ) && ( ! isspace( data[pos] ) ) && ( pos - start < 32 ) )
+		++pos;
+	if( ( pos == start ) || ( pos >= size ) )
+		throw ImageSourceFilePnmException();
+
+	*offset = pos;
+	return std::string( reinterpret_cast<const char*>( data + start ), pos - start );
+}
+
+int32_t parseHeaderInt( const std::string &token )
+{
+	char *end;
+	long result = strtol( token.c_str(), &end, 10 );
+	if( ( *end != 0 ) || ( result <= 0 ) || ( result > 0x7FFFFFFF ) )
+		throw ImageSourceFilePnmException();
+	return static_cast<int32_t>( result );
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageSourceFilePnm::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::SourceCreationFunc sourceFunc = ImageSourceFilePnm::createSourceRef;
+	ImageIoRegistrar::registerSourceType( "ppm", sourceFunc, PRIORITY );
+	ImageIoRegistrar::registerSourceType( "pgm", sourceFunc, PRIORITY );
+	ImageIoRegistrar::registerSourceType( "pnm", sourceFunc, PRIORITY );
+	ImageIoRegistrar::registerSourceType( "pfm", sourceFunc, PRIORITY );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageSourceFilePnm
+ImageSourceFilePnmRef ImageSourceFilePnm::createRef( DataSourceRef dataSourceRef )
+{
+	return ImageSourceFilePnmRef( new ImageSourceFilePnm( dataSourceRef ) );
+}
+
+ImageSourceFilePnm::ImageSourceFilePnm( DataSourceRef dataSourceRef )
+	: ImageSource(), mMaxValue( 0 ), mIsBottomUp( false ), mIsBigEndian( true )
+{
+	mBuffer = dataSourceRef->getBuffer();
+	const uint8_t *data = reinterpret_cast<const uint8_t*>( mBuffer.getData() );
+	size_t size = mBuffer.getDataSize();
+	size_t offset = 0;
+
+	std::string magic = nextHeaderToken( data, size, &offset );
+	bool isPfm = ( magic == "Pf" ) || ( magic == "PF" );
+	if( ( magic == "P5" ) || ( magic == "Pf" ) ) {
+		setColorModel( ImageIo::CM_GRAY );
+		setChannelOrder( ImageIo::Y );
+	}
+	else if( ( magic == "P6" ) || ( magic == "PF" ) ) {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( ImageIo::RGB );
+	}
+	else
+		throw ImageSourceFilePnmException();
+
+	int32_t width = parseHeaderInt( nextHeaderToken( data, size, &offset ) );
+	int32_t height = parseHeaderInt( nextHeaderToken( data, size, &offset ) );
+	setSize( width, height );
+
+	if( isPfm ) {
+		// the sign of the scale gives the endianness; PFM rows are stored bottom to top
+		double scale = atof( nextHeaderToken( data, size, &offset ).c_str() );
+		if( scale == 0 )
+			throw ImageSourceFilePnmException();
+		mIsBigEndian = scale > 0;
+		mIsBottomUp = true;
+		setDataType( ImageIo::FLOAT32 );
+	}
+	else {
+		mMaxValue = parseHeaderInt( nextHeaderToken( data, size, &offset ) );
+		if( mMaxValue > 65535 )
+			throw ImageSourceFilePnmException();
+		setDataType( ( mMaxValue < 256 ) ? ImageIo::UINT8 : ImageIo::UINT16 );
+	}
+
+	// exactly one whitespace character separates the header from the raster
+	mDataOffset = offset + 1;
+	// in 64 bits, so that a huge width can't wrap around and slip past the size check
+	uint64_t rowBytes = (uint64_t)mWidth * ImageIo::channelOrderNumChannels( mChannelOrder ) * ImageIo::dataTypeBytes( mDataType );
+	if( ( mDataOffset > size ) || ( rowBytes > ( size - mDataOffset ) / mHeight ) )
+		throw ImageSourceFilePnmException();
+	mRowBytes = static_cast<size_t>( rowBytes );
+}
+
+void ImageSourceFilePnm::load( ImageTargetRef target )
+{
+	// get a pointer to the ImageSource function appropriate for handling our data configuration
+	ImageSource::RowFunc func = setupRowFunc( target );
+
+	const uint8_t *data = reinterpret_cast<const uint8_t*>( mBuffer.getData() ) + mDataOffset;
+#if defined( CINDER_LITTLE_ENDIAN )
+	bool swap = mIsBigEndian && ( mDataType != ImageIo::UINT8 );
+#else
+	bool swap = ( ! mIsBigEndian ) && ( mDataType == ImageIo::FLOAT32 );
+#endif
+	bool rescale = ( mMaxValue != 0 ) && ( mMaxValue != 255 ) && ( mMaxValue != 65535 );
+
+	// when the raster matches our in-memory layout the target reads straight out of the Buffer
+	if( ( ! swap ) && ( ! rescale ) ) {
+		for( int32_t row = 0; row < mHeight; ++row ) {
+			size_t srcRow = mIsBottomUp ? ( mHeight - 1 - row ) : row;
+			((*this).*func)( target, row, data + srcRow * mRowBytes );
+		}
+		return;
+	}
+
+	std::vector<uint8_t> rowData( mRowBytes );
+	int32_t numValues = mWidth * ImageIo::channelOrderNumChannels( mChannelOrder );
+	for( int32_t row = 0; row < mHeight; ++row ) {
+		size_t srcRow = mIsBottomUp ? ( mHeight - 1 - row ) : row;
+		memcpy( &rowData[0], data + srcRow * mRowBytes, mRowBytes );
+		if( mDataType == ImageIo::FLOAT32 ) {
+			swapEndianBlock( reinterpret_cast<float*>( &rowData[0] ), mRowBytes );
+		}
+		else if( mDataType == ImageIo::UINT16 ) {
+			uint16_t *values = reinterpret_cast<uint16_t*>( &rowData[0] );
+			if( swap )
+				swapEndianBlock( values, mRowBytes );
+			if( rescale )
+				for( int32_t v = 0; v < numValues; ++v )
+					values[v] = static_cast<uint16_t>( std::min<uint32_t>( values[v], mMaxValue ) * 65535 / mMaxValue );
+		}
+		else {
+			for( int32_t v = 0; v < numValues; ++v )
+				rowData[v] = static_cast<uint8_t>( std::min<uint32_t>( rowData[v], mMaxValue ) * 255 / mMaxValue );
+		}
+		((*this).*func)( target, row, &rowData[0] );
+	}
+}
+
+} // namespace cinder
@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageSourceFileRaw.h"
+
+#include <cstring>
+
+namespace cinder {
+
+namespace {
+
+uint32_t readUint32Little( const uint8_t *data )
+{
+	return data[0] | ( data[1] << 8 ) | ( data[2] << 16 ) | ( (uint32_t)data[3] << 24 );
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageSourceFileRaw::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::SourceCreationFunc sourceFunc = ImageSourceFileRaw::createSourceRef;
+	ImageIoRegistrar::registerSourceType( "cri", sourceFunc, PRIORITY );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageSourceFileRaw
+ImageSourceFileRawRef ImageSourceFileRaw::createRef( DataSourceRef dataSourceRef )
+{
+	return ImageSourceFileRawRef( new ImageSourceFileRaw( dataSourceRef ) );
+}
+
+ImageSourceFileRaw::ImageSourceFileRaw( DataSourceRef dataSourceRef )
+	: ImageSource()
+{
+	mBuffer = dataSourceRef->getBuffer();
+	const uint8_t *data = reinterpret_cast<const uint8_t*>( mBuffer.getData() );
+	size_t size = mBuffer.getDataSize();
+	if( ( size < HEADER_SIZE ) || ( memcmp( data, "CIRI", 4 ) != 0 ) || ( readUint32Little( data + 4 ) != VERSION ) )
+		throw ImageSourceFileRawException();
+
+	uint32_t width = readUint32Little( data + 8 );
+	uint32_t height = readUint32Little( data + 12 );
+	uint32_t rowBytes = readUint32Little( data + 16 );
+	if( ( data[20] > ImageIo::FLOAT32 ) || ( data[21] > ImageIo::CM_GRAY ) || ( data[22] >= ImageIo::CUSTOM ) )
+		throw ImageSourceFileRawException();
+	if( ( width == 0 ) || ( height == 0 ) || ( width > 0x7FFFFFFF ) || ( height > 0x7FFFFFFF ) || ( rowBytes > 0x7FFFFFFF ) )
+		throw ImageSourceFileRawException();
+
+	setSize( width, height );
+	setDataType( ImageIo::DataType( data[20] ) );
+	setColorModel( ImageIo::ColorModel( data[21] ) );
+	setChannelOrder( ImageIo::ChannelOrder( data[22] ) );
+	setPremultiplied( ( data[23] & 1 ) != 0 );
+
+	bool grayOrder = ( mChannelOrder == ImageIo::Y ) || ( mChannelOrder == ImageIo::YA );
+	if( grayOrder != ( mColorModel == ImageIo::CM_GRAY ) )
+		throw ImageSourceFileRawException();
+
+	// in 64 bits, so that a huge width can't wrap around and slip past the size checks
+	uint64_t minRowBytes = (uint64_t)mWidth * ImageIo::channelOrderNumChannels( mChannelOrder ) * ImageIo::dataTypeBytes( mDataType );
+	if( ( rowBytes < minRowBytes ) || ( rowBytes > ( size - HEADER_SIZE ) / mHeight ) )
+		throw ImageSourceFileRawException();
+	mRowBytes = rowBytes;
+}
+
+void ImageSourceFileRaw::load( ImageTargetRef target )
+{
+	// get a pointer to the ImageSource function appropriate for handling our data configuration
+	ImageSource::RowFunc func = setupRowFunc( target );
+
+	const uint8_t *data = reinterpret_cast<const uint8_t*>( mBuffer.getData() ) + HEADER_SIZE;
+	for( int32_t row = 0; row < mHeight; ++row )
+		((*this).*func)( target, row, data + (size_t)row * mRowBytes );
+}
+
+} // namespace cinder
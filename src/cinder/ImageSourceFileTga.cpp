@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageSourceFileTga.h"
+
+namespace cinder {
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageSourceFileTga::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::SourceCreationFunc sourceFunc = ImageSourceFileTga::createSourceRef;
+	ImageIoRegistrar::registerSourceType( "tga", sourceFunc, PRIORITY );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageSourceFileTga
+ImageSourceFileTgaRef ImageSourceFileTga::createRef( DataSourceRef dataSourceRef )
+{
+	return ImageSourceFileTgaRef( new ImageSourceFileTga( dataSourceRef ) );
+}
+
+ImageSourceFileTga::ImageSourceFileTga( DataSourceRef dataSourceRef )
+	: ImageSource()
+{
+	const size_t HEADER_SIZE = 18;
+
+	mBuffer = dataSourceRef->getBuffer();
+	const uint8_t *data = reinterpret_cast<const uint8_t*>( mBuffer.getData() );
+	size_t size = mBuffer.getDataSize();
+	if( size < HEADER_SIZE )
+		throw ImageSourceFileTgaException();
+
+	uint8_t idLength = data[0];
+	uint8_t colorMapType = data[1];
+	uint8_t imageType = data[2];
+	uint16_t colorMapLength = data[5] | ( data[6] << 8 );
+	uint8_t colorMapEntrySize = data[7];
+	int32_t width = data[12] | ( data[13] << 8 );
+	int32_t height = data[14] | ( data[15] << 8 );
+	uint8_t bitsPerPixel = data[16];
+	uint8_t descriptor = data[17];
+
+	// only uncompressed truecolor (2) and grayscale (3) are handled; anything else falls through to the next registered loader
+	if( imageType == 2 && bitsPerPixel == 24 ) {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( ImageIo::BGR );
+	}
+	else if( imageType == 2 && bitsPerPixel == 32 ) {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( ( ( descriptor & 0x0F ) == 0 ) ? ImageIo::BGRX : ImageIo::BGRA );
+	}
+	else if( imageType == 3 && bitsPerPixel == 8 ) {
+		setColorModel( ImageIo::CM_GRAY );
+		setChannelOrder( ImageIo::Y );
+	}
+	else
+		throw ImageSourceFileTgaException();
+	if( ( width == 0 ) || ( height == 0 ) || ( descriptor & 0x10 ) ) // right-to-left storage is vanishingly rare
+		throw ImageSourceFileTgaException();
+
+	setSize( width, height );
+	setDataType( ImageIo::UINT8 );
+	mIsBottomUp = ( descriptor & 0x20 ) == 0;
+
+	mDataOffset = HEADER_SIZE + idLength;
+	if( colorMapType == 1 )
+		mDataOffset += colorMapLength * ( ( colorMapEntrySize + 7 ) / 8 );
+	mRowBytes = (size_t)mWidth * ( bitsPerPixel / 8 );
+	if( ( mDataOffset > size ) || ( mRowBytes > ( size - mDataOffset ) / mHeight ) )
+		throw ImageSourceFileTgaException();
+}
+
+void ImageSourceFileTga::load( ImageTargetRef target )
+{
+	// get a pointer to the ImageSource function appropriate for handling our data configuration
+	ImageSource::RowFunc func = setupRowFunc( target );
+
+	const uint8_t *data = reinterpret_cast<const uint8_t*>( mBuffer.getData() ) + mDataOffset;
+	for( int32_t row = 0; row < mHeight; ++row ) {
+		size_t srcRow = mIsBottomUp ? ( mHeight - 1 - row ) : row;
+		((*this).*func)( target, row, data + srcRow * mRowBytes );
+	}
+}
+
+} // namespace cinder
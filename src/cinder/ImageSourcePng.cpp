@@ -38,7 +38,7 @@ static void ci_PNG_stream_reader( png_structp mPngPtr, png_bytep data, png_size_
 		((ci_png_info*)png_get_io_ptr(mPngPtr))->srcStreamRef->readData( data, (size_t)length );
 	}
 	catch ( ... ) {
-		longjmp( mPngPtr->jmpbuf, 1 );
+		longjmp( png_jmpbuf( mPngPtr ), 1 );
 	}
 }
 
@@ -52,7 +52,7 @@ static void ci_png_warning( png_structp mPngPtr, png_const_charp message )
 static void ci_png_error( png_structp mPngPtr, png_const_charp message )
 {
     ci_png_warning(NULL, message);
-    longjmp( mPngPtr->jmpbuf, 1 );
+    longjmp( png_jmpbuf( mPngPtr ), 1 );
 }
 
 } // extern "C"
@@ -73,7 +73,7 @@ ImageSourcePngRef ImageSourcePng::createRef( DataSourceRef dataSourceRef )
 }
 
 ImageSourcePng::ImageSourcePng( DataSourceRef dataSourceRef )
-	: ImageSource(), mInfoPtr( 0 ), mPngPtr( 0 )
+	: ImageSource(), mInfoPtr( 0 ), mPngPtr( 0 ), mNumPasses( 1 )
 {
 	mPngPtr = png_create_read_struct( PNG_LIBPNG_VER_STRING, (png_voidp)NULL, NULL, NULL );
 	if( ! mPngPtr ) {
@@ -101,7 +101,7 @@ bool ImageSourcePng::loadHeader()
 {
 	bool success = true;
 
-	if( setjmp( mPngPtr->jmpbuf ) ) {
+	if( setjmp( png_jmpbuf( mPngPtr ) ) ) {
 		success = false;
 	}
 	else {
@@ -147,7 +147,11 @@ bool ImageSourcePng::loadHeader()
 
 		png_set_expand_gray_1_2_4_to_8( mPngPtr );
 		png_set_palette_to_rgb( mPngPtr );
-		png_set_tRNS_to_alpha( mPngPtr );
+		if( png_get_valid( mPngPtr, mInfoPtr, PNG_INFO_tRNS ) ) {
+			png_set_tRNS_to_alpha( mPngPtr );
+			setChannelOrder( ( getColorModel() == ImageIo::CM_GRAY ) ? ImageIo::YA : ImageIo::RGBA );
+		}
+		mNumPasses = png_set_interlace_handling( mPngPtr );
 		
 		png_read_update_info( mPngPtr, mInfoPtr );
 	}
@@ -164,7 +168,7 @@ ImageSourcePng::~ImageSourcePng()
 void ImageSourcePng::load( ImageTargetRef target )
 {
 	bool success = true;
-	if( setjmp( mPngPtr->jmpbuf ) ) {
+	if( setjmp( png_jmpbuf( mPngPtr ) ) ) {
 		png_destroy_read_struct( &mPngPtr, &mInfoPtr, (png_infopp)NULL );
 		mPngPtr = 0;
 		success = false;
@@ -172,11 +176,22 @@ void ImageSourcePng::load( ImageTargetRef target )
 	else {
 		// get a pointer to the ImageSource function appropriate for handling our data configuration
 		ImageSource::RowFunc func = setupRowFunc( target );
-		//int number_passes = png_set_interlace_handling( mPngPtr );
-		shared_ptr<png_byte> row_pointer( new png_byte[png_get_rowbytes( mPngPtr, mInfoPtr )], checked_array_deleter<png_byte>() );
-		for( int32_t row = 0; row < mHeight; ++row ) {
-			png_read_row( mPngPtr, row_pointer.get(), NULL );
-			((*this).*func)( target, row, row_pointer.get() );
+		size_t rowBytes = png_get_rowbytes( mPngPtr, mInfoPtr );
+		if( mNumPasses > 1 ) {
+			// interlaced images need every row kept around until the final pass has been combined into it
+			shared_ptr<png_byte> image( new png_byte[rowBytes * mHeight], checked_array_deleter<png_byte>() );
+			for( int32_t pass = 0; pass < mNumPasses; ++pass )
+				for( int32_t row = 0; row < mHeight; ++row )
+					png_read_row( mPngPtr, image.get() + row * rowBytes, NULL );
+			for( int32_t row = 0; row < mHeight; ++row )
+				((*this).*func)( target, row, image.get() + row * rowBytes );
+		}
+		else {
+			shared_ptr<png_byte> row_pointer( new png_byte[rowBytes], checked_array_deleter<png_byte>() );
+			for( int32_t row = 0; row < mHeight; ++row ) {
+				png_read_row( mPngPtr, row_pointer.get(), NULL );
+				((*this).*func)( target, row, row_pointer.get() );
+			}
 		}
 	}
 	
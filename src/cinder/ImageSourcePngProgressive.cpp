@@ -0,0 +1,296 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageSourcePngProgressive.h"
+#include <png.h>
+
+#include <cstring>
+#include <vector>
+
+namespace cinder {
+
+struct ImageSourcePngProgressiveCallbacks {
+	static void info( png_structp pngPtr, png_infop infoPtr )
+	{
+		reinterpret_cast<ImageSourcePngProgressive*>( png_get_progressive_ptr( pngPtr ) )->infoCallback();
+	}
+
+	static void row( png_structp pngPtr, png_bytep newRow, png_uint_32 rowNum, int pass )
+	{
+		reinterpret_cast<ImageSourcePngProgressive*>( png_get_progressive_ptr( pngPtr ) )->rowCallback( newRow, rowNum, pass );
+	}
+
+	static void end( png_structp pngPtr, png_infop infoPtr )
+	{
+		ImageSourcePngProgressive *source = reinterpret_cast<ImageSourcePngProgressive*>( png_get_progressive_ptr( pngPtr ) );
+		source->flushBlock( source->mBlockPass );
+		source->mFinished = true;
+	}
+};
+
+extern "C" {
+
+static void ci_png_progressive_info( png_structp pngPtr, png_infop infoPtr )
+{
+	ImageSourcePngProgressiveCallbacks::info( pngPtr, infoPtr );
+}
+
+static void ci_png_progressive_row( png_structp pngPtr, png_bytep newRow, png_uint_32 rowNum, int pass )
+{
+	ImageSourcePngProgressiveCallbacks::row( pngPtr, newRow, rowNum, pass );
+}
+
+static void ci_png_progressive_end( png_structp pngPtr, png_infop infoPtr )
+{
+	ImageSourcePngProgressiveCallbacks::end( pngPtr, infoPtr );
+}
+
+static void ci_png_progressive_warning( png_structp pngPtr, png_const_charp message )
+{
+}
+
+static void ci_png_progressive_error( png_structp pngPtr, png_const_charp message )
+{
+	longjmp( png_jmpbuf( pngPtr ), 1 );
+}
+
+} // extern "C"
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageSourcePngProgressive
+ImageSourcePngProgressiveRef ImageSourcePngProgressive::createRef( DataSourceRef dataSourceRef, size_t chunkSize )
+{
+	return ImageSourcePngProgressiveRef( new ImageSourcePngProgressive( dataSourceRef->getStream(), chunkSize ) );
+}
+
+ImageSourcePngProgressiveRef ImageSourcePngProgressive::createRef( IStreamRef stream, size_t chunkSize )
+{
+	return ImageSourcePngProgressiveRef( new ImageSourcePngProgressive( stream, chunkSize ) );
+}
+
+ImageSourcePngProgressive::ImageSourcePngProgressive( IStreamRef stream, size_t chunkSize )
+	: ImageSource(), mStream( stream ), mChunkSize( std::max<size_t>( chunkSize, 64 ) ), mPngPtr( 0 ), mInfoPtr( 0 ), mNumPasses( 1 ), mRowBytes( 0 ),
+		mHeaderRead( false ), mFinished( false ), mCallbackFailed( false ), mRowFunc( 0 ), mRowsPerBlock( 16 ), mBlockBegin( 0 ), mBlockEnd( 0 ), mBlockPass( 0 )
+{
+	mPngPtr = png_create_read_struct( PNG_LIBPNG_VER_STRING, (png_voidp)NULL, ci_png_progressive_error, ci_png_progressive_warning );
+	if( ! mPngPtr )
+		throw ImageSourcePngProgressiveException();
+
+	mInfoPtr = png_create_info_struct( mPngPtr );
+	if( ! mInfoPtr ) {
+		png_destroy_read_struct( &mPngPtr, (png_infopp)NULL, (png_infopp)NULL );
+		mPngPtr = 0;
+		throw ImageSourcePngProgressiveException();
+	}
+
+	png_set_progressive_read_fn( mPngPtr, reinterpret_cast<void*>( this ), ci_png_progressive_info, ci_png_progressive_row, ci_png_progressive_end );
+
+	// the destructor won't run if we throw from here, so the libpng structs have to be released first
+	bool headerRead = false;
+	try {
+		headerRead = readHeader();
+	}
+	catch( ... ) {
+		png_destroy_read_struct( &mPngPtr, &mInfoPtr, NULL );
+		throw;
+	}
+	if( ! headerRead ) {
+		png_destroy_read_struct( &mPngPtr, &mInfoPtr, NULL );
+		throw ImageSourcePngProgressiveException();
+	}
+}
+
+ImageSourcePngProgressive::~ImageSourcePngProgressive()
+{
+	if( mPngPtr )
+		png_destroy_read_struct( &mPngPtr, &mInfoPtr, NULL );
+}
+
+// Feeds the signature and then whole chunks until libpng has seen the first IDAT chunk header. Stopping there means no
+// image data is decoded before load() has supplied a target.
+bool ImageSourcePngProgressive::readHeader()
+{
+	uint8_t signature[8];
+	mStream->readData( signature, 8 );
+	if( ! processData( signature, 8 ) )
+		return false;
+
+	std::vector<uint8_t> chunk( mChunkSize );
+	while( ! mHeaderRead ) {
+		uint8_t chunkHeader[8];
+		mStream->readData( chunkHeader, 8 );
+		uint32_t length = ( chunkHeader[0] << 24 ) | ( chunkHeader[1] << 16 ) | ( chunkHeader[2] << 8 ) | chunkHeader[3];
+		if( length > 0x7FFFFFFF )
+			return false;
+		if( ! processData( chunkHeader, 8 ) )
+			return false;
+		if( mHeaderRead ) // this was the first IDAT
+			break;
+
+		size_t remaining = length + 4; // chunk data followed by its CRC
+		while( remaining > 0 ) {
+			size_t size = std::min( remaining, mChunkSize );
+			mStream->readData( &chunk[0], size );
+			if( ! processData( &chunk[0], size ) )
+				return false;
+			remaining -= size;
+		}
+	}
+
+	return true;
+}
+
+bool ImageSourcePngProgressive::processData( uint8_t *data, size_t size )
+{
+	if( setjmp( png_jmpbuf( mPngPtr ) ) )
+		return false;
+
+	png_process_data( mPngPtr, mInfoPtr, data, size );
+	return ! mCallbackFailed;
+}
+
+void ImageSourcePngProgressive::infoCallback()
+{
+	png_uint_32 width, height;
+	int bitDepth, colorType, interlaceType, compressionType, filterMethod;
+	png_get_IHDR( mPngPtr, mInfoPtr, &width, &height, &bitDepth, &colorType, &interlaceType, &compressionType, &filterMethod );
+
+	setSize( width, height );
+	setDataType( ( bitDepth == 16 ) ? ImageIo::UINT16 : ImageIo::UINT8 );
+
+#ifdef CINDER_LITTLE_ENDIAN
+	png_set_swap( mPngPtr );
+#endif
+
+	switch( colorType ) {
+		case PNG_COLOR_TYPE_GRAY:
+			setColorModel( ImageIo::CM_GRAY );
+			setChannelOrder( ImageIo::Y );
+		break;
+		case PNG_COLOR_TYPE_GRAY_ALPHA:
+			setColorModel( ImageIo::CM_GRAY );
+			setChannelOrder( ImageIo::YA );
+		break;
+		case PNG_COLOR_TYPE_RGB:
+		case PNG_COLOR_TYPE_PALETTE:
+			setColorModel( ImageIo::CM_RGB );
+			setChannelOrder( ImageIo::RGB );
+		break;
+		case PNG_COLOR_TYPE_RGB_ALPHA:
+			setColorModel( ImageIo::CM_RGB );
+			setChannelOrder( ImageIo::RGBA );
+		break;
+		default:
+			png_error( mPngPtr, "unknown color type" );
+	}
+
+	png_set_expand_gray_1_2_4_to_8( mPngPtr );
+	png_set_palette_to_rgb( mPngPtr );
+	if( png_get_valid( mPngPtr, mInfoPtr, PNG_INFO_tRNS ) ) {
+		png_set_tRNS_to_alpha( mPngPtr );
+		setChannelOrder( ( mColorModel == ImageIo::CM_GRAY ) ? ImageIo::YA : ImageIo::RGBA );
+	}
+	mNumPasses = png_set_interlace_handling( mPngPtr );
+
+	png_read_update_info( mPngPtr, mInfoPtr );
+	mRowBytes = png_get_rowbytes( mPngPtr, mInfoPtr );
+	mHeaderRead = true;
+}
+
+void ImageSourcePngProgressive::rowCallback( uint8_t *newRow, uint32_t rowNum, int32_t pass )
+{
+	// libpng hands us NULL for rows which are unchanged by this pass of an interlaced image
+	if( ( ! newRow ) || mCallbackFailed || ( (int32_t)rowNum >= mHeight ) )
+		return;
+
+	if( pass != mBlockPass ) {
+		flushBlock( mBlockPass );
+		mBlockPass = pass;
+	}
+	if( mBlockEnd == mBlockBegin )
+		mBlockBegin = rowNum;
+
+	const uint8_t *rowData = newRow;
+	if( mImage ) {
+		uint8_t *imageRow = mImage.get() + rowNum * mRowBytes;
+		png_progressive_combine_row( mPngPtr, imageRow, newRow );
+		rowData = imageRow;
+	}
+
+	try {
+		((*this).*mRowFunc)( mTarget, rowNum, rowData );
+	}
+	catch( ... ) { // we can't let an exception unwind through libpng
+		mCallbackFailed = true;
+		return;
+	}
+
+	mBlockEnd = rowNum + 1;
+	if( mBlockEnd - mBlockBegin >= mRowsPerBlock )
+		flushBlock( pass );
+}
+
+void ImageSourcePngProgressive::flushBlock( int32_t pass )
+{
+	if( ( mBlockEnd > mBlockBegin ) && mRowsCallback && ( ! mCallbackFailed ) ) {
+		try {
+			mRowsCallback( mBlockBegin, mBlockEnd, pass );
+		}
+		catch( ... ) {
+			mCallbackFailed = true;
+		}
+	}
+	mBlockBegin = mBlockEnd;
+}
+
+void ImageSourcePngProgressive::load( ImageTargetRef target )
+{
+	// the stream is consumed as we go, so an image can only be loaded once
+	if( ( ! mPngPtr ) || mFinished || mTarget )
+		throw ImageSourcePngProgressiveException();
+
+	mTarget = target;
+	mRowFunc = setupRowFunc( target );
+	if( mNumPasses > 1 ) {
+		mImage = shared_ptr<uint8_t>( new uint8_t[mRowBytes * mHeight], checked_array_deleter<uint8_t>() );
+		memset( mImage.get(), 0, mRowBytes * mHeight );
+	}
+
+	std::vector<uint8_t> chunk( mChunkSize );
+	bool success = true;
+	while( success && ( ! mFinished ) ) {
+		size_t size = mStream->readDataAvailable( &chunk[0], mChunkSize );
+		if( size == 0 )
+			break;
+		success = processData( &chunk[0], size );
+	}
+
+	mTarget.reset();
+	mImage.reset();
+	if( ! mFinished ) {
+		png_destroy_read_struct( &mPngPtr, &mInfoPtr, NULL );
+		mPngPtr = 0;
+		throw ImageSourcePngProgressiveException();
+	}
+}
+
+} // namespace cinder
@@ -0,0 +1,204 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageTargetFileJpeg.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <setjmp.h>
+extern "C" {
+	#include <jpeglib.h>
+}
+
+namespace cinder {
+
+static const size_t JPEG_DEST_BUFFER_SIZE = 16384;
+
+struct ci_jpeg_dest_info {
+	ci_jpeg_dest_info() : mCreated( false ) {}
+	~ci_jpeg_dest_info() { if( mCreated ) jpeg_destroy_compress( &mCompress ); }
+
+	jpeg_compress_struct	mCompress;
+	jpeg_error_mgr			mErr;
+	jmp_buf					mJmpBuf;
+	jpeg_destination_mgr	mDest;
+	OStreamRef				mStream;
+	JOCTET					mBuffer[JPEG_DEST_BUFFER_SIZE];
+	bool					mCreated;
+};
+
+extern "C" {
+
+static void ci_jpeg_dest_error_exit( j_common_ptr cinfo )
+{
+	longjmp( reinterpret_cast<ci_jpeg_dest_info*>( cinfo->client_data )->mJmpBuf, 1 );
+}
+
+static void ci_jpeg_dest_output_message( j_common_ptr cinfo )
+{
+}
+
+static void ci_jpeg_init_destination( j_compress_ptr cinfo )
+{
+	ci_jpeg_dest_info *info = reinterpret_cast<ci_jpeg_dest_info*>( cinfo->client_data );
+	info->mDest.next_output_byte = info->mBuffer;
+	info->mDest.free_in_buffer = JPEG_DEST_BUFFER_SIZE;
+}
+
+static boolean ci_jpeg_empty_output_buffer( j_compress_ptr cinfo )
+{
+	ci_jpeg_dest_info *info = reinterpret_cast<ci_jpeg_dest_info*>( cinfo->client_data );
+	bool failed = false;
+	try {
+		// libjpeg asks us to write the entire buffer here, regardless of free_in_buffer
+		info->mStream->writeData( info->mBuffer, JPEG_DEST_BUFFER_SIZE );
+	}
+	catch( ... ) {
+		failed = true;
+	}
+	// jumping out of an active handler is undefined, so only longjmp once it has exited
+	if( failed )
+		longjmp( info->mJmpBuf, 1 );
+	info->mDest.next_output_byte = info->mBuffer;
+	info->mDest.free_in_buffer = JPEG_DEST_BUFFER_SIZE;
+	return TRUE;
+}
+
+static void ci_jpeg_term_destination( j_compress_ptr cinfo )
+{
+	ci_jpeg_dest_info *info = reinterpret_cast<ci_jpeg_dest_info*>( cinfo->client_data );
+	size_t remaining = JPEG_DEST_BUFFER_SIZE - info->mDest.free_in_buffer;
+	bool failed = false;
+	try {
+		if( remaining > 0 )
+			info->mStream->writeData( info->mBuffer, remaining );
+	}
+	catch( ... ) {
+		failed = true;
+	}
+	if( failed )
+		longjmp( info->mJmpBuf, 1 );
+}
+
+} // extern "C"
+
+namespace {
+
+// separated so that nothing with a destructor lives in the frame that calls setjmp
+bool compressJpeg( ci_jpeg_dest_info *info, const uint8_t *data, int32_t width, int32_t height, int32_t rowBytes, bool gray, int32_t quality )
+{
+	jpeg_compress_struct *cinfo = &info->mCompress;
+	if( setjmp( info->mJmpBuf ) )
+		return false;
+
+	jpeg_create_compress( cinfo );
+	info->mCreated = true;
+	cinfo->client_data = info;
+
+	info->mDest.init_destination = ci_jpeg_init_destination;
+	info->mDest.empty_output_buffer = ci_jpeg_empty_output_buffer;
+	info->mDest.term_destination = ci_jpeg_term_destination;
+	cinfo->dest = &info->mDest;
+
+	cinfo->image_width = width;
+	cinfo->image_height = height;
+	cinfo->input_components = gray ? 1 : 3;
+	cinfo->in_color_space = gray ? JCS_GRAYSCALE : JCS_RGB;
+	jpeg_set_defaults( cinfo );
+	jpeg_set_quality( cinfo, quality, TRUE );
+
+	jpeg_start_compress( cinfo, TRUE );
+	while( cinfo->next_scanline < cinfo->image_height ) {
+		JSAMPROW rowPointer = const_cast<JSAMPROW>( data + cinfo->next_scanline * rowBytes );
+		jpeg_write_scanlines( cinfo, &rowPointer, 1 );
+	}
+	jpeg_finish_compress( cinfo );
+
+	return true;
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageTargetFileJpeg::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::TargetCreationFunc func = ImageTargetFileJpeg::createRef;
+	ImageIoRegistrar::registerTargetType( "jpg", func, PRIORITY, "jpg" );
+	ImageIoRegistrar::registerTargetType( "jpeg", func, PRIORITY, "jpg" );
+	ImageIoRegistrar::registerTargetType( "jpe", func, PRIORITY, "jpg" );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageTargetFileJpeg
+ImageTargetRef ImageTargetFileJpeg::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+{
+	return ImageTargetRef( new ImageTargetFileJpeg( dataTarget, imageSource, DEFAULT_QUALITY ) );
+}
+
+ImageTargetFileJpegRef ImageTargetFileJpeg::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, int32_t quality )
+{
+	return ImageTargetFileJpegRef( new ImageTargetFileJpeg( dataTarget, imageSource, quality ) );
+}
+
+ImageTargetFileJpeg::ImageTargetFileJpeg( DataTargetRef dataTarget, ImageSourceRef imageSource, int32_t quality )
+	: ImageTarget(), mQuality( quality ), mDataTarget( dataTarget )
+{
+	setSize( imageSource->getWidth(), imageSource->getHeight() );
+	setDataType( ImageIo::UINT8 );
+	// JPEG has no alpha, so we just ask for the color channels
+	if( imageSource->getColorModel() == ImageIo::CM_GRAY ) {
+		setColorModel( ImageIo::CM_GRAY );
+		setChannelOrder( ImageIo::Y );
+		mRowBytes = mWidth;
+	}
+	else {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( ImageIo::RGB );
+		mRowBytes = mWidth * 3;
+	}
+
+	mData = shared_ptr<uint8_t>( new uint8_t[mHeight * mRowBytes], checked_array_deleter<uint8_t>() );
+}
+
+void* ImageTargetFileJpeg::getRowPointer( int32_t row )
+{
+	return mData.get() + row * mRowBytes;
+}
+
+void ImageTargetFileJpeg::finalize()
+{
+	int32_t quality = std::max<int32_t>( 1, std::min<int32_t>( 100, mQuality ) );
+
+	shared_ptr<ci_jpeg_dest_info> info( new ci_jpeg_dest_info );
+	info->mStream = mDataTarget->getStream();
+	info->mCompress.err = jpeg_std_error( &info->mErr );
+	info->mErr.error_exit = ci_jpeg_dest_error_exit;
+	info->mErr.output_message = ci_jpeg_dest_output_message;
+	info->mCompress.client_data = info.get();
+
+	if( ! compressJpeg( info.get(), mData.get(), mWidth, mHeight, mRowBytes, getColorModel() == ImageIo::CM_GRAY, quality ) )
+		throw ImageIoExceptionFailedWrite();
+}
+
+} // namespace cinder
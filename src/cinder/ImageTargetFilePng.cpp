@@ -0,0 +1,339 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageTargetFilePng.h"
+#include "cinder/Utilities.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+using namespace std;
+
+namespace cinder {
+
+namespace {
+
+const size_t MIN_STRIP_BYTES = 128 * 1024;
+const size_t DICTIONARY_SIZE = 32768;
+
+inline uint8_t paethPredictor( int32_t a, int32_t b, int32_t c )
+{
+	int32_t p = a + b - c;
+	int32_t pa = abs( p - a ), pb = abs( p - b ), pc = abs( p - c );
+	if( ( pa <= pb ) && ( pa <= pc ) )
+		return static_cast<uint8_t>( a );
+	else if( pb <= pc )
+		return static_cast<uint8_t>( b );
+	else
+		return static_cast<uint8_t>( c );
+}
+
+// Filters \a cur into \a out using filter \a type; \a prev is the unfiltered previous row or NULL for the first row
+void applyFilter( int32_t type, const uint8_t *cur, const uint8_t *prev, uint8_t *out, size_t rowBytes, size_t bpp )
+{
+	switch( type ) {
+		case ImageTargetFilePng::FILTER_NONE:
+			memcpy( out, cur, rowBytes );
+		break;
+		case ImageTargetFilePng::FILTER_SUB:
+			for( size_t i = 0; i < rowBytes; ++i )
+				out[i] = cur[i] - ( ( i >= bpp ) ? cur[i - bpp] : 0 );
+		break;
+		case ImageTargetFilePng::FILTER_UP:
+			for( size_t i = 0; i < rowBytes; ++i )
+				out[i] = cur[i] - ( prev ? prev[i] : 0 );
+		break;
+		case ImageTargetFilePng::FILTER_AVERAGE:
+			for( size_t i = 0; i < rowBytes; ++i ) {
+				int32_t left = ( i >= bpp ) ? cur[i - bpp] : 0;
+				int32_t up = prev ? prev[i] : 0;
+				out[i] = cur[i] - static_cast<uint8_t>( ( left + up ) >> 1 );
+			}
+		break;
+		case ImageTargetFilePng::FILTER_PAETH:
+			for( size_t i = 0; i < rowBytes; ++i ) {
+				int32_t left = ( i >= bpp ) ? cur[i - bpp] : 0;
+				int32_t up = prev ? prev[i] : 0;
+				int32_t upLeft = ( prev && ( i >= bpp ) ) ? prev[i - bpp] : 0;
+				out[i] = cur[i] - paethPredictor( left, up, upLeft );
+			}
+		break;
+	}
+}
+
+// the usual heuristic: the sum of the filtered bytes interpreted as signed
+uint32_t filterCost( const uint8_t *data, size_t size )
+{
+	uint32_t result = 0;
+	for( size_t i = 0; i < size; ++i )
+		result += abs( static_cast<int8_t>( data[i] ) );
+	return result;
+}
+
+void writeUint32Big( uint8_t *data, uint32_t value )
+{
+	data[0] = ( value >> 24 ) & 0xFF; data[1] = ( value >> 16 ) & 0xFF; data[2] = ( value >> 8 ) & 0xFF; data[3] = value & 0xFF;
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageTargetFilePng::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::TargetCreationFunc func = ImageTargetFilePng::createRef;
+	ImageIoRegistrar::registerTargetType( "png", func, PRIORITY, "png" );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageTargetFilePng
+ImageTargetRef ImageTargetFilePng::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+{
+	return ImageTargetRef( new ImageTargetFilePng( dataTarget, imageSource, Options() ) );
+}
+
+ImageTargetFilePngRef ImageTargetFilePng::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const Options &options )
+{
+	return ImageTargetFilePngRef( new ImageTargetFilePng( dataTarget, imageSource, options ) );
+}
+
+ImageTargetFilePng::ImageTargetFilePng( DataTargetRef dataTarget, ImageSourceRef imageSource, const Options &options )
+	: ImageTarget(), mOptions( options ), mDataTarget( dataTarget )
+{
+	// PNG can't represent an empty image, and there would be no rows to filter or deflate
+	if( ( imageSource->getWidth() <= 0 ) || ( imageSource->getHeight() <= 0 ) )
+		throw ImageIoExceptionFailedWrite();
+	setSize( imageSource->getWidth(), imageSource->getHeight() );
+	// PNG tops out at 16 bits per channel, so float images are written at 16
+	setDataType( ( imageSource->getDataType() == ImageIo::UINT8 ) ? ImageIo::UINT8 : ImageIo::UINT16 );
+	if( imageSource->getColorModel() == ImageIo::CM_GRAY ) {
+		setColorModel( ImageIo::CM_GRAY );
+		setChannelOrder( imageSource->hasAlpha() ? ImageIo::YA : ImageIo::Y );
+	}
+	else {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( imageSource->hasAlpha() ? ImageIo::RGBA : ImageIo::RGB );
+	}
+
+	mBytesPerPixel = ImageIo::channelOrderNumChannels( mChannelOrder ) * ImageIo::dataTypeBytes( mDataType );
+	mRowBytes = mWidth * mBytesPerPixel;
+	mData = shared_ptr<uint8_t>( new uint8_t[mHeight * mRowBytes], checked_array_deleter<uint8_t>() );
+}
+
+void* ImageTargetFilePng::getRowPointer( int32_t row )
+{
+	return mData.get() + row * mRowBytes;
+}
+
+void ImageTargetFilePng::filterRow( int32_t row, uint8_t *scratch )
+{
+	const uint8_t *cur = mData.get() + row * mRowBytes;
+	const uint8_t *prev = ( row > 0 ) ? cur - mRowBytes : 0;
+	uint8_t *out = &mFiltered[row * ( mRowBytes + 1 )];
+
+	if( mOptions.getFilter() != FILTER_ADAPTIVE ) {
+		out[0] = static_cast<uint8_t>( mOptions.getFilter() );
+		applyFilter( mOptions.getFilter(), cur, prev, out + 1, mRowBytes, mBytesPerPixel );
+		return;
+	}
+
+	uint32_t bestCost = 0xFFFFFFFF;
+	int32_t bestFilter = FILTER_NONE;
+	for( int32_t filter = FILTER_NONE; filter <= FILTER_PAETH; ++filter ) {
+		applyFilter( filter, cur, prev, scratch, mRowBytes, mBytesPerPixel );
+		uint32_t cost = filterCost( scratch, mRowBytes );
+		if( cost < bestCost ) {
+			bestCost = cost;
+			bestFilter = filter;
+			memcpy( out + 1, scratch, mRowBytes );
+		}
+	}
+	out[0] = static_cast<uint8_t>( bestFilter );
+}
+
+void ImageTargetFilePng::filterStrips( size_t threadIndex, size_t numThreads )
+{
+	vector<uint8_t> scratch( mRowBytes );
+	for( size_t s = threadIndex; s < mStrips.size(); s += numThreads )
+		for( int32_t row = mStrips[s].mRowBegin; row < mStrips[s].mRowEnd; ++row )
+			filterRow( row, &scratch[0] );
+}
+
+void ImageTargetFilePng::deflateStrips( size_t threadIndex, size_t numThreads )
+{
+	for( size_t s = threadIndex; s < mStrips.size(); s += numThreads )
+		deflateStrip( s );
+}
+
+// Each strip is a raw deflate stream primed with the preceding 32k of filtered data. All but the last end with a sync flush,
+// which leaves the stream byte aligned and unterminated, so the strips can simply be concatenated.
+void ImageTargetFilePng::deflateStrip( size_t stripIndex )
+{
+	Strip &strip( mStrips[stripIndex] );
+	bool last = ( stripIndex + 1 == mStrips.size() );
+	size_t begin = strip.mRowBegin * ( mRowBytes + 1 );
+	size_t size = ( strip.mRowEnd - strip.mRowBegin ) * ( mRowBytes + 1 );
+	const uint8_t *input = &mFiltered[0] + begin;
+
+	strip.mAdler = adler32( adler32( 0L, Z_NULL, 0 ), input, size );
+
+	z_stream stream;
+	memset( &stream, 0, sizeof(stream) );
+	if( deflateInit2( &stream, mOptions.getCompressionLevel(), Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+		strip.mFailed = true;
+		return;
+	}
+	if( begin > 0 ) {
+		size_t dictionarySize = std::min( begin, DICTIONARY_SIZE );
+		deflateSetDictionary( &stream, input - dictionarySize, dictionarySize );
+	}
+
+	// the first strip leaves room for the zlib header and the last for the adler32 trailer
+	size_t prefix = ( stripIndex == 0 ) ? 2 : 0;
+	strip.mDeflated.resize( prefix + deflateBound( &stream, size ) + 16 );
+	stream.next_in = const_cast<Bytef*>( input );
+	stream.avail_in = size;
+	stream.next_out = &strip.mDeflated[prefix];
+	stream.avail_out = strip.mDeflated.size() - prefix;
+
+	int result = deflate( &stream, last ? Z_FINISH : Z_SYNC_FLUSH );
+	while( ( last && ( result == Z_OK ) ) || ( ( ! last ) && ( result == Z_OK ) && ( stream.avail_out == 0 ) ) ) { // deflateBound() should make this unnecessary
+		size_t used = strip.mDeflated.size();
+		strip.mDeflated.resize( used * 2 );
+		stream.next_out = &strip.mDeflated[used];
+		stream.avail_out = used;
+		result = deflate( &stream, last ? Z_FINISH : Z_SYNC_FLUSH );
+	}
+	strip.mFailed = last ? ( result != Z_STREAM_END ) : ( result != Z_OK );
+	strip.mDeflated.resize( strip.mDeflated.size() - stream.avail_out );
+	deflateEnd( &stream );
+}
+
+void ImageTargetFilePng::runThreads( void (ImageTargetFilePng::*fn)( size_t, size_t ), size_t numThreads )
+{
+	if( numThreads == 1 ) {
+		(this->*fn)( 0, 1 );
+		return;
+	}
+
+	vector<shared_ptr<boost::thread> > threads;
+	for( size_t t = 0; t < numThreads; ++t )
+		threads.push_back( shared_ptr<boost::thread>( new boost::thread( boost::bind( fn, this, t, numThreads ) ) ) );
+	for( size_t t = 0; t < numThreads; ++t )
+		threads[t]->join();
+}
+
+void ImageTargetFilePng::writeChunk( OStreamRef stream, const char *type, const uint8_t *data, size_t size )
+{
+	uint8_t header[8];
+	writeUint32Big( header, static_cast<uint32_t>( size ) );
+	memcpy( header + 4, type, 4 );
+	uLong crc = crc32( crc32( 0L, Z_NULL, 0 ), header + 4, 4 );
+	if( size > 0 )
+		crc = crc32( crc, data, size );
+	uint8_t trailer[4];
+	writeUint32Big( trailer, static_cast<uint32_t>( crc ) );
+
+	stream->writeData( header, 8 );
+	if( size > 0 )
+		stream->writeData( data, size );
+	stream->writeData( trailer, 4 );
+}
+
+void ImageTargetFilePng::finalize()
+{
+#if defined( CINDER_LITTLE_ENDIAN )
+	// PNG samples are big endian
+	if( mDataType == ImageIo::UINT16 )
+		swapEndianBlock( reinterpret_cast<uint16_t*>( mData.get() ), mHeight * mRowBytes );
+#endif
+
+	size_t numThreads = ( mOptions.getNumThreads() > 0 ) ? mOptions.getNumThreads() : std::max<size_t>( 1, boost::thread::hardware_concurrency() );
+	size_t filteredSize = mHeight * ( mRowBytes + 1 );
+	size_t numStrips = 1;
+	if( numThreads > 1 )
+		numStrips = std::max<size_t>( 1, std::min<size_t>( std::min<size_t>( filteredSize / MIN_STRIP_BYTES, numThreads * 4 ), mHeight ) );
+	numThreads = std::min( numThreads, numStrips );
+
+	mFiltered.resize( filteredSize );
+	mStrips.resize( numStrips );
+	for( size_t s = 0; s < numStrips; ++s ) {
+		mStrips[s].mRowBegin = static_cast<int32_t>( s * mHeight / numStrips );
+		mStrips[s].mRowEnd = static_cast<int32_t>( ( s + 1 ) * mHeight / numStrips );
+		mStrips[s].mFailed = false;
+	}
+
+	// every strip's dictionary comes from its predecessor's filtered rows, so filtering has to finish before any deflating starts
+	runThreads( &ImageTargetFilePng::filterStrips, numThreads );
+	runThreads( &ImageTargetFilePng::deflateStrips, numThreads );
+
+	uLong adler = adler32( 0L, Z_NULL, 0 );
+	for( size_t s = 0; s < numStrips; ++s ) {
+		if( mStrips[s].mFailed )
+			throw ImageIoExceptionFailedWrite();
+		adler = adler32_combine( adler, mStrips[s].mAdler, ( mStrips[s].mRowEnd - mStrips[s].mRowBegin ) * ( mRowBytes + 1 ) );
+	}
+
+	// zlib header: deflate with a 32k window, FLEVEL from the compression level and no preset dictionary
+	int32_t level = mOptions.getCompressionLevel();
+	uint8_t cmf = 0x78;
+	uint8_t flg = ( ( level < 2 ) ? 0 : ( level < 6 ) ? 1 : ( level == 6 ) ? 2 : 3 ) << 6;
+	flg += ( 31 - ( ( cmf * 256 + flg ) % 31 ) ) % 31;
+	mStrips.front().mDeflated[0] = cmf;
+	mStrips.front().mDeflated[1] = flg;
+	uint8_t trailer[4];
+	writeUint32Big( trailer, static_cast<uint32_t>( adler ) );
+	mStrips.back().mDeflated.insert( mStrips.back().mDeflated.end(), trailer, trailer + 4 );
+
+	uint8_t colorType;
+	switch( mChannelOrder ) {
+		case ImageIo::Y: colorType = 0; break;
+		case ImageIo::YA: colorType = 4; break;
+		case ImageIo::RGB: colorType = 2; break;
+		default: colorType = 6; break;
+	}
+	uint8_t ihdr[13];
+	writeUint32Big( ihdr, mWidth );
+	writeUint32Big( ihdr + 4, mHeight );
+	ihdr[8] = ( mDataType == ImageIo::UINT8 ) ? 8 : 16;
+	ihdr[9] = colorType;
+	ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	OStreamRef stream = mDataTarget->getStream();
+	stream->writeData( signature, 8 );
+	writeChunk( stream, "IHDR", ihdr, 13 );
+	// the zlib stream may be split across IDAT chunks at arbitrary points, so each strip gets its own
+	for( size_t s = 0; s < numStrips; ++s )
+		writeChunk( stream, "IDAT", &mStrips[s].mDeflated[0], mStrips[s].mDeflated.size() );
+	writeChunk( stream, "IEND", 0, 0 );
+
+	mFiltered.clear();
+	mStrips.clear();
+}
+
+} // namespace cinder
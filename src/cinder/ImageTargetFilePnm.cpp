@@ -0,0 +1,104 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageTargetFilePnm.h"
+#include "cinder/Utilities.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace cinder {
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageTargetFilePnm::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::TargetCreationFunc func = ImageTargetFilePnm::createRef;
+	ImageIoRegistrar::registerTargetType( "ppm", func, PRIORITY, "ppm" );
+	ImageIoRegistrar::registerTargetType( "pgm", func, PRIORITY, "pgm" );
+	ImageIoRegistrar::registerTargetType( "pnm", func, PRIORITY, "pnm" );
+	ImageIoRegistrar::registerTargetType( "pfm", func, PRIORITY, "pfm" );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageTargetFilePnm
+ImageTargetRef ImageTargetFilePnm::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+{
+	return ImageTargetRef( new ImageTargetFilePnm( dataTarget, imageSource, extensionData ) );
+}
+
+ImageTargetFilePnm::ImageTargetFilePnm( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+	: ImageTarget(), mIsPfm( extensionData == "pfm" ), mDataTarget( dataTarget )
+{
+	setSize( imageSource->getWidth(), imageSource->getHeight() );
+
+	bool gray;
+	if( extensionData == "pgm" )
+		gray = true;
+	else if( extensionData == "ppm" )
+		gray = false;
+	else
+		gray = imageSource->getColorModel() == ImageIo::CM_GRAY;
+	setColorModel( gray ? ImageIo::CM_GRAY : ImageIo::CM_RGB );
+	setChannelOrder( gray ? ImageIo::Y : ImageIo::RGB );
+
+	char header[64];
+	if( mIsPfm ) {
+		setDataType( ImageIo::FLOAT32 );
+	#if defined( CINDER_LITTLE_ENDIAN )
+		sprintf( header, "%s\n%d %d\n-1.0\n", gray ? "Pf" : "PF", mWidth, mHeight );
+	#else
+		sprintf( header, "%s\n%d %d\n1.0\n", gray ? "Pf" : "PF", mWidth, mHeight );
+	#endif
+	}
+	else {
+		setDataType( ( imageSource->getDataType() == ImageIo::UINT8 ) ? ImageIo::UINT8 : ImageIo::UINT16 );
+		sprintf( header, "%s\n%d %d\n%d\n", gray ? "P5" : "P6", mWidth, mHeight, ( mDataType == ImageIo::UINT8 ) ? 255 : 65535 );
+	}
+
+	mHeaderSize = strlen( header );
+	mRowBytes = mWidth * ImageIo::channelOrderNumChannels( mChannelOrder ) * ImageIo::dataTypeBytes( mDataType );
+	mData = shared_ptr<uint8_t>( new uint8_t[mHeaderSize + mHeight * mRowBytes], checked_array_deleter<uint8_t>() );
+	memcpy( mData.get(), header, mHeaderSize );
+}
+
+void* ImageTargetFilePnm::getRowPointer( int32_t row )
+{
+	// PFM stores its rows bottom to top
+	if( mIsPfm )
+		row = mHeight - 1 - row;
+	return mData.get() + mHeaderSize + row * mRowBytes;
+}
+
+void ImageTargetFilePnm::finalize()
+{
+#if defined( CINDER_LITTLE_ENDIAN )
+	// 16 bit PGM and PPM are always big endian
+	if( mDataType == ImageIo::UINT16 )
+		swapEndianBlock( reinterpret_cast<uint16_t*>( mData.get() + mHeaderSize ), mHeight * mRowBytes );
+#endif
+
+	mDataTarget->getStream()->writeData( mData.get(), mHeaderSize + mHeight * mRowBytes );
+}
+
+} // namespace cinder
@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageTargetFileRaw.h"
+#include "cinder/ImageSourceFileRaw.h"
+
+#include <cstring>
+
+namespace cinder {
+
+namespace {
+
+void writeUint32Little( uint8_t *data, uint32_t value )
+{
+	data[0] = value & 0xFF; data[1] = ( value >> 8 ) & 0xFF; data[2] = ( value >> 16 ) & 0xFF; data[3] = ( value >> 24 ) & 0xFF;
+}
+
+} // anonymous namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageTargetFileRaw::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::TargetCreationFunc func = ImageTargetFileRaw::createRef;
+	ImageIoRegistrar::registerTargetType( "cri", func, PRIORITY, "cri" );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageTargetFileRaw
+ImageTargetRef ImageTargetFileRaw::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+{
+	return ImageTargetRef( new ImageTargetFileRaw( dataTarget, imageSource, extensionData ) );
+}
+
+ImageTargetFileRaw::ImageTargetFileRaw( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+	: ImageTarget(), mDataTarget( dataTarget )
+{
+	setSize( imageSource->getWidth(), imageSource->getHeight() );
+	setDataType( imageSource->getDataType() );
+	if( imageSource->getColorModel() == ImageIo::CM_GRAY ) {
+		setColorModel( ImageIo::CM_GRAY );
+		setChannelOrder( imageSource->hasAlpha() ? ImageIo::YA : ImageIo::Y );
+	}
+	else {
+		setColorModel( ImageIo::CM_RGB );
+		if( ( imageSource->getChannelOrder() != ImageIo::CUSTOM ) && ( imageSource->getChannelOrder() != ImageIo::Y ) && ( imageSource->getChannelOrder() != ImageIo::YA ) )
+			setChannelOrder( imageSource->getChannelOrder() );
+		else
+			setChannelOrder( imageSource->hasAlpha() ? ImageIo::RGBA : ImageIo::RGB );
+	}
+
+	mRowBytes = mWidth * ImageIo::channelOrderNumChannels( mChannelOrder ) * ImageIo::dataTypeBytes( mDataType );
+	mData = shared_ptr<uint8_t>( new uint8_t[ImageSourceFileRaw::HEADER_SIZE + mHeight * mRowBytes], checked_array_deleter<uint8_t>() );
+
+	uint8_t *header = mData.get();
+	memset( header, 0, ImageSourceFileRaw::HEADER_SIZE );
+	memcpy( header, "CIRI", 4 );
+	writeUint32Little( header + 4, ImageSourceFileRaw::VERSION );
+	writeUint32Little( header + 8, mWidth );
+	writeUint32Little( header + 12, mHeight );
+	writeUint32Little( header + 16, mRowBytes );
+	header[20] = static_cast<uint8_t>( mDataType );
+	header[21] = static_cast<uint8_t>( mColorModel );
+	header[22] = static_cast<uint8_t>( mChannelOrder );
+	header[23] = imageSource->isPremultiplied() ? 1 : 0;
+}
+
+void* ImageTargetFileRaw::getRowPointer( int32_t row )
+{
+	return mData.get() + ImageSourceFileRaw::HEADER_SIZE + row * mRowBytes;
+}
+
+void ImageTargetFileRaw::finalize()
+{
+	mDataTarget->getStream()->writeData( mData.get(), ImageSourceFileRaw::HEADER_SIZE + mHeight * mRowBytes );
+}
+
+} // namespace cinder
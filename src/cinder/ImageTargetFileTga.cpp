@@ -0,0 +1,94 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/ImageTargetFileTga.h"
+
+#include <cstring>
+
+namespace cinder {
+
+static const size_t TGA_HEADER_SIZE = 18;
+
+///////////////////////////////////////////////////////////////////////////////
+// Registrar
+void ImageTargetFileTga::registerSelf()
+{
+	const int32_t PRIORITY = 1;
+	ImageIoRegistrar::TargetCreationFunc func = ImageTargetFileTga::createRef;
+	ImageIoRegistrar::registerTargetType( "tga", func, PRIORITY, "tga" );
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ImageTargetFileTga
+ImageTargetRef ImageTargetFileTga::createRef( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+{
+	return ImageTargetRef( new ImageTargetFileTga( dataTarget, imageSource, extensionData ) );
+}
+
+ImageTargetFileTga::ImageTargetFileTga( DataTargetRef dataTarget, ImageSourceRef imageSource, const std::string &extensionData )
+	: ImageTarget(), mDataTarget( dataTarget )
+{
+	setSize( imageSource->getWidth(), imageSource->getHeight() );
+	if( ( mWidth > 65535 ) || ( mHeight > 65535 ) )
+		throw ImageIoExceptionFailedWrite();
+	setDataType( ImageIo::UINT8 );
+
+	uint8_t imageType, bitsPerPixel, alphaBits;
+	if( imageSource->getColorModel() == ImageIo::CM_GRAY && ( ! imageSource->hasAlpha() ) ) {
+		setColorModel( ImageIo::CM_GRAY );
+		setChannelOrder( ImageIo::Y );
+		imageType = 3; bitsPerPixel = 8; alphaBits = 0;
+	}
+	else if( imageSource->hasAlpha() ) {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( ImageIo::BGRA );
+		imageType = 2; bitsPerPixel = 32; alphaBits = 8;
+	}
+	else {
+		setColorModel( ImageIo::CM_RGB );
+		setChannelOrder( ImageIo::BGR );
+		imageType = 2; bitsPerPixel = 24; alphaBits = 0;
+	}
+
+	mRowBytes = mWidth * ( bitsPerPixel / 8 );
+	mData = shared_ptr<uint8_t>( new uint8_t[TGA_HEADER_SIZE + mHeight * mRowBytes], checked_array_deleter<uint8_t>() );
+
+	uint8_t *header = mData.get();
+	memset( header, 0, TGA_HEADER_SIZE );
+	header[2] = imageType;
+	header[12] = mWidth & 0xFF; header[13] = ( mWidth >> 8 ) & 0xFF;
+	header[14] = mHeight & 0xFF; header[15] = ( mHeight >> 8 ) & 0xFF;
+	header[16] = bitsPerPixel;
+	header[17] = 0x20 | alphaBits; // top-left origin
+}
+
+void* ImageTargetFileTga::getRowPointer( int32_t row )
+{
+	return mData.get() + TGA_HEADER_SIZE + row * mRowBytes;
+}
+
+void ImageTargetFileTga::finalize()
+{
+	mDataTarget->getStream()->writeData( mData.get(), TGA_HEADER_SIZE + mHeight * mRowBytes );
+}
+
+} // namespace cinder
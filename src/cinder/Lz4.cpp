@@ -0,0 +1,342 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/Lz4.h"
+
+#include <cstring>
+#include <vector>
+
+namespace cinder { namespace lz4 {
+
+static const size_t MIN_MATCH = 4;
+static const size_t LAST_LITERALS = 5;		// the block must end with at least this many literals
+static const size_t MF_LIMIT = 12;			// and no match may start closer than this to its end
+static const size_t MAX_DISTANCE = 65535;
+static const int HASH_LOG = 14;
+
+static inline uint32_t read32( const uint8_t *p )
+{
+	uint32_t result;
+	memcpy( &result, p, sizeof(result) );
+	return result;
+}
+
+static inline uint32_t hashSequence( uint32_t sequence, int hashLog )
+{
+	return ( sequence * 2654435761U ) >> ( 32 - hashLog );
+}
+
+// Hashing 5 bytes rather than 4 finds noticeably more useful matches in interleaved pixel data
+static inline uint32_t hashPosition( const uint8_t *p )
+{
+	uint64_t sequence;
+	memcpy( &sequence, p, sizeof(sequence) );
+#ifdef CINDER_LITTLE_ENDIAN
+	return static_cast<uint32_t>( ( ( sequence << 24 ) * 889523592379ULL ) >> ( 64 - HASH_LOG ) );
+#else
+	return static_cast<uint32_t>( ( ( sequence >> 24 ) * 11400714785074694791ULL ) >> ( 64 - HASH_LOG ) );
+#endif
+}
+
+static inline size_t matchLength( const uint8_t *ip, const uint8_t *ref, const uint8_t *limit )
+{
+	const uint8_t *start = ip;
+	while( ( ip + 4 <= limit ) && ( read32( ip ) == read32( ref ) ) ) {
+		ip += 4;
+		ref += 4;
+	}
+	while( ( ip < limit ) && ( *ip == *ref ) ) {
+		++ip;
+		++ref;
+	}
+	return ip - start;
+}
+
+// Copies in 8 byte steps, so it may write up to 7 bytes past \a dstEnd
+static inline void wildCopy( uint8_t *dst, const uint8_t *src, uint8_t *dstEnd )
+{
+	do {
+		memcpy( dst, src, 8 );
+		dst += 8;
+		src += 8;
+	} while( dst < dstEnd );
+}
+
+static inline uint8_t* writeLength( uint8_t *op, size_t length )
+{
+	while( length >= 255 ) {
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = static_cast<uint8_t>( length );
+	return op;
+}
+
+// Emits literals [anchor, ip) followed by a match of \a length bytes at distance \a offset. An \a offset of 0 emits the final, literal-only sequence.
+static inline uint8_t* writeSequence( uint8_t *op, const uint8_t *anchor, const uint8_t *ip, size_t offset, size_t length )
+{
+	size_t literals = ip - anchor;
+	uint8_t *token = op++;
+	*token = static_cast<uint8_t>( ( literals >= 15 ? 15 : literals ) << 4 );
+	if( literals >= 15 )
+		op = writeLength( op, literals - 15 );
+	if( offset ) // a match follows, so the input and output both extend at least 8 bytes past the literals
+		wildCopy( op, anchor, op + literals );
+	else
+		memcpy( op, anchor, literals );
+	op += literals;
+
+	if( offset ) {
+		*op++ = static_cast<uint8_t>( offset & 0xFF );
+		*op++ = static_cast<uint8_t>( offset >> 8 );
+		length -= MIN_MATCH;
+		*token |= static_cast<uint8_t>( length >= 15 ? 15 : length );
+		if( length >= 15 )
+			op = writeLength( op, length - 15 );
+	}
+
+	return op;
+}
+
+size_t compressBound( size_t srcSize )
+{
+	return srcSize + srcSize / 255 + 16;
+}
+
+// Single-probe hash table, skipping ahead faster the longer it goes without finding a match
+static uint8_t* compressFast( const uint8_t *src, size_t srcSize, uint8_t *op )
+{
+	const uint8_t *ip = src, *anchor = src;
+	const uint8_t *const iend = src + srcSize;
+	const uint8_t *const mfLimit = iend - MF_LIMIT;
+	const uint8_t *const matchLimit = iend - LAST_LITERALS;
+
+	std::vector<uint32_t> table( 1 << HASH_LOG, 0 );
+	++ip;
+
+	size_t searchCount = 1 << 6;
+	while( ip < mfLimit ) {
+		uint32_t sequence = read32( ip );
+		uint32_t h = hashPosition( ip );
+		const uint8_t *ref = src + table[h];
+		table[h] = static_cast<uint32_t>( ip - src );
+		if( ( ref >= ip ) || ( static_cast<size_t>( ip - ref ) > MAX_DISTANCE ) || ( read32( ref ) != sequence ) ) {
+			// the step grows by one every 64 misses, so incompressible data is skipped over quickly
+			ip += searchCount++ >> 6;
+			continue;
+		}
+		searchCount = 1 << 6;
+
+		while( ( ip > anchor ) && ( ref > src ) && ( ip[-1] == ref[-1] ) ) {
+			--ip;
+			--ref;
+		}
+		size_t length = MIN_MATCH + matchLength( ip + MIN_MATCH, ref + MIN_MATCH, matchLimit );
+		op = writeSequence( op, anchor, ip, ip - ref, length );
+		ip += length;
+		anchor = ip;
+		if( ip < mfLimit ) // seed the table with a position inside the match
+			table[hashPosition( ip - 2 )] = static_cast<uint32_t>( ip - 2 - src );
+	}
+
+	return writeSequence( op, anchor, iend, 0, 0 );
+}
+
+// Hash chains over the last 64KB of positions
+struct HashChains {
+	static const int CHAIN_HASH_LOG = 15;
+
+	HashChains( const uint8_t *src, const uint8_t *matchLimit, int searchDepth )
+		: mSrc( src ), mMatchLimit( matchLimit ), mSearchDepth( searchDepth ), mHead( 1 << CHAIN_HASH_LOG, -1 ), mChain( MAX_DISTANCE + 1, 0 ), mNextToInsert( 0 )
+	{}
+
+	// Returns the longest match for \a ip among up to mSearchDepth candidates, or 0 if there is none
+	size_t findLongest( const uint8_t *ip, size_t *offset )
+	{
+		const size_t pos = ip - mSrc;
+		for( ; mNextToInsert < pos; ++mNextToInsert ) {
+			uint32_t h = hashSequence( read32( mSrc + mNextToInsert ), CHAIN_HASH_LOG );
+			size_t delta = ( mHead[h] < 0 ) ? 0 : mNextToInsert - mHead[h];
+			mChain[mNextToInsert & MAX_DISTANCE] = static_cast<uint16_t>( delta > MAX_DISTANCE ? 0 : delta );
+			mHead[h] = static_cast<int32_t>( mNextToInsert );
+		}
+
+		size_t bestLength = 0;
+		int32_t candidate = mHead[hashSequence( read32( ip ), CHAIN_HASH_LOG )];
+		for( int attempts = 0; ( candidate >= 0 ) && ( attempts < mSearchDepth ); ++attempts ) {
+			size_t distance = pos - candidate;
+			if( ( distance == 0 ) || ( distance > MAX_DISTANCE ) )
+				break;
+			const uint8_t *ref = mSrc + candidate;
+			if( ( ref[bestLength] == ip[bestLength] ) && ( read32( ref ) == read32( ip ) ) ) {
+				size_t length = MIN_MATCH + matchLength( ip + MIN_MATCH, ref + MIN_MATCH, mMatchLimit );
+				if( length > bestLength ) {
+					bestLength = length;
+					*offset = distance;
+				}
+			}
+			uint16_t step = mChain[candidate & MAX_DISTANCE];
+			if( step == 0 )
+				break;
+			candidate -= step;
+		}
+
+		return bestLength;
+	}
+
+	const uint8_t			*mSrc, *mMatchLimit;
+	int						mSearchDepth;
+	std::vector<int32_t>	mHead;
+	std::vector<uint16_t>	mChain;
+	size_t					mNextToInsert;
+};
+
+// Keeps the longest match found through the hash chains, deferring it whenever the next position offers a longer one
+static uint8_t* compressHigh( const uint8_t *src, size_t srcSize, uint8_t *op, int searchDepth )
+{
+	const uint8_t *ip = src, *anchor = src;
+	const uint8_t *const iend = src + srcSize;
+	const uint8_t *const mfLimit = iend - MF_LIMIT;
+	const uint8_t *const matchLimit = iend - LAST_LITERALS;
+	HashChains chains( src, matchLimit, searchDepth );
+
+	while( ip < mfLimit ) {
+		size_t offset = 0;
+		size_t length = chains.findLongest( ip, &offset );
+		if( length < MIN_MATCH ) {
+			++ip;
+			continue;
+		}
+
+		while( ip + 1 < mfLimit ) {
+			size_t nextOffset = 0;
+			size_t nextLength = chains.findLongest( ip + 1, &nextOffset );
+			if( nextLength <= length )
+				break;
+			++ip;
+			length = nextLength;
+			offset = nextOffset;
+		}
+
+		op = writeSequence( op, anchor, ip, offset, length );
+		ip += length;
+		anchor = ip;
+	}
+
+	return writeSequence( op, anchor, iend, 0, 0 );
+}
+
+size_t compress( const void *src, size_t srcSize, void *dst, size_t dstCapacity, int searchDepth )
+{
+	if( dstCapacity < compressBound( srcSize ) )
+		return 0;
+
+	const uint8_t *src8 = reinterpret_cast<const uint8_t*>( src );
+	uint8_t *dst8 = reinterpret_cast<uint8_t*>( dst );
+	uint8_t *op;
+	if( srcSize < MF_LIMIT + 1 ) // too small to hold a match
+		op = writeSequence( dst8, src8, src8 + srcSize, 0, 0 );
+	else if( searchDepth > 0 )
+		op = compressHigh( src8, srcSize, dst8, searchDepth );
+	else
+		op = compressFast( src8, srcSize, dst8 );
+
+	return op - dst8;
+}
+
+static inline bool readLength( const uint8_t *&ip, const uint8_t *iend, size_t *length )
+{
+	uint8_t b;
+	do {
+		if( ip >= iend )
+			return false;
+		b = *ip++;
+		*length += b;
+	} while( b == 255 );
+	return true;
+}
+
+bool decompress( const void *src, size_t srcSize, void *dst, size_t dstSize )
+{
+	const uint8_t *ip = reinterpret_cast<const uint8_t*>( src );
+	const uint8_t *const iend = ip + srcSize;
+	uint8_t *const dst8 = reinterpret_cast<uint8_t*>( dst );
+	uint8_t *op = dst8;
+	uint8_t *const oend = dst8 + dstSize;
+
+	while( ip < iend ) {
+		const uint8_t token = *ip++;
+		size_t literals = token >> 4;
+		if( ( literals == 15 ) && ! readLength( ip, iend, &literals ) )
+			return false;
+		if( ( literals > static_cast<size_t>( iend - ip ) ) || ( literals > static_cast<size_t>( oend - op ) ) )
+			return false;
+		if( ( literals + 8 <= static_cast<size_t>( iend - ip ) ) && ( literals + 8 <= static_cast<size_t>( oend - op ) ) )
+			wildCopy( op, ip, op + literals );
+		else
+			memcpy( op, ip, literals );
+		ip += literals;
+		op += literals;
+
+		if( ip == iend ) // the last sequence has no match
+			break;
+
+		if( iend - ip < 2 )
+			return false;
+		size_t offset = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+		if( ( offset == 0 ) || ( offset > static_cast<size_t>( op - dst8 ) ) )
+			return false;
+
+		size_t length = token & 15;
+		if( ( length == 15 ) && ! readLength( ip, iend, &length ) )
+			return false;
+		length += MIN_MATCH;
+		if( length > static_cast<size_t>( oend - op ) )
+			return false;
+
+		const uint8_t *ref = op - offset;
+		if( length + 8 <= static_cast<size_t>( oend - op ) ) {
+			if( offset < 8 ) {
+				// seed 8 bytes of the repeating pattern, then copy from a whole number of periods back, at least 8 bytes away
+				for( size_t i = 0; i < 8; ++i )
+					op[i] = ref[i];
+				const size_t period = offset * ( ( 8 + offset - 1 ) / offset );
+				if( length > 8 )
+					wildCopy( op + 8, op + 8 - period, op + length );
+			}
+			else
+				wildCopy( op, ref, op + length );
+		}
+		else if( offset >= length )
+			memcpy( op, ref, length );
+		else { // overlapping copy repeats the last offset bytes
+			for( size_t i = 0; i < length; ++i )
+				op[i] = ref[i];
+		}
+		op += length;
+	}
+
+	return op == oend;
+}
+
+} } // namespace cinder::lz4
@@ -22,133 +22,542 @@
 
 #include "cinder/ObjLoader.h"
 
-#include <boost/lexical_cast.hpp>
-using boost::lexical_cast;
-
-#include <sstream>
-using std::map;
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 using std::pair;
 using std::make_pair;
-using boost::make_tuple;
-using std::stringstream;
 using std::string;
 using std::vector;
 
 namespace cinder {
 
-ObjLoader::ObjLoader( shared_ptr<IStream> aStream, bool includeUVs )
-	: mStream( aStream )
+namespace {
+
+// files smaller than this per thread aren't worth splitting up
+const size_t MIN_CHUNK_SIZE = 2 * 1024 * 1024;
+const size_t READ_BLOCK_SIZE = 1024 * 1024;
+
+enum LineType { LINE_OTHER, LINE_VERTEX, LINE_TEXCOORD, LINE_NORMAL, LINE_FACE, LINE_GROUP };
+
+// A run of whole lines parsed independently of the rest of the file
+struct Chunk {
+	const char		*mBegin, *mEnd;
+	size_t			mNumVertices, mNumTexCoords, mNumNormals;	// counted by the first pass
+	size_t			mBaseVertex, mBaseTexCoord, mBaseNormal;	// the number of elements preceding this chunk in the file
+	size_t			mTotalVertices, mTotalTexCoords, mTotalNormals;	// the number of elements in the whole file
+	vector<ObjLoader::Group>	mGroups;	// mGroups[0] continues whichever group the previous chunk ended in
+};
+
+inline bool isBlank( char c )
 {
-	Group *currentGroup;
-	mGroups.push_back( Group() );
-	currentGroup = &mGroups[mGroups.size()-1];
-	currentGroup->mBaseVertexOffset = currentGroup->mBaseTexCoordOffset = currentGroup->mBaseNormalOffset = 0;
-
-	size_t lineNumber = 0;
-	while( ! mStream->isEof() ) {
-		lineNumber++;
-		string line = mStream->readLine(), tag;
-		stringstream ss( line );
-		ss >> tag;
-		if( tag == "v" ) { // vertex
-			Vec3f v;
-			ss >> v.x >> v.y >> v.z;
-			mVertices.push_back( v );
+	return ( c == ' ' ) || ( c == '\t' ) || ( c == '\r' );
+}
+
+inline bool isDigit( char c )
+{
+	return ( c >= '0' ) && ( c <= '9' );
+}
+
+inline const char* skipBlanks( const char *p, const char *end )
+{
+	while( ( p < end ) && isBlank( *p ) )
+		++p;
+	return p;
+}
+
+inline const char* findLineEnd( const char *p, const char *end )
+{
+	const char *result = reinterpret_cast<const char*>( memchr( p, '\n', end - p ) );
+	return ( result ) ? result : end;
+}
+
+// Returns the type of the line beginning at \a p and advances \a p past its tag
+LineType classifyLine( const char *&p, const char *lineEnd )
+{
+	p = skipBlanks( p, lineEnd );
+	if( lineEnd - p < 2 )
+		return LINE_OTHER;
+	LineType result = LINE_OTHER;
+	const char *tagEnd = p + 1;
+	if( p[0] == 'v' ) {
+		if( p[1] == 't' ) { result = LINE_TEXCOORD; ++tagEnd; }
+		else if( p[1] == 'n' ) { result = LINE_NORMAL; ++tagEnd; }
+		else result = LINE_VERTEX;
+	}
+	else if( p[0] == 'f' )
+		result = LINE_FACE;
+	else if( p[0] == 'g' )
+		result = LINE_GROUP;
+	
+	// the tag has to be followed by whitespace, which rules out things like "vp" or "fo"
+	if( ( result == LINE_OTHER ) || ( ( tagEnd < lineEnd ) && ( ! isBlank( *tagEnd ) ) ) )
+		return LINE_OTHER;
+	p = tagEnd;
+	return result;
+}
+
+const char* parseInt( const char *p, const char *end, int *result )
+{
+	const char *start = p;
+	bool negative = false;
+	if( ( p < end ) && ( ( *p == '-' ) || ( *p == '+' ) ) ) {
+		negative = *p == '-';
+		++p;
+	}
+	if( ( p == end ) || ( ! isDigit( *p ) ) )
+		return start;
+	int value = 0;
+	for( ; ( p < end ) && isDigit( *p ); ++p )
+		value = value * 10 + ( *p - '0' );
+	*result = ( negative ) ? -value : value;
+	return p;
+}
+
+// Parses a decimal float, leaving \a result untouched and returning \a p if there isn't one. Rarely seen forms like "inf" go through strtod().
+const char* parseFloat( const char *p, const char *end, float *result )
+{
+	static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+									1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char *start = p;
+	bool negative = false;
+	if( ( p < end ) && ( ( *p == '-' ) || ( *p == '+' ) ) ) {
+		negative = *p == '-';
+		++p;
+	}
+
+	// accumulate up to 19 significant digits, which is as many as fit in 64 bits and far more than a float can use
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool anyDigits = false;
+	for( ; ( p < end ) && isDigit( *p ); ++p ) {
+		anyDigits = true;
+		if( digits < 19 ) {
+			mantissa = mantissa * 10 + ( *p - '0' );
+			digits += ( mantissa != 0 ) ? 1 : 0;
 		}
-		else if( tag == "vt" ) { // vertex texture coordinates
-			if( includeUVs ) {
-				Vec2f tex;
-				ss >> tex.x >> tex.y;
-				mTexCoords.push_back( tex );
+		else
+			++exponent;
+	}
+	if( ( p < end ) && ( *p == '.' ) ) {
+		++p;
+		for( ; ( p < end ) && isDigit( *p ); ++p ) {
+			anyDigits = true;
+			if( digits < 19 ) {
+				mantissa = mantissa * 10 + ( *p - '0' );
+				digits += ( mantissa != 0 ) ? 1 : 0;
+				--exponent;
 			}
 		}
-		else if( tag == "vn" ) { // vertex normals
-			Vec3f v;
-			ss >> v.x >> v.y >> v.z;
-			mNormals.push_back( v.normalized() );
+	}
+	
+	if( ! anyDigits ) {
+		char text[32];
+		size_t length = 0;
+		for( const char *c = start; ( c < end ) && ( ! isBlank( *c ) ) && ( length < sizeof(text) - 1 ); ++c )
+			text[length++] = *c;
+		text[length] = 0;
+		char *textEnd;
+		double value = strtod( text, &textEnd );
+		if( textEnd == text )
+			return start;
+		*result = static_cast<float>( value );
+		return start + ( textEnd - text );
+	}
+
+	if( ( p < end ) && ( ( *p == 'e' ) || ( *p == 'E' ) ) ) {
+		const char *e = p + 1;
+		bool negativeExponent = false;
+		if( ( e < end ) && ( ( *e == '-' ) || ( *e == '+' ) ) ) {
+			negativeExponent = *e == '-';
+			++e;
 		}
-		else if( tag == "f" ) { // face
-			parseFace( currentGroup, line, includeUVs );
+		if( ( e < end ) && isDigit( *e ) ) {
+			int value = 0;
+			for( ; ( e < end ) && isDigit( *e ); ++e ) {
+				if( value < 10000 )
+					value = value * 10 + ( *e - '0' );
+			}
+			exponent += ( negativeExponent ) ? -value : value;
+			p = e;
 		}
-		else if( tag == "g" ) { // group
-			if( ! currentGroup->mFaces.empty() )
-				mGroups.push_back( Group() );
-			currentGroup = &mGroups[mGroups.size()-1];
-			currentGroup->mBaseVertexOffset = mVertices.size();
-			currentGroup->mBaseTexCoordOffset = mTexCoords.size();
-			currentGroup->mBaseNormalOffset = mNormals.size();
-			currentGroup->mName = line.substr( line.find( ' ' ) + 1 );
+	}
+
+	double value = static_cast<double>( mantissa );
+	if( ( mantissa != 0 ) && ( exponent != 0 ) ) {
+		if( ( exponent < 0 ) && ( exponent >= -22 ) )
+			value /= powersOf10[-exponent];
+		else if( ( exponent > 0 ) && ( exponent <= 22 ) )
+			value *= powersOf10[exponent];
+		else
+			value *= pow( 10.0, exponent );
+	}
+	*result = static_cast<float>( ( negative ) ? -value : value );
+	return p;
+}
+
+// Parses up to \a count floats, leaving any which are missing as zero
+const char* parseFloats( const char *p, const char *end, float *result, int count )
+{
+	for( int i = 0; i < count; ++i ) {
+		result[i] = 0;
+		p = parseFloat( skipBlanks( p, end ), end, &result[i] );
+	}
+	return p;
+}
+
+// Converts a 1-based or negative, relative OBJ index to a 0-based one, given that \a count of the file's \a total elements precede it. Returns -1 for an invalid index.
+inline int resolveIndex( int index, size_t count, size_t total )
+{
+	if( ( index > 0 ) && ( static_cast<size_t>( index ) <= total ) )
+		return index - 1;
+	else if( ( index < 0 ) && ( static_cast<size_t>( -index ) <= count ) )
+		return static_cast<int>( count ) + index;
+	else
+		return -1;
+}
+
+void parseFace( const char *p, const char *end, ObjLoader::Group *group, const Chunk &chunk, size_t numVertices, size_t numTexCoords, size_t numNormals, bool includeUVs )
+{
+	ObjLoader::Face face;
+	face.mNumVertices = 0;
+	face.mFirstIndex = group->mVertexIndices.size();
+	face.mHasTexCoords = face.mHasNormals = true;
+	bool valid = true;
+
+	// each vertex is one of "v", "v/vt", "v//vn" or "v/vt/vn"
+	while( ( p = skipBlanks( p, end ) ) < end ) {
+		int index;
+		const char *next = parseInt( p, end, &index );
+		if( next == p )
+			break;
+		p = next;
+		int vertex = resolveIndex( index, numVertices, chunk.mTotalVertices ), texCoord = -1, normal = -1;
+		if( ( p < end ) && ( *p == '/' ) ) {
+			++p;
+			next = parseInt( p, end, &index );
+			if( next != p ) {
+				if( includeUVs )
+					texCoord = resolveIndex( index, numTexCoords, chunk.mTotalTexCoords );
+				p = next;
+			}
+			if( ( p < end ) && ( *p == '/' ) ) {
+				++p;
+				next = parseInt( p, end, &index );
+				if( next != p ) {
+					normal = resolveIndex( index, numNormals, chunk.mTotalNormals );
+					p = next;
+				}
+			}
 		}
+		while( ( p < end ) && ( ! isBlank( *p ) ) )
+			++p;
+
+		valid = valid && ( vertex >= 0 );
+		face.mHasTexCoords = face.mHasTexCoords && ( texCoord >= 0 );
+		face.mHasNormals = face.mHasNormals && ( normal >= 0 );
+		group->mVertexIndices.push_back( vertex );
+		group->mTexCoordIndices.push_back( texCoord );
+		group->mNormalIndices.push_back( normal );
+		face.mNumVertices++;
 	}
+
+	// faces which aren't at least a triangle, or which refer to vertices that don't exist, are dropped
+	if( ( ! valid ) || ( face.mNumVertices < 3 ) ) {
+		group->mVertexIndices.resize( face.mFirstIndex );
+		group->mTexCoordIndices.resize( face.mFirstIndex );
+		group->mNormalIndices.resize( face.mFirstIndex );
+	}
+	else
+		group->mFaces.push_back( face );
 }
 
-ObjLoader::~ObjLoader()
+void initGroup( ObjLoader::Group *group, size_t baseVertex, size_t baseTexCoord, size_t baseNormal )
 {
+	group->mBaseVertexOffset = static_cast<int>( baseVertex );
+	group->mBaseTexCoordOffset = static_cast<int>( baseTexCoord );
+	group->mBaseNormalOffset = static_cast<int>( baseNormal );
+	group->mHasTexCoords = group->mHasNormals = false;
 }
 
-void ObjLoader::parseFace( Group *group, const std::string &s, bool includeUVs )
+// First pass: counts the elements in a chunk so that every chunk knows where its own will land
+void countChunk( Chunk *chunk, bool includeUVs )
 {
-	ObjLoader::Face result;
-	result.mNumVertices = 0;
+	chunk->mNumVertices = chunk->mNumTexCoords = chunk->mNumNormals = 0;
+	for( const char *line = chunk->mBegin; line < chunk->mEnd; ) {
+		const char *lineEnd = findLineEnd( line, chunk->mEnd );
+		switch( classifyLine( line, lineEnd ) ) {
+			case LINE_VERTEX: chunk->mNumVertices++; break;
+			case LINE_TEXCOORD: if( includeUVs ) chunk->mNumTexCoords++; break;
+			case LINE_NORMAL: chunk->mNumNormals++; break;
+			default: break;
+		}
+		line = lineEnd + 1;
+	}
+}
 
-	size_t offset = 2; // account for "f "
-	size_t length = s.length();
-	while( offset < length ) {
-		size_t endOfTriple, firstSlashOffset, secondSlashOffset;
+// Second pass: parses a chunk's elements directly into their final location and collects its faces
+void parseChunk( Chunk *chunk, Vec3f *vertices, Vec2f *texCoords, Vec3f *normals, bool includeUVs )
+{
+	size_t numVertices = chunk->mBaseVertex, numTexCoords = chunk->mBaseTexCoord, numNormals = chunk->mBaseNormal;
+	chunk->mGroups.push_back( ObjLoader::Group() );
+	ObjLoader::Group *group = &chunk->mGroups.back();
+	initGroup( group, numVertices, numTexCoords, numNormals );
 	
-		// find the end of this triple "v/vt/vn"
-		endOfTriple = s.find( ' ', offset );
-		if( endOfTriple == string::npos ) endOfTriple = length;
-		firstSlashOffset = s.find( '/', offset );
-		if( firstSlashOffset != string::npos ) {
-			secondSlashOffset = s.find( '/', firstSlashOffset + 1 );
-			if( secondSlashOffset > endOfTriple ) secondSlashOffset = string::npos;
+	for( const char *line = chunk->mBegin; line < chunk->mEnd; ) {
+		const char *lineEnd = findLineEnd( line, chunk->mEnd );
+		const char *p = line;
+		switch( classifyLine( p, lineEnd ) ) {
+			case LINE_VERTEX:
+				parseFloats( p, lineEnd, &vertices[numVertices++].x, 3 );
+			break;
+			case LINE_TEXCOORD:
+				if( includeUVs )
+					parseFloats( p, lineEnd, &texCoords[numTexCoords++].x, 2 );
+			break;
+			case LINE_NORMAL: {
+				Vec3f &normal = normals[numNormals++];
+				parseFloats( p, lineEnd, &normal.x, 3 );
+				normal.normalize();
+			}
+			break;
+			case LINE_FACE:
+				parseFace( p, lineEnd, group, *chunk, numVertices, numTexCoords, numNormals, includeUVs );
+			break;
+			case LINE_GROUP: {
+				chunk->mGroups.push_back( ObjLoader::Group() );
+				group = &chunk->mGroups.back();
+				initGroup( group, numVertices, numTexCoords, numNormals );
+				const char *nameBegin = skipBlanks( p, lineEnd ), *nameEnd = lineEnd;
+				while( ( nameEnd > nameBegin ) && isBlank( nameEnd[-1] ) )
+					--nameEnd;
+				group->mName.assign( nameBegin, nameEnd );
+			}
+			break;
+			default:
+			break;
 		}
-		else
-			secondSlashOffset = string::npos;
-		
-		// process the vertex index
-		int vertexIndex = lexical_cast<int>( s.substr( offset, firstSlashOffset - offset ) );
-		if( vertexIndex < 0 )
-			result.mVertexIndices.push_back( group->mBaseVertexOffset + vertexIndex );
-		else
-			result.mVertexIndices.push_back( vertexIndex - 1 );
-			
-		// process the tex coord index
-		if( includeUVs && ( firstSlashOffset != string::npos ) ) {
-			size_t numSize = ( secondSlashOffset == string::npos ) ? ( endOfTriple - firstSlashOffset - 1 ) : secondSlashOffset - firstSlashOffset - 1;
-			if( numSize > 0 ) {
-				int texCoordIndex = lexical_cast<int>( s.substr( firstSlashOffset + 1, numSize ) );
-				if( texCoordIndex < 0 )
-					result.mTexCoordIndices.push_back( group->mBaseTexCoordOffset + texCoordIndex );
-				else
-					result.mTexCoordIndices.push_back( texCoordIndex - 1 );
-				if( group->mFaces.empty() )
-					group->mHasTexCoords = true;
+		line = lineEnd + 1;
+	}
+}
+
+// Appends the faces of \a source to \a dest, taking over its arrays when \a dest is still empty
+void appendFaces( ObjLoader::Group *dest, ObjLoader::Group *source )
+{
+	if( dest->mFaces.empty() ) {
+		dest->mFaces.swap( source->mFaces );
+		dest->mVertexIndices.swap( source->mVertexIndices );
+		dest->mTexCoordIndices.swap( source->mTexCoordIndices );
+		dest->mNormalIndices.swap( source->mNormalIndices );
+		return;
+	}
+
+	size_t indexOffset = dest->mVertexIndices.size();
+	for( vector<ObjLoader::Face>::iterator faceIt = source->mFaces.begin(); faceIt != source->mFaces.end(); ++faceIt ) {
+		faceIt->mFirstIndex += indexOffset;
+		dest->mFaces.push_back( *faceIt );
+	}
+	dest->mVertexIndices.insert( dest->mVertexIndices.end(), source->mVertexIndices.begin(), source->mVertexIndices.end() );
+	dest->mTexCoordIndices.insert( dest->mTexCoordIndices.end(), source->mTexCoordIndices.begin(), source->mTexCoordIndices.end() );
+	dest->mNormalIndices.insert( dest->mNormalIndices.end(), source->mNormalIndices.begin(), source->mNormalIndices.end() );
+}
+
+} // anonymous namespace
+
+// Maps OBJ index triples to the TriMesh vertex made from them, using an open addressing hash table with linear probing.
+// Slots hold indices into mEntries, which keeps the table itself small enough to stay cache friendly.
+class ObjLoader::VertexWelder {
+ public:
+	//! \a expectedVertices sizes the table up front; it grows if more unique triples than that are inserted
+	VertexWelder( size_t expectedVertices );
+
+	//! Returns the vertex index stored for the triple, first storing \a newIndex if the triple is new, and whether it was new
+	pair<int,bool>	insert( int vertex, int texCoord, int normal, int newIndex );
+
+ private:
+	struct Entry {
+		int		mVertex, mTexCoord, mNormal;
+		int		mIndex;
+	};
+
+	static uint32_t	hash( int vertex, int texCoord, int normal );
+	void			grow();
+
+	vector<int32_t>	mSlots;		// -1 for an empty slot
+	vector<Entry>	mEntries;
+};
+
+ObjLoader::VertexWelder::VertexWelder( size_t expectedVertices )
+{
+	// keep the load factor at or below one half
+	size_t numSlots = 16;
+	while( numSlots < expectedVertices * 2 )
+		numSlots *= 2;
+	mSlots.assign( numSlots, -1 );
+	mEntries.reserve( expectedVertices );
+}
+
+uint32_t ObjLoader::VertexWelder::hash( int vertex, int texCoord, int normal )
+{
+	uint32_t result = static_cast<uint32_t>( vertex ) * 0x9E3779B1U;
+	result ^= static_cast<uint32_t>( texCoord ) * 0x85EBCA77U + ( result << 6 ) + ( result >> 2 );
+	result ^= static_cast<uint32_t>( normal ) * 0xC2B2AE3DU + ( result << 6 ) + ( result >> 2 );
+	// finalizer from MurmurHash3, as neighboring triples are the common case
+	result ^= result >> 16;
+	result *= 0x85EBCA6BU;
+	result ^= result >> 13;
+	result *= 0xC2B2AE35U;
+	result ^= result >> 16;
+	return result;
+}
+
+pair<int,bool> ObjLoader::VertexWelder::insert( int vertex, int texCoord, int normal, int newIndex )
+{
+	size_t mask = mSlots.size() - 1;
+	for( size_t slot = hash( vertex, texCoord, normal ) & mask; ; slot = ( slot + 1 ) & mask ) {
+		int32_t entryIndex = mSlots[slot];
+		if( entryIndex < 0 ) {
+			if( ( mEntries.size() + 1 ) * 2 > mSlots.size() ) {
+				grow();
+				return insert( vertex, texCoord, normal, newIndex );
 			}
-			else
-				group->mHasTexCoords = false;
+			mSlots[slot] = static_cast<int32_t>( mEntries.size() );
+			Entry entry = { vertex, texCoord, normal, newIndex };
+			mEntries.push_back( entry );
+			return make_pair( newIndex, true );
 		}
-		else if( group->mFaces.empty() ) // if this is the first face, let's note that this group has no tex coords
-			group->mHasTexCoords = false;
-			
-		// process the normal index
-		if( secondSlashOffset != string::npos ) {
-			int normalIndex = lexical_cast<int>( s.substr( secondSlashOffset + 1, endOfTriple - secondSlashOffset - 1 ) );
-			if( normalIndex < 0 )
-				result.mNormalIndices.push_back( group->mBaseNormalOffset + normalIndex );
-			else
-				result.mNormalIndices.push_back( normalIndex - 1 );
-			group->mHasNormals = true;
+		const Entry &entry = mEntries[entryIndex];
+		if( ( entry.mVertex == vertex ) && ( entry.mTexCoord == texCoord ) && ( entry.mNormal == normal ) )
+			return make_pair( entry.mIndex, false );
+	}
+}
+
+void ObjLoader::VertexWelder::grow()
+{
+	mSlots.assign( mSlots.size() * 2, -1 );
+	size_t mask = mSlots.size() - 1;
+	for( size_t e = 0; e < mEntries.size(); ++e ) {
+		size_t slot = hash( mEntries[e].mVertex, mEntries[e].mTexCoord, mEntries[e].mNormal ) & mask;
+		while( mSlots[slot] >= 0 )
+			slot = ( slot + 1 ) & mask;
+		mSlots[slot] = static_cast<int32_t>( e );
+	}
+}
+
+ObjLoader::ObjLoader( shared_ptr<IStream> aStream, bool includeUVs, bool parallelParse )
+	: mStream( aStream )
+{
+	// parse straight out of memory when the stream already has its contents there, otherwise read the rest of it in
+	shared_ptr<IStreamMem> memStream = boost::dynamic_pointer_cast<IStreamMem>( mStream );
+	shared_ptr<IStreamMmap> mmapStream = boost::dynamic_pointer_cast<IStreamMmap>( mStream );
+	if( memStream || mmapStream ) {
+		const char *data = reinterpret_cast<const char*>( ( memStream ) ? memStream->getData() : mmapStream->getData() );
+		size_t offset = static_cast<size_t>( mStream->tell() );
+		size_t dataSize = ( memStream ) ? static_cast<size_t>( memStream->size() ) : static_cast<size_t>( mmapStream->getDataSize() );
+		parse( data + offset, dataSize - offset, includeUVs, parallelParse );
+		mStream->seekAbsolute( mStream->size() );
+	}
+	else {
+		vector<char> data;
+		if( mStream->size() > mStream->tell() )
+			data.reserve( static_cast<size_t>( mStream->size() - mStream->tell() ) );
+		while( ! mStream->isEof() ) {
+			size_t oldSize = data.size();
+			data.resize( oldSize + READ_BLOCK_SIZE );
+			size_t bytesRead = mStream->readDataAvailable( &data[oldSize], READ_BLOCK_SIZE );
+			data.resize( oldSize + bytesRead );
+			if( bytesRead == 0 )
+				break;
 		}
-		else if( group->mFaces.empty() ) // if this is the first face, let's note that this group has no normals
-			group->mHasNormals = false;
-		
-		offset = endOfTriple + 1;
-		result.mNumVertices++;
+		parse( ( data.empty() ) ? 0 : &data[0], data.size(), includeUVs, parallelParse );
+	}
+}
+
+ObjLoader::~ObjLoader()
+{
+}
+
+void ObjLoader::parse( const char *data, size_t dataSize, bool includeUVs, bool parallelParse )
+{
+	size_t numChunks = 1;
+	if( parallelParse )
+		numChunks = std::max<size_t>( 1, std::min<size_t>( boost::thread::hardware_concurrency(), dataSize / MIN_CHUNK_SIZE ) );
+
+	// chunks always begin at the start of a line
+	vector<Chunk> chunks( numChunks );
+	const char *dataEnd = data + dataSize;
+	for( size_t c = 0; c < numChunks; ++c ) {
+		chunks[c].mBegin = ( c == 0 ) ? data : chunks[c-1].mEnd;
+		chunks[c].mEnd = ( c == numChunks - 1 ) ? dataEnd : std::max( chunks[c].mBegin, data + dataSize / numChunks * ( c + 1 ) );
+		if( chunks[c].mEnd < dataEnd )
+			chunks[c].mEnd = std::min( findLineEnd( chunks[c].mEnd, dataEnd ) + 1, dataEnd );
+	}
+
+	if( numChunks > 1 ) {
+		boost::thread_group threads;
+		for( size_t c = 0; c < numChunks; ++c )
+			threads.create_thread( boost::bind( countChunk, &chunks[c], includeUVs ) );
+		threads.join_all();
+	}
+	else
+		countChunk( &chunks[0], includeUVs );
+
+	size_t numVertices = 0, numTexCoords = 0, numNormals = 0;
+	for( size_t c = 0; c < numChunks; ++c ) {
+		chunks[c].mBaseVertex = numVertices;
+		chunks[c].mBaseTexCoord = numTexCoords;
+		chunks[c].mBaseNormal = numNormals;
+		numVertices += chunks[c].mNumVertices;
+		numTexCoords += chunks[c].mNumTexCoords;
+		numNormals += chunks[c].mNumNormals;
+	}
+	for( size_t c = 0; c < numChunks; ++c ) {
+		chunks[c].mTotalVertices = numVertices;
+		chunks[c].mTotalTexCoords = numTexCoords;
+		chunks[c].mTotalNormals = numNormals;
+	}
+	mVertices.resize( numVertices );
+	mTexCoords.resize( numTexCoords );
+	mNormals.resize( numNormals );
+	Vec3f *vertices = ( numVertices ) ? &mVertices[0] : 0;
+	Vec2f *texCoords = ( numTexCoords ) ? &mTexCoords[0] : 0;
+	Vec3f *normals = ( numNormals ) ? &mNormals[0] : 0;
+
+	if( numChunks > 1 ) {
+		boost::thread_group threads;
+		for( size_t c = 0; c < numChunks; ++c )
+			threads.create_thread( boost::bind( parseChunk, &chunks[c], vertices, texCoords, normals, includeUVs ) );
+		threads.join_all();
+	}
+	else
+		parseChunk( &chunks[0], vertices, texCoords, normals, includeUVs );
+
+	// stitch the chunks' groups together; a "g" line only starts a new group if the current one has faces
+	mGroups.push_back( Group() );
+	initGroup( &mGroups.back(), 0, 0, 0 );
+	for( size_t c = 0; c < numChunks; ++c ) {
+		for( size_t g = 0; g < chunks[c].mGroups.size(); ++g ) {
+			Group &source = chunks[c].mGroups[g];
+			if( g > 0 ) {
+				if( ! mGroups.back().mFaces.empty() )
+					mGroups.push_back( Group() );
+				Group &dest = mGroups.back();
+				initGroup( &dest, source.mBaseVertexOffset, source.mBaseTexCoordOffset, source.mBaseNormalOffset );
+				dest.mName.swap( source.mName );
+			}
+			appendFaces( &mGroups.back(), &source );
+		}
+	}
+
+	// a group is considered to have texture coordinates or normals if its first face does
+	for( vector<Group>::iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt ) {
+		groupIt->mHasTexCoords = ( ! groupIt->mFaces.empty() ) && groupIt->mFaces.front().mHasTexCoords;
+		groupIt->mHasNormals = ( ! groupIt->mFaces.empty() ) && groupIt->mFaces.front().mHasNormals;
 	}
-	
-	group->mFaces.push_back( result );
 }
 
 void ObjLoader::load( size_t groupIndex, TriMesh *destTriMesh, boost::tribool loadNormals, boost::tribool loadTexCoords, bool optimizeVertices )
@@ -167,24 +576,18 @@ void ObjLoader::load( size_t groupIndex, TriMesh *destTriMesh, boost::tribool lo
 
 	if( ! optimizeVertices ) {
 		loadInternalNoOptimize( mGroups[groupIndex], destTriMesh, texCoords, normals );
+		return;
 	}
-	else if( normals && texCoords ) {
-		map<VertexTriple,int> uniqueVerts;
+
+	VertexWelder uniqueVerts( estimateUniqueVertices( mGroups[groupIndex].mVertexIndices.size() ) );
+	if( normals && texCoords )
 		loadInternalNormalsTextures( mGroups[groupIndex], uniqueVerts, destTriMesh );
-	}
-	else if( normals ) {
-		map<VertexPair,int> uniqueVerts;
+	else if( normals )
 		loadInternalNormals( mGroups[groupIndex], uniqueVerts, destTriMesh );
-	}
-	else if( texCoords ) {
-		map<VertexPair,int> uniqueVerts;
+	else if( texCoords )
 		loadInternalTextures( mGroups[groupIndex], uniqueVerts, destTriMesh );
-	}
-	else {
-		map<int,int> uniqueVerts;
+	else
 		loadInternal( mGroups[groupIndex], uniqueVerts, destTriMesh );
-	}
-
 }
 
 void ObjLoader::load( TriMesh *destTriMesh, boost::tribool loadNormals, boost::tribool loadTexCoords, bool optimizeVertices )
@@ -220,104 +623,113 @@ void ObjLoader::load( TriMesh *destTriMesh, boost::tribool loadNormals, boost::t
 		for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt ) {
 			loadInternalNoOptimize( *groupIt, destTriMesh, texCoords, normals );
 		}	
+		return;
 	}
-	else if( normals && texCoords ) {
-		map<VertexTriple,int> uniqueVerts;
-		for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt )
+
+	size_t numIndices = 0;
+	for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt )
+		numIndices += groupIt->mVertexIndices.size();
+	VertexWelder uniqueVerts( estimateUniqueVertices( numIndices ) );
+	for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt ) {
+		if( normals && texCoords )
 			loadInternalNormalsTextures( *groupIt, uniqueVerts, destTriMesh );
-	}
-	else if( normals ) {
-		map<VertexPair,int> uniqueVerts;
-		for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt )
+		else if( normals )
 			loadInternalNormals( *groupIt, uniqueVerts, destTriMesh );
-	}
-	else if( texCoords ) {
-		map<VertexPair,int> uniqueVerts;
-		for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt )
+		else if( texCoords )
 			loadInternalTextures( *groupIt, uniqueVerts, destTriMesh );
-	}
-	else {
-		map<int,int> uniqueVerts;
-		for( vector<Group>::const_iterator groupIt = mGroups.begin(); groupIt != mGroups.end(); ++groupIt )
+		else
 			loadInternal( *groupIt, uniqueVerts, destTriMesh );
 	}
 }
 
+// Welded meshes usually end up with about as many vertices as the file has positions, normals or texture coordinates, and never more than they have indices
+size_t ObjLoader::estimateUniqueVertices( size_t numIndices ) const
+{
+	return std::min( numIndices, std::max( mVertices.size(), std::max( mTexCoords.size(), mNormals.size() ) ) );
+}
+
 void ObjLoader::loadInternalNoOptimize( const Group &group, TriMesh *destTriMesh, bool texCoords, bool normals )
 {
 	size_t offset = destTriMesh->getNumVertices();
 	for( size_t f = 0; f < group.mFaces.size(); ++f ) {
+		const Face &face = group.mFaces[f];
+		const int *vertexIndices = &group.mVertexIndices[face.mFirstIndex];
+		const int *texCoordIndices = &group.mTexCoordIndices[face.mFirstIndex];
+		const int *normalIndices = &group.mNormalIndices[face.mFirstIndex];
 		Vec3f normal;
-		if( normals && ( ! group.mHasNormals ) ) { // we'll have to derive it from two edges
-			Vec3f edge1 = mVertices[group.mFaces[f].mVertexIndices[1]] - mVertices[group.mFaces[f].mVertexIndices[0]];
-			Vec3f edge2 = mVertices[group.mFaces[f].mVertexIndices[2]] - mVertices[group.mFaces[f].mVertexIndices[0]];
+		if( normals && ( ! face.mHasNormals ) ) { // we'll have to derive it from two edges
+			Vec3f edge1 = mVertices[vertexIndices[1]] - mVertices[vertexIndices[0]];
+			Vec3f edge2 = mVertices[vertexIndices[2]] - mVertices[vertexIndices[0]];
 			normal = edge1.cross( edge2 ).normalized();
 		}
-		for( int v = 0; v < group.mFaces[f].mNumVertices; ++v ) {
-			destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-			if( normals && group.mHasNormals )
-				destTriMesh->appendNormal( mNormals[group.mFaces[f].mNormalIndices[v]] );
-			else if( normals && ( ! group.mHasNormals ) ) { // we'll have to use the one derived from two edges
+		for( int v = 0; v < face.mNumVertices; ++v ) {
+			destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+			if( normals && face.mHasNormals )
+				destTriMesh->appendNormal( mNormals[normalIndices[v]] );
+			else if( normals && ( ! face.mHasNormals ) ) { // we'll have to use the one derived from two edges
 				destTriMesh->appendNormal( normal );
 			}
-			if( texCoords && group.mHasTexCoords ) {
-				Vec2f texCoord = mTexCoords[group.mFaces[f].mTexCoordIndices[v]];
+			if( texCoords && face.mHasTexCoords ) {
+				Vec2f texCoord = mTexCoords[texCoordIndices[v]];
 				texCoord.y = 1.0f - texCoord.y;
 				destTriMesh->appendTexCoord( texCoord );	
 			}
-			else if( texCoords && ( ! group.mHasTexCoords ) ) // we'll have to make some up
+			else if( texCoords && ( ! face.mHasTexCoords ) ) // we'll have to make some up
 				destTriMesh->appendTexCoord( Vec2f::zero() );
 		}
 
-		int triangles = group.mFaces[f].mNumVertices - 2;
+		int triangles = face.mNumVertices - 2;
 		for( int t = 0; t < triangles; ++t ) {
 			destTriMesh->appendTriangle( offset + 0, offset + t + 1, offset + t + 2 );
 		}
-		offset += group.mFaces[f].mNumVertices;
+		offset += face.mNumVertices;
 	}	
 }
 
-void ObjLoader::loadInternalNormalsTextures( const Group &group, map<VertexTriple,int> &uniqueVerts, TriMesh *destTriMesh )
+void ObjLoader::loadInternalNormalsTextures( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh )
 {
+	vector<int> faceIndices;
 	for( size_t f = 0; f < group.mFaces.size(); ++f ) {
+		const Face &face = group.mFaces[f];
+		const int *vertexIndices = &group.mVertexIndices[face.mFirstIndex];
+		const int *texCoordIndices = &group.mTexCoordIndices[face.mFirstIndex];
+		const int *normalIndices = &group.mNormalIndices[face.mFirstIndex];
 		Vec3f inferredNormal;
 		bool forceUnique = false;
-		if( group.mFaces[f].mNormalIndices.empty() ) { // we'll have to derive it from two edges
-			Vec3f edge1 = mVertices[group.mFaces[f].mVertexIndices[1]] - mVertices[group.mFaces[f].mVertexIndices[0]];
-			Vec3f edge2 = mVertices[group.mFaces[f].mVertexIndices[2]] - mVertices[group.mFaces[f].mVertexIndices[0]];
+		if( ! face.mHasNormals ) { // we'll have to derive it from two edges
+			Vec3f edge1 = mVertices[vertexIndices[1]] - mVertices[vertexIndices[0]];
+			Vec3f edge2 = mVertices[vertexIndices[2]] - mVertices[vertexIndices[0]];
 			inferredNormal = edge1.cross( edge2 ).normalized();
 			forceUnique = true;
 		}
 		
-		if( group.mFaces[f].mTexCoordIndices.empty() )
+		if( ! face.mHasTexCoords )
 			forceUnique = true;
 		
-		vector<int> faceIndices;
-		faceIndices.reserve( group.mFaces[f].mNumVertices );
-		for( int v = 0; v < group.mFaces[f].mNumVertices; ++v ) {
+		faceIndices.clear();
+		for( int v = 0; v < face.mNumVertices; ++v ) {
 			if( ! forceUnique ) {
-				VertexTriple triple = make_tuple( group.mFaces[f].mVertexIndices[v], group.mFaces[f].mTexCoordIndices[v], group.mFaces[f].mNormalIndices[v] );
-				pair<map<VertexTriple,int>::iterator,bool> result = uniqueVerts.insert( make_pair( triple, destTriMesh->getVertices().size() ) );
+				pair<int,bool> result = uniqueVerts.insert( vertexIndices[v], texCoordIndices[v], normalIndices[v], destTriMesh->getVertices().size() );
 				if( result.second ) { // we've got a new, unique vertex here, so let's append it
-					destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-					destTriMesh->appendNormal( mNormals[group.mFaces[f].mNormalIndices[v]] );
-					destTriMesh->appendTexCoord( mTexCoords[group.mFaces[f].mTexCoordIndices[v]] );
+					destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+					destTriMesh->appendNormal( mNormals[normalIndices[v]] );
+					destTriMesh->appendTexCoord( mTexCoords[texCoordIndices[v]] );
 				}
 				// the unique ID of the vertex is appended for this vert
-				faceIndices.push_back( result.first->second );
+				faceIndices.push_back( result.first );
 			}
-			else { // have to force unique because this group lacks either normals or texCoords
+			else { // have to force unique because this face lacks either normals or texCoords
 				faceIndices.push_back( destTriMesh->getVertices().size() );
 
-				destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-				if( ! group.mHasNormals )
+				destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+				if( ! face.mHasNormals )
 					destTriMesh->appendNormal( inferredNormal );
 				else
-					destTriMesh->appendNormal( mNormals[group.mFaces[f].mNormalIndices[v]] );
-				if( ! group.mHasTexCoords )
+					destTriMesh->appendNormal( mNormals[normalIndices[v]] );
+				if( ! face.mHasTexCoords )
 					destTriMesh->appendTexCoord( Vec2f::zero() );
 				else
-					destTriMesh->appendTexCoord( mTexCoords[group.mFaces[f].mTexCoordIndices[v]] );
+					destTriMesh->appendTexCoord( mTexCoords[texCoordIndices[v]] );
 			}
 		}
 
@@ -328,39 +740,41 @@ void ObjLoader::loadInternalNormalsTextures( const Group &group, map<VertexTripl
 	}	
 }
 
-void ObjLoader::loadInternalNormals( const Group &group, map<VertexPair,int> &uniqueVerts, TriMesh *destTriMesh )
+void ObjLoader::loadInternalNormals( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh )
 {
+	vector<int> faceIndices;
 	for( size_t f = 0; f < group.mFaces.size(); ++f ) {
+		const Face &face = group.mFaces[f];
+		const int *vertexIndices = &group.mVertexIndices[face.mFirstIndex];
+		const int *normalIndices = &group.mNormalIndices[face.mFirstIndex];
 		Vec3f inferredNormal;
 		bool forceUnique = false;
-		if( group.mFaces[f].mNormalIndices.empty() ) { // we'll have to derive it from two edges
-			Vec3f edge1 = mVertices[group.mFaces[f].mVertexIndices[1]] - mVertices[group.mFaces[f].mVertexIndices[0]];
-			Vec3f edge2 = mVertices[group.mFaces[f].mVertexIndices[2]] - mVertices[group.mFaces[f].mVertexIndices[0]];
+		if( ! face.mHasNormals ) { // we'll have to derive it from two edges
+			Vec3f edge1 = mVertices[vertexIndices[1]] - mVertices[vertexIndices[0]];
+			Vec3f edge2 = mVertices[vertexIndices[2]] - mVertices[vertexIndices[0]];
 			inferredNormal = edge1.cross( edge2 ).normalized();
 			forceUnique = true;
 		}
 		
-		vector<int> faceIndices;
-		faceIndices.reserve( group.mFaces[f].mNumVertices );
-		for( int v = 0; v < group.mFaces[f].mNumVertices; ++v ) {
+		faceIndices.clear();
+		for( int v = 0; v < face.mNumVertices; ++v ) {
 			if( ! forceUnique ) {
-				VertexPair triple = make_tuple( group.mFaces[f].mVertexIndices[v], group.mFaces[f].mNormalIndices[v] );
-				pair<map<VertexPair,int>::iterator,bool> result = uniqueVerts.insert( make_pair( triple, destTriMesh->getVertices().size() ) );
+				pair<int,bool> result = uniqueVerts.insert( vertexIndices[v], -1, normalIndices[v], destTriMesh->getVertices().size() );
 				if( result.second ) { // we've got a new, unique vertex here, so let's append it
-					destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-					destTriMesh->appendNormal( mNormals[group.mFaces[f].mNormalIndices[v]] );
+					destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+					destTriMesh->appendNormal( mNormals[normalIndices[v]] );
 				}
 				// the unique ID of the vertex is appended for this vert
-				faceIndices.push_back( result.first->second );
+				faceIndices.push_back( result.first );
 			}
-			else { // have to force unique because this group lacks normals
+			else { // have to force unique because this face lacks normals
 				faceIndices.push_back( destTriMesh->getVertices().size() );
 
-				destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-				if( ! group.mHasNormals )
+				destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+				if( ! face.mHasNormals )
 					destTriMesh->appendNormal( inferredNormal );
 				else
-					destTriMesh->appendNormal( mNormals[group.mFaces[f].mNormalIndices[v]] );
+					destTriMesh->appendNormal( mNormals[normalIndices[v]] );
 			}
 		}
 
@@ -371,34 +785,36 @@ void ObjLoader::loadInternalNormals( const Group &group, map<VertexPair,int> &un
 	}	
 }
 
-void ObjLoader::loadInternalTextures( const Group &group, map<VertexPair,int> &uniqueVerts, TriMesh *destTriMesh )
+void ObjLoader::loadInternalTextures( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh )
 {
+	vector<int> faceIndices;
 	for( size_t f = 0; f < group.mFaces.size(); ++f ) {
+		const Face &face = group.mFaces[f];
+		const int *vertexIndices = &group.mVertexIndices[face.mFirstIndex];
+		const int *texCoordIndices = &group.mTexCoordIndices[face.mFirstIndex];
 		bool forceUnique = false;
-		if( group.mFaces[f].mTexCoordIndices.empty() )
+		if( ! face.mHasTexCoords )
 			forceUnique = true;
 		
-		vector<int> faceIndices;
-		faceIndices.reserve( group.mFaces[f].mNumVertices );
-		for( int v = 0; v < group.mFaces[f].mNumVertices; ++v ) {
+		faceIndices.clear();
+		for( int v = 0; v < face.mNumVertices; ++v ) {
 			if( ! forceUnique ) {
-				VertexPair triple = make_tuple( group.mFaces[f].mVertexIndices[v], group.mFaces[f].mTexCoordIndices[v] );
-				pair<map<VertexPair,int>::iterator,bool> result = uniqueVerts.insert( make_pair( triple, destTriMesh->getVertices().size() ) );
+				pair<int,bool> result = uniqueVerts.insert( vertexIndices[v], texCoordIndices[v], -1, destTriMesh->getVertices().size() );
 				if( result.second ) { // we've got a new, unique vertex here, so let's append it
-					destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-					destTriMesh->appendTexCoord( mTexCoords[group.mFaces[f].mTexCoordIndices[v]] );
+					destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+					destTriMesh->appendTexCoord( mTexCoords[texCoordIndices[v]] );
 				}
 				// the unique ID of the vertex is appended for this vert
-				faceIndices.push_back( result.first->second );
+				faceIndices.push_back( result.first );
 			}
-			else { // have to force unique because this group lacks texCoords
+			else { // have to force unique because this face lacks texCoords
 				faceIndices.push_back( destTriMesh->getVertices().size() );
 
-				destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
-				if( ! group.mHasTexCoords )
+				destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
+				if( ! face.mHasTexCoords )
 					destTriMesh->appendTexCoord( Vec2f::zero() );
 				else
-					destTriMesh->appendTexCoord( mTexCoords[group.mFaces[f].mTexCoordIndices[v]] );
+					destTriMesh->appendTexCoord( mTexCoords[texCoordIndices[v]] );
 			}
 		}
 
@@ -409,18 +825,20 @@ void ObjLoader::loadInternalTextures( const Group &group, map<VertexPair,int> &u
 	}	
 }
 
-void ObjLoader::loadInternal( const Group &group, map<int,int> &uniqueVerts, TriMesh *destTriMesh )
+void ObjLoader::loadInternal( const Group &group, VertexWelder &uniqueVerts, TriMesh *destTriMesh )
 {
+	vector<int> faceIndices;
 	for( size_t f = 0; f < group.mFaces.size(); ++f ) {
-		vector<int> faceIndices;
-		faceIndices.reserve( group.mFaces[f].mNumVertices );
-		for( int v = 0; v < group.mFaces[f].mNumVertices; ++v ) {
-			pair<map<int,int>::iterator,bool> result = uniqueVerts.insert( make_pair( group.mFaces[f].mVertexIndices[v], destTriMesh->getVertices().size() ) );
+		const Face &face = group.mFaces[f];
+		const int *vertexIndices = &group.mVertexIndices[face.mFirstIndex];
+		faceIndices.clear();
+		for( int v = 0; v < face.mNumVertices; ++v ) {
+			pair<int,bool> result = uniqueVerts.insert( vertexIndices[v], -1, -1, destTriMesh->getVertices().size() );
 			if( result.second ) { // we've got a new, unique vertex here, so let's append it
-				destTriMesh->appendVertex( mVertices[group.mFaces[f].mVertexIndices[v]] );
+				destTriMesh->appendVertex( mVertices[vertexIndices[v]] );
 			}
 			// the unique ID of the vertex is appended for this vert
-			faceIndices.push_back( result.first->second );
+			faceIndices.push_back( result.first );
 		}
 
 		int triangles = faceIndices.size() - 2;
@@ -24,14 +24,49 @@
 #include "cinder/Stream.h"
 #include "cinder/Utilities.h"
 
+#if defined( CINDER_MSW )
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
 #include <stdio.h>
 #include <limits>
+#include <algorithm>
 #include <boost/scoped_array.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <iostream>
 using std::string;
 
 namespace cinder {
 
+namespace {
+// fseek() and ftell() take a long, which is narrower than off_t on 32-bit POSIX systems built with 64-bit file offsets
+int seekFile( FILE *file, off_t offset, int origin )
+{
+#if defined( CINDER_MSW )
+	return _fseeki64( file, offset, origin );
+#else
+	return fseeko( file, offset, origin );
+#endif
+}
+
+off_t tellFile( FILE *file )
+{
+#if defined( CINDER_MSW )
+	return static_cast<off_t>( _ftelli64( file ) );
+#else
+	return ftello( file );
+#endif
+}
+} // anonymous namespace
+
 //////////////////////////////////////////////////////////////////////////
 template<typename T>
 void OStream::write( T t )
@@ -61,6 +96,48 @@ void OStream::writeLittle( T t )
 #endif
 }
 
+template<typename T>
+void OStream::write( const T *t, size_t count )
+{
+	IOWrite( t, sizeof(T) * count );
+}
+
+// Swaps into a fixed-size scratch block so the caller's data is left untouched and the write doesn't allocate
+template<typename T>
+static void writeSwapped( OStream *stream, const T *t, size_t count )
+{
+	const size_t SCRATCH_COUNT = 4096 / sizeof(T);
+	T scratch[SCRATCH_COUNT];
+	while( count > 0 ) {
+		size_t blockCount = std::min( count, SCRATCH_COUNT );
+		memcpy( scratch, t, sizeof(T) * blockCount );
+		swapEndianBlock( scratch, sizeof(T) * blockCount );
+		stream->write( scratch, blockCount );
+		t += blockCount;
+		count -= blockCount;
+	}
+}
+
+template<typename T>
+void OStream::writeBig( const T *t, size_t count )
+{
+#ifdef BOOST_BIG_ENDIAN
+	write( t, count );
+#else
+	writeSwapped( this, t, count );
+#endif
+}
+
+template<typename T>
+void OStream::writeLittle( const T *t, size_t count )
+{
+#ifdef CINDER_LITTLE_ENDIAN
+	write( t, count );
+#else
+	writeSwapped( this, t, count );
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////
 template<typename T>
 void IStream::read( T *t )
@@ -74,7 +151,7 @@ void IStream::readBig( T *t )
 #ifdef BOOST_BIG_ENDIAN
 	read( t );
 #else
-	IORead( &t, sizeof(T) );
+	IORead( t, sizeof(T) );
 	*t = swapEndian( *t );
 #endif
 }
@@ -85,11 +162,35 @@ void IStream::readLittle( T *t )
 #ifdef CINDER_LITTLE_ENDIAN
 	read( t );
 #else
-	IORead( &t, sizeof(T) );
+	IORead( t, sizeof(T) );
 	*t = swapEndian( *t );
 #endif
 }
 
+template<typename T>
+void IStream::read( T *t, size_t count )
+{
+	IORead( t, sizeof(T) * count );
+}
+
+template<typename T>
+void IStream::readBig( T *t, size_t count )
+{
+	IORead( t, sizeof(T) * count );
+#ifndef BOOST_BIG_ENDIAN
+	swapEndianBlock( t, sizeof(T) * count );
+#endif
+}
+
+template<typename T>
+void IStream::readLittle( T *t, size_t count )
+{
+	IORead( t, sizeof(T) * count );
+#ifndef CINDER_LITTLE_ENDIAN
+	swapEndianBlock( t, sizeof(T) * count );
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 
 void IStream::readFixedString( char *t, size_t size, bool nullTerminate )
@@ -151,10 +252,86 @@ IStreamFileRef IStreamFile::createRef( FILE *file, bool ownsFile, int32_t defaul
 	return IStreamFileRef( new IStreamFile( file, ownsFile, defaultBufferSize ) );
 }
 
+// The read-ahead worker owns the FILE only while a request is in flight; the stream waits on it before touching the FILE itself
+struct IStreamFile::ReadAhead {
+	ReadAhead( FILE *file )
+		: mFile( file ), mAllocatedSize( 0 ), mOffset( 0 ), mSize( 0 ), mRequestSize( 0 ), mValid( false ), mBusy( false ), mQuit( false )
+	{
+		mThread = shared_ptr<boost::thread>( new boost::thread( boost::bind( &ReadAhead::threadFn, this ) ) );
+	}
+
+	~ReadAhead()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock( mMutex );
+			mQuit = true;
+		}
+		mCond.notify_all();
+		mThread->join();
+	}
+
+	// Queues a read of \a size bytes at \a offset. Must not be called while busy.
+	void request( off_t offset, size_t size )
+	{
+		if( mAllocatedSize < size ) {
+			mBuffer = shared_ptr<uint8_t>( new uint8_t[size], checked_array_deleter<uint8_t>() );
+			mAllocatedSize = size;
+		}
+		{
+			boost::lock_guard<boost::mutex> lock( mMutex );
+			mOffset = offset;
+			mRequestSize = size;
+			mValid = false;
+			mBusy = true;
+		}
+		mCond.notify_all();
+	}
+
+	void wait()
+	{
+		boost::unique_lock<boost::mutex> lock( mMutex );
+		while( mBusy )
+			mCond.wait( lock );
+	}
+
+	void threadFn()
+	{
+		boost::unique_lock<boost::mutex> lock( mMutex );
+		while( true ) {
+			while( ! mBusy && ! mQuit )
+				mCond.wait( lock );
+			if( mQuit )
+				return;
+
+			lock.unlock();
+			size_t bytesRead = 0;
+			if( seekFile( mFile, mOffset, SEEK_SET ) == 0 )
+				bytesRead = fread( mBuffer.get(), 1, mRequestSize, mFile );
+			lock.lock();
+
+			mSize = bytesRead;
+			mValid = bytesRead > 0;
+			mBusy = false;
+			mCond.notify_all();
+		}
+	}
+
+	FILE						*mFile;
+	shared_ptr<uint8_t>			mBuffer;
+	size_t						mAllocatedSize;
+	off_t						mOffset;
+	size_t						mSize, mRequestSize;
+	bool						mValid, mBusy, mQuit;
+	boost::mutex				mMutex;
+	boost::condition_variable	mCond;
+	shared_ptr<boost::thread>	mThread;
+};
+
 IStreamFile::IStreamFile( FILE *aFile, bool aOwnsFile, int32_t aDefaultBufferSize )
 	: IStream(), mFile( aFile ), mOwnsFile( aOwnsFile ), mDefaultBufferSize( aDefaultBufferSize ), mSizeCached( false )
 {
 	mBuffer = shared_ptr<uint8_t>( new uint8_t[mDefaultBufferSize], checked_array_deleter<uint8_t>() );
+	mBufferCapacity = mBufferAllocatedSize = mDefaultBufferSize;
 	mBufferFileOffset = std::numeric_limits<off_t>::min();
 	mBufferOffset = 0;
 	mBufferSize = 0;
@@ -162,31 +339,129 @@ IStreamFile::IStreamFile( FILE *aFile, bool aOwnsFile, int32_t aDefaultBufferSiz
 
 IStreamFile::~IStreamFile()
 {
+	// stop the worker before the FILE goes away
+	mReadAhead.reset();
 	if( mOwnsFile )
 		fclose( mFile );
 }
 
+void IStreamFile::setReadAhead( bool readAhead )
+{
+	if( readAhead && ( ! mReadAhead ) )
+		mReadAhead = shared_ptr<ReadAhead>( new ReadAhead( mFile ) );
+	else if( ( ! readAhead ) && mReadAhead )
+		mReadAhead.reset();
+}
+
+void IStreamFile::waitForReadAhead() const
+{
+	if( mReadAhead )
+		mReadAhead->wait();
+}
+
+bool IStreamFile::fillBuffer()
+{
+	// grow the buffer while the stream is being read front to back, and fall back to the default size after a seek
+	if( mBufferOffset == mBufferFileOffset + (off_t)mBufferSize )
+		mBufferCapacity = ( mBufferCapacity * 2 < MAX_BUFFER_SIZE ) ? mBufferCapacity * 2 : MAX_BUFFER_SIZE;
+	else
+		mBufferCapacity = mDefaultBufferSize;
+
+	waitForReadAhead();
+	if( mReadAhead && mReadAhead->mValid && ( mReadAhead->mOffset == mBufferOffset ) ) {
+		std::swap( mBuffer, mReadAhead->mBuffer );
+		std::swap( mBufferAllocatedSize, mReadAhead->mAllocatedSize );
+		mBufferSize = mReadAhead->mSize;
+		mReadAhead->mValid = false;
+	}
+	else {
+		if( mBufferAllocatedSize < mBufferCapacity ) {
+			mBuffer = shared_ptr<uint8_t>( new uint8_t[mBufferCapacity], checked_array_deleter<uint8_t>() );
+			mBufferAllocatedSize = mBufferCapacity;
+		}
+		seekFile( mFile, mBufferOffset, SEEK_SET );
+		mBufferSize = fread( mBuffer.get(), 1, mBufferCapacity, mFile );
+	}
+	mBufferFileOffset = mBufferOffset;
+
+	if( mReadAhead && ( mBufferSize > 0 ) )
+		mReadAhead->request( mBufferFileOffset + (off_t)mBufferSize, mBufferCapacity );
+
+	return mBufferSize > 0;
+}
+
 size_t IStreamFile::readDataAvailable( void *dest, size_t maxSize )
 {
+	// serve whatever has already been buffered; the FILE's own position is past it
+	if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset < mBufferFileOffset + (off_t)mBufferSize ) ) {
+		size_t amount = std::min<size_t>( maxSize, static_cast<size_t>( mBufferFileOffset + mBufferSize - mBufferOffset ) );
+		memcpy( dest, mBuffer.get() + ( mBufferOffset - mBufferFileOffset ), amount );
+		mBufferOffset += amount;
+		return amount;
+	}
+
+	if( maxSize < mBufferCapacity ) {
+		if( ! fillBuffer() )
+			return 0;
+		return readDataAvailable( dest, maxSize );
+	}
+
+	waitForReadAhead();
+	seekFile( mFile, mBufferOffset, SEEK_SET );
 	size_t bytesRead = fread( dest, 1, maxSize, mFile );
-	mBufferOffset = ftell( mFile );
+	mBufferOffset += bytesRead;
 	return bytesRead;
 }
 
+std::string IStreamFile::readLine()
+{
+	string result;
+	while( true ) {
+		if( ( mBufferOffset < mBufferFileOffset ) || ( mBufferOffset >= mBufferFileOffset + (off_t)mBufferSize ) ) {
+			if( ! fillBuffer() )
+				break;
+		}
+
+		const char *start = reinterpret_cast<const char*>( mBuffer.get() ) + ( mBufferOffset - mBufferFileOffset );
+		size_t available = static_cast<size_t>( mBufferFileOffset + (off_t)mBufferSize - mBufferOffset );
+		const char *lf = reinterpret_cast<const char*>( memchr( start, '\n', available ) );
+		const char *cr = reinterpret_cast<const char*>( memchr( start, '\r', lf ? ( lf - start ) : available ) );
+		const char *end = cr ? cr : lf;
+		if( ! end ) { // no line ending in this buffer; keep the partial line and refill
+			result.append( start, available );
+			mBufferOffset += available;
+			continue;
+		}
+
+		result.append( start, end - start );
+		mBufferOffset += ( end - start ) + 1;
+		if( cr ) { // swallow the LF of a CRLF, even when it lands in the next buffer
+			if( ( mBufferOffset < mBufferFileOffset + (off_t)mBufferSize ) || fillBuffer() ) {
+				if( mBuffer.get()[mBufferOffset - mBufferFileOffset] == '\n' )
+					++mBufferOffset;
+			}
+		}
+		break;
+	}
+
+	return result;
+}
+
 void IStreamFile::seekAbsolute( off_t absoluteOffset )
 {
-	int dir = ( absoluteOffset >= 0 ) ? SEEK_SET : SEEK_END;
-	absoluteOffset = abs( absoluteOffset );
-	if( fseek( mFile, static_cast<long>( absoluteOffset ), dir ) )
+	waitForReadAhead();
+	// a negative offset is relative to the end
+	if( seekFile( mFile, absoluteOffset, ( absoluteOffset >= 0 ) ? SEEK_SET : SEEK_END ) )
 		throw StreamExc();
-	mBufferOffset = absoluteOffset;
+	mBufferOffset = tellFile( mFile );
 }
 
 void IStreamFile::seekRelative( off_t relativeOffset )
 {
-	if( fseek( mFile, static_cast<long>( mBufferOffset + relativeOffset ), SEEK_SET ) )
+	waitForReadAhead();
+	if( seekFile( mFile, mBufferOffset + relativeOffset, SEEK_SET ) )
 		throw StreamExc();
-	mBufferOffset = ftell( mFile );
+	mBufferOffset = tellFile( mFile );
 }
 
 off_t IStreamFile::tell() const
@@ -197,11 +472,12 @@ off_t IStreamFile::tell() const
 off_t IStreamFile::size() const
 {
 	if ( ! mSizeCached ) {
-		off_t curOff = ftell( mFile );
-		fseek( mFile, 0, SEEK_END );
-		mSize = ftell( mFile );
+		waitForReadAhead();
+		off_t curOff = tellFile( mFile );
+		seekFile( mFile, 0, SEEK_END );
+		mSize = tellFile( mFile );
 		mSizeCached = true;
-		fseek( mFile, static_cast<long>( curOff ), SEEK_SET );
+		seekFile( mFile, curOff, SEEK_SET );
 	}
 	
 	return mSize;
@@ -209,35 +485,36 @@ off_t IStreamFile::size() const
 
 bool IStreamFile::isEof() const
 {
-	return ( ( mBufferOffset >= mBufferFileOffset + (off_t)mBufferSize ) && ( static_cast<bool>( feof( mFile ) != 0 ) ) );
+	if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset < mBufferFileOffset + (off_t)mBufferSize ) )
+		return false;
+	// the read-ahead worker reaches the end of the file before the reader does, so the FILE's EOF flag can't be trusted.
+	// Without it a buffer that ends exactly at the end of the file never sets the flag either.
+	if( ( ! mReadAhead ) && feof( mFile ) )
+		return true;
+	return mBufferOffset >= size();
 }
 
 void IStreamFile::IORead( void *t, size_t size )
 {
-	if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset + static_cast<int32_t>( size ) < mBufferFileOffset + (off_t)mBufferSize ) ) { // entirely inside the buffer
-		memcpy( t, mBuffer.get() + ( mBufferOffset - mBufferFileOffset ), size );
-		mBufferOffset += size;
-	}
-	else if ( ( mBufferFileOffset < mBufferOffset ) && ( mBufferOffset < mBufferFileOffset + (off_t)mBufferSize ) ) { // partially inside
-		size_t amountInBuffer = ( mBufferFileOffset + mBufferSize ) - mBufferOffset;
-		memcpy( t, mBuffer.get() + ( mBufferOffset - mBufferFileOffset ), amountInBuffer );
-		mBufferOffset += amountInBuffer;
-		IORead( reinterpret_cast<uint8_t*>( t ) + amountInBuffer, size - amountInBuffer );
-	}
-	else if( size > mDefaultBufferSize ) { // entirely outside of buffer, and too big to buffer anyway
-		fseek( mFile, static_cast<long>( mBufferOffset ), SEEK_SET );
-		if ( fread( t, size, 1, mFile ) != 1 )
-			throw StreamExc();
-		mBufferOffset += size;
-	}
-	else { // outside the current buffer, but not too big
-		fseek( mFile, static_cast<long>( mBufferOffset ), SEEK_SET );
-		mBufferFileOffset = mBufferOffset;
-		mBufferSize = fread( mBuffer.get(), 1, mDefaultBufferSize, mFile );
-		if( mBufferSize < size ) // we didn't read the whole thing
+	uint8_t *dest = reinterpret_cast<uint8_t*>( t );
+	while( size > 0 ) {
+		if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset < mBufferFileOffset + (off_t)mBufferSize ) ) { // at least partially inside the buffer
+			size_t amount = std::min<size_t>( size, static_cast<size_t>( mBufferFileOffset + (off_t)mBufferSize - mBufferOffset ) );
+			memcpy( dest, mBuffer.get() + ( mBufferOffset - mBufferFileOffset ), amount );
+			mBufferOffset += amount;
+			dest += amount;
+			size -= amount;
+		}
+		else if( size > mBufferCapacity ) { // outside of the buffer, and too big to buffer anyway
+			waitForReadAhead();
+			seekFile( mFile, mBufferOffset, SEEK_SET );
+			if ( fread( dest, size, 1, mFile ) != 1 )
+				throw StreamExc();
+			mBufferOffset += size;
+			size = 0;
+		}
+		else if( ! fillBuffer() ) // we didn't read the whole thing
 			throw StreamExc();
-		memcpy( t, mBuffer.get(), size );
-		mBufferOffset = mBufferFileOffset + size;
 	}
 }
 
@@ -261,20 +538,19 @@ OStreamFile::~OStreamFile()
 
 off_t OStreamFile::tell() const
 {
-	return ftell( mFile );
+	return tellFile( mFile );
 }
 
 void OStreamFile::seekAbsolute( off_t absoluteOffset )
 {
-	int dir = ( absoluteOffset >= 0 ) ? SEEK_SET : SEEK_END;
-	absoluteOffset = abs( absoluteOffset );
-	if( fseek( mFile, static_cast<long>( absoluteOffset ), dir ) )
+	// a negative offset is relative to the end
+	if( seekFile( mFile, absoluteOffset, ( absoluteOffset >= 0 ) ? SEEK_SET : SEEK_END ) )
 		throw StreamExc();
 }
 
 void OStreamFile::seekRelative( off_t relativeOffset )
 {
-	fseek( mFile, relativeOffset, SEEK_CUR );
+	seekFile( mFile, relativeOffset, SEEK_CUR );
 }
 
 void OStreamFile::IOWrite( const void *t, size_t size )
@@ -308,25 +584,33 @@ IoStreamFile::~IoStreamFile()
 
 size_t IoStreamFile::readDataAvailable( void *dest, size_t maxSize )
 {
+	// serve whatever IORead() has already buffered; the FILE's own position is past it
+	if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset < mBufferFileOffset + mBufferSize ) ) {
+		size_t amount = std::min<size_t>( maxSize, static_cast<size_t>( mBufferFileOffset + mBufferSize - mBufferOffset ) );
+		memcpy( dest, mBuffer.get() + ( mBufferOffset - mBufferFileOffset ), amount );
+		mBufferOffset += amount;
+		return amount;
+	}
+
+	seekFile( mFile, mBufferOffset, SEEK_SET );
 	size_t bytesRead = fread( dest, 1, maxSize, mFile );
-	mBufferOffset = ftell( mFile );
+	mBufferOffset += bytesRead;
 	return bytesRead;
 }
 
 void IoStreamFile::seekAbsolute( off_t absoluteOffset )
 {
-	int dir = ( absoluteOffset >= 0 ) ? SEEK_SET : SEEK_END;
-	absoluteOffset = abs( absoluteOffset );
-	if( fseek( mFile, static_cast<long>( absoluteOffset ), dir ) )
+	// a negative offset is relative to the end
+	if( seekFile( mFile, absoluteOffset, ( absoluteOffset >= 0 ) ? SEEK_SET : SEEK_END ) )
 		throw StreamExc();
-	mBufferOffset = absoluteOffset;
+	mBufferOffset = tellFile( mFile );
 }
 
 void IoStreamFile::seekRelative( off_t relativeOffset )
 {
-	if( fseek( mFile, static_cast<long>( mBufferOffset + relativeOffset ), SEEK_SET ) )
+	if( seekFile( mFile, mBufferOffset + relativeOffset, SEEK_SET ) )
 		throw StreamExc();
-	mBufferOffset = ftell( mFile );
+	mBufferOffset = tellFile( mFile );
 }
 
 off_t IoStreamFile::tell() const
@@ -337,11 +621,11 @@ off_t IoStreamFile::tell() const
 off_t IoStreamFile::size() const
 {
 	if ( ! mSizeCached ) {
-		off_t curOff = ftell( mFile );
-		fseek( mFile, 0, SEEK_END );
-		mSize = ftell( mFile );
+		off_t curOff = tellFile( mFile );
+		seekFile( mFile, 0, SEEK_END );
+		mSize = tellFile( mFile );
 		mSizeCached = true;
-		fseek( mFile, static_cast<long>( curOff ), SEEK_SET );
+		seekFile( mFile, curOff, SEEK_SET );
 	}
 	
 	return mSize;
@@ -354,7 +638,7 @@ bool IoStreamFile::isEof() const
 
 void IoStreamFile::IORead( void *t, size_t size )
 {
-	if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset + static_cast<int32_t>( size ) < mBufferFileOffset + mBufferSize ) ) { // entirely inside the buffer
+	if( ( mBufferOffset >= mBufferFileOffset ) && ( mBufferOffset + static_cast<int32_t>( size ) <= mBufferFileOffset + mBufferSize ) ) { // entirely inside the buffer
 		memcpy( t, mBuffer.get() + ( mBufferOffset - mBufferFileOffset ), size );
 		mBufferOffset += size;
 	}
@@ -365,13 +649,13 @@ void IoStreamFile::IORead( void *t, size_t size )
 		IORead( reinterpret_cast<uint8_t*>( t ) + amountInBuffer, size - amountInBuffer );
 	}
 	else if( static_cast<int32_t>( size ) > mDefaultBufferSize ) { // entirely outside of buffer, and too big to buffer anyway
-		fseek( mFile, static_cast<long>( mBufferOffset ), SEEK_SET );
+		seekFile( mFile, mBufferOffset, SEEK_SET );
 		if ( fread( t, size, 1, mFile ) != 1 )
 			throw StreamExc();
 		mBufferOffset += size;
 	}
 	else { // outside the current buffer, but not too big
-		fseek( mFile, static_cast<long>( mBufferOffset ), SEEK_SET );
+		seekFile( mFile, mBufferOffset, SEEK_SET );
 		mBufferFileOffset = mBufferOffset;
 		mBufferSize = fread( mBuffer.get(), 1, mDefaultBufferSize, mFile );
 		if( mBufferSize < (int32_t)size ) // we didn't read the whole thing
@@ -383,9 +667,35 @@ void IoStreamFile::IORead( void *t, size_t size )
 
 void IoStreamFile::IOWrite( const void *t, size_t size )
 {
+	// the FILE's position may be past mBufferOffset due to buffering, and the write makes the buffer stale
+	seekFile( mFile, mBufferOffset, SEEK_SET );
 	if( fwrite( t, size, 1, mFile ) != 1 ) {
 		throw StreamExc();
 	}
+	mBufferOffset += size;
+	mBufferFileOffset = std::numeric_limits<off_t>::min();
+	mBufferSize = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// Scans for the line ending with memchr() rather than reading a byte at a time. Advances \a offset past the line ending.
+static std::string readLineFromMemory( const uint8_t *data, uint64_t dataSize, uint64_t *offset )
+{
+	const char *start = reinterpret_cast<const char*>( data + *offset );
+	size_t available = static_cast<size_t>( dataSize - *offset );
+	const char *lf = reinterpret_cast<const char*>( memchr( start, '\n', available ) );
+	const char *cr = reinterpret_cast<const char*>( memchr( start, '\r', lf ? ( lf - start ) : available ) );
+	const char *end = cr ? cr : ( lf ? lf : start + available );
+
+	std::string result( start, end );
+	*offset += end - start;
+	if( *offset < dataSize ) {
+		++*offset;
+		if( cr && ( *offset < dataSize ) && ( data[*offset] == '\n' ) )
+			++*offset;
+	}
+
+	return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -395,6 +705,13 @@ IStreamMemRef IStreamMem::createRef( const void *data, size_t size )
 	return IStreamMemRef( new IStreamMem( data, size ) );
 }
 
+IStreamMemRef IStreamMem::createRef( const Buffer &buffer )
+{
+	IStreamMemRef result( new IStreamMem( buffer.getData(), buffer.getDataSize() ) );
+	result->mBuffer = buffer;
+	return result;
+}
+
 IStreamMem::IStreamMem( const void *aData, size_t aDataSize )
 	: IStream(), mData( reinterpret_cast<const uint8_t*>( aData ) ), mDataSize( aDataSize )
 {
@@ -420,6 +737,14 @@ size_t IStreamMem::readDataAvailable( void *dest, size_t maxSize )
 	return maxSize;	
 }
 
+std::string IStreamMem::readLine()
+{
+	uint64_t offset = mOffset;
+	std::string result = readLineFromMemory( mData, mDataSize, &offset );
+	mOffset = static_cast<size_t>( offset );
+	return result;
+}
+
 void IStreamMem::seekAbsolute( off_t absoluteOffset )
 {
 	if( absoluteOffset < 0 )
@@ -454,44 +779,368 @@ void IStreamMem::IORead( void *t, size_t size )
 	mOffset += size;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+// IStreamMmap
+struct IStreamMmap::Mapping {
+	Mapping() : mData( 0 ), mSize( 0 )
+#if defined( CINDER_MSW )
+		, mFile( INVALID_HANDLE_VALUE ), mMap( NULL )
+#endif
+	{}
+	~Mapping();
+
+	// returns false if the file could not be opened or mapped
+	bool	map( const std::string &path, AccessHint hint );
+	void	advise( AccessHint hint );
+
+	void		*mData;
+	uint64_t	mSize;
+#if defined( CINDER_MSW )
+	HANDLE		mFile, mMap;
+#endif
+};
+
+#if defined( CINDER_MSW )
+bool IStreamMmap::Mapping::map( const std::string &path, AccessHint hint )
+{
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	if( hint == ACCESS_SEQUENTIAL )
+		flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+	else if( hint == ACCESS_RANDOM )
+		flags |= FILE_FLAG_RANDOM_ACCESS;
+
+	mFile = ::CreateFileW( toUtf16( path ).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL );
+	if( mFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if( ! ::GetFileSizeEx( mFile, &fileSize ) )
+		return false;
+	// empty files can't be mapped, and a 32-bit process can't map more than its address space
+	if( ( fileSize.QuadPart == 0 ) || ( static_cast<uint64_t>( fileSize.QuadPart ) > std::numeric_limits<size_t>::max() ) )
+		return false;
+	mSize = static_cast<uint64_t>( fileSize.QuadPart );
+
+	// mapped copy-on-write since Buffer hands out non-const pointers; writes never reach the file
+	mMap = ::CreateFileMappingW( mFile, NULL, PAGE_WRITECOPY, fileSize.HighPart, fileSize.LowPart, NULL );
+	if( ! mMap )
+		return false;
+	mData = ::MapViewOfFile( mMap, FILE_MAP_COPY, 0, 0, static_cast<SIZE_T>( mSize ) );
+	return mData != 0;
+}
+
+void IStreamMmap::Mapping::advise( AccessHint /*hint*/ )
+{
+	// Windows only accepts access hints when the file is opened
+}
+
+IStreamMmap::Mapping::~Mapping()
+{
+	if( mData )
+		::UnmapViewOfFile( mData );
+	if( mMap )
+		::CloseHandle( mMap );
+	if( mFile != INVALID_HANDLE_VALUE )
+		::CloseHandle( mFile );
+}
+#else
+bool IStreamMmap::Mapping::map( const std::string &path, AccessHint hint )
+{
+	int fd = ::open( path.c_str(), O_RDONLY );
+	if( fd < 0 )
+		return false;
+
+	struct stat st;
+	if( ( ::fstat( fd, &st ) != 0 ) || ( st.st_size <= 0 ) || ( static_cast<uint64_t>( st.st_size ) > std::numeric_limits<size_t>::max() ) ) {
+		::close( fd );
+		return false;
+	}
+	mSize = static_cast<uint64_t>( st.st_size );
+
+	// mapped copy-on-write since Buffer hands out non-const pointers; writes never reach the file
+	void *data = ::mmap( 0, static_cast<size_t>( mSize ), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	// the mapping holds its own reference to the file
+	::close( fd );
+	if( data == MAP_FAILED )
+		return false;
+
+	mData = data;
+	advise( hint );
+	return true;
+}
+
+void IStreamMmap::Mapping::advise( AccessHint hint )
+{
+	int advice = MADV_NORMAL;
+	if( hint == ACCESS_SEQUENTIAL )
+		advice = MADV_SEQUENTIAL;
+	else if( hint == ACCESS_RANDOM )
+		advice = MADV_RANDOM;
+	::madvise( mData, static_cast<size_t>( mSize ), advice );
+}
+
+IStreamMmap::Mapping::~Mapping()
+{
+	if( mData )
+		::munmap( mData, static_cast<size_t>( mSize ) );
+}
+#endif
+
+IStreamMmapRef IStreamMmap::createRef( const std::string &path, AccessHint hint )
+{
+	shared_ptr<Mapping> mapping( new Mapping );
+	if( ! mapping->map( path, hint ) )
+		return IStreamMmapRef();
+
+	return IStreamMmapRef( new IStreamMmap( mapping ) );
+}
+
+IStreamMmap::IStreamMmap( shared_ptr<Mapping> mapping )
+	: IStream(), mMapping( mapping ), mData( reinterpret_cast<const uint8_t*>( mapping->mData ) ), mDataSize( mapping->mSize ), mOffset( 0 )
+{
+}
+
+IStreamMmap::~IStreamMmap()
+{
+}
+
+size_t IStreamMmap::readDataAvailable( void *dest, size_t maxSize )
+{
+	if( mOffset + maxSize > mDataSize )
+		maxSize = static_cast<size_t>( mDataSize - mOffset );
+	memcpy( dest, mData + mOffset, maxSize );
+	mOffset += maxSize;
+
+	return maxSize;
+}
+
+std::string IStreamMmap::readLine()
+{
+	return readLineFromMemory( mData, mDataSize, &mOffset );
+}
+
+void IStreamMmap::seekAbsolute( off_t absoluteOffset )
+{
+	int64_t offset = absoluteOffset;
+	if( offset < 0 )
+		offset += static_cast<int64_t>( mDataSize );
+	if( ( offset < 0 ) || ( static_cast<uint64_t>( offset ) > mDataSize ) )
+		throw StreamExc();
+	mOffset = static_cast<uint64_t>( offset );
+}
+
+void IStreamMmap::seekRelative( off_t relativeOffset )
+{
+	int64_t offset = static_cast<int64_t>( mOffset ) + relativeOffset;
+	if( ( offset < 0 ) || ( static_cast<uint64_t>( offset ) > mDataSize ) )
+		throw StreamExc();
+	mOffset = static_cast<uint64_t>( offset );
+}
+
+void IStreamMmap::setOffset( uint64_t offset )
+{
+	if( offset > mDataSize )
+		throw StreamExc();
+	mOffset = offset;
+}
+
+off_t IStreamMmap::tell() const
+{
+	if( mOffset > static_cast<uint64_t>( std::numeric_limits<off_t>::max() ) )
+		throw StreamExc();
+	return static_cast<off_t>( mOffset );
+}
+
+off_t IStreamMmap::size() const
+{
+	if( mDataSize > static_cast<uint64_t>( std::numeric_limits<off_t>::max() ) )
+		throw StreamExc();
+	return static_cast<off_t>( mDataSize );
+}
+
+bool IStreamMmap::isEof() const
+{
+	return mOffset >= mDataSize;
+}
+
+Buffer IStreamMmap::getBuffer()
+{
+	return Buffer( mMapping->mData, static_cast<size_t>( mDataSize ), mMapping );
+}
+
+void IStreamMmap::setAccessHint( AccessHint hint )
+{
+	mMapping->advise( hint );
+}
+
+void IStreamMmap::prefetch( uint64_t offset, uint64_t length )
+{
+#if ! defined( CINDER_MSW )
+	if( offset >= mDataSize )
+		return;
+	length = std::min( length, mDataSize - offset );
+	// madvise() requires a page-aligned address
+	const uint64_t pageSize = static_cast<uint64_t>( ::sysconf( _SC_PAGESIZE ) );
+	const uint64_t alignedOffset = offset - ( offset % pageSize );
+	::madvise( const_cast<uint8_t*>( mData ) + alignedOffset, static_cast<size_t>( length + offset - alignedOffset ), MADV_WILLNEED );
+#endif
+}
+
+void IStreamMmap::IORead( void *t, size_t size )
+{
+	if( mOffset + size > mDataSize )
+		throw StreamExc();
+	memcpy( t, mData + mOffset, size );
+	mOffset += size;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 // OStreamMem
+OStreamMemRef OStreamMem::createRef( size_t bufferSizeHint )
+{
+	return OStreamMemRef( new OStreamMem( bufferSizeHint ) );
+}
+
 OStreamMem::OStreamMem( size_t bufferSizeHint )
+	: OStream(), mCapacity( 0 ), mDataSize( 0 ), mOffset( 0 ), mLastChunk( 0 ), mFirstChunkSize( std::max<size_t>( bufferSizeHint, 1 ) )
 {
-	mBuffer = malloc( bufferSizeHint );
-	mDataSize = bufferSizeHint;
-	mOffset = 0;
 }
 
 OStreamMem::~OStreamMem()
 {
-	free( mBuffer );
 }
 
 void OStreamMem::seekAbsolute( off_t absoluteOffset )
 {
-	if( absoluteOffset >= (off_t)mDataSize ) {
-		while( (off_t)mDataSize < absoluteOffset )
-			mDataSize *= 2;
-		mBuffer = realloc( mBuffer, mDataSize );
-	}
-	mOffset = absoluteOffset;
+	if( absoluteOffset < 0 )
+		throw StreamExc();
+	// nothing is allocated until the next write
+	mOffset = static_cast<size_t>( absoluteOffset );
 }
 
 void OStreamMem::seekRelative( off_t relativeOffset )
 {
-	seekAbsolute( mOffset + relativeOffset );
+	seekAbsolute( static_cast<off_t>( mOffset ) + relativeOffset );
 }
 
 void OStreamMem::IOWrite( const void *t, size_t size )
 {
-	if( mOffset + size >= mDataSize ) {
-		while( mDataSize < mOffset + size )
-			mDataSize *= 2;
-		mBuffer = realloc( mBuffer, mDataSize );
-	}
-	memcpy( ((uint8_t*)mBuffer) + mOffset, t, size );
+	if( mOffset > mDataSize ) // zero the gap left by seeking past the end
+		copyIn( mDataSize, 0, mOffset - mDataSize );
+	copyIn( mOffset, reinterpret_cast<const uint8_t*>( t ), size );
 	mOffset += size;
+	mDataSize = std::max( mDataSize, mOffset );
+}
+
+void OStreamMem::copyIn( size_t offset, const uint8_t *src, size_t size )
+{
+	if( offset + size > mCapacity )
+		addChunk( offset + size - mCapacity );
+
+	size_t chunkIndex = findChunk( offset );
+	while( size > 0 ) {
+		Chunk &chunk = mChunks[chunkIndex];
+		size_t chunkOffset = offset - chunk.mStart;
+		size_t bytes = std::min( size, chunk.mSize - chunkOffset );
+		if( src ) {
+			memcpy( chunk.mData.get() + chunkOffset, src, bytes );
+			src += bytes;
+		}
+		else
+			memset( chunk.mData.get() + chunkOffset, 0, bytes );
+		offset += bytes;
+		size -= bytes;
+		mLastChunk = chunkIndex++;
+	}
+}
+
+void OStreamMem::addChunk( size_t minSize )
+{
+	size_t size = mChunks.empty() ? mFirstChunkSize : std::min( mChunks.back().mSize * 2, MAX_CHUNK_SIZE );
+	size = std::max( size, minSize );
+
+	uint8_t *data = reinterpret_cast<uint8_t*>( malloc( size ) );
+	if( ! data )
+		throw StreamExcOutOfMemory();
+
+	Chunk chunk;
+	chunk.mData = shared_ptr<uint8_t>( data, free );
+	chunk.mStart = mCapacity;
+	chunk.mSize = size;
+	mChunks.push_back( chunk );
+	mCapacity += size;
+}
+
+size_t OStreamMem::findChunk( size_t offset )
+{
+	// writes are nearly always sequential, so try the last chunk written and the one after it
+	for( size_t c = mLastChunk; ( c < mChunks.size() ) && ( c <= mLastChunk + 1 ); ++c ) {
+		if( ( offset >= mChunks[c].mStart ) && ( offset < mChunks[c].mStart + mChunks[c].mSize ) )
+			return c;
+	}
+
+	size_t low = 0, high = mChunks.size();
+	while( high - low > 1 ) {
+		size_t mid = ( low + high ) / 2;
+		if( mChunks[mid].mStart <= offset )
+			low = mid;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+void OStreamMem::flatten()
+{
+	if( mChunks.size() <= 1 )
+		return;
+
+	uint8_t *data = reinterpret_cast<uint8_t*>( malloc( mDataSize ) );
+	if( ! data )
+		throw StreamExcOutOfMemory();
+	for( std::vector<Chunk>::const_iterator chunkIt = mChunks.begin(); ( chunkIt != mChunks.end() ) && ( chunkIt->mStart < mDataSize ); ++chunkIt )
+		memcpy( data + chunkIt->mStart, chunkIt->mData.get(), std::min( chunkIt->mSize, mDataSize - chunkIt->mStart ) );
+
+	Chunk chunk;
+	chunk.mData = shared_ptr<uint8_t>( data, free );
+	chunk.mStart = 0;
+	chunk.mSize = mDataSize;
+	mChunks.assign( 1, chunk );
+	mCapacity = mDataSize;
+	mLastChunk = 0;
+}
+
+void* OStreamMem::getBuffer()
+{
+	flatten();
+	return mChunks.empty() ? 0 : mChunks[0].mData.get();
+}
+
+Buffer OStreamMem::createBuffer()
+{
+	flatten();
+	if( mChunks.empty() )
+		addChunk( 1 );
+	return Buffer( mChunks[0].mData.get(), mDataSize, mChunks[0].mData );
+}
+
+IStreamMemRef OStreamMem::createIStream()
+{
+	return IStreamMem::createRef( createBuffer() );
+}
+
+off_t OStreamMem::reserve( size_t size )
+{
+	off_t result = tell();
+	IOWrite( 0, size ); // zeros
+	return result;
+}
+
+void OStreamMem::patch( off_t offset, const void *data, size_t size )
+{
+	if( ( offset < 0 ) || ( static_cast<size_t>( offset ) + size > mDataSize ) )
+		throw StreamExc();
+	copyIn( static_cast<size_t>( offset ), reinterpret_cast<const uint8_t*>( data ), size );
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -508,6 +1157,14 @@ IStreamFileRef loadFileStream( const std::string &path )
 		return IStreamFileRef();
 }
 
+IStreamMmapRef loadFileStreamMmap( const std::string &path, IStreamMmap::AccessHint hint )
+{
+	IStreamMmapRef s = IStreamMmap::createRef( path, hint );
+	if( s )
+		s->setFileName( path );
+	return s;
+}
+
 shared_ptr<OStreamFile> writeFileStream( const std::string &path, bool createParents )
 {
 	if( createParents ) {
@@ -535,10 +1192,25 @@ IoStreamFileRef readWriteFileStream( const std::string &path )
 		return IoStreamFileRef();
 }
 
+namespace {
+// readDataAvailable() is allowed to return less than requested, so keep going until the stream runs dry
+void readStreamFully( IStreamRef is, void *dest, size_t size )
+{
+	uint8_t *dest8 = reinterpret_cast<uint8_t*>( dest );
+	while( size > 0 ) {
+		size_t bytesRead = is->readDataAvailable( dest8, size );
+		if( bytesRead == 0 )
+			break;
+		dest8 += bytesRead;
+		size -= bytesRead;
+	}
+}
+} // anonymous namespace
+
 void loadStreamMemory( IStreamRef is, shared_ptr<uint8_t> *resultData, size_t *resultDataSize )
 {
 	off_t fileSize = is->size();
-	if( fileSize > std::numeric_limits<off_t>::max() )
+	if( static_cast<uint64_t>( fileSize ) > std::numeric_limits<size_t>::max() )
 		throw StreamExcOutOfMemory();
 	
 	*resultData = shared_ptr<uint8_t>( (uint8_t*)malloc( fileSize ), free );
@@ -546,17 +1218,17 @@ void loadStreamMemory( IStreamRef is, shared_ptr<uint8_t> *resultData, size_t *r
 		throw StreamExcOutOfMemory();
 
 	*resultDataSize = static_cast<size_t>( fileSize );
-	is->readDataAvailable( resultData->get(), fileSize );
+	readStreamFully( is, resultData->get(), *resultDataSize );
 }
 
 Buffer loadStreamBuffer( IStreamRef is )
 {
 	off_t fileSize = is->size();
-	if( fileSize > std::numeric_limits<off_t>::max() )
+	if( static_cast<uint64_t>( fileSize ) > std::numeric_limits<size_t>::max() )
 		throw StreamExcOutOfMemory();
 	
-	Buffer result( fileSize );
-	is->readDataAvailable( result.getData(), fileSize );
+	Buffer result( static_cast<size_t>( fileSize ) );
+	readStreamFully( is, result.getData(), static_cast<size_t>( fileSize ) );
 	
 	return result;
 }
@@ -571,8 +1243,14 @@ Buffer loadStreamBuffer( IStreamRef is )
 	template void IStream::read<T>( T *t ); \
 	template void IStream::readEndian<T>( T *t, uint8_t endian ); \
 	template void IStream::readBig<T>( T *t ); \
-	template void IStream::readLittle<T>( T *t );
-
-BOOST_PP_SEQ_FOR_EACH( STREAM_PROTOTYPES, ~, (int8_t)(uint8_t)(int16_t)(uint16_t)(int32_t)(uint32_t)(float)(double) )
+	template void IStream::readLittle<T>( T *t ); \
+	template void OStream::write<T>( const T *t, size_t count ); \
+	template void OStream::writeBig<T>( const T *t, size_t count ); \
+	template void OStream::writeLittle<T>( const T *t, size_t count ); \
+	template void IStream::read<T>( T *t, size_t count ); \
+	template void IStream::readBig<T>( T *t, size_t count ); \
+	template void IStream::readLittle<T>( T *t, size_t count );
+
+BOOST_PP_SEQ_FOR_EACH( STREAM_PROTOTYPES, ~, (int8_t)(uint8_t)(int16_t)(uint16_t)(int32_t)(uint32_t)(int64_t)(uint64_t)(float)(double) )
 
 } // namespace dt
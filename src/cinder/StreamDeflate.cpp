@@ -0,0 +1,310 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/StreamDeflate.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+
+namespace cinder {
+
+static int windowBitsForFraming( DeflateFraming framing )
+{
+	switch( framing ) {
+		case DEFLATE_FRAMING_GZIP: return 15 + 16;
+		case DEFLATE_FRAMING_RAW: return -15;
+		case DEFLATE_FRAMING_AUTO: return 15 + 32;
+		default: return 15;
+	}
+}
+
+static void inflateDeleter( z_stream *strm )
+{
+	inflateEnd( strm );
+	delete strm;
+}
+
+static void deflateDeleter( z_stream *strm )
+{
+	deflateEnd( strm );
+	delete strm;
+}
+
+static shared_ptr<z_stream> createInflateStream( DeflateFraming framing )
+{
+	z_stream *strm = new z_stream;
+	memset( strm, 0, sizeof(z_stream) );
+	if( inflateInit2( strm, windowBitsForFraming( framing ) ) != Z_OK ) {
+		delete strm;
+		throw StreamDeflateExc();
+	}
+	return shared_ptr<z_stream>( strm, inflateDeleter );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// IStreamDeflate
+IStreamDeflateRef IStreamDeflate::createRef( IStreamRef source, DeflateFraming framing, size_t chunkSize )
+{
+	return IStreamDeflateRef( new IStreamDeflate( source, framing, chunkSize ) );
+}
+
+IStreamDeflate::IStreamDeflate( IStreamRef source, DeflateFraming framing, size_t chunkSize )
+	: IStream(), mSource( source ), mFraming( framing ), mChunkSize( std::max<size_t>( chunkSize, 64 ) ), mOutPos( 0 ), mOutSize( 0 ), 
+	mStreamEnd( false ), mOffset( 0 ), mSizeCached( false )
+{
+	mSourceStart = mSource->tell();
+	mIn = shared_ptr<uint8_t>( new uint8_t[mChunkSize], checked_array_deleter<uint8_t>() );
+	mOut = shared_ptr<uint8_t>( new uint8_t[mChunkSize], checked_array_deleter<uint8_t>() );
+	mZStream = createInflateStream( mFraming );
+	setFileName( mSource->getFileName() );
+}
+
+IStreamDeflate::~IStreamDeflate()
+{
+}
+
+void IStreamDeflate::restart()
+{
+	mSource->seekAbsolute( mSourceStart );
+	if( inflateReset( mZStream.get() ) != Z_OK )
+		throw StreamDeflateExc();
+	mZStream->next_in = 0;
+	mZStream->avail_in = 0;
+	mOutPos = mOutSize = 0;
+	mStreamEnd = false;
+	mOffset = 0;
+}
+
+bool IStreamDeflate::fillOutput()
+{
+	mOutPos = mOutSize = 0;
+	z_stream *strm = mZStream.get();
+	while( ( mOutSize == 0 ) && ( ! mStreamEnd ) ) {
+		if( strm->avail_in == 0 ) {
+			strm->avail_in = static_cast<uInt>( mSource->readDataAvailable( mIn.get(), mChunkSize ) );
+			strm->next_in = mIn.get();
+			if( strm->avail_in == 0 ) // the compressed data ended before its trailer
+				throw StreamDeflateExc();
+		}
+
+		strm->next_out = mOut.get();
+		strm->avail_out = static_cast<uInt>( mChunkSize );
+		int err = inflate( strm, Z_NO_FLUSH );
+		mOutSize = mChunkSize - strm->avail_out;
+		if( err == Z_STREAM_END ) {
+			// another gzip member may follow the one that just ended
+			bool moreMembers = ( mFraming == DEFLATE_FRAMING_GZIP || mFraming == DEFLATE_FRAMING_AUTO ) && ( ( strm->avail_in > 0 ) || ( ! mSource->isEof() ) );
+			if( moreMembers && ( strm->avail_in == 0 ) ) {
+				strm->avail_in = static_cast<uInt>( mSource->readDataAvailable( mIn.get(), mChunkSize ) );
+				strm->next_in = mIn.get();
+				moreMembers = strm->avail_in > 0;
+			}
+			if( moreMembers && ( strm->next_in[0] == 0x1f ) ) {
+				if( inflateReset( strm ) != Z_OK )
+					throw StreamDeflateExc();
+			}
+			else {
+				mStreamEnd = true;
+				// hand back what was read past the end of the compressed data, in case the source continues with something else
+				if( strm->avail_in > 0 ) {
+					try {
+						mSource->seekRelative( -static_cast<off_t>( strm->avail_in ) );
+						strm->avail_in = 0;
+					}
+					catch( StreamExc & ) {
+					}
+				}
+			}
+		}
+		else if( ( err != Z_OK ) && ( err != Z_BUF_ERROR ) )
+			throw StreamDeflateExc();
+	}
+
+	return mOutSize > 0;
+}
+
+size_t IStreamDeflate::readDataAvailable( void *dest, size_t maxSize )
+{
+	if( ( mOutPos == mOutSize ) && ! fillOutput() )
+		return 0;
+
+	size_t amount = std::min( maxSize, mOutSize - mOutPos );
+	memcpy( dest, mOut.get() + mOutPos, amount );
+	mOutPos += amount;
+	mOffset += amount;
+	return amount;
+}
+
+void IStreamDeflate::IORead( void *t, size_t size )
+{
+	uint8_t *dest = reinterpret_cast<uint8_t*>( t );
+	while( size > 0 ) {
+		size_t bytesRead = readDataAvailable( dest, size );
+		if( bytesRead == 0 )
+			throw StreamExc();
+		dest += bytesRead;
+		size -= bytesRead;
+	}
+}
+
+void IStreamDeflate::seekAbsolute( off_t absoluteOffset )
+{
+	if( absoluteOffset < 0 )
+		absoluteOffset += size();
+	if( absoluteOffset < 0 )
+		throw StreamExc();
+
+	if( absoluteOffset < mOffset ) {
+		// still inside the current chunk; otherwise there's no way back but to start over
+		if( mOffset - absoluteOffset <= static_cast<off_t>( mOutPos ) ) {
+			mOutPos -= static_cast<size_t>( mOffset - absoluteOffset );
+			mOffset = absoluteOffset;
+			return;
+		}
+		restart();
+	}
+
+	while( mOffset < absoluteOffset ) {
+		if( ( mOutPos == mOutSize ) && ! fillOutput() )
+			throw StreamExc();
+		size_t amount = static_cast<size_t>( std::min<off_t>( absoluteOffset - mOffset, static_cast<off_t>( mOutSize - mOutPos ) ) );
+		mOutPos += amount;
+		mOffset += amount;
+	}
+}
+
+void IStreamDeflate::seekRelative( off_t relativeOffset )
+{
+	seekAbsolute( mOffset + relativeOffset );
+}
+
+off_t IStreamDeflate::size() const
+{
+	if( ! mSizeCached ) {
+		// decompress everything with a separate z_stream and put the source back where it was
+		off_t sourcePos = mSource->tell();
+		mSource->seekAbsolute( mSourceStart );
+		IStreamDeflateRef counter = IStreamDeflate::createRef( mSource, mFraming, mChunkSize );
+		mSize = 0;
+		while( counter->fillOutput() )
+			mSize += counter->mOutSize;
+		mSource->seekAbsolute( sourcePos );
+		mSizeCached = true;
+	}
+
+	return mSize;
+}
+
+bool IStreamDeflate::isEof() const
+{
+	if( mOutPos < mOutSize )
+		return false;
+	// the end of the data is only known once inflate() has reported it
+	return ! const_cast<IStreamDeflate*>( this )->fillOutput();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+// OStreamDeflate
+OStreamDeflateRef OStreamDeflate::createRef( OStreamRef sink, DeflateFraming framing, int compressionLevel, size_t chunkSize )
+{
+	return OStreamDeflateRef( new OStreamDeflate( sink, framing, compressionLevel, chunkSize ) );
+}
+
+OStreamDeflate::OStreamDeflate( OStreamRef sink, DeflateFraming framing, int compressionLevel, size_t chunkSize )
+	: OStream(), mSink( sink ), mChunkSize( std::max<size_t>( chunkSize, 64 ) ), mFinished( false ), mOffset( 0 )
+{
+	if( framing == DEFLATE_FRAMING_AUTO ) // there's nothing to detect when writing
+		framing = DEFLATE_FRAMING_ZLIB;
+
+	z_stream *strm = new z_stream;
+	memset( strm, 0, sizeof(z_stream) );
+	if( deflateInit2( strm, compressionLevel, Z_DEFLATED, windowBitsForFraming( framing ), 8, Z_DEFAULT_STRATEGY ) != Z_OK ) {
+		delete strm;
+		throw StreamDeflateExc();
+	}
+	mZStream = shared_ptr<z_stream>( strm, deflateDeleter );
+	mOut = shared_ptr<uint8_t>( new uint8_t[mChunkSize], checked_array_deleter<uint8_t>() );
+	setFileName( mSink->getFileName() );
+}
+
+OStreamDeflate::~OStreamDeflate()
+{
+	try {
+		finish();
+	}
+	catch( ... ) {
+	}
+}
+
+void OStreamDeflate::deflateAndWrite( const void *data, size_t size, int flush )
+{
+	z_stream *strm = mZStream.get();
+	strm->next_in = reinterpret_cast<Bytef*>( const_cast<void*>( data ) );
+	strm->avail_in = static_cast<uInt>( size );
+	do {
+		strm->next_out = mOut.get();
+		strm->avail_out = static_cast<uInt>( mChunkSize );
+		int err = deflate( strm, flush );
+		if( ( err != Z_OK ) && ( err != Z_STREAM_END ) && ( err != Z_BUF_ERROR ) )
+			throw StreamDeflateExc();
+		size_t produced = mChunkSize - strm->avail_out;
+		if( produced > 0 )
+			mSink->writeData( mOut.get(), produced );
+	} while( ( strm->avail_out == 0 ) || ( strm->avail_in > 0 ) );
+}
+
+void OStreamDeflate::IOWrite( const void *t, size_t size )
+{
+	if( mFinished )
+		throw StreamExc();
+	deflateAndWrite( t, size, Z_NO_FLUSH );
+	mOffset += size;
+}
+
+void OStreamDeflate::flush()
+{
+	if( ! mFinished )
+		deflateAndWrite( 0, 0, Z_SYNC_FLUSH );
+}
+
+void OStreamDeflate::finish()
+{
+	if( mFinished )
+		return;
+	mFinished = true;
+	deflateAndWrite( 0, 0, Z_FINISH );
+}
+
+void OStreamDeflate::seekAbsolute( off_t absoluteOffset )
+{
+	if( absoluteOffset != mOffset )
+		throw StreamExc();
+}
+
+void OStreamDeflate::seekRelative( off_t relativeOffset )
+{
+	if( relativeOffset != 0 )
+		throw StreamExc();
+}
+
+} // namespace cinder
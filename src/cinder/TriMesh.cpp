@@ -21,29 +21,444 @@
 */
 
 #include "cinder/TriMesh.h"
+#include "cinder/Utilities.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
 
 using std::vector;
 
 namespace cinder {
 
+namespace {
+
+// Version 2 is a 32 byte header, a table of 32 byte section records and then the sections themselves, each aligned to 16 bytes.
+// Offsets are relative to the first byte of the header so that a TriMesh can be embedded anywhere in a stream.
+// Header: uint8 version, 3 reserved bytes, uint32 section count, uint64 total size, 16 reserved bytes
+// Section: uint32 type, uint32 element count, uint8 codec, 7 reserved bytes, uint64 offset, uint64 stored size
+const uint32_t HEADER_SIZE = 32;
+const uint32_t SECTION_RECORD_SIZE = 32;
+const uint32_t SECTION_ALIGNMENT = 16;
+
+// readers skip sections of types they don't know, so new attributes can be added without a new version
+enum SectionType { SECTION_POSITIONS = 1, SECTION_NORMALS, SECTION_TEXCOORDS, SECTION_COLORS_RGB, SECTION_COLORS_RGBA, SECTION_INDICES, SECTION_TANGENTS };
+// compressed sections hold the output of compressBuffer(), which records its own codec
+enum SectionCodec { SECTION_STORED = 0, SECTION_COMPRESSED = 1 };
+// no codec compressBuffer() offers can expand its input by more than this; zlib's limit is about 1032:1, LZ4's about 255:1
+const uint64_t MAX_COMPRESSION_RATIO = 1032;
+
+struct Section {
+	uint32_t		mType, mCount;
+	uint8_t			mCodec;
+	uint64_t		mOffset, mStoredSize;
+	const void		*mData;		// the elements themselves, or for compressed sections the contents of mCompressed
+	Buffer			mCompressed;
+};
+
+uint64_t alignSection( uint64_t offset )
+{
+	return ( offset + SECTION_ALIGNMENT - 1 ) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Writes \a size zero bytes, of which there are never more than SECTION_ALIGNMENT. Some streams reject empty writes, so those are skipped.
+void writePadding( OStream *out, size_t size )
+{
+	const uint8_t zeros[SECTION_ALIGNMENT] = { 0 };
+	if( size > 0 )
+		out->writeData( zeros, size );
+}
+
+// Every attribute is made of 32 bit components, which lets the byte order be handled uniformly
+template<typename T>
+void addSection( uint32_t type, const vector<T> &elements, const TriMesh::WriteOptions &options, vector<Section> *sections )
+{
+	if( elements.empty() )
+		return;
+
+	Section section;
+	section.mType = type;
+	section.mCount = static_cast<uint32_t>( elements.size() );
+	section.mStoredSize = elements.size() * sizeof(T);
+	section.mData = &elements[0];
+	section.mCodec = SECTION_STORED;
+	if( options.isCompressed() ) {
+		Buffer raw( const_cast<T*>( &elements[0] ), elements.size() * sizeof(T) );
+#if ! defined( CINDER_LITTLE_ENDIAN )
+		raw = Buffer( elements.size() * sizeof(T) );
+		raw.copyFrom( &elements[0], raw.getDataSize() );
+		swapEndianBlock( reinterpret_cast<uint32_t*>( raw.getData() ), raw.getDataSize() );
+#endif
+		section.mCompressed = compressBuffer( raw, options.getCodec() );
+		section.mCodec = SECTION_COMPRESSED;
+		section.mStoredSize = section.mCompressed.getDataSize();
+		section.mData = section.mCompressed.getData();
+	}
+	sections->push_back( section );
+}
+
+template<typename T>
+void readSection( IStream *in, off_t start, const uint8_t *mapped, const Section &section, vector<T> *result )
+{
+	// stored sizes were already checked against the stream's size, so bounding the element count by them keeps a corrupt count from driving the allocation
+	const uint64_t size = static_cast<uint64_t>( section.mCount ) * sizeof(T);
+	if( ( section.mCodec == SECTION_STORED ) && ( section.mStoredSize != size ) )
+		throw TriMeshExcInvalidData();
+	else if( ( section.mCodec == SECTION_COMPRESSED ) && ( size / MAX_COMPRESSION_RATIO > section.mStoredSize ) )
+		throw TriMeshExcInvalidData();
+	else if( ( section.mCodec != SECTION_STORED ) && ( section.mCodec != SECTION_COMPRESSED ) )
+		throw TriMeshExcInvalidData();
+
+	if( section.mCount == 0 ) {
+		result->clear();
+		return;
+	}
+
+	if( section.mCodec == SECTION_STORED ) {
+		result->resize( section.mCount );
+		in->seekAbsolute( start + static_cast<off_t>( section.mOffset ) );
+		in->readLittle( reinterpret_cast<uint32_t*>( &(*result)[0] ), static_cast<size_t>( size / sizeof(uint32_t) ) );
+	}
+	else {
+		Buffer stored;
+		if( mapped ) // decompress straight out of the mapping
+			stored = Buffer( const_cast<uint8_t*>( mapped + section.mOffset ), static_cast<size_t>( section.mStoredSize ) );
+		else {
+			stored = Buffer( static_cast<size_t>( section.mStoredSize ) );
+			in->seekAbsolute( start + static_cast<off_t>( section.mOffset ) );
+			in->readData( stored.getData(), stored.getDataSize() );
+		}
+		Buffer data = decompressBuffer( stored );
+		if( data.getDataSize() != size )
+			throw TriMeshExcInvalidData();
+		result->resize( section.mCount );
+		uint32_t *dest = reinterpret_cast<uint32_t*>( &(*result)[0] );
+		memcpy( dest, data.getData(), static_cast<size_t>( size ) );
+#if ! defined( CINDER_LITTLE_ENDIAN )
+		swapEndianBlock( dest, static_cast<size_t>( size ) );
+#endif
+	}
+}
+
+// Takes \a count elements of \a elementSize bytes from \a remaining, throwing if a version 1 header claims more than the stream holds
+void reserveVersion1Data( uint64_t count, size_t elementSize, uint64_t *remaining )
+{
+	if( count > *remaining / elementSize )
+		throw TriMeshExcInvalidData();
+	*remaining -= count * elementSize;
+}
+
+// Simulates a FIFO post-transform cache, which is what ACMR is conventionally measured against
+class FifoCache {
+  public:
+	FifoCache( size_t numVertices, size_t cacheSize )
+		: mStamps( numVertices, 0 ), mSize( static_cast<uint32_t>( cacheSize ) ), mTime( mSize + 1 )
+	{}
+
+	//! Returns whether \a vertex missed the cache, in which case it's now the newest entry
+	bool access( uint32_t vertex )
+	{
+		if( mTime - mStamps[vertex] <= mSize )
+			return false;
+		mStamps[vertex] = mTime++;
+		return true;
+	}
+	//! Returns the number of misses for the triangle starting at \a indices
+	int accessTriangle( const uint32_t *indices )
+	{
+		return access( indices[0] ) + access( indices[1] ) + access( indices[2] );
+	}
+	void flush() { mTime += mSize + 1; }
+
+  private:
+	vector<uint32_t>	mStamps;
+	uint32_t			mSize, mTime;
+};
+
+// Scores follow Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+const uint32_t FORSYTH_MAX_VALENCE = 64; // valence scores are tabulated up to here and level off beyond it
+
+// Returns \a indices reordered for an LRU cache of \a cacheSize vertices
+vector<uint32_t> forsythOrder( const vector<uint32_t> &indices, size_t numVertices, size_t cacheSize )
+{
+	const size_t numTriangles = indices.size() / 3;
+	cacheSize = std::min<size_t>( std::max<size_t>( cacheSize, 4 ), 256 );
+
+	float cacheScores[256], valenceScores[FORSYTH_MAX_VALENCE + 1];
+	for( size_t i = 0; i < cacheSize; ++i ) {
+		// the most recent triangle's vertices score lower, so the strip doesn't just turn back on itself
+		if( i < 3 )
+			cacheScores[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+		else
+			cacheScores[i] = std::pow( 1.0f - ( i - 3 ) / (float)( cacheSize - 3 ), FORSYTH_CACHE_DECAY_POWER );
+	}
+	valenceScores[0] = 0;
+	for( uint32_t v = 1; v <= FORSYTH_MAX_VALENCE; ++v )
+		valenceScores[v] = FORSYTH_VALENCE_BOOST_SCALE * std::pow( (float)v, -FORSYTH_VALENCE_BOOST_POWER );
+
+	// each vertex's remaining triangles, stored contiguously; a vertex's list shrinks as its triangles are emitted
+	vector<uint32_t> valences( numVertices, 0 ), firstTriangles( numVertices + 1, 0 );
+	for( size_t i = 0; i < indices.size(); ++i )
+		++valences[indices[i]];
+	for( size_t v = 0; v < numVertices; ++v )
+		firstTriangles[v + 1] = firstTriangles[v] + valences[v];
+	vector<uint32_t> vertexTriangles( indices.size() ), fill( firstTriangles.begin(), firstTriangles.end() - 1 );
+	for( size_t i = 0; i < indices.size(); ++i )
+		vertexTriangles[fill[indices[i]]++] = static_cast<uint32_t>( i / 3 );
+
+	vector<int32_t> cachePositions( numVertices, -1 );
+	vector<float> vertexScores( numVertices );
+	for( size_t v = 0; v < numVertices; ++v )
+		vertexScores[v] = valenceScores[std::min( valences[v], FORSYTH_MAX_VALENCE )];
+
+	vector<uint8_t> emitted( numTriangles, 0 );
+	int64_t bestTriangle = -1;
+	float bestScore = -1;
+	for( size_t t = 0; t < numTriangles; ++t ) {
+		const float score = vertexScores[indices[t*3]] + vertexScores[indices[t*3+1]] + vertexScores[indices[t*3+2]];
+		if( score > bestScore ) {
+			bestScore = score;
+			bestTriangle = t;
+		}
+	}
+
+	vector<uint32_t> result( numTriangles * 3 ), cache, newCache;
+	cache.reserve( cacheSize + 3 );
+	newCache.reserve( cacheSize + 3 );
+	size_t cursor = 0;
+	for( size_t out = 0; out < numTriangles; ++out ) {
+		// when nothing in the cache has triangles left, restart from the next triangle in input order
+		if( bestTriangle < 0 ) {
+			while( emitted[cursor] )
+				++cursor;
+			bestTriangle = cursor;
+		}
+
+		const uint32_t *tri = &indices[bestTriangle * 3];
+		std::copy( tri, tri + 3, &result[out * 3] );
+		emitted[bestTriangle] = 1;
+
+		newCache.clear();
+		for( int k = 0; k < 3; ++k ) {
+			const uint32_t v = tri[k];
+			uint32_t *begin = &vertexTriangles[firstTriangles[v]], *end = begin + valences[v];
+			*std::find( begin, end, static_cast<uint32_t>( bestTriangle ) ) = *( end - 1 );
+			--valences[v];
+			if( std::find( newCache.begin(), newCache.end(), v ) == newCache.end() )
+				newCache.push_back( v );
+		}
+		for( size_t i = 0; i < cache.size(); ++i ) {
+			if( ( cache[i] != tri[0] ) && ( cache[i] != tri[1] ) && ( cache[i] != tri[2] ) )
+				newCache.push_back( cache[i] );
+		}
+
+		// entries past cacheSize have just been evicted, but still need rescoring
+		for( size_t i = 0; i < newCache.size(); ++i ) {
+			const uint32_t v = newCache[i];
+			cachePositions[v] = ( i < cacheSize ) ? static_cast<int32_t>( i ) : -1;
+			vertexScores[v] = ( valences[v] == 0 ) ? 0 : valenceScores[std::min( valences[v], FORSYTH_MAX_VALENCE )];
+			if( ( cachePositions[v] >= 0 ) && ( valences[v] > 0 ) )
+				vertexScores[v] += cacheScores[i];
+		}
+
+		bestTriangle = -1;
+		bestScore = -1;
+		for( size_t i = 0; i < newCache.size(); ++i ) {
+			const uint32_t v = newCache[i];
+			for( uint32_t j = firstTriangles[v]; j < firstTriangles[v] + valences[v]; ++j ) {
+				const uint32_t t = vertexTriangles[j];
+				const float score = vertexScores[indices[t*3]] + vertexScores[indices[t*3+1]] + vertexScores[indices[t*3+2]];
+				if( score > bestScore ) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		if( newCache.size() > cacheSize )
+			newCache.resize( cacheSize );
+		cache.swap( newCache );
+	}
+
+	return result;
+}
+
+template<typename T>
+void remapAttribute( const vector<uint32_t> &remap, vector<T> *attribute )
+{
+	if( attribute->size() != remap.size() )
+		return;
+
+	vector<T> result( attribute->size() );
+	for( size_t v = 0; v < remap.size(); ++v )
+		result[remap[v]] = (*attribute)[v];
+	attribute->swap( result );
+}
+
+// meshes with fewer triangles or vertices than this per thread aren't worth splitting up
+const size_t MIN_PARALLEL_ELEMENTS = 32 * 1024;
+
+// Calls \a func on consecutive ranges covering [0, \a count), each on its own thread if \a parallel and there's enough work to go around
+void runInRanges( size_t count, bool parallel, const boost::function<void ( size_t, size_t )> &func )
+{
+	size_t numRanges = 1;
+	if( parallel )
+		numRanges = std::max<size_t>( 1, std::min<size_t>( boost::thread::hardware_concurrency(), count / MIN_PARALLEL_ELEMENTS ) );
+	if( numRanges == 1 ) {
+		func( 0, count );
+		return;
+	}
+
+	boost::thread_group threads;
+	for( size_t r = 0; r < numRanges; ++r )
+		threads.create_thread( boost::bind( func, count * r / numRanges, count * ( r + 1 ) / numRanges ) );
+	threads.join_all();
+}
+
+// Lists the corners, as positions in \a indices, that use each vertex contiguously and in order. Per-vertex sums can then be gathered
+// by each vertex rather than scattered by each triangle, so threads never write to the same vertex, and the result doesn't depend on their number.
+void listVertexCorners( const vector<uint32_t> &indices, size_t numVertices, vector<uint32_t> *firstCorners, vector<uint32_t> *corners )
+{
+	firstCorners->assign( numVertices + 1, 0 );
+	for( size_t i = 0; i < indices.size(); ++i )
+		++(*firstCorners)[indices[i] + 1];
+	for( size_t v = 0; v < numVertices; ++v )
+		(*firstCorners)[v + 1] += (*firstCorners)[v];
+
+	corners->resize( indices.size() );
+	vector<uint32_t> next( firstCorners->begin(), firstCorners->end() - 1 );
+	for( size_t i = 0; i < indices.size(); ++i )
+		(*corners)[next[indices[i]]++] = static_cast<uint32_t>( i );
+}
+
+// Returns the angle between \a a and \a b, or 0 if either is degenerate
+float calcAngle( const Vec3f &a, const Vec3f &b )
+{
+	const float lengths = math<float>::sqrt( a.lengthSquared() * b.lengthSquared() );
+	return ( lengths > 0 ) ? math<float>::acos( math<float>::clamp( a.dot( b ) / lengths, -1, 1 ) ) : 0;
+}
+
+// The cross product's length is twice the triangle's area, which is the weight unless the weights are the corners' angles
+void calcTriangleNormals( const TriMesh *mesh, bool angleWeighted, Vec3f *triangleNormals, float *cornerAngles, size_t begin, size_t end )
+{
+	const Vec3f *positions = &mesh->getVertices()[0];
+	const uint32_t *indices = &mesh->getIndices()[0];
+	for( size_t t = begin; t < end; ++t ) {
+		const Vec3f &p0 = positions[indices[t*3]], &p1 = positions[indices[t*3+1]], &p2 = positions[indices[t*3+2]];
+		const Vec3f e01 = p1 - p0, e12 = p2 - p1, e20 = p0 - p2;
+		triangleNormals[t] = e01.cross( -e20 );
+		if( angleWeighted ) {
+			triangleNormals[t].safeNormalize();
+			cornerAngles[t*3] = calcAngle( e01, -e20 );
+			cornerAngles[t*3+1] = calcAngle( e12, -e01 );
+			cornerAngles[t*3+2] = calcAngle( e20, -e12 );
+		}
+	}
+}
+
+void gatherNormals( const vector<uint32_t> *firstCorners, const vector<uint32_t> *corners, const Vec3f *triangleNormals, const float *cornerAngles, Vec3f *normals, size_t begin, size_t end )
+{
+	for( size_t v = begin; v < end; ++v ) {
+		Vec3f sum = Vec3f::zero();
+		for( uint32_t c = (*firstCorners)[v]; c < (*firstCorners)[v + 1]; ++c ) {
+			const uint32_t corner = (*corners)[c];
+			sum += ( cornerAngles ) ? triangleNormals[corner / 3] * cornerAngles[corner] : triangleNormals[corner / 3];
+		}
+		normals[v] = sum.safeNormalized();
+	}
+}
+
+// Each triangle's directions of increasing u and v, after Lengyel, scaled by its area
+void calcTriangleTangents( const TriMesh *mesh, Vec3f *triangleTangents, Vec3f *triangleBitangents, size_t begin, size_t end )
+{
+	const Vec3f *positions = &mesh->getVertices()[0];
+	const Vec2f *texCoords = &mesh->getTexCoords()[0];
+	const uint32_t *indices = &mesh->getIndices()[0];
+	for( size_t t = begin; t < end; ++t ) {
+		const uint32_t i0 = indices[t*3], i1 = indices[t*3+1], i2 = indices[t*3+2];
+		const Vec3f e1 = positions[i1] - positions[i0], e2 = positions[i2] - positions[i0];
+		const Vec2f d1 = texCoords[i1] - texCoords[i0], d2 = texCoords[i2] - texCoords[i0];
+		Vec3f tangent = e1 * d2.y - e2 * d1.y, bitangent = e2 * d1.x - e1 * d2.x;
+		// the texture space's orientation is all that matters, and the area restores the weighting
+		const float area = e1.cross( e2 ).length();
+		if( d1.x * d2.y - d1.y * d2.x < 0 ) {
+			tangent = -tangent;
+			bitangent = -bitangent;
+		}
+		triangleTangents[t] = tangent.safeNormalized() * area;
+		triangleBitangents[t] = bitangent.safeNormalized() * area;
+	}
+}
+
+void gatherTangents( const vector<uint32_t> *firstCorners, const vector<uint32_t> *corners, const Vec3f *triangleTangents, const Vec3f *triangleBitangents,
+					const Vec3f *normals, Vec4f *tangents, size_t begin, size_t end )
+{
+	for( size_t v = begin; v < end; ++v ) {
+		Vec3f tangent = Vec3f::zero(), bitangent = Vec3f::zero();
+		for( uint32_t c = (*firstCorners)[v]; c < (*firstCorners)[v + 1]; ++c ) {
+			tangent += triangleTangents[(*corners)[c] / 3];
+			bitangent += triangleBitangents[(*corners)[c] / 3];
+		}
+
+		// Gram-Schmidt against the normal, falling back on any direction in the tangent plane where the texture space is degenerate
+		const Vec3f &normal = normals[v];
+		tangent -= normal * normal.dot( tangent );
+		if( tangent.lengthSquared() == 0 )
+			tangent = ( bitangent - normal * normal.dot( bitangent ) ).cross( normal );
+		if( tangent.lengthSquared() == 0 )
+			tangent = normal.randomOrthogonal();
+		tangent.safeNormalize();
+		tangents[v] = Vec4f( tangent, ( normal.cross( tangent ).dot( bitangent ) < 0 ) ? -1.0f : 1.0f );
+	}
+}
+
+// the number of floats in each of the interleavable attributes, in the order of their bits
+const size_t INTERLEAVED_COMPONENTS[] = { 3, 3, 3, 4, 2, 4 };
+const size_t NUM_INTERLEAVED_ATTRIBUTES = sizeof(INTERLEAVED_COMPONENTS) / sizeof(INTERLEAVED_COMPONENTS[0]);
+
+// Copies \a numComponents floats per vertex from \a source to every \a strideComponents floats of \a dest
+void interleaveComponents( const float *source, size_t numComponents, size_t numVertices, float *dest, size_t strideComponents )
+{
+	for( size_t v = 0; v < numVertices; ++v, source += numComponents, dest += strideComponents ) {
+		for( size_t c = 0; c < numComponents; ++c )
+			dest[c] = source[c];
+	}
+}
+
+} // anonymous namespace
+
 void TriMesh::clear()
 {
 	mVertices.clear();
 	mNormals.clear();
 	mTexCoords.clear();
+	mColorsRGB.clear();
+	mColorsRGBA.clear();
+	mTangents.clear();
 	mIndices.clear();
+	discardInterleaved();
 }
 
 void TriMesh::appendVertices( const Vec4d *verts, size_t num )
 {
 	for( size_t v = 0; v < num; ++v )
 		mVertices.push_back( Vec3f( (float)verts[v].x, (float)verts[v].y, (float)verts[v].z ) );
+	discardInterleaved();
 }
 
 void TriMesh::appendNormals( const Vec4d *normals, size_t num )
 {
 	for( size_t v = 0; v < num; ++v )
 		mNormals.push_back( Vec3f( (float)normals[v].x, (float)normals[v].y, (float)normals[v].z ) );
+	discardInterleaved();
 }
 
 AxisAlignedBox3f TriMesh::calcBoundingBox() const
@@ -70,45 +485,331 @@ AxisAlignedBox3f TriMesh::calcBoundingBox() const
 	return AxisAlignedBox3f( min, max );
 }
 
+float TriMesh::calcAcmr( size_t cacheSize ) const
+{
+	if( mIndices.size() < 3 )
+		return 0;
+
+	FifoCache cache( mVertices.size(), cacheSize );
+	size_t misses = 0;
+	for( size_t i = 0; i + 2 < mIndices.size(); i += 3 )
+		misses += cache.accessTriangle( &mIndices[i] );
+
+	return misses / (float)getNumTriangles();
+}
+
+void TriMesh::optimizeVertexCache( size_t cacheSize )
+{
+	if( mIndices.size() < 6 )
+		return;
+
+	forsythOrder( mIndices, mVertices.size(), cacheSize ).swap( mIndices );
+}
+
+void TriMesh::optimizeOverdraw( float threshold )
+{
+	const size_t numTriangles = getNumTriangles();
+	if( numTriangles < 2 )
+		return;
+
+	// Following Sander et al.'s "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", the existing order is cut
+	// into clusters, first wherever all three vertices miss the cache, and then within those wherever the ACMR so far is low enough
+	const size_t cacheSize = 16;
+	FifoCache cache( mVertices.size(), cacheSize );
+	vector<size_t> hardStarts;
+	for( size_t t = 0; t < numTriangles; ++t ) {
+		if( ( cache.accessTriangle( &mIndices[t * 3] ) == 3 ) || ( t == 0 ) )
+			hardStarts.push_back( t );
+	}
+	hardStarts.push_back( numTriangles );
+
+	vector<size_t> clusterStarts;
+	for( size_t h = 0; h + 1 < hardStarts.size(); ++h ) {
+		const size_t begin = hardStarts[h], end = hardStarts[h + 1];
+		cache.flush();
+		size_t misses = 0;
+		for( size_t t = begin; t < end; ++t )
+			misses += cache.accessTriangle( &mIndices[t * 3] );
+		const float clusterThreshold = threshold * misses / (float)( end - begin );
+
+		cache.flush();
+		size_t softStart = begin, softMisses = 0;
+		clusterStarts.push_back( begin );
+		for( size_t t = begin; t + 1 < end; ++t ) {
+			softMisses += cache.accessTriangle( &mIndices[t * 3] );
+			if( softMisses <= clusterThreshold * ( t + 1 - softStart ) ) {
+				clusterStarts.push_back( t + 1 );
+				cache.flush();
+				softStart = t + 1;
+				softMisses = 0;
+			}
+		}
+	}
+	clusterStarts.push_back( numTriangles );
+	const size_t numClusters = clusterStarts.size() - 1;
+
+	// clusters are drawn in order of how far out they sit along their own average normal
+	vector<Vec3f> clusterCentroids( numClusters, Vec3f::zero() ), clusterNormals( numClusters, Vec3f::zero() );
+	Vec3f meshCentroid = Vec3f::zero();
+	float meshArea = 0;
+	for( size_t c = 0; c < numClusters; ++c ) {
+		float clusterArea = 0;
+		for( size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t ) {
+			const Vec3f &v0 = mVertices[mIndices[t*3]], &v1 = mVertices[mIndices[t*3+1]], &v2 = mVertices[mIndices[t*3+2]];
+			const Vec3f normal = ( v1 - v0 ).cross( v2 - v0 );
+			const float area = normal.length();
+			clusterCentroids[c] += ( v0 + v1 + v2 ) * ( area / 3 );
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+		if( clusterArea > 0 )
+			clusterCentroids[c] /= clusterArea;
+	}
+	if( meshArea > 0 )
+		meshCentroid /= meshArea;
+
+	vector<std::pair<float,size_t> > order( numClusters );
+	for( size_t c = 0; c < numClusters; ++c )
+		order[c] = std::make_pair( -( clusterCentroids[c] - meshCentroid ).dot( clusterNormals[c].safeNormalized() ), c );
+	std::stable_sort( order.begin(), order.end() );
+
+	vector<uint32_t> result;
+	result.reserve( mIndices.size() );
+	for( size_t i = 0; i < numClusters; ++i ) {
+		const size_t c = order[i].second;
+		result.insert( result.end(), mIndices.begin() + clusterStarts[c] * 3, mIndices.begin() + clusterStarts[c + 1] * 3 );
+	}
+	mIndices.swap( result );
+}
+
+void TriMesh::optimizeVertexFetch()
+{
+	const uint32_t unused = 0xFFFFFFFF;
+	vector<uint32_t> remap( mVertices.size(), unused );
+	uint32_t next = 0;
+	for( vector<uint32_t>::iterator indexIt = mIndices.begin(); indexIt != mIndices.end(); ++indexIt ) {
+		if( remap[*indexIt] == unused )
+			remap[*indexIt] = next++;
+		*indexIt = remap[*indexIt];
+	}
+	for( size_t v = 0; v < remap.size(); ++v ) {
+		if( remap[v] == unused )
+			remap[v] = next++;
+	}
+
+	remapAttribute( remap, &mVertices );
+	remapAttribute( remap, &mNormals );
+	remapAttribute( remap, &mTexCoords );
+	remapAttribute( remap, &mColorsRGB );
+	remapAttribute( remap, &mColorsRGBA );
+	remapAttribute( remap, &mTangents );
+	discardInterleaved();
+}
+
+void TriMesh::optimize()
+{
+	optimizeVertexCache();
+	optimizeOverdraw();
+	optimizeVertexFetch();
+}
+
+void TriMesh::recalculateNormals( bool angleWeighted, bool parallel )
+{
+	// Triangles and then vertices are processed in two separate phases, so each only ever writes to its own elements
+	const size_t numTriangles = getNumTriangles();
+	discardInterleaved();
+	mNormals.resize( mVertices.size() );
+	if( mVertices.empty() )
+		return;
+
+	vector<Vec3f> triangleNormals( numTriangles );
+	vector<float> cornerAngles( angleWeighted ? numTriangles * 3 : 0 );
+	if( numTriangles > 0 )
+		runInRanges( numTriangles, parallel, boost::bind( calcTriangleNormals, this, angleWeighted, &triangleNormals[0], angleWeighted ? &cornerAngles[0] : 0, _1, _2 ) );
+
+	vector<uint32_t> firstCorners, corners;
+	listVertexCorners( mIndices, mVertices.size(), &firstCorners, &corners );
+	runInRanges( mVertices.size(), parallel, boost::bind( gatherNormals, &firstCorners, &corners, numTriangles ? &triangleNormals[0] : 0,
+				angleWeighted && numTriangles ? &cornerAngles[0] : 0, &mNormals[0], _1, _2 ) );
+}
+
+void TriMesh::recalculateTangents( bool parallel )
+{
+	if( ( mNormals.size() != mVertices.size() ) || ( mTexCoords.size() != mVertices.size() ) )
+		throw TriMeshExcMissingAttribute();
+
+	const size_t numTriangles = getNumTriangles();
+	discardInterleaved();
+	mTangents.resize( mVertices.size() );
+	if( mVertices.empty() )
+		return;
+
+	vector<Vec3f> triangleTangents( numTriangles ), triangleBitangents( numTriangles );
+	if( numTriangles > 0 )
+		runInRanges( numTriangles, parallel, boost::bind( calcTriangleTangents, this, &triangleTangents[0], &triangleBitangents[0], _1, _2 ) );
+
+	vector<uint32_t> firstCorners, corners;
+	listVertexCorners( mIndices, mVertices.size(), &firstCorners, &corners );
+	runInRanges( mVertices.size(), parallel, boost::bind( gatherTangents, &firstCorners, &corners, numTriangles ? &triangleTangents[0] : 0,
+				numTriangles ? &triangleBitangents[0] : 0, &mNormals[0], &mTangents[0], _1, _2 ) );
+}
+
+void TriMesh::interleave( uint32_t attributes )
+{
+	discardInterleaved();
+
+	// only attributes every vertex has can be interleaved
+	const size_t numVertices = mVertices.size();
+	const float *sources[NUM_INTERLEAVED_ATTRIBUTES] = { 0 };
+	if( numVertices > 0 ) {
+		sources[0] = &mVertices[0].x;
+		sources[1] = ( mNormals.size() == numVertices ) ? &mNormals[0].x : 0;
+		sources[2] = ( mColorsRGB.size() == numVertices ) ? &mColorsRGB[0].r : 0;
+		sources[3] = ( ( mColorsRGBA.size() == numVertices ) && ( ! ( sources[2] && ( attributes & INTERLEAVE_COLORS_RGB ) ) ) ) ? &mColorsRGBA[0].r : 0;
+		sources[4] = ( mTexCoords.size() == numVertices ) ? &mTexCoords[0].x : 0;
+		sources[5] = ( mTangents.size() == numVertices ) ? &mTangents[0].x : 0;
+	}
+	size_t strideComponents = 0;
+	for( size_t a = 0; a < NUM_INTERLEAVED_ATTRIBUTES; ++a ) {
+		if( sources[a] && ( attributes & ( 1 << a ) ) ) {
+			mInterleavedAttributes |= 1 << a;
+			strideComponents += INTERLEAVED_COMPONENTS[a];
+		}
+	}
+	mInterleavedStride = strideComponents * sizeof(float);
+
+	mInterleaved.resize( numVertices * strideComponents );
+	size_t offsetComponents = 0;
+	for( size_t a = 0; a < NUM_INTERLEAVED_ATTRIBUTES; ++a ) {
+		if( mInterleavedAttributes & ( 1 << a ) ) {
+			interleaveComponents( sources[a], INTERLEAVED_COMPONENTS[a], numVertices, &mInterleaved[offsetComponents], strideComponents );
+			offsetComponents += INTERLEAVED_COMPONENTS[a];
+		}
+	}
+}
+
+size_t TriMesh::getInterleavedOffset( uint32_t attribute ) const
+{
+	size_t result = 0;
+	for( size_t a = 0; ( a < NUM_INTERLEAVED_ATTRIBUTES ) && ( ( 1u << a ) < attribute ); ++a ) {
+		if( mInterleavedAttributes & ( 1 << a ) )
+			result += INTERLEAVED_COMPONENTS[a] * sizeof(float);
+	}
+
+	return result;
+}
+
 void TriMesh::read( IStream *in )
 {
 	clear();
 
+	off_t start = in->tell();
 	uint8_t versionNumber;
 	in->read( &versionNumber );
-	
+	if( versionNumber == 1 )
+		readVersion1( in );
+	else if( versionNumber == 2 )
+		readVersion2( in, start );
+	else
+		throw TriMeshExcInvalidData();
+}
+
+void TriMesh::readVersion1( IStream *in )
+{
 	uint32_t numVertices, numNormals, numTexCoords, numIndices;
 	in->readLittle( &numVertices );
 	in->readLittle( &numNormals );
 	in->readLittle( &numTexCoords );
 	in->readLittle( &numIndices );
 	
-	for( size_t idx = 0; idx < numVertices; ++idx ) {
-		Vec3f v;
-		in->readLittle( &v.x ); in->readLittle( &v.y ); in->readLittle( &v.z );
-		mVertices.push_back( v );
-	}
+	// Vec3f and Vec2f are tightly packed floats, so each array is read with a single call. The counts are checked against what's left
+	// of the stream first so that a corrupt header can't make us allocate more than the file could possibly hold.
+	uint64_t remaining = static_cast<uint64_t>( in->size() - in->tell() );
+	reserveVersion1Data( numVertices, sizeof(Vec3f), &remaining );
+	reserveVersion1Data( numNormals, sizeof(Vec3f), &remaining );
+	reserveVersion1Data( numTexCoords, sizeof(Vec2f), &remaining );
+	reserveVersion1Data( numIndices, sizeof(uint32_t), &remaining );
+	const size_t vertexFloats = static_cast<size_t>( numVertices ) * 3, normalFloats = static_cast<size_t>( numNormals ) * 3;
+	const size_t texCoordFloats = static_cast<size_t>( numTexCoords ) * 2;
+
+	mVertices.resize( numVertices );
+	if( numVertices )
+		in->readLittle( &mVertices[0].x, vertexFloats );
+
+	mNormals.resize( numNormals );
+	if( numNormals )
+		in->readLittle( &mNormals[0].x, normalFloats );
+
+	mTexCoords.resize( numTexCoords );
+	if( numTexCoords )
+		in->readLittle( &mTexCoords[0].x, texCoordFloats );
+
+	mIndices.resize( numIndices );
+	if( numIndices )
+		in->readLittle( &mIndices[0], numIndices );
+}
+
+void TriMesh::readVersion2( IStream *in, off_t start )
+{
+	uint32_t numSections;
+	uint64_t totalSize;
+	in->seekAbsolute( start + 4 );
+	in->readLittle( &numSections );
+	in->readLittle( &totalSize );
+	// every later check is against totalSize, so it has to fit in what the stream actually holds
+	if( totalSize > static_cast<uint64_t>( in->size() - start ) )
+		throw TriMeshExcInvalidData();
+	if( HEADER_SIZE + static_cast<uint64_t>( numSections ) * SECTION_RECORD_SIZE > totalSize )
+		throw TriMeshExcInvalidData();
 
-	for( size_t idx = 0; idx < numNormals; ++idx ) {
-		Vec3f v;
-		in->readLittle( &v.x ); in->readLittle( &v.y ); in->readLittle( &v.z );
-		mNormals.push_back( v );
+	vector<Section> sections( numSections );
+	for( uint32_t s = 0; s < numSections; ++s ) {
+		in->seekAbsolute( start + HEADER_SIZE + s * SECTION_RECORD_SIZE );
+		in->readLittle( &sections[s].mType );
+		in->readLittle( &sections[s].mCount );
+		in->read( &sections[s].mCodec );
+		in->seekRelative( 7 );
+		in->readLittle( &sections[s].mOffset );
+		in->readLittle( &sections[s].mStoredSize );
+		if( ( sections[s].mOffset > totalSize ) || ( sections[s].mStoredSize > totalSize - sections[s].mOffset ) )
+			throw TriMeshExcInvalidData();
 	}
 
-	for( size_t idx = 0; idx < numTexCoords; ++idx ) {
-		Vec2f v;
-		in->readLittle( &v.x ); in->readLittle( &v.y );
-		mTexCoords.push_back( v );
+	// a memory-mapped file can be decompressed in place
+	const uint8_t *mapped = 0;
+	if( IStreamMmap *mmapStream = dynamic_cast<IStreamMmap*>( in ) ) {
+		if( static_cast<uint64_t>( start ) + totalSize <= mmapStream->getDataSize() )
+			mapped = reinterpret_cast<const uint8_t*>( mmapStream->getData() ) + start;
 	}
 
-	for( size_t idx = 0; idx < numIndices; ++idx ) {
-		uint32_t v;
-		in->readLittle( &v );
-		mIndices.push_back( v );
+	for( vector<Section>::const_iterator sectionIt = sections.begin(); sectionIt != sections.end(); ++sectionIt ) {
+		switch( sectionIt->mType ) {
+			case SECTION_POSITIONS: readSection( in, start, mapped, *sectionIt, &mVertices ); break;
+			case SECTION_NORMALS: readSection( in, start, mapped, *sectionIt, &mNormals ); break;
+			case SECTION_TEXCOORDS: readSection( in, start, mapped, *sectionIt, &mTexCoords ); break;
+			case SECTION_COLORS_RGB: readSection( in, start, mapped, *sectionIt, &mColorsRGB ); break;
+			case SECTION_COLORS_RGBA: readSection( in, start, mapped, *sectionIt, &mColorsRGBA ); break;
+			case SECTION_INDICES: readSection( in, start, mapped, *sectionIt, &mIndices ); break;
+			case SECTION_TANGENTS: readSection( in, start, mapped, *sectionIt, &mTangents ); break;
+			default: break;
+		}
 	}
+
+	// leave the stream just past this TriMesh
+	in->seekAbsolute( start + static_cast<off_t>( totalSize ) );
 }
 
-void TriMesh::write( OStream *out ) const
+void TriMesh::write( OStream *out, const WriteOptions &options ) const
+{
+	if( options.getVersion() == 1 )
+		writeVersion1( out );
+	else
+		writeVersion2( out, options );
+}
+
+void TriMesh::writeVersion1( OStream *out ) const
 {
 	const uint8_t versionNumber = 1;
 	out->write( versionNumber );
@@ -118,21 +819,61 @@ void TriMesh::write( OStream *out ) const
 	out->writeLittle( static_cast<uint32_t>( mTexCoords.size() ) );
 	out->writeLittle( static_cast<uint32_t>( mIndices.size() ) );
 	
-	for( vector<Vec3f>::const_iterator it = mVertices.begin(); it != mVertices.end(); ++it ) {
-		out->writeLittle( it->x ); out->writeLittle( it->y ); out->writeLittle( it->z );
-	}
+	if( ! mVertices.empty() )
+		out->writeLittle( &mVertices[0].x, mVertices.size() * 3 );
+	if( ! mNormals.empty() )
+		out->writeLittle( &mNormals[0].x, mNormals.size() * 3 );
+	if( ! mTexCoords.empty() )
+		out->writeLittle( &mTexCoords[0].x, mTexCoords.size() * 2 );
 
-	for( vector<Vec3f>::const_iterator it = mNormals.begin(); it != mNormals.end(); ++it ) {
-		out->writeLittle( it->x ); out->writeLittle( it->y ); out->writeLittle( it->z );
+	if( ! mIndices.empty() )
+		out->writeLittle( &mIndices[0], mIndices.size() );
+}
+
+void TriMesh::writeVersion2( OStream *out, const WriteOptions &options ) const
+{
+	// the sections are prepared, and compressed if need be, up front so the table can record where each one lands
+	vector<Section> sections;
+	addSection( SECTION_POSITIONS, mVertices, options, &sections );
+	addSection( SECTION_NORMALS, mNormals, options, &sections );
+	addSection( SECTION_TEXCOORDS, mTexCoords, options, &sections );
+	addSection( SECTION_COLORS_RGB, mColorsRGB, options, &sections );
+	addSection( SECTION_COLORS_RGBA, mColorsRGBA, options, &sections );
+	addSection( SECTION_INDICES, mIndices, options, &sections );
+	addSection( SECTION_TANGENTS, mTangents, options, &sections );
+
+	uint64_t offset = alignSection( HEADER_SIZE + sections.size() * SECTION_RECORD_SIZE );
+	for( vector<Section>::iterator sectionIt = sections.begin(); sectionIt != sections.end(); ++sectionIt ) {
+		sectionIt->mOffset = offset;
+		offset = alignSection( offset + sectionIt->mStoredSize );
 	}
+	const uint64_t totalSize = offset;
 
-	for( vector<Vec2f>::const_iterator it = mTexCoords.begin(); it != mTexCoords.end(); ++it ) {
-		out->writeLittle( it->x ); out->writeLittle( it->y );
+	const uint8_t versionNumber = 2;
+	out->write( versionNumber );
+	writePadding( out, 3 );
+	out->writeLittle( static_cast<uint32_t>( sections.size() ) );
+	out->writeLittle( totalSize );
+	writePadding( out, 16 );
+	for( vector<Section>::const_iterator sectionIt = sections.begin(); sectionIt != sections.end(); ++sectionIt ) {
+		out->writeLittle( sectionIt->mType );
+		out->writeLittle( sectionIt->mCount );
+		out->write( sectionIt->mCodec );
+		writePadding( out, 7 );
+		out->writeLittle( sectionIt->mOffset );
+		out->writeLittle( sectionIt->mStoredSize );
 	}
 
-	for( vector<size_t>::const_iterator it = mIndices.begin(); it != mIndices.end(); ++it ) {
-		out->writeLittle( static_cast<uint32_t>( *it) );
+	uint64_t position = HEADER_SIZE + sections.size() * SECTION_RECORD_SIZE;
+	for( vector<Section>::const_iterator sectionIt = sections.begin(); sectionIt != sections.end(); ++sectionIt ) {
+		writePadding( out, static_cast<size_t>( sectionIt->mOffset - position ) );
+		if( sectionIt->mCodec == SECTION_STORED )
+			out->writeLittle( reinterpret_cast<const uint32_t*>( sectionIt->mData ), static_cast<size_t>( sectionIt->mStoredSize / sizeof(uint32_t) ) );
+		else
+			out->writeData( sectionIt->mData, static_cast<size_t>( sectionIt->mStoredSize ) );
+		position = sectionIt->mOffset + sectionIt->mStoredSize;
 	}
+	writePadding( out, static_cast<size_t>( totalSize - position ) );
 }
 
 } // namespace cinder
@@ -0,0 +1,611 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/TriMeshBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using std::vector;
+
+namespace cinder {
+
+namespace {
+
+// Costs are relative to intersecting a single triangle
+const float TRAVERSAL_COST = 1.0f;
+const size_t NUM_BINS = 16;
+const uint32_t MAX_LEAF_TRIANGLES = 8;
+// Below this depth nodes are split at their median instead, which keeps degenerate input from exhausting the traversal stack
+const size_t MAX_SAH_DEPTH = 64;
+const size_t STACK_SIZE = 128;
+const uint32_t MIN_PARALLEL_TRIANGLES = 16 * 1024;
+
+// 32 bytes, so two share a cache line
+struct Node {
+	Vec3f		mMin;
+	// a leaf's first triangle, or an interior node's second child, the first being the next node
+	uint32_t	mIndex;
+	Vec3f		mMax;
+	// 0 for interior nodes
+	uint32_t	mNumTriangles;
+};
+
+struct Bounds {
+	Bounds() : mMin( Vec3f( 1, 1, 1 ) * std::numeric_limits<float>::max() ), mMax( Vec3f( 1, 1, 1 ) * -std::numeric_limits<float>::max() ) {}
+
+	void	include( const Vec3f &point )
+	{
+		mMin.x = std::min( mMin.x, point.x ); mMin.y = std::min( mMin.y, point.y ); mMin.z = std::min( mMin.z, point.z );
+		mMax.x = std::max( mMax.x, point.x ); mMax.y = std::max( mMax.y, point.y ); mMax.z = std::max( mMax.z, point.z );
+	}
+	void	include( const Bounds &bounds ) { include( bounds.mMin ); include( bounds.mMax ); }
+	// half the surface area, which is all the heuristic needs
+	float	calcArea() const
+	{
+		if( mMin.x > mMax.x )
+			return 0;
+		Vec3f extent = mMax - mMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	Vec3f	mMin, mMax;
+};
+
+struct BuildState {
+	vector<Bounds>		mTriangleBounds;
+	vector<Vec3f>		mCentroids;
+	// the triangles in leaf order, which each node partitions its range of
+	vector<uint32_t>	mOrder;
+};
+
+struct CentroidLess {
+	CentroidLess( const vector<Vec3f> &centroids, int axis ) : mCentroids( centroids ), mAxis( axis ) {}
+	bool operator()( uint32_t a, uint32_t b ) const { return mCentroids[a][mAxis] < mCentroids[b][mAxis]; }
+
+	const vector<Vec3f>		&mCentroids;
+	int						mAxis;
+};
+
+struct InBins {
+	InBins( const vector<Vec3f> &centroids, int axis, float start, float scale, size_t lastBin ) : mCentroids( centroids ), mAxis( axis ), mStart( start ), mScale( scale ), mLastBin( lastBin ) {}
+	bool operator()( uint32_t triangle ) const { return calcBin( mCentroids[triangle][mAxis], mStart, mScale ) <= mLastBin; }
+
+	static size_t calcBin( float coordinate, float start, float scale ) { return std::min<size_t>( NUM_BINS - 1, static_cast<size_t>( ( coordinate - start ) * scale ) ); }
+
+	const vector<Vec3f>		&mCentroids;
+	int						mAxis;
+	float					mStart, mScale;
+	size_t					mLastBin;
+};
+
+// Partitions the triangles [begin, end) between two children, the first getting [begin, *split). Returns false if they're better off as a leaf.
+bool splitNode( BuildState *state, uint32_t begin, uint32_t end, const Bounds &bounds, const Bounds &centroidBounds, size_t depth, uint32_t *split )
+{
+	const uint32_t count = end - begin;
+	if( count == 1 )
+		return false;
+
+	const float area = bounds.calcArea();
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	size_t bestBin = 0;
+	for( int axis = 0; ( axis < 3 ) && ( depth < MAX_SAH_DEPTH ) && ( area > 0 ); ++axis ) {
+		const float start = centroidBounds.mMin[axis], extent = centroidBounds.mMax[axis] - start;
+		if( extent <= 0 )
+			continue;
+		const float scale = NUM_BINS / extent;
+		Bounds binBounds[NUM_BINS];
+		uint32_t binCounts[NUM_BINS] = { 0 };
+		for( uint32_t i = begin; i < end; ++i ) {
+			const uint32_t triangle = state->mOrder[i];
+			const size_t bin = InBins::calcBin( state->mCentroids[triangle][axis], start, scale );
+			++binCounts[bin];
+			binBounds[bin].include( state->mTriangleBounds[triangle] );
+		}
+
+		// the split after bin b puts bins [0, b] in the first child
+		float rightAreas[NUM_BINS - 1];
+		uint32_t rightCounts[NUM_BINS - 1];
+		Bounds right;
+		uint32_t rightCount = 0;
+		for( size_t b = NUM_BINS - 1; b > 0; --b ) {
+			right.include( binBounds[b] );
+			rightCount += binCounts[b];
+			rightAreas[b - 1] = right.calcArea();
+			rightCounts[b - 1] = rightCount;
+		}
+		Bounds left;
+		uint32_t leftCount = 0;
+		for( size_t b = 0; b < NUM_BINS - 1; ++b ) {
+			left.include( binBounds[b] );
+			leftCount += binCounts[b];
+			if( ( leftCount == 0 ) || ( rightCounts[b] == 0 ) )
+				continue;
+			const float cost = TRAVERSAL_COST + ( left.calcArea() * leftCount + rightAreas[b] * rightCounts[b] ) / area;
+			if( cost < bestCost ) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	if( ( count <= MAX_LEAF_TRIANGLES ) && ( count <= bestCost ) )
+		return false;
+
+	vector<uint32_t>::iterator first = state->mOrder.begin() + begin, last = state->mOrder.begin() + end;
+	if( bestAxis >= 0 ) {
+		const float start = centroidBounds.mMin[bestAxis];
+		*split = static_cast<uint32_t>( std::partition( first, last, InBins( state->mCentroids, bestAxis, start, NUM_BINS / ( centroidBounds.mMax[bestAxis] - start ), bestBin ) ) - state->mOrder.begin() );
+		return true;
+	}
+
+	// the leaf would be too large but no split was found, because the centroids coincide or the tree is too deep already
+	Vec3f extent = centroidBounds.mMax - centroidBounds.mMin;
+	const int axis = ( extent.x >= extent.y ) ? ( ( extent.x >= extent.z ) ? 0 : 2 ) : ( ( extent.y >= extent.z ) ? 1 : 2 );
+	*split = begin + count / 2;
+	std::nth_element( first, state->mOrder.begin() + *split, last, CentroidLess( state->mCentroids, axis ) );
+	return true;
+}
+
+// Appends the subtree over the triangles [begin, end) to \a nodes, depth first. Child indices count from the start of \a nodes, so a subtree
+// built into a separate vector on another thread only needs them offset when it's appended, and the tree doesn't depend on the number of threads.
+void buildSubtree( BuildState *state, uint32_t begin, uint32_t end, size_t depth, size_t parallelDepth, vector<Node> *nodes )
+{
+	Bounds bounds, centroidBounds;
+	for( uint32_t i = begin; i < end; ++i ) {
+		bounds.include( state->mTriangleBounds[state->mOrder[i]] );
+		centroidBounds.include( state->mCentroids[state->mOrder[i]] );
+	}
+
+	const size_t nodeIndex = nodes->size();
+	Node node;
+	node.mMin = bounds.mMin;
+	node.mMax = bounds.mMax;
+	uint32_t split;
+	if( ! splitNode( state, begin, end, bounds, centroidBounds, depth, &split ) ) {
+		node.mIndex = begin;
+		node.mNumTriangles = end - begin;
+		nodes->push_back( node );
+		return;
+	}
+
+	node.mNumTriangles = 0;
+	nodes->push_back( node );
+	if( ( parallelDepth > 0 ) && ( end - begin >= MIN_PARALLEL_TRIANGLES ) ) {
+		vector<Node> secondNodes;
+		boost::thread thread( boost::bind( buildSubtree, state, split, end, depth + 1, parallelDepth - 1, &secondNodes ) );
+		buildSubtree( state, begin, split, depth + 1, parallelDepth - 1, nodes );
+		thread.join();
+
+		const uint32_t offset = static_cast<uint32_t>( nodes->size() );
+		for( vector<Node>::iterator nodeIt = secondNodes.begin(); nodeIt != secondNodes.end(); ++nodeIt )
+			if( nodeIt->mNumTriangles == 0 )
+				nodeIt->mIndex += offset;
+		(*nodes)[nodeIndex].mIndex = offset;
+		nodes->insert( nodes->end(), secondNodes.begin(), secondNodes.end() );
+	}
+	else {
+		buildSubtree( state, begin, split, depth + 1, parallelDepth, nodes );
+		(*nodes)[nodeIndex].mIndex = static_cast<uint32_t>( nodes->size() );
+		buildSubtree( state, split, end, depth + 1, parallelDepth, nodes );
+	}
+}
+
+// Returns the distance along the ray at which it enters \a node, or a negative value if it misses it or enters beyond \a maxDistance. Bounds are taken
+// nearest first on each axis, by the sign of \a inverseDirection. A ray parallel to an axis that lies in one of the node's planes gives 0 * infinity there,
+// and the comparisons are ordered so that the NaN is ignored, treating the plane as inside.
+inline float intersectNode( const Node &node, const Vec3f &origin, const Vec3f &inverseDirection, float maxDistance )
+{
+	const bool negativeX = inverseDirection.x < 0, negativeY = inverseDirection.y < 0, negativeZ = inverseDirection.z < 0;
+	const float nearX = ( ( negativeX ? node.mMax.x : node.mMin.x ) - origin.x ) * inverseDirection.x, farX = ( ( negativeX ? node.mMin.x : node.mMax.x ) - origin.x ) * inverseDirection.x;
+	const float nearY = ( ( negativeY ? node.mMax.y : node.mMin.y ) - origin.y ) * inverseDirection.y, farY = ( ( negativeY ? node.mMin.y : node.mMax.y ) - origin.y ) * inverseDirection.y;
+	const float nearZ = ( ( negativeZ ? node.mMax.z : node.mMin.z ) - origin.z ) * inverseDirection.z, farZ = ( ( negativeZ ? node.mMin.z : node.mMax.z ) - origin.z ) * inverseDirection.z;
+	float enter = 0, exit = maxDistance;
+	enter = ( nearX > enter ) ? nearX : enter;
+	enter = ( nearY > enter ) ? nearY : enter;
+	enter = ( nearZ > enter ) ? nearZ : enter;
+	exit = ( farX < exit ) ? farX : exit;
+	exit = ( farY < exit ) ? farY : exit;
+	exit = ( farZ < exit ) ? farZ : exit;
+	return ( enter <= exit ) ? enter : -1.0f;
+}
+
+inline float calcDistanceSquared( const Node &node, const Vec3f &point )
+{
+	const float x = std::max( std::max( node.mMin.x - point.x, point.x - node.mMax.x ), 0.0f );
+	const float y = std::max( std::max( node.mMin.y - point.y, point.y - node.mMax.y ), 0.0f );
+	const float z = std::max( std::max( node.mMin.z - point.z, point.z - node.mMax.z ), 0.0f );
+	return x * x + y * y + z * z;
+}
+
+// Möller and Trumbore's "Fast, Minimum Storage Ray-Triangle Intersection", without backface culling. Degenerate triangles are never hit.
+inline bool intersectTriangle( const Ray &ray, const Vec3f *vertices, float maxDistance, float *distance, float *u, float *v )
+{
+	const Vec3f edge1 = vertices[1] - vertices[0], edge2 = vertices[2] - vertices[0];
+	const Vec3f p = ray.getDirection().cross( edge2 );
+	const float det = edge1.dot( p );
+	if( det == 0 )
+		return false;
+	const float inverseDet = 1.0f / det;
+
+	const Vec3f s = ray.getOrigin() - vertices[0];
+	const float hitU = s.dot( p ) * inverseDet;
+	if( ( hitU < 0 ) || ( hitU > 1 ) )
+		return false;
+	const Vec3f q = s.cross( edge1 );
+	const float hitV = ray.getDirection().dot( q ) * inverseDet;
+	if( ( hitV < 0 ) || ( hitU + hitV > 1 ) )
+		return false;
+	const float t = edge2.dot( q ) * inverseDet;
+	if( ( t < 0 ) || ( t > maxDistance ) )
+		return false;
+
+	*distance = t;
+	*u = hitU;
+	*v = hitV;
+	return true;
+}
+
+// From Ericson's "Real-Time Collision Detection", which finds the closest point by which of the triangle's Voronoi regions \a point lies in
+Vec3f calcClosestPointOnTriangle( const Vec3f &point, const Vec3f *vertices, float *u, float *v )
+{
+	const Vec3f &a = vertices[0], &b = vertices[1], &c = vertices[2];
+	const Vec3f ab = b - a, ac = c - a, ap = point - a;
+	const float d1 = ab.dot( ap ), d2 = ac.dot( ap );
+	if( ( d1 <= 0 ) && ( d2 <= 0 ) ) {
+		*u = 0; *v = 0;
+		return a;
+	}
+
+	const Vec3f bp = point - b;
+	const float d3 = ab.dot( bp ), d4 = ac.dot( bp );
+	if( ( d3 >= 0 ) && ( d4 <= d3 ) ) {
+		*u = 1; *v = 0;
+		return b;
+	}
+
+	const float vc = d1 * d4 - d3 * d2;
+	if( ( vc <= 0 ) && ( d1 >= 0 ) && ( d3 <= 0 ) ) {
+		*u = d1 / ( d1 - d3 ); *v = 0;
+		return a + ab * *u;
+	}
+
+	const Vec3f cp = point - c;
+	const float d5 = ab.dot( cp ), d6 = ac.dot( cp );
+	if( ( d6 >= 0 ) && ( d5 <= d6 ) ) {
+		*u = 0; *v = 1;
+		return c;
+	}
+
+	const float vb = d5 * d2 - d1 * d6;
+	if( ( vb <= 0 ) && ( d2 >= 0 ) && ( d6 <= 0 ) ) {
+		*u = 0; *v = d2 / ( d2 - d6 );
+		return a + ac * *v;
+	}
+
+	const float va = d3 * d6 - d5 * d4;
+	if( ( va <= 0 ) && ( d4 - d3 >= 0 ) && ( d5 - d6 >= 0 ) ) {
+		*v = ( d4 - d3 ) / ( ( d4 - d3 ) + ( d5 - d6 ) ); *u = 1 - *v;
+		return b + ( c - b ) * *v;
+	}
+
+	// a degenerate triangle can fall through every edge test
+	const float sum = va + vb + vc;
+	if( sum <= 0 ) {
+		*u = 0; *v = 0;
+		return a;
+	}
+	*u = vb / sum; *v = vc / sum;
+	return a + ab * *u + ac * *v;
+}
+
+} // anonymous namespace
+
+struct TriMeshBvh::Obj {
+	// Visits each leaf \a ray enters within \a *maxDistance, nearer nodes first. \a visitLeaf( first, count, maxDistance ) may shorten \a *maxDistance
+	// to skip what lies beyond, and returns true to end the traversal.
+	template<typename LeafVisitor>
+	void	traverse( const Ray &ray, float *maxDistance, LeafVisitor &visitLeaf ) const
+	{
+		if( mNodes.empty() )
+			return;
+		const Vec3f &origin = ray.getOrigin(), &inverseDirection = ray.getInverseDirection();
+		if( intersectNode( mNodes[0], origin, inverseDirection, *maxDistance ) < 0 )
+			return;
+
+		uint32_t stack[STACK_SIZE];
+		float stackDistances[STACK_SIZE];
+		size_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+		while( true ) {
+			const Node &node = mNodes[nodeIndex];
+			if( node.mNumTriangles ) {
+				if( visitLeaf( node.mIndex, node.mNumTriangles, maxDistance ) )
+					return;
+			}
+			else {
+				const uint32_t first = nodeIndex + 1, second = node.mIndex;
+				const float firstDistance = intersectNode( mNodes[first], origin, inverseDirection, *maxDistance );
+				const float secondDistance = intersectNode( mNodes[second], origin, inverseDirection, *maxDistance );
+				if( ( firstDistance >= 0 ) && ( secondDistance >= 0 ) ) {
+					const bool firstNearer = firstDistance <= secondDistance;
+					stack[stackSize] = firstNearer ? second : first;
+					stackDistances[stackSize++] = firstNearer ? secondDistance : firstDistance;
+					nodeIndex = firstNearer ? first : second;
+					continue;
+				}
+				else if( firstDistance >= 0 || secondDistance >= 0 ) {
+					nodeIndex = ( firstDistance >= 0 ) ? first : second;
+					continue;
+				}
+			}
+
+			// nodes entered beyond a hit found since they were pushed can be skipped
+			do {
+				if( stackSize == 0 )
+					return;
+				nodeIndex = stack[--stackSize];
+			} while( stackDistances[stackSize] > *maxDistance );
+		}
+	}
+
+	vector<Node>		mNodes;
+	// each triangle's three vertices, in leaf order
+	vector<Vec3f>		mVertices;
+	// the index in the source mesh of each triangle, in leaf order
+	vector<uint32_t>	mTriangles;
+};
+
+namespace {
+
+struct FirstHit {
+	FirstHit( const vector<Vec3f> &vertices, const Ray &ray ) : mVertices( vertices ), mRay( ray ), mFound( false ) {}
+
+	bool operator()( uint32_t first, uint32_t count, float *maxDistance )
+	{
+		for( uint32_t t = first; t < first + count; ++t ) {
+			if( intersectTriangle( mRay, &mVertices[t * 3], *maxDistance, maxDistance, &mU, &mV ) ) {
+				mTriangle = t;
+				mFound = true;
+			}
+		}
+		return false;
+	}
+
+	const vector<Vec3f>		&mVertices;
+	const Ray				&mRay;
+	bool					mFound;
+	uint32_t				mTriangle;
+	float					mU, mV;
+};
+
+struct AnyHit {
+	AnyHit( const vector<Vec3f> &vertices, const Ray &ray ) : mVertices( vertices ), mRay( ray ), mFound( false ) {}
+
+	bool operator()( uint32_t first, uint32_t count, float *maxDistance )
+	{
+		float distance, u, v;
+		for( uint32_t t = first; t < first + count; ++t )
+			if( intersectTriangle( mRay, &mVertices[t * 3], *maxDistance, &distance, &u, &v ) )
+				return mFound = true;
+		return false;
+	}
+
+	const vector<Vec3f>		&mVertices;
+	const Ray				&mRay;
+	bool					mFound;
+};
+
+struct AllHits {
+	AllHits( const vector<Vec3f> &vertices, const vector<uint32_t> &triangles, const Ray &ray, vector<TriMeshBvh::Hit> *hits )
+		: mVertices( vertices ), mTriangles( triangles ), mRay( ray ), mHits( hits ) {}
+
+	bool operator()( uint32_t first, uint32_t count, float *maxDistance )
+	{
+		TriMeshBvh::Hit hit;
+		for( uint32_t t = first; t < first + count; ++t ) {
+			if( intersectTriangle( mRay, &mVertices[t * 3], *maxDistance, &hit.mDistance, &hit.mU, &hit.mV ) ) {
+				hit.mTriangle = mTriangles[t];
+				hit.mPosition = mRay.calcPosition( hit.mDistance );
+				mHits->push_back( hit );
+			}
+		}
+		return false;
+	}
+
+	const vector<Vec3f>			&mVertices;
+	const vector<uint32_t>		&mTriangles;
+	const Ray					&mRay;
+	vector<TriMeshBvh::Hit>		*mHits;
+};
+
+bool hitDistanceLess( const TriMeshBvh::Hit &a, const TriMeshBvh::Hit &b )
+{
+	return a.mDistance < b.mDistance;
+}
+
+void calcTriangleBounds( const TriMesh *mesh, BuildState *state, size_t begin, size_t end )
+{
+	const vector<Vec3f> &vertices = mesh->getVertices();
+	const vector<uint32_t> &indices = mesh->getIndices();
+	for( size_t t = begin; t < end; ++t ) {
+		Bounds &bounds = state->mTriangleBounds[t];
+		bounds.include( vertices[indices[t * 3]] );
+		bounds.include( vertices[indices[t * 3 + 1]] );
+		bounds.include( vertices[indices[t * 3 + 2]] );
+		state->mCentroids[t] = ( bounds.mMin + bounds.mMax ) * 0.5f;
+	}
+}
+
+} // anonymous namespace
+
+TriMeshBvh::TriMeshBvh( const TriMesh &mesh, bool parallel )
+	: mObj( new Obj )
+{
+	const size_t numTriangles = mesh.getNumTriangles();
+	if( numTriangles == 0 )
+		return;
+
+	BuildState state;
+	state.mTriangleBounds.resize( numTriangles );
+	state.mCentroids.resize( numTriangles );
+	state.mOrder.resize( numTriangles );
+	for( size_t t = 0; t < numTriangles; ++t )
+		state.mOrder[t] = static_cast<uint32_t>( t );
+
+	// each split can hand one of its halves to another thread, so this many levels of them keep every core busy
+	size_t parallelDepth = 0;
+	const size_t numThreads = parallel ? std::max<size_t>( 1, boost::thread::hardware_concurrency() ) : 1;
+	while( ( size_t( 1 ) << parallelDepth ) < numThreads )
+		++parallelDepth;
+	if( parallelDepth > 0 && numTriangles >= MIN_PARALLEL_TRIANGLES ) {
+		boost::thread_group threads;
+		for( size_t r = 0; r < numThreads; ++r )
+			threads.create_thread( boost::bind( calcTriangleBounds, &mesh, &state, numTriangles * r / numThreads, numTriangles * ( r + 1 ) / numThreads ) );
+		threads.join_all();
+	}
+	else
+		calcTriangleBounds( &mesh, &state, 0, numTriangles );
+
+	mObj->mNodes.reserve( numTriangles * 2 / MAX_LEAF_TRIANGLES );
+	buildSubtree( &state, 0, static_cast<uint32_t>( numTriangles ), 0, parallelDepth, &mObj->mNodes );
+
+	// copied in leaf order, so that each leaf's triangles are contiguous
+	const vector<Vec3f> &vertices = mesh.getVertices();
+	const vector<uint32_t> &indices = mesh.getIndices();
+	mObj->mVertices.resize( numTriangles * 3 );
+	for( size_t i = 0; i < numTriangles; ++i ) {
+		const uint32_t triangle = state.mOrder[i];
+		for( size_t v = 0; v < 3; ++v )
+			mObj->mVertices[i * 3 + v] = vertices[indices[triangle * 3 + v]];
+	}
+	mObj->mTriangles.swap( state.mOrder );
+}
+
+bool TriMeshBvh::intersect( const Ray &ray, Hit *result, float maxDistance ) const
+{
+	FirstHit firstHit( mObj->mVertices, ray );
+	mObj->traverse( ray, &maxDistance, firstHit );
+	if( ! firstHit.mFound )
+		return false;
+
+	result->mTriangle = mObj->mTriangles[firstHit.mTriangle];
+	result->mDistance = maxDistance;
+	result->mU = firstHit.mU;
+	result->mV = firstHit.mV;
+	result->mPosition = ray.calcPosition( maxDistance );
+	return true;
+}
+
+bool TriMeshBvh::intersects( const Ray &ray, float maxDistance ) const
+{
+	AnyHit anyHit( mObj->mVertices, ray );
+	mObj->traverse( ray, &maxDistance, anyHit );
+	return anyHit.mFound;
+}
+
+size_t TriMeshBvh::intersectAll( const Ray &ray, vector<Hit> *result, float maxDistance ) const
+{
+	result->clear();
+	AllHits allHits( mObj->mVertices, mObj->mTriangles, ray, result );
+	mObj->traverse( ray, &maxDistance, allHits );
+	std::sort( result->begin(), result->end(), hitDistanceLess );
+	return result->size();
+}
+
+bool TriMeshBvh::calcClosestPoint( const Vec3f &point, Hit *result, float maxDistance ) const
+{
+	const vector<Node> &nodes = mObj->mNodes;
+	float bestDistanceSquared = ( maxDistance < std::sqrt( std::numeric_limits<float>::max() ) ) ? maxDistance * maxDistance : std::numeric_limits<float>::max();
+	if( nodes.empty() || ( calcDistanceSquared( nodes[0], point ) > bestDistanceSquared ) )
+		return false;
+
+	bool found = false;
+	uint32_t stack[STACK_SIZE];
+	float stackDistances[STACK_SIZE];
+	size_t stackSize = 0;
+	uint32_t nodeIndex = 0;
+	while( true ) {
+		const Node &node = nodes[nodeIndex];
+		if( node.mNumTriangles ) {
+			for( uint32_t t = node.mIndex; t < node.mIndex + node.mNumTriangles; ++t ) {
+				float u, v;
+				const Vec3f closest = calcClosestPointOnTriangle( point, &mObj->mVertices[t * 3], &u, &v );
+				const float distanceSquared = closest.distanceSquared( point );
+				if( distanceSquared <= bestDistanceSquared ) {
+					bestDistanceSquared = distanceSquared;
+					result->mTriangle = mObj->mTriangles[t];
+					result->mU = u;
+					result->mV = v;
+					result->mPosition = closest;
+					found = true;
+				}
+			}
+		}
+		else {
+			const uint32_t first = nodeIndex + 1, second = node.mIndex;
+			const float firstDistance = calcDistanceSquared( nodes[first], point ), secondDistance = calcDistanceSquared( nodes[second], point );
+			const bool firstNearer = firstDistance <= secondDistance;
+			const float nearDistance = firstNearer ? firstDistance : secondDistance, farDistance = firstNearer ? secondDistance : firstDistance;
+			if( nearDistance <= bestDistanceSquared ) {
+				if( farDistance <= bestDistanceSquared ) {
+					stack[stackSize] = firstNearer ? second : first;
+					stackDistances[stackSize++] = farDistance;
+				}
+				nodeIndex = firstNearer ? first : second;
+				continue;
+			}
+		}
+
+		do {
+			if( stackSize == 0 ) {
+				if( found )
+					result->mDistance = std::sqrt( bestDistanceSquared );
+				return found;
+			}
+			nodeIndex = stack[--stackSize];
+		} while( stackDistances[stackSize] > bestDistanceSquared );
+	}
+}
+
+size_t TriMeshBvh::getNumTriangles() const
+{
+	return mObj->mTriangles.size();
+}
+
+size_t TriMeshBvh::getNumNodes() const
+{
+	return mObj->mNodes.size();
+}
+
+AxisAlignedBox3f TriMeshBvh::getBoundingBox() const
+{
+	if( mObj->mNodes.empty() )
+		return AxisAlignedBox3f( Vec3f::zero(), Vec3f::zero() );
+	return AxisAlignedBox3f( mObj->mNodes[0].mMin, mObj->mNodes[0].mMax );
+}
+
+} // namespace cinder
@@ -0,0 +1,731 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/TriMeshSimplifier.h"
+#include "cinder/CinderMath.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::vector;
+
+namespace cinder {
+
+namespace {
+
+const uint32_t NONE = 0xFFFFFFFF;
+const uint32_t MULTIPLE = 0xFFFFFFFE;
+// weight of the quadrics that hold borders and seams in place, relative to those of the faces
+const double EDGE_WEIGHT = 10.0;
+// a collapse is rejected if it turns any triangle by more than about 75 degrees, or more than 90 degrees from where it started
+const float MIN_NORMAL_COSINE = 0.25f;
+
+// each pass considers at least this fraction of its candidates, so that passes near the target don't dwindle to a few collapses
+const size_t MIN_PASS_DIVISOR = 16;
+
+enum VertexKind { KIND_MANIFOLD, KIND_BORDER, KIND_SEAM, KIND_LOCKED };
+
+bool isVertex( uint32_t index )
+{
+	return index < MULTIPLE;
+}
+
+uint64_t hashBits( uint64_t h )
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+size_t tableCapacity( size_t numElements )
+{
+	size_t capacity = 16;
+	while( capacity < numElements * 2 )
+		capacity *= 2;
+	return capacity;
+}
+
+// Returns, for each vertex, the first vertex with exactly the same position
+vector<uint32_t> weldPositions( const vector<Vec3f> &positions )
+{
+	vector<uint32_t> result( positions.size() );
+	vector<uint32_t> table( tableCapacity( positions.size() ), NONE );
+	const size_t mask = table.size() - 1;
+	for( size_t v = 0; v < positions.size(); ++v ) {
+		// adding 0 turns -0 into 0, so that positions which compare equal also hash equally
+		float coords[3] = { positions[v].x + 0.0f, positions[v].y + 0.0f, positions[v].z + 0.0f };
+		uint32_t bits[3];
+		memcpy( bits, coords, sizeof(bits) );
+		size_t slot = static_cast<size_t>( hashBits( ( (uint64_t)bits[0] << 32 | bits[1] ) ^ ( (uint64_t)bits[2] * 0x9e3779b97f4a7c15ULL ) ) ) & mask;
+		while( ( table[slot] != NONE ) && ( positions[table[slot]] != positions[v] ) )
+			slot = ( slot + 1 ) & mask;
+		if( table[slot] == NONE )
+			table[slot] = static_cast<uint32_t>( v );
+		result[v] = table[slot];
+	}
+
+	return result;
+}
+
+// A set of directed edges, using open addressing
+class EdgeSet {
+  public:
+	EdgeSet( size_t numEdges )
+		: mKeys( tableCapacity( numEdges ), ~0ULL ), mMask( mKeys.size() - 1 )
+	{}
+
+	//! Returns false if the edge from \a a to \a b was already present
+	bool insert( uint32_t a, uint32_t b )
+	{
+		const uint64_t key = (uint64_t)a << 32 | b;
+		size_t slot = find( key );
+		if( mKeys[slot] == key )
+			return false;
+		mKeys[slot] = key;
+		return true;
+	}
+	bool contains( uint32_t a, uint32_t b ) const
+	{
+		const uint64_t key = (uint64_t)a << 32 | b;
+		return mKeys[find( key )] == key;
+	}
+
+  private:
+	size_t find( uint64_t key ) const
+	{
+		size_t slot = static_cast<size_t>( hashBits( key ) ) & mMask;
+		while( ( mKeys[slot] != ~0ULL ) && ( mKeys[slot] != key ) )
+			slot = ( slot + 1 ) & mMask;
+		return slot;
+	}
+
+	vector<uint64_t>	mKeys;
+	size_t				mMask;
+};
+
+// A symmetric 4x4 matrix accumulated from weighted planes. Dividing by the total weight turns its error into a mean squared distance.
+struct Quadric {
+	Quadric() : mA00( 0 ), mA01( 0 ), mA02( 0 ), mA11( 0 ), mA12( 0 ), mA22( 0 ), mB0( 0 ), mB1( 0 ), mB2( 0 ), mC( 0 ), mWeight( 0 ) {}
+
+	void addPlane( const Vec3d &normal, double distance, double weight )
+	{
+		mA00 += weight * normal.x * normal.x;
+		mA01 += weight * normal.x * normal.y;
+		mA02 += weight * normal.x * normal.z;
+		mA11 += weight * normal.y * normal.y;
+		mA12 += weight * normal.y * normal.z;
+		mA22 += weight * normal.z * normal.z;
+		mB0 += weight * normal.x * distance;
+		mB1 += weight * normal.y * distance;
+		mB2 += weight * normal.z * distance;
+		mC += weight * distance * distance;
+		mWeight += weight;
+	}
+
+	Quadric& operator+=( const Quadric &rhs )
+	{
+		mA00 += rhs.mA00; mA01 += rhs.mA01; mA02 += rhs.mA02; mA11 += rhs.mA11; mA12 += rhs.mA12; mA22 += rhs.mA22;
+		mB0 += rhs.mB0; mB1 += rhs.mB1; mB2 += rhs.mB2;
+		mC += rhs.mC;
+		mWeight += rhs.mWeight;
+		return *this;
+	}
+
+	//! Returns the error of moving to \a p the vertices of both \a a and \a b
+	static double calcError( const Quadric &a, const Quadric &b, const Vec3f &p )
+	{
+		const double weight = a.mWeight + b.mWeight;
+		if( weight <= 0 )
+			return 0;
+		const double x = p.x, y = p.y, z = p.z;
+		const double error = ( a.mA00 + b.mA00 ) * x * x + ( a.mA11 + b.mA11 ) * y * y + ( a.mA22 + b.mA22 ) * z * z
+			+ 2 * ( ( a.mA01 + b.mA01 ) * x * y + ( a.mA02 + b.mA02 ) * x * z + ( a.mA12 + b.mA12 ) * y * z )
+			+ 2 * ( ( a.mB0 + b.mB0 ) * x + ( a.mB1 + b.mB1 ) * y + ( a.mB2 + b.mB2 ) * z ) + a.mC + b.mC;
+		return std::max( error, 0.0 ) / weight;
+	}
+
+	double	mA00, mA01, mA02, mA11, mA12, mA22;
+	double	mB0, mB1, mB2;
+	double	mC;
+	double	mWeight;
+};
+
+// A vertex's cheapest collapse
+struct Collapse {
+	Collapse( float cost, uint32_t vertex, uint32_t target )
+		: mCost( cost ), mVertex( vertex ), mTarget( target )
+	{}
+
+	// the heap functions build a max-heap, so this is reversed
+	bool operator<( const Collapse &rhs ) const { return mCost > rhs.mCost; }
+
+	float		mCost;
+	uint32_t	mVertex, mTarget;
+};
+
+} // anonymous namespace
+
+struct TriMeshSimplifier::Obj {
+	Obj( const TriMesh &mesh );
+
+	void		classifyVertices( const EdgeSet &edges, const EdgeSet &positionEdges, const vector<uint8_t> &nonManifold );
+	void		computeQuadrics( const EdgeSet &edges );
+	void		buildAdjacency();
+	bool		collapsePass( size_t targetTriangles, double maxErrorSquared );
+	void		gatherCollapses( uint32_t vertex, vector<Collapse> *result ) const;
+	bool		findCollapse( uint32_t vertex, Collapse *result );
+	size_t		findValidCollapse( uint32_t vertex, double maxCostSquared, Collapse *result );
+	bool		canCollapseKinds( uint32_t vertex, uint32_t target ) const;
+	uint32_t	findSeamTarget( uint32_t vertex, uint32_t target ) const;
+	size_t		countValidCollapse( uint32_t position, uint32_t targetPosition );
+	void		gatherNeighbors( uint32_t position, vector<uint32_t> *result ) const;
+	bool		getCorners( uint32_t triangle, uint32_t corners[3] ) const;
+	void		collapse( uint32_t vertex, uint32_t target );
+	void		relinkOpenEdges( uint32_t vertex, uint32_t target );
+	void		removeCollapsedTriangles();
+
+	TriMesh						mSource;
+	vector<uint32_t>			mIndices;
+	// each triangle's normal in the source mesh
+	vector<Vec3f>				mSourceNormals;
+	size_t						mNumTriangles;
+	double						mError;
+
+	// per vertex: the first vertex at the same position, which stands for the position, and a circular list of the others there
+	vector<uint32_t>			mRemap, mWedges;
+	// per vertex: its neighbor across its one open edge in each direction, or NONE or MULTIPLE. Open edges are borders or seams.
+	vector<uint32_t>			mOpenIn, mOpenOut;
+	vector<uint8_t>				mKinds, mCollapsed;
+	vector<uint32_t>			mCollapseTargets;
+
+	// per position
+	vector<Quadric>				mQuadrics;
+	// each position's triangles, rebuilt for every pass
+	vector<uint32_t>			mFirstTriangles, mPositionTriangles;
+	// positions that have been collapsed or collapsed onto during the current pass
+	vector<uint8_t>				mLocked;
+
+	vector<Collapse>			mHeap, mCandidates;
+	vector<float>				mCosts;
+	vector<uint32_t>			mNeighbors, mTargetNeighbors;
+};
+
+TriMeshSimplifier::Obj::Obj( const TriMesh &mesh )
+	: mSource( mesh ), mIndices( mesh.getIndices() ), mError( 0 )
+{
+	const vector<Vec3f> &positions = mSource.getVertices();
+	const size_t numVertices = positions.size();
+	mIndices.resize( mIndices.size() / 3 * 3 );
+
+	mRemap = weldPositions( positions );
+	mWedges.resize( numVertices );
+	for( size_t v = 0; v < numVertices; ++v )
+		mWedges[v] = static_cast<uint32_t>( v );
+	for( size_t v = 0; v < numVertices; ++v ) {
+		if( mRemap[v] != v ) {
+			mWedges[v] = mWedges[mRemap[v]];
+			mWedges[mRemap[v]] = static_cast<uint32_t>( v );
+		}
+	}
+
+	// triangles that are degenerate in position would confuse everything below, so they're dropped up front
+	mCollapsed.assign( numVertices, 0 );
+	mSourceNormals.resize( mIndices.size() / 3 );
+	removeCollapsedTriangles();
+	// checking each collapse only against the previous shape would let triangles turn over a little at a time
+	for( size_t t = 0; t < mNumTriangles; ++t ) {
+		const Vec3f &p0 = positions[mIndices[t*3]], &p1 = positions[mIndices[t*3+1]], &p2 = positions[mIndices[t*3+2]];
+		mSourceNormals[t] = ( p1 - p0 ).cross( p2 - p0 );
+	}
+
+	// a directed edge used twice means the surface isn't a consistently oriented manifold there
+	EdgeSet edges( mIndices.size() ), positionEdges( mIndices.size() );
+	vector<uint8_t> nonManifold( numVertices, 0 );
+	for( size_t t = 0; t < mNumTriangles; ++t ) {
+		for( int k = 0; k < 3; ++k ) {
+			const uint32_t a = mIndices[t*3+k], b = mIndices[t*3+(k+1)%3];
+			edges.insert( a, b );
+			if( ! positionEdges.insert( mRemap[a], mRemap[b] ) )
+				nonManifold[mRemap[a]] = nonManifold[mRemap[b]] = 1;
+		}
+	}
+
+	classifyVertices( edges, positionEdges, nonManifold );
+	computeQuadrics( edges );
+	mCollapseTargets.assign( numVertices, NONE );
+}
+
+void TriMeshSimplifier::Obj::classifyVertices( const EdgeSet &edges, const EdgeSet &positionEdges, const vector<uint8_t> &nonManifold )
+{
+	const size_t numVertices = mRemap.size();
+	mOpenIn.assign( numVertices, NONE );
+	mOpenOut.assign( numVertices, NONE );
+	for( size_t i = 0; i < mIndices.size(); ++i ) {
+		const uint32_t a = mIndices[i], b = mIndices[i % 3 == 2 ? i - 2 : i + 1];
+		if( ! edges.contains( b, a ) ) {
+			mOpenOut[a] = ( mOpenOut[a] == NONE ) ? b : MULTIPLE;
+			mOpenIn[b] = ( mOpenIn[b] == NONE ) ? a : MULTIPLE;
+		}
+	}
+
+	mKinds.assign( numVertices, KIND_LOCKED );
+	for( size_t v = 0; v < numVertices; ++v ) {
+		if( ( mRemap[v] != v ) || nonManifold[v] )
+			continue;
+
+		const uint32_t position = static_cast<uint32_t>( v ), in = mOpenIn[v], out = mOpenOut[v];
+		uint8_t kind = KIND_LOCKED;
+		if( mWedges[v] == v ) {
+			if( ( in == NONE ) && ( out == NONE ) )
+				kind = KIND_MANIFOLD;
+			// a border has to be open in position too, rather than being the end of a seam
+			else if( isVertex( in ) && isVertex( out ) && ( in != out )
+					&& ( ! positionEdges.contains( mRemap[out], position ) ) && ( ! positionEdges.contains( position, mRemap[in] ) ) )
+				kind = KIND_BORDER;
+		}
+		else if( mWedges[mWedges[v]] == v ) {
+			// the two sides of a seam have to mirror each other, and be closed in position
+			const uint32_t w = mWedges[v];
+			if( isVertex( in ) && isVertex( out ) && isVertex( mOpenIn[w] ) && isVertex( mOpenOut[w] ) && ( in != out )
+					&& ( mRemap[out] == mRemap[mOpenIn[w]] ) && ( mRemap[in] == mRemap[mOpenOut[w]] )
+					&& positionEdges.contains( mRemap[out], position ) && positionEdges.contains( position, mRemap[in] ) )
+				kind = KIND_SEAM;
+		}
+
+		uint32_t w = position;
+		do {
+			mKinds[w] = kind;
+			w = mWedges[w];
+		} while( w != position );
+	}
+}
+
+void TriMeshSimplifier::Obj::computeQuadrics( const EdgeSet &edges )
+{
+	const vector<Vec3f> &positions = mSource.getVertices();
+	mQuadrics.resize( positions.size() );
+	for( size_t t = 0; t < mNumTriangles; ++t ) {
+		const Vec3d p[3] = { positions[mIndices[t*3]], positions[mIndices[t*3+1]], positions[mIndices[t*3+2]] };
+		Vec3d normal = ( p[1] - p[0] ).cross( p[2] - p[0] );
+		const double length = normal.length();
+		if( length <= 0 )
+			continue;
+		normal /= length;
+		for( int k = 0; k < 3; ++k )
+			mQuadrics[mRemap[mIndices[t*3+k]]].addPlane( normal, -normal.dot( p[0] ), length / 2 );
+
+		// borders and seams also get a plane through each of their edges, perpendicular to the face
+		for( int k = 0; k < 3; ++k ) {
+			const uint32_t a = mIndices[t*3+k], b = mIndices[t*3+(k+1)%3];
+			if( edges.contains( b, a ) )
+				continue;
+			const Vec3d edge = p[(k+1)%3] - p[k];
+			Vec3d edgeNormal = edge.cross( normal );
+			const double edgeLength = edgeNormal.length();
+			if( edgeLength <= 0 )
+				continue;
+			edgeNormal /= edgeLength;
+			const double distance = -edgeNormal.dot( p[k] );
+			mQuadrics[mRemap[a]].addPlane( edgeNormal, distance, EDGE_WEIGHT * edgeLength * edgeLength );
+			mQuadrics[mRemap[b]].addPlane( edgeNormal, distance, EDGE_WEIGHT * edgeLength * edgeLength );
+		}
+	}
+}
+
+// Lists each position's triangles contiguously, in a single array
+void TriMeshSimplifier::Obj::buildAdjacency()
+{
+	mFirstTriangles.assign( mRemap.size() + 1, 0 );
+	for( size_t i = 0; i < mIndices.size(); ++i )
+		++mFirstTriangles[mRemap[mIndices[i]] + 1];
+	for( size_t v = 0; v < mRemap.size(); ++v )
+		mFirstTriangles[v + 1] += mFirstTriangles[v];
+
+	mPositionTriangles.resize( mIndices.size() );
+	vector<uint32_t> &fill = mNeighbors;
+	fill.assign( mFirstTriangles.begin(), mFirstTriangles.end() - 1 );
+	for( size_t i = 0; i < mIndices.size(); ++i )
+		mPositionTriangles[fill[mRemap[mIndices[i]]]++] = static_cast<uint32_t>( i / 3 );
+}
+
+// Interior vertices can collapse onto any neighbor, but borders and seams only along themselves
+bool TriMeshSimplifier::Obj::canCollapseKinds( uint32_t vertex, uint32_t target ) const
+{
+	switch( mKinds[vertex] ) {
+		case KIND_MANIFOLD:
+			return true;
+		case KIND_BORDER:
+			return ( mKinds[target] == KIND_BORDER ) || ( mKinds[target] == KIND_LOCKED );
+		case KIND_SEAM:
+			return ( ( mKinds[target] == KIND_SEAM ) || ( mKinds[target] == KIND_LOCKED ) ) && ( findSeamTarget( vertex, target ) != NONE );
+		default:
+			return false;
+	}
+}
+
+// Returns where the other side of a seam goes when \a vertex collapses onto \a target
+uint32_t TriMeshSimplifier::Obj::findSeamTarget( uint32_t vertex, uint32_t target ) const
+{
+	const uint32_t sibling = mWedges[vertex];
+	uint32_t result = NONE;
+	if( target == mOpenOut[vertex] )
+		result = mOpenIn[sibling];
+	else if( target == mOpenIn[vertex] )
+		result = mOpenOut[sibling];
+
+	return ( isVertex( result ) && ( mRemap[result] == mRemap[target] ) ) ? result : NONE;
+}
+
+// Returns \a triangle's corners as of the collapses so far in this pass, or false if they have left it degenerate
+bool TriMeshSimplifier::Obj::getCorners( uint32_t triangle, uint32_t corners[3] ) const
+{
+	for( int k = 0; k < 3; ++k ) {
+		corners[k] = mIndices[triangle * 3 + k];
+		if( mCollapsed[corners[k]] )
+			corners[k] = mCollapseTargets[corners[k]];
+	}
+
+	return ( mRemap[corners[0]] != mRemap[corners[1]] ) && ( mRemap[corners[1]] != mRemap[corners[2]] ) && ( mRemap[corners[2]] != mRemap[corners[0]] );
+}
+
+// Only valid for positions that haven't been locked in this pass, whose lists of triangles are still complete
+void TriMeshSimplifier::Obj::gatherNeighbors( uint32_t position, vector<uint32_t> *result ) const
+{
+	result->clear();
+	uint32_t corners[3];
+	for( uint32_t i = mFirstTriangles[position]; i < mFirstTriangles[position + 1]; ++i ) {
+		if( ! getCorners( mPositionTriangles[i], corners ) )
+			continue;
+		for( int k = 0; k < 3; ++k ) {
+			if( mRemap[corners[k]] != position )
+				result->push_back( mRemap[corners[k]] );
+		}
+	}
+	std::sort( result->begin(), result->end() );
+	result->erase( std::unique( result->begin(), result->end() ), result->end() );
+}
+
+// Lists the collapses \a vertex could make, as of the collapses so far in this pass, leaving their effect on the topology to be checked
+void TriMeshSimplifier::Obj::gatherCollapses( uint32_t vertex, vector<Collapse> *result ) const
+{
+	const uint32_t position = mRemap[vertex];
+	const vector<Vec3f> &positions = mSource.getVertices();
+	result->clear();
+	if( mKinds[vertex] == KIND_MANIFOLD ) {
+		// a manifold vertex is its position's only vertex, so the triangles' corners are the candidates
+		uint32_t corners[3];
+		for( uint32_t i = mFirstTriangles[position]; i < mFirstTriangles[position + 1]; ++i ) {
+			if( ! getCorners( mPositionTriangles[i], corners ) )
+				continue;
+			for( int k = 0; k < 3; ++k ) {
+				if( corners[k] != vertex )
+					result->push_back( Collapse( (float)Quadric::calcError( mQuadrics[position], mQuadrics[mRemap[corners[k]]], positions[corners[k]] ), vertex, corners[k] ) );
+			}
+		}
+	}
+	else if( ( mKinds[vertex] == KIND_BORDER ) || ( mKinds[vertex] == KIND_SEAM ) ) {
+		const uint32_t candidates[2] = { mOpenIn[vertex], mOpenOut[vertex] };
+		for( int c = 0; c < 2; ++c ) {
+			if( isVertex( candidates[c] ) && ( candidates[0] != candidates[1] ) && canCollapseKinds( vertex, candidates[c] ) )
+				result->push_back( Collapse( (float)Quadric::calcError( mQuadrics[position], mQuadrics[mRemap[candidates[c]]], positions[candidates[c]] ), vertex, candidates[c] ) );
+		}
+	}
+}
+
+// Finds the cheapest collapse of \a vertex
+bool TriMeshSimplifier::Obj::findCollapse( uint32_t vertex, Collapse *result )
+{
+	gatherCollapses( vertex, &mCandidates );
+	if( mCandidates.empty() )
+		return false;
+
+	// the heap's order is reversed, so its greatest element is the cheapest
+	*result = *std::max_element( mCandidates.begin(), mCandidates.end() );
+	return true;
+}
+
+// Finds the cheapest valid collapse of \a vertex costing at most \a maxCostSquared, for when its cheapest one turns out to be invalid.
+// Without this, a vertex whose neighbors all cost the same, as on a flat surface, could keep picking the same invalid collapse.
+size_t TriMeshSimplifier::Obj::findValidCollapse( uint32_t vertex, double maxCostSquared, Collapse *result )
+{
+	gatherCollapses( vertex, &mCandidates );
+	std::sort( mCandidates.begin(), mCandidates.end() );
+	for( vector<Collapse>::reverse_iterator candidate = mCandidates.rbegin(); ( candidate != mCandidates.rend() ) && ( candidate->mCost <= maxCostSquared ); ++candidate ) {
+		const uint32_t targetPosition = mRemap[candidate->mTarget];
+		if( mLocked[targetPosition] )
+			continue;
+		const size_t removed = countValidCollapse( mRemap[vertex], targetPosition );
+		if( removed > 0 ) {
+			*result = *candidate;
+			return removed;
+		}
+	}
+
+	return 0;
+}
+
+// Checks that moving \a position onto \a targetPosition keeps the mesh manifold and doesn't fold any triangle over. Returns the
+// number of triangles the collapse would remove, or 0 if it's invalid.
+size_t TriMeshSimplifier::Obj::countValidCollapse( uint32_t position, uint32_t targetPosition )
+{
+	const vector<Vec3f> &positions = mSource.getVertices();
+	const Vec3f &newPosition = positions[targetPosition];
+	size_t sharedTriangles = 0;
+	uint32_t corners[3];
+	for( uint32_t i = mFirstTriangles[position]; i < mFirstTriangles[position + 1]; ++i ) {
+		const uint32_t t = mPositionTriangles[i];
+		if( ! getCorners( t, corners ) )
+			continue;
+		Vec3f p[3], moved[3];
+		bool shared = false;
+		for( int k = 0; k < 3; ++k ) {
+			p[k] = moved[k] = positions[corners[k]];
+			if( mRemap[corners[k]] == position )
+				moved[k] = newPosition;
+			else if( mRemap[corners[k]] == targetPosition )
+				shared = true;
+		}
+		if( shared ) {
+			++sharedTriangles;
+			continue;
+		}
+
+		const Vec3f oldNormal = ( p[1] - p[0] ).cross( p[2] - p[0] ), newNormal = ( moved[1] - moved[0] ).cross( moved[2] - moved[0] );
+		if( ( oldNormal.lengthSquared() > 0 ) && ( newNormal.dot( oldNormal ) <= MIN_NORMAL_COSINE * newNormal.length() * oldNormal.length() ) )
+			return 0;
+		if( newNormal.dot( mSourceNormals[t] ) <= 0 )
+			return 0;
+	}
+	if( sharedTriangles == 0 )
+		return 0;
+
+	// the link condition: the only neighbors the two share are those across the triangles being removed
+	gatherNeighbors( position, &mNeighbors );
+	gatherNeighbors( targetPosition, &mTargetNeighbors );
+	size_t sharedNeighbors = 0;
+	for( vector<uint32_t>::const_iterator a = mNeighbors.begin(), b = mTargetNeighbors.begin(); ( a != mNeighbors.end() ) && ( b != mTargetNeighbors.end() ); ) {
+		if( *a < *b )
+			++a;
+		else if( *b < *a )
+			++b;
+		else {
+			++sharedNeighbors;
+			++a;
+			++b;
+		}
+	}
+
+	return ( sharedNeighbors == sharedTriangles ) ? sharedTriangles : 0;
+}
+
+// Keeps the open edge links consistent once \a vertex has been moved onto \a target, which is one of its open neighbors
+void TriMeshSimplifier::Obj::relinkOpenEdges( uint32_t vertex, uint32_t target )
+{
+	const uint32_t in = mOpenIn[vertex], out = mOpenOut[vertex];
+	if( out == target ) {
+		if( mOpenIn[target] == vertex )
+			mOpenIn[target] = in;
+		if( isVertex( in ) && ( mOpenOut[in] == vertex ) )
+			mOpenOut[in] = target;
+	}
+	else if( in == target ) {
+		if( mOpenOut[target] == vertex )
+			mOpenOut[target] = out;
+		if( isVertex( out ) && ( mOpenIn[out] == vertex ) )
+			mOpenIn[out] = target;
+	}
+}
+
+void TriMeshSimplifier::Obj::collapse( uint32_t vertex, uint32_t target )
+{
+	const uint32_t position = mRemap[vertex], targetPosition = mRemap[target];
+	mQuadrics[targetPosition] += mQuadrics[position];
+
+	relinkOpenEdges( vertex, target );
+	mCollapsed[vertex] = 1;
+	mCollapseTargets[vertex] = target;
+	if( mKinds[vertex] == KIND_SEAM ) {
+		const uint32_t sibling = mWedges[vertex], siblingTarget = findSeamTarget( vertex, target );
+		relinkOpenEdges( sibling, siblingTarget );
+		mCollapsed[sibling] = 1;
+		mCollapseTargets[sibling] = siblingTarget;
+	}
+
+	// the target's quadric and list of triangles are out of date until the next pass. Other positions' quadrics are unaffected,
+	// so their costs stay exact, and their triangles' corners are looked up through mCollapseTargets.
+	mLocked[position] = mLocked[targetPosition] = 1;
+}
+
+// Moves the corners of collapsed vertices onto their targets, and drops the triangles that leaves degenerate
+void TriMeshSimplifier::Obj::removeCollapsedTriangles()
+{
+	size_t numTriangles = 0;
+	for( size_t t = 0; t < mIndices.size() / 3; ++t ) {
+		uint32_t corners[3];
+		for( int k = 0; k < 3; ++k ) {
+			corners[k] = mIndices[t*3+k];
+			if( mCollapsed[corners[k]] )
+				corners[k] = mCollapseTargets[corners[k]];
+		}
+		if( ( mRemap[corners[0]] == mRemap[corners[1]] ) || ( mRemap[corners[1]] == mRemap[corners[2]] ) || ( mRemap[corners[2]] == mRemap[corners[0]] ) )
+			continue;
+		std::copy( corners, corners + 3, &mIndices[numTriangles * 3] );
+		mSourceNormals[numTriangles] = mSourceNormals[t];
+		++numTriangles;
+	}
+	mIndices.resize( numTriangles * 3 );
+	mSourceNormals.resize( numTriangles );
+	mNumTriangles = numTriangles;
+}
+
+// Performs the cheapest collapses that don't overlap, up to the target or the error limit. Returns false if none were possible.
+bool TriMeshSimplifier::Obj::collapsePass( size_t targetTriangles, double maxErrorSquared )
+{
+	buildAdjacency();
+
+	mHeap.clear();
+	Collapse candidate( 0, 0, 0 );
+	for( size_t v = 0; v < mRemap.size(); ++v ) {
+		if( ( ! mCollapsed[v] ) && ( mFirstTriangles[mRemap[v]] != mFirstTriangles[mRemap[v] + 1] ) && findCollapse( static_cast<uint32_t>( v ), &candidate ) )
+			mHeap.push_back( candidate );
+	}
+	// a pass usually stops well short of using every candidate, so a heap saves sorting them all
+	std::make_heap( mHeap.begin(), mHeap.end() );
+
+	// Only as many of the cheapest candidates as would reach the target, or 1 / MIN_PASS_DIVISOR of them, are considered. Otherwise, as cheap collapses were
+	// locked out, the pass would carry on with ever more expensive ones instead of leaving them to the next pass.
+	double passErrorSquared = maxErrorSquared;
+	if( ! mHeap.empty() ) {
+		mCosts.resize( mHeap.size() );
+		for( size_t i = 0; i < mHeap.size(); ++i )
+			mCosts[i] = mHeap[i].mCost;
+		const size_t rank = std::min( std::max( ( mNumTriangles - targetTriangles + 1 ) / 2, mCosts.size() / MIN_PASS_DIVISOR ), mCosts.size() - 1 );
+		std::nth_element( mCosts.begin(), mCosts.begin() + rank, mCosts.end() );
+		passErrorSquared = std::min<double>( passErrorSquared, mCosts[rank] );
+	}
+
+	mLocked.assign( mRemap.size(), 0 );
+	size_t numCollapses = 0, numTriangles = mNumTriangles;
+	while( ( ! mHeap.empty() ) && ( numTriangles > targetTriangles ) ) {
+		const Collapse top = mHeap.front();
+		if( top.mCost > passErrorSquared ) {
+			// every pass has to make some progress
+			if( ( numCollapses > 0 ) || ( top.mCost > maxErrorSquared ) )
+				break;
+			passErrorSquared = top.mCost;
+		}
+		std::pop_heap( mHeap.begin(), mHeap.end() );
+		mHeap.pop_back();
+
+		if( mLocked[mRemap[top.mVertex]] )
+			continue;
+		Collapse chosen = top;
+		size_t removed = mLocked[mRemap[top.mTarget]] ? 0 : countValidCollapse( mRemap[top.mVertex], mRemap[top.mTarget] );
+		if( removed == 0 )
+			removed = findValidCollapse( top.mVertex, passErrorSquared, &chosen );
+		if( removed == 0 )
+			continue;
+
+		collapse( chosen.mVertex, chosen.mTarget );
+		mError = std::max<double>( mError, chosen.mCost );
+		numTriangles -= std::min( removed, numTriangles );
+		++numCollapses;
+	}
+
+	removeCollapsedTriangles();
+	return numCollapses > 0;
+}
+
+TriMeshSimplifier::TriMeshSimplifier( const TriMesh &mesh )
+	: mObj( new Obj( mesh ) )
+{
+}
+
+size_t TriMeshSimplifier::simplify( size_t targetTriangles, float maxError )
+{
+	const double maxErrorSquared = (double)maxError * maxError;
+	while( ( mObj->mNumTriangles > targetTriangles ) && mObj->collapsePass( targetTriangles, maxErrorSquared ) )
+		;
+
+	return mObj->mNumTriangles;
+}
+
+size_t TriMeshSimplifier::getNumTriangles() const
+{
+	return mObj->mNumTriangles;
+}
+
+float TriMeshSimplifier::getError() const
+{
+	return (float)math<double>::sqrt( mObj->mError );
+}
+
+vector<uint32_t> TriMeshSimplifier::getIndices() const
+{
+	return mObj->mIndices;
+}
+
+TriMesh TriMeshSimplifier::getMesh() const
+{
+	const TriMesh &source = mObj->mSource;
+	const vector<uint32_t> &indices = mObj->mIndices;
+	vector<uint32_t> remap( source.getNumVertices(), NONE );
+	TriMesh result;
+	for( size_t i = 0; i < indices.size(); ++i ) {
+		const uint32_t v = indices[i];
+		if( remap[v] == NONE ) {
+			remap[v] = static_cast<uint32_t>( result.getNumVertices() );
+			result.appendVertex( source.getVertices()[v] );
+			if( source.getNormals().size() == source.getNumVertices() )
+				result.appendNormal( source.getNormals()[v] );
+			if( source.getTexCoords().size() == source.getNumVertices() )
+				result.appendTexCoord( source.getTexCoords()[v] );
+			if( source.getColorsRGB().size() == source.getNumVertices() )
+				result.appendColorRGB( source.getColorsRGB()[v] );
+			if( source.getColorsRGBA().size() == source.getNumVertices() )
+				result.appendColorRGBA( source.getColorsRGBA()[v] );
+			if( source.getTangents().size() == source.getNumVertices() )
+				result.appendTangent( source.getTangents()[v] );
+		}
+	}
+	for( size_t i = 0; i < indices.size(); i += 3 )
+		result.appendTriangle( remap[indices[i]], remap[indices[i+1]], remap[indices[i+2]] );
+
+	return result;
+}
+
+vector<TriMesh> TriMeshSimplifier::generateLods( const TriMesh &mesh, const vector<size_t> &targetTriangles )
+{
+	vector<TriMesh> result;
+	TriMeshSimplifier simplifier( mesh );
+	for( size_t i = 0; i < targetTriangles.size(); ++i ) {
+		simplifier.simplify( targetTriangles[i] );
+		result.push_back( simplifier.getMesh() );
+	}
+
+	return result;
+}
+
+} // namespace cinder
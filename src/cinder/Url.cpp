@@ -24,10 +24,36 @@
 #include "cinder/DataSource.h"
 #include <curl/curl.h>
 
-#include <boost/noncopyable.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <sstream>
 
 namespace cinder {
 
+namespace {
+// the longest the fetch thread blocks in select() while transfers are active, which bounds how long new requests wait to be picked up
+const long MAX_WAIT_MS = 10;
+// the most of a transfer's Content-Length that's allocated before any data arrives; the rest is grown as it's received, so a bogus header can't force a huge allocation
+const uint64_t MAX_PREALLOCATED_BYTES = 8 * 1024 * 1024;
+
+bool equalsNoCase( const std::string &a, const std::string &b )
+{
+	if( a.size() != b.size() )
+		return false;
+	for( size_t i = 0; i < a.size(); ++i )
+		if( tolower( (unsigned char)a[i] ) != tolower( (unsigned char)b[i] ) )
+			return false;
+	return true;
+}
+} // anonymous namespace
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 // Url
 Url::Url( const std::string &urlString )
@@ -71,266 +97,875 @@ CURLLib* CURLLib::instance()
 	return sInstance;
 }
 
-extern "C" {
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+// UrlTransfer
+UrlTransfer::UrlTransfer( const Url &url, const Options &options, bool streaming, const Callback &callback )
+	: mUrl( url ), mOptions( options ), mStreaming( streaming ), mCallback( callback ), mCurl( 0 ), mHeaderList( 0 ),
+	mState( STATE_QUEUED ), mCancelRequested( false ), mHeadersReceived( false ), mResponseCode( 0 ), mContentLength( -1 ), mBytesReceived( 0 ),
+	mStreamReadOffset( 0 ), mPaused( false )
+{
+	mCurl = curl_easy_init();
+	if( ! mCurl )
+		throw UrlTransferExc( "Unable to create a curl handle" );
+
+	curl_easy_setopt( mCurl, CURLOPT_URL, mUrl.c_str() );
+	curl_easy_setopt( mCurl, CURLOPT_WRITEFUNCTION, UrlTransfer::writeCallback );
+	curl_easy_setopt( mCurl, CURLOPT_WRITEDATA, this );
+	curl_easy_setopt( mCurl, CURLOPT_HEADERFUNCTION, UrlTransfer::headerCallback );
+	curl_easy_setopt( mCurl, CURLOPT_WRITEHEADER, this );
+	curl_easy_setopt( mCurl, CURLOPT_VERBOSE, 0L );
+	curl_easy_setopt( mCurl, CURLOPT_NOSIGNAL, 1L ); // signals can't be used to time out DNS lookups off the main thread
+	curl_easy_setopt( mCurl, CURLOPT_FOLLOWLOCATION, mOptions.getFollowRedirects() ? 1L : 0L );
+
+	if( ( ! mOptions.getUser().empty() ) || ( ! mOptions.getPassword().empty() ) ) {
+		mUserColonPassword = mOptions.getUser() + ":" + mOptions.getPassword();
+		curl_easy_setopt( mCurl, CURLOPT_USERPWD, mUserColonPassword.c_str() );
+		curl_easy_setopt( mCurl, CURLOPT_HTTPAUTH, CURLAUTH_ANY );
+	}
+
+	for( std::vector<std::string>::const_iterator headerIt = mOptions.getHeaders().begin(); headerIt != mOptions.getHeaders().end(); ++headerIt )
+		mHeaderList = curl_slist_append( mHeaderList, headerIt->c_str() );
+	if( mHeaderList )
+		curl_easy_setopt( mCurl, CURLOPT_HTTPHEADER, mHeaderList );
+
+	if( mOptions.hasRange() ) {
+		char rangeString[64];
+		if( mOptions.getRangeLength() > 0 )
+			sprintf( rangeString, "%llu-%llu", (unsigned long long)mOptions.getRangeOffset(), (unsigned long long)( mOptions.getRangeOffset() + mOptions.getRangeLength() - 1 ) );
+		else
+			sprintf( rangeString, "%llu-", (unsigned long long)mOptions.getRangeOffset() );
+		mRangeString = rangeString;
+		curl_easy_setopt( mCurl, CURLOPT_RANGE, mRangeString.c_str() );
+	}
+
+	if( mOptions.getTimeout() > 0 )
+		curl_easy_setopt( mCurl, CURLOPT_TIMEOUT_MS, (long)( mOptions.getTimeout() * 1000 ) );
+	if( mOptions.getConnectTimeout() > 0 )
+		curl_easy_setopt( mCurl, CURLOPT_CONNECTTIMEOUT_MS, (long)( mOptions.getConnectTimeout() * 1000 ) );
+
+	if( ! mStreaming ) {
+		mBuffer = Buffer( 16 * 1024 );
+		mBuffer.setDataSize( 0 );
+	}
+}
+
+UrlTransfer::~UrlTransfer()
+{
+	if( mCurl )
+		curl_easy_cleanup( mCurl );
+	if( mHeaderList )
+		curl_slist_free_all( mHeaderList );
+}
 
-size_t IStreamUrl::writeCallback( char *buffer, size_t size, size_t nitems, void *userp )
+size_t UrlTransfer::writeCallback( char *buffer, size_t size, size_t nitems, void *userp )
 {
-	cinder::IStreamUrl *stream = (cinder::IStreamUrl*)userp;
+	UrlTransfer *transfer = reinterpret_cast<UrlTransfer*>( userp );
 	size *= nitems;
 
-	int roomInBuffer = stream->mBufferSize - stream->mBufferedBytes;
-
-	if( (off_t)size > roomInBuffer ) {
-		// not enough space in buffer
-		int oldBufferSize = stream->mBufferSize;
-		while( stream->mBufferSize - stream->mBufferedBytes <= (off_t)size )
-			stream->mBufferSize *= 2;
-		uint8_t *newBuff = reinterpret_cast<uint8_t*>( realloc( stream->mBuffer, stream->mBufferSize ) );
-		if( ! newBuff ) { // allocation failed - just copy the bytes we can fit
-			size = stream->bufferRemaining();
-			stream->mBufferSize = oldBufferSize;
+	boost::mutex::scoped_lock lock( transfer->mMutex );
+	if( transfer->mCancelRequested )
+		return 0; // aborts the transfer
+
+	if( ! transfer->mHeadersReceived )
+		transfer->captureHeaderInfoLocked();
+
+	if( transfer->mStreaming ) {
+		// the reader has fallen behind; curl holds onto this data and hands it to us again once we're unpaused
+		if( transfer->mStreamData.size() - transfer->mStreamReadOffset >= transfer->mOptions.getMaxBufferedBytes() ) {
+			transfer->mPaused = true;
+			return CURL_WRITEFUNC_PAUSE;
 		}
-		else {
-			// realloc suceeded increase buffer size
-			stream->mBuffer = newBuff;
+		transfer->mStreamData.insert( transfer->mStreamData.end(), buffer, buffer + size );
+		transfer->mCond.notify_all();
+	}
+	else {
+		size_t dataSize = transfer->mBuffer.getDataSize();
+		if( dataSize + size > transfer->mBuffer.getAllocatedSize() ) {
+			try {
+				transfer->mBuffer.resize( std::max( transfer->mBuffer.getAllocatedSize() * 2, dataSize + size ) );
+			}
+			catch( std::bad_alloc & ) {
+				return 0; // aborts the transfer
+			}
 		}
+		memcpy( reinterpret_cast<uint8_t*>( transfer->mBuffer.getData() ) + dataSize, buffer, size );
+		transfer->mBuffer.setDataSize( dataSize + size );
 	}
 
-	memcpy( &stream->mBuffer[stream->mBufferedBytes], buffer, size );
-	stream->mBufferedBytes += size;
+	transfer->mBytesReceived += size;
+	return size;
+}
+
+size_t UrlTransfer::headerCallback( char *buffer, size_t size, size_t nitems, void *userp )
+{
+	UrlTransfer *transfer = reinterpret_cast<UrlTransfer*>( userp );
+	size *= nitems;
+
+	std::string line( buffer, size );
+	while( ( ! line.empty() ) && ( ( line[line.size() - 1] == '\r' ) || ( line[line.size() - 1] == '\n' ) ) )
+		line.erase( line.size() - 1 );
+
+	boost::mutex::scoped_lock lock( transfer->mMutex );
+	if( line.compare( 0, 5, "HTTP/" ) == 0 ) // a new response, after a redirect or a 100 Continue
+		transfer->mHeaders.clear();
+	else {
+		std::string::size_type colon = line.find( ':' );
+		if( colon != std::string::npos ) {
+			std::string::size_type valueStart = line.find_first_not_of( " \t", colon + 1 );
+			transfer->mHeaders.push_back( std::make_pair( line.substr( 0, colon ), ( valueStart == std::string::npos ) ? std::string() : line.substr( valueStart ) ) );
+		}
+	}
 
 	return size;
 }
 
-} // extern "C"
+void UrlTransfer::captureHeaderInfoLocked()
+{
+	curl_easy_getinfo( mCurl, CURLINFO_RESPONSE_CODE, &mResponseCode );
+
+	char *effectiveUrl = 0;
+	if( ( curl_easy_getinfo( mCurl, CURLINFO_EFFECTIVE_URL, &effectiveUrl ) == CURLE_OK ) && effectiveUrl )
+		mEffectiveUrl = effectiveUrl;
+
+	double contentLength = -1;
+	if( ( curl_easy_getinfo( mCurl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength ) == CURLE_OK ) && ( contentLength >= 0 ) ) {
+		mContentLength = (int64_t)contentLength;
+		// we know how much is coming, so allocate it up front rather than growing the Buffer
+		const uint64_t preallocate = std::min<uint64_t>( mContentLength, MAX_PREALLOCATED_BYTES );
+		if( ( ! mStreaming ) && ( preallocate > mBuffer.getAllocatedSize() ) ) {
+			size_t dataSize = mBuffer.getDataSize();
+			try {
+				mBuffer.resize( (size_t)preallocate );
+			}
+			catch( std::bad_alloc & ) { // writeCallback() will try again as the data arrives
+			}
+			mBuffer.setDataSize( dataSize );
+		}
+	}
 
-IStreamUrlRef IStreamUrl::createRef( const std::string &url, const std::string &user, const std::string &password )
+	mHeadersReceived = true;
+	mCond.notify_all();
+}
+
+void UrlTransfer::finish( State state, const std::string &error )
 {
-	return IStreamUrlRef( new IStreamUrl( url, user, password ) );
+	Callback callback;
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		if( isOverLocked() )
+			return;
+		if( ( ! mHeadersReceived ) && ( state == STATE_DONE ) )
+			captureHeaderInfoLocked();
+		if( ( ! mStreaming ) && ( mBuffer.getDataSize() > 0 ) && ( mBuffer.getDataSize() < mBuffer.getAllocatedSize() ) )
+			mBuffer.resize( mBuffer.getDataSize() );
+
+		mState = state;
+		mError = error;
+		mPaused = false;
+		callback.swap( mCallback );
+		mCond.notify_all();
+	}
+
+	if( callback ) {
+		try {
+			callback( shared_from_this() );
+		}
+		catch( ... ) { // an exception escaping here would take down the fetch thread and every other transfer with it
+		}
+	}
 }
 
-IStreamUrl::IStreamUrl( const std::string &url, const std::string &aUser, const std::string &aPassword )
-	: IStream(), mUser( aUser ), mPassword( aPassword ), still_running( 1 ), mSizeCached( false ), mBufferFileOffset( 0 ), mStartedRead( false ),
-	mEffectiveUrl( 0 ), mResponseCode( 0 )
-{	
-	setFileName( url );
+UrlTransfer::State UrlTransfer::getState() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mState;
+}
 
-	if( ! CURLLib::instance() )
-		throw StreamExc(); // for some reason the curl lib isn't initialized, and we're screwed
-	
-	mMulti = curl_multi_init();
+bool UrlTransfer::isDone() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return isOverLocked();
+}
 
-	mCurl = curl_easy_init();
-	curl_easy_setopt( mCurl, CURLOPT_URL, url.c_str() );
-	curl_easy_setopt( mCurl, CURLOPT_WRITEDATA, this );
-	curl_easy_setopt( mCurl, CURLOPT_VERBOSE, 0L );
-	curl_easy_setopt( mCurl, CURLOPT_FOLLOWLOCATION, 1L );
-	curl_easy_setopt( mCurl, CURLOPT_WRITEFUNCTION, IStreamUrl::writeCallback );
+bool UrlTransfer::hasFailed() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return ( mState == STATE_FAILED ) || ( mState == STATE_CANCELLED );
+}
 
-	if( ( ! mUser.empty() ) || ( ! mPassword.empty() ) ) {
-		mUserColonPassword = mUser + ":" + mPassword;
-		curl_easy_setopt( mCurl, CURLOPT_USERPWD, mUserColonPassword.c_str() );
-		curl_easy_setopt( mCurl, CURLOPT_HTTPAUTH, CURLAUTH_ANY );
+std::string UrlTransfer::getError() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mError;
+}
+
+void UrlTransfer::wait() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( ! isOverLocked() )
+		mCond.wait( lock );
+}
+
+bool UrlTransfer::waitForHeaders() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( ( ! mHeadersReceived ) && ( ! isOverLocked() ) )
+		mCond.wait( lock );
+	return mHeadersReceived;
+}
+
+Buffer UrlTransfer::getBuffer() const
+{
+	if( mStreaming )
+		throw UrlTransferExc( "A streaming transfer has no Buffer" );
+
+	boost::mutex::scoped_lock lock( mMutex );
+	while( ! isOverLocked() )
+		mCond.wait( lock );
+	if( mState == STATE_FAILED )
+		throw UrlTransferExc( mError );
+	else if( mState == STATE_CANCELLED )
+		throw UrlTransferExc( "Transfer cancelled" );
+	return mBuffer;
+}
+
+size_t UrlTransfer::read( void *dest, size_t maxSize )
+{
+	if( ! mStreaming )
+		throw UrlTransferExc( "Only streaming transfers can be read incrementally" );
+
+	bool unpause = false;
+	size_t result;
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		while( ( mStreamReadOffset == mStreamData.size() ) && ( ! isOverLocked() ) )
+			mCond.wait( lock );
+
+		result = std::min( maxSize, mStreamData.size() - mStreamReadOffset );
+		if( result == 0 ) // the transfer is over and everything has been read; mStreamData may be empty
+			return 0;
+		memcpy( dest, &mStreamData[0] + mStreamReadOffset, result );
+		mStreamReadOffset += result;
+		if( mStreamReadOffset == mStreamData.size() ) {
+			mStreamData.clear();
+			mStreamReadOffset = 0;
+		}
+		else if( mStreamReadOffset > mStreamData.size() / 2 ) { // reclaim the consumed front once it dominates
+			mStreamData.erase( mStreamData.begin(), mStreamData.begin() + mStreamReadOffset );
+			mStreamReadOffset = 0;
+		}
+
+		// let the download resume once there's a good amount of room, rather than on every read
+		if( mPaused && ( mStreamData.size() - mStreamReadOffset <= mOptions.getMaxBufferedBytes() / 2 ) ) {
+			mPaused = false;
+			unpause = true;
+		}
 	}
-		
-	curl_multi_add_handle( mMulti, mCurl );
 
-	// we fill the buffer just to get things rolling
-	mBufferSize = DEFAULT_BUFFER_SIZE;
-	mBuffer = (uint8_t*)malloc( mBufferSize );
-	mBufferOffset = 0;
-	mBufferedBytes = 0;
-	mBufferFileOffset = 0;
-//	fillBuffer( Stream::MINIMUM_BUFFER_SIZE );
+	if( unpause ) {
+		if( UrlFetcher *fetcher = UrlFetcher::instance() )
+			fetcher->requestUnpause( shared_from_this() );
+	}
+	return result;
 }
 
-IStreamUrl::~IStreamUrl()
+size_t UrlTransfer::getBytesAvailable() const
 {
-	if( mBuffer )
-		free( mBuffer );
+	boost::mutex::scoped_lock lock( mMutex );
+	return mStreamData.size() - mStreamReadOffset;
+}
 
-	curl_multi_remove_handle( mMulti, mCurl );
-	curl_easy_cleanup( mCurl );
+long UrlTransfer::getResponseCode() const
+{
+	waitForHeaders();
+	boost::mutex::scoped_lock lock( mMutex );
+	return mResponseCode;
+}
 
-	if( mMulti )
-		curl_multi_cleanup( mMulti );
+std::string UrlTransfer::getEffectiveUrl() const
+{
+	waitForHeaders();
+	boost::mutex::scoped_lock lock( mMutex );
+	return mEffectiveUrl;
 }
 
-bool IStreamUrl::isEof() const
+int64_t UrlTransfer::getContentLength() const
 {
-	return ( mBufferedBytes - mBufferOffset == 0 ) && ( ! still_running );
+	waitForHeaders();
+	boost::mutex::scoped_lock lock( mMutex );
+	return mContentLength;
 }
 
-void IStreamUrl::seekRelative( off_t relativeOffset )
+std::string UrlTransfer::getHeader( const std::string &name ) const
 {
-	// if this move stays inside the current buffer, we're good
-	if( ( mBufferOffset + relativeOffset >= 0 ) && ( mBufferOffset + relativeOffset < mBufferedBytes ) ) {
-		mBufferOffset += relativeOffset;
-		return;
+	waitForHeaders();
+	boost::mutex::scoped_lock lock( mMutex );
+	for( std::vector<std::pair<std::string,std::string> >::const_iterator headerIt = mHeaders.begin(); headerIt != mHeaders.end(); ++headerIt )
+		if( equalsNoCase( headerIt->first, name ) )
+			return headerIt->second;
+	return std::string();
+}
+
+uint64_t UrlTransfer::getBytesReceived() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mBytesReceived;
+}
+
+void UrlTransfer::cancel()
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		if( isOverLocked() || mCancelRequested )
+			return;
+		mCancelRequested = true;
 	}
-	else if( relativeOffset < 0 ) {	// if we're moving backwards out of the buffer, we have to reset
-throw; // need to implement this
+
+	if( UrlFetcher *fetcher = UrlFetcher::instance() )
+		fetcher->requestCancel( shared_from_this() );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+// UrlFetcher
+UrlFetcher *UrlFetcher::sInstance = 0;
+static boost::once_flag sFetcherOnceFlag = BOOST_ONCE_INIT;
+static bool sFetcherShutdown = false;
+
+UrlFetcher* UrlFetcher::instance()
+{
+	boost::call_once( &UrlFetcher::createInstance, sFetcherOnceFlag );
+	return sInstance;
+}
+
+void UrlFetcher::createInstance()
+{
+	if( sFetcherShutdown )
+		return;
+	sInstance = new UrlFetcher;
+	atexit( &UrlFetcher::shutdown );
+}
+
+void UrlFetcher::shutdown()
+{
+	sFetcherShutdown = true;
+	// if the UrlFetcher was never created this makes sure it can't be now
+	boost::call_once( &UrlFetcher::createInstance, sFetcherOnceFlag );
+	delete sInstance;
+	sInstance = 0;
+}
+
+UrlFetcher::UrlFetcher()
+	: mMaxConcurrentTransfers( 16 ), mShutdown( false )
+{
+	if( ! CURLLib::instance() )
+		throw UrlTransferExc( "Unable to initialize curl" );
+
+	mMulti = curl_multi_init();
+	mThread = shared_ptr<boost::thread>( new boost::thread( boost::bind( &UrlFetcher::threadFn, this ) ) );
+}
+
+UrlFetcher::~UrlFetcher()
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mShutdown = true;
+		mWake.notify_one();
 	}
-	else { // moving forward off the end of the buffer - keep buffering til we're in range
-throw; // need to implement this		
+	// waitForActivity() never blocks for more than MAX_WAIT_MS, so this is prompt even mid-transfer
+	mThread->join();
+
+	// with the thread gone, whatever is left is ours to cancel
+	for( std::map<CURL*,UrlTransferRef>::const_iterator activeIt = mActive.begin(); activeIt != mActive.end(); ++activeIt ) {
+		curl_multi_remove_handle( mMulti, activeIt->first );
+		activeIt->second->finish( UrlTransfer::STATE_CANCELLED, "Transfer cancelled" );
 	}
+	mActive.clear();
+	for( std::deque<UrlTransferRef>::const_iterator queuedIt = mQueued.begin(); queuedIt != mQueued.end(); ++queuedIt )
+		(*queuedIt)->finish( UrlTransfer::STATE_CANCELLED, "Transfer cancelled" );
+	mQueued.clear();
+	for( std::vector<UrlTransferRef>::const_iterator cancelIt = mCancels.begin(); cancelIt != mCancels.end(); ++cancelIt )
+		(*cancelIt)->finish( UrlTransfer::STATE_CANCELLED, "Transfer cancelled" );
+	mCancels.clear();
+	mUnpauses.clear();
+
+	curl_multi_cleanup( mMulti );
 }
 
-void IStreamUrl::seekAbsolute( off_t absoluteOffset )
+UrlTransferRef UrlFetcher::fetch( const Url &url, const UrlTransfer::Options &options, const UrlTransfer::Callback &callback )
 {
-	seekRelative( absoluteOffset - ( mBufferFileOffset + mBufferOffset ) );
+	UrlTransferRef result( new UrlTransfer( url, options, false, callback ) );
+	enqueue( result );
+	return result;
 }
 
-off_t IStreamUrl::size() const
+UrlTransferRef UrlFetcher::fetchStream( const Url &url, const UrlTransfer::Options &options, const UrlTransfer::Callback &callback )
 {
-	if( ! mStartedRead )
-		fillBuffer( 1 );
+	UrlTransferRef result( new UrlTransfer( url, options, true, callback ) );
+	enqueue( result );
+	return result;
+}
 
-	if( mSizeCached )
-		return mSize;
-	else {
-		if( still_running ) {			
-			double tempSize = 0;
-			CURLcode result = curl_easy_getinfo( mCurl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &tempSize );
-			if( ( result == CURLE_OK ) && ( tempSize > 0 ) ) {
-				mSize = (off_t)tempSize;
-				mSizeCached = true;
+void UrlFetcher::setMaxConcurrentTransfers( size_t maxTransfers )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	mMaxConcurrentTransfers = std::max<size_t>( maxTransfers, 1 );
+	mWake.notify_one();
+}
+
+size_t UrlFetcher::getMaxConcurrentTransfers() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mMaxConcurrentTransfers;
+}
+
+void UrlFetcher::enqueue( UrlTransferRef transfer )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	mQueued.push_back( transfer );
+	mWake.notify_one();
+}
+
+void UrlFetcher::requestCancel( UrlTransferRef transfer )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	mCancels.push_back( transfer );
+	mWake.notify_one();
+}
+
+void UrlFetcher::requestUnpause( UrlTransferRef transfer )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	mUnpauses.push_back( transfer );
+	mWake.notify_one();
+}
+
+void UrlFetcher::threadFn()
+{
+	while( true ) {
+		std::vector<UrlTransferRef> adds, cancels, unpauses;
+		{
+			boost::mutex::scoped_lock lock( mMutex );
+			while( mActive.empty() && mQueued.empty() && mCancels.empty() && mUnpauses.empty() && ( ! mShutdown ) )
+				mWake.wait( lock );
+			if( mShutdown )
+				return;
+
+			cancels.swap( mCancels );
+			unpauses.swap( mUnpauses );
+			for( std::vector<UrlTransferRef>::const_iterator cancelIt = cancels.begin(); cancelIt != cancels.end(); ++cancelIt ) {
+				std::deque<UrlTransferRef>::iterator queuedIt = std::find( mQueued.begin(), mQueued.end(), *cancelIt );
+				if( queuedIt != mQueued.end() )
+					mQueued.erase( queuedIt );
 			}
-			else
-				mSize = 0;
+			while( ( ! mQueued.empty() ) && ( mActive.size() + adds.size() < mMaxConcurrentTransfers ) ) {
+				adds.push_back( mQueued.front() );
+				mQueued.pop_front();
+			}
+		}
+
+		for( std::vector<UrlTransferRef>::const_iterator addIt = adds.begin(); addIt != adds.end(); ++addIt ) {
+			{
+				boost::mutex::scoped_lock lock( (*addIt)->mMutex );
+				(*addIt)->mState = UrlTransfer::STATE_RUNNING;
+			}
+			mActive[(*addIt)->mCurl] = *addIt;
+			curl_multi_add_handle( mMulti, (*addIt)->mCurl );
 		}
-		else { // transfer is done, so use CURLINFO_SIZE_DOWNLOAD 
-			double tempSize = 0;
-			CURLcode result = curl_easy_getinfo( mCurl, CURLINFO_SIZE_DOWNLOAD, &tempSize );
-			if( ( result == CURLE_OK ) && ( tempSize > 0 ) ) {
-				mSize = (off_t)tempSize;
-				mSizeCached = true;
+
+		for( std::vector<UrlTransferRef>::const_iterator cancelIt = cancels.begin(); cancelIt != cancels.end(); ++cancelIt ) {
+			std::map<CURL*,UrlTransferRef>::iterator activeIt = mActive.find( (*cancelIt)->mCurl );
+			if( activeIt != mActive.end() ) {
+				curl_multi_remove_handle( mMulti, activeIt->first );
+				mActive.erase( activeIt );
 			}
-			else
-				mSize = 0;			
+			(*cancelIt)->finish( UrlTransfer::STATE_CANCELLED, "Transfer cancelled" );
+		}
+
+		for( std::vector<UrlTransferRef>::const_iterator unpauseIt = unpauses.begin(); unpauseIt != unpauses.end(); ++unpauseIt ) {
+			if( mActive.find( (*unpauseIt)->mCurl ) != mActive.end() )
+				curl_easy_pause( (*unpauseIt)->mCurl, CURLPAUSE_CONT );
 		}
-		return mSize;
+
+		int stillRunning;
+		while( curl_multi_perform( mMulti, &stillRunning ) == CURLM_CALL_MULTI_PERFORM )
+			;
+		processCompletions();
+
+		if( ! mActive.empty() )
+			waitForActivity();
 	}
 }
 
-void IStreamUrl::fillBuffer( int wantBytes ) const
+void UrlFetcher::processCompletions()
 {
-	// first make sure we've started reading, and do so if not
-	if( ! mStartedRead ) {
-		while( curl_multi_perform( mMulti, &still_running ) == CURLM_CALL_MULTI_PERFORM );
-		if( ( bufferRemaining() == 0 ) && ( ! still_running ) ) {			
-			throw StreamExc();
+	CURLMsg *msg;
+	int msgsLeft;
+	while( ( msg = curl_multi_info_read( mMulti, &msgsLeft ) ) != 0 ) {
+		if( msg->msg != CURLMSG_DONE )
+			continue;
+		// msg is freed by curl_multi_remove_handle()
+		CURL *curl = msg->easy_handle;
+		CURLcode result = msg->data.result;
+
+		std::map<CURL*,UrlTransferRef>::iterator activeIt = mActive.find( curl );
+		if( activeIt == mActive.end() )
+			continue;
+		UrlTransferRef transfer = activeIt->second;
+		mActive.erase( activeIt );
+		curl_multi_remove_handle( mMulti, curl );
+
+		bool cancelled;
+		{
+			boost::mutex::scoped_lock lock( transfer->mMutex );
+			cancelled = transfer->mCancelRequested;
 		}
-		
-		mStartedRead = true;
-	}
-	
-
-    // only attempt to fill buffer if transactions still running and buffer
-    // doesnt exceed required size already
-    if( ( ! still_running ) || ( bufferRemaining() >= wantBytes ) )
-        return;
-
-	// if we want more bytes than will fit in the rest of the buffer, let's make some room
-	if( mBufferSize - mBufferedBytes < wantBytes ) {
-		int bytesCulled = mBufferOffset;
-		memmove( mBuffer, &mBuffer[mBufferOffset], mBufferedBytes - bytesCulled );
-		mBufferedBytes -= bytesCulled;
-		mBufferOffset = 0;
-		mBufferFileOffset += bytesCulled;
+		if( cancelled )
+			transfer->finish( UrlTransfer::STATE_CANCELLED, "Transfer cancelled" );
+		else if( result == CURLE_OK )
+			transfer->finish( UrlTransfer::STATE_DONE, "" );
+		else
+			transfer->finish( UrlTransfer::STATE_FAILED, curl_easy_strerror( result ) );
 	}
+}
+
+void UrlFetcher::waitForActivity()
+{
+	long timeoutMs = -1;
+	curl_multi_timeout( mMulti, &timeoutMs );
+	if( ( timeoutMs < 0 ) || ( timeoutMs > MAX_WAIT_MS ) )
+		timeoutMs = MAX_WAIT_MS;
+	if( timeoutMs == 0 )
+		return;
+
+	fd_set fdread, fdwrite, fdexcep;
+	FD_ZERO( &fdread );
+	FD_ZERO( &fdwrite );
+	FD_ZERO( &fdexcep );
+	int maxfd = -1;
+	curl_multi_fdset( mMulti, &fdread, &fdwrite, &fdexcep, &maxfd );
 
-    // attempt to fill buffer
-    do {
-		fd_set fdread;
-		fd_set fdwrite;
-		fd_set fdexcep;
-		int maxfd;
+	// no sockets to wait on, as when every transfer is paused or resolving; select() on an empty set fails on Windows
+	if( maxfd == -1 )
+		boost::this_thread::sleep( boost::posix_time::milliseconds( timeoutMs ) );
+	else {
 		struct timeval timeout;
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_usec = ( timeoutMs % 1000 ) * 1000;
+		select( maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout );
+	}
+}
 
-		FD_ZERO( &fdread );
-		FD_ZERO( &fdwrite );
-		FD_ZERO( &fdexcep );
-
-		// set a suitable timeout to fail on
-		timeout.tv_sec = 60; /* 1 minute */
-		timeout.tv_usec = 0;
-
-		// get file descriptors from the transfers
-		curl_multi_fdset( mMulti, &fdread, &fdwrite, &fdexcep, &maxfd );
-
-		int rc = select( maxfd + 1, &fdread, &fdwrite, &fdexcep, &timeout );
-
-		switch( rc ) {
-			case -1:
-				throw StreamExc();
-			break;
-			case 0:
-			break;
-			default:
-				// timeout or readable/writable sockets
-				// note we *could* be more efficient and not wait for
-				// CURLM_CALL_MULTI_PERFORM to clear here and check it on re-entry
-				// but that gets messy
-				while( curl_multi_perform( mMulti, &still_running ) == CURLM_CALL_MULTI_PERFORM );
-			break;
-		}
-    } while( still_running && ( bufferRemaining() < wantBytes ) );
+UrlTransferRef fetchUrl( const Url &url, const UrlTransfer::Options &options, const UrlTransfer::Callback &callback )
+{
+	UrlFetcher *fetcher = UrlFetcher::instance();
+	if( ! fetcher )
+		throw UrlTransferExc( "UrlFetcher has been shut down" );
+	return fetcher->fetch( url, options, callback );
 }
 
-void IStreamUrl::IORead( void *dest, size_t size )
+UrlTransferRef fetchUrlStream( const Url &url, const UrlTransfer::Options &options )
 {
-	fillBuffer( size );
-	
-	// check if theres data in the buffer - if not fillBuffer() either errored or EOF
-	if( bufferRemaining() < (off_t)size )
-		throw StreamExc();
+	UrlFetcher *fetcher = UrlFetcher::instance();
+	if( ! fetcher )
+		throw UrlTransferExc( "UrlFetcher has been shut down" );
+	return fetcher->fetchStream( url, options );
+}
 
-	memcpy( dest, mBuffer + mBufferOffset, size );
-	mBufferOffset += size;
+//////////////////////////////////////////////////////////////////////////////////////////////////////
+// IStreamUrl
+IStreamUrlRef IStreamUrl::createRef( const std::string &url, const std::string &user, const std::string &password )
+{
+	UrlTransfer::Options options;
+	if( ( ! user.empty() ) || ( ! password.empty() ) )
+		options.user( user, password );
+	return IStreamUrlRef( new IStreamUrl( Url( url ), options ) );
 }
 
-size_t IStreamUrl::readDataAvailable( void *dest, size_t maxSize )
+IStreamUrlRef IStreamUrl::createRef( const Url &url, const UrlTransfer::Options &options )
 {
-	fillBuffer( maxSize );
-	
-	if( bufferRemaining() < (off_t)maxSize )
-		maxSize = bufferRemaining();
-		
-	memcpy( dest, mBuffer + mBufferOffset, maxSize );
-	
-	mBufferOffset += maxSize;
-	return maxSize;
+	return IStreamUrlRef( new IStreamUrl( url, options ) );
+}
+
+namespace {
+const uint64_t TRANSFER_OPEN = std::numeric_limits<uint64_t>::max();
+const uint64_t INITIAL_RANGE_LENGTH = IStreamUrl::BLOCK_SIZE;
+const uint64_t MAX_RANGE_LENGTH = 16 * 1024 * 1024;
+// reading forward this far through the current transfer is assumed cheaper than the round trip of a new request
+const uint64_t READ_FORWARD_LIMIT = 128 * 1024;
+} // anonymous namespace
+
+IStreamUrl::IStreamUrl( const Url &url, const UrlTransfer::Options &options )
+	: IStream(), mUrl( url ), mOptions( options ), mTransferOffset( 0 ), mTransferEnd( TRANSFER_OPEN ), mTransferRanged( false ), mHeadersChecked( false ),
+	mNextRangeLength( INITIAL_RANGE_LENGTH ), mRangeSupport( RANGES_UNKNOWN ), mSize( -1 ), mResponseCode( 0 ), mPosition( 0 ), mUseCounter( 0 )
+{	
+	setFileName( url.str() );
+	mOptions.range( 0, 0 );
+	mScratch.resize( BLOCK_SIZE );
+
+	// start on the first range right away; it grows quickly if the stream is read front to back
+	startTransfer( 0, false );
+}
+
+IStreamUrl::~IStreamUrl()
+{
+	mTransfer->cancel();
+}
+
+bool IStreamUrl::isEof() const
+{
+	return fillAt( mPosition ) == 0;
+}
+
+void IStreamUrl::seekRelative( off_t relativeOffset )
+{
+	seekAbsolute( (off_t)mPosition + relativeOffset );
+}
+
+void IStreamUrl::seekAbsolute( off_t absoluteOffset )
+{
+	if( absoluteOffset < 0 )
+		throw StreamExc();
+	// nothing is downloaded until the next read
+	mPosition = (uint64_t)absoluteOffset;
+}
+
+off_t IStreamUrl::size() const
+{
+	if( mSize < 0 )
+		checkHeaders();
+	return ( mSize >= 0 ) ? (off_t)mSize : 0;
 }
 
 long IStreamUrl::getResponseCode() const
 {
-	if( ! mStartedRead )
-		fillBuffer( 1 );
+	checkHeaders();
+	return mResponseCode;
+}
+
+std::string	IStreamUrl::getEffectiveUrl() const
+{
+	checkHeaders();
+	return mEffectiveUrl;
+}
+
+size_t IStreamUrl::cachedAt( uint64_t offset ) const
+{
+	std::map<uint64_t,Block>::const_iterator blockIt = mBlocks.find( offset / BLOCK_SIZE );
+	if( blockIt == mBlocks.end() )
+		return 0;
+	size_t blockOffset = (size_t)( offset % BLOCK_SIZE );
+	return ( blockOffset < blockIt->second.mData.size() ) ? blockIt->second.mData.size() - blockOffset : 0;
+}
+
+size_t IStreamUrl::fillAt( uint64_t offset ) const
+{
+	size_t result = cachedAt( offset );
+	if( result > 0 )
+		return result;
+	if( ( mSize >= 0 ) && ( offset >= (uint64_t)mSize ) )
+		return 0;
+
+	// continue with the current transfer if the offset is just ahead of it, and otherwise start over there
+	if( ( offset < mTransferOffset ) || ( offset >= mTransferEnd ) || ( offset - mTransferOffset > READ_FORWARD_LIMIT + mTransfer->getBytesAvailable() ) ) {
+		// whether the server honors ranges is usually announced by the first response, so it's worth a look before deciding
+		if( mRangeSupport == RANGES_UNKNOWN )
+			checkHeaders();
+		// without ranges, skipping ahead through the current transfer beats starting over from the beginning
+		if( ( offset < mTransferOffset ) || ( offset >= mTransferEnd ) || ( mRangeSupport != RANGES_UNSUPPORTED ) ) {
+			// picking up right where a finished range left off is still a sequential read, so the next range keeps growing
+			const bool sequential = ( offset == mTransferEnd ) && ( mTransferOffset == mTransferEnd );
+			startTransfer( offset, sequential );
+		}
+	}
+
+	while( true ) {
+		result = cachedAt( offset );
+		if( result > 0 )
+			return result;
+
+		if( ! receive() ) {
+			if( mTransfer->hasFailed() )
+				throw UrlTransferExc( mTransfer->getError() );
+			else if( ! mTransferError.empty() )
+				throw UrlTransferExc( mTransferError );
+			else if( ( mTransferEnd != TRANSFER_OPEN ) && ( mTransferOffset == mTransferEnd ) && ( ( mSize < 0 ) || ( mTransferOffset < (uint64_t)mSize ) ) )
+				startTransfer( mTransferOffset, true ); // the range ran out before the reader did
+			else {
+				// the transfer ended short of where we expected, so whatever the headers claimed, this is where the resource ends
+				if( ( mSize < 0 ) || ( mTransferOffset < (uint64_t)mSize ) )
+					mSize = (int64_t)mTransferOffset;
+				return 0;
+			}
+		}
+	}
+}
+
+void IStreamUrl::startTransfer( uint64_t offset, bool sequential ) const
+{
+	if( mTransfer )
+		mTransfer->cancel();
+
+	// blocks only hold prefixes, so resume from the end of what's cached in offset's block
+	uint64_t blockIndex = offset / BLOCK_SIZE;
+	std::map<uint64_t,Block>::const_iterator blockIt = mBlocks.find( blockIndex );
+	uint64_t start = blockIndex * BLOCK_SIZE + ( ( blockIt != mBlocks.end() ) ? blockIt->second.mData.size() : 0 );
+
+	if( ! sequential )
+		mNextRangeLength = INITIAL_RANGE_LENGTH;
+
+	UrlTransfer::Options options( mOptions );
+	if( mRangeSupport != RANGES_UNSUPPORTED ) {
+		options.range( start, mNextRangeLength );
+		mTransferOffset = start;
+		mTransferEnd = start + mNextRangeLength;
+		mTransferRanged = true;
+		mNextRangeLength = std::min( mNextRangeLength * 2, MAX_RANGE_LENGTH );
+	}
+	else {
+		mTransferOffset = 0;
+		mTransferEnd = TRANSFER_OPEN;
+		mTransferRanged = false;
+	}
+
+	mHeadersChecked = false;
+	mTransferError.clear();
+	mTransfer = fetchUrlStream( mUrl, options );
+}
 
+void IStreamUrl::checkHeaders() const
+{
+	if( mHeadersChecked )
+		return;
+	mHeadersChecked = true;
+	if( ! mTransfer->waitForHeaders() )
+		return; // failed outright, which the next read reports
+
+	long responseCode = mTransfer->getResponseCode();
 	if( ! mResponseCode ) {
-		curl_easy_getinfo( mCurl, CURLINFO_RESPONSE_CODE, &mResponseCode );
+		mResponseCode = responseCode;
+		mEffectiveUrl = mTransfer->getEffectiveUrl();
+	}
+
+	// status codes only mean something for HTTP; other protocols report their own codes, or none
+	const std::string scheme = mUrl.str().substr( 0, mUrl.str().find( ':' ) );
+	const bool http = equalsNoCase( scheme, "http" ) || equalsNoCase( scheme, "https" );
+
+	if( ( responseCode == 206 ) || ( mTransferRanged && ( responseCode == 416 ) ) ) { // 416 is a range past the end
+		mRangeSupport = RANGES_SUPPORTED;
+		// Content-Range: bytes first-last/total, or bytes */total for a 416, where total may be '*'
+		std::string contentRange = mTransfer->getHeader( "Content-Range" );
+		std::string::size_type slash = contentRange.find( '/' );
+		if( ( mSize < 0 ) && ( slash != std::string::npos ) && ( slash + 1 < contentRange.size() ) && isdigit( (unsigned char)contentRange[slash + 1] ) )
+			mSize = (int64_t)strtod( contentRange.c_str() + slash + 1, 0 );
+
+		if( responseCode == 416 ) {
+			// the body is an error message rather than data, and the resource ends no later than where this range started
+			if( ( mSize < 0 ) || ( (uint64_t)mSize > mTransferOffset ) )
+				mSize = (int64_t)mTransferOffset;
+			mTransferEnd = mTransferOffset;
+		}
+		else {
+			// a server answering with some other range than the one asked for would scramble the cache
+			std::string::size_type first = contentRange.find_first_of( "0123456789" );
+			if( ( first == std::string::npos ) || ( first > slash ) || ( strtod( contentRange.c_str() + first, 0 ) != (double)mTransferOffset ) )
+				mTransferError = "Unexpected Content-Range: " + contentRange;
+		}
+	}
+	else {
+		if( mTransferRanged ) { // the range was ignored and the whole resource is on its way
+			mRangeSupport = RANGES_UNSUPPORTED;
+			mTransferOffset = 0;
+			mTransferEnd = TRANSFER_OPEN;
+			mTransferRanged = false;
+		}
+		else if( ( mRangeSupport == RANGES_UNKNOWN ) && equalsNoCase( mTransfer->getHeader( "Accept-Ranges" ), "bytes" ) )
+			mRangeSupport = RANGES_SUPPORTED;
+
+		if( http && ( responseCode != 200 ) ) {
+			std::ostringstream error;
+			error << "HTTP response " << responseCode;
+			mTransferError = error.str();
+		}
+		else if( ( mSize < 0 ) && ( responseCode == 200 ) && ( mTransfer->getContentLength() >= 0 ) )
+			mSize = mTransfer->getContentLength();
 	}
-	
-	return mResponseCode;
 }
 
-std::string	IStreamUrl::getEffectiveUrl() const
+bool IStreamUrl::receive() const
 {
-	if( ! mStartedRead )
-		fillBuffer( 1 );
+	checkHeaders();
+	// nothing more was asked for, or the body is an error message
+	if( ( mTransferOffset == mTransferEnd ) || ( ! mTransferError.empty() ) )
+		return false;
+
+	// read no further than the end of the block, so each read lands in a single block
+	const uint64_t blockIndex = mTransferOffset / BLOCK_SIZE;
+	const size_t blockOffset = (size_t)( mTransferOffset % BLOCK_SIZE );
+	size_t bytesRead = mTransfer->read( &mScratch[0], BLOCK_SIZE - blockOffset );
+	if( bytesRead == 0 )
+		return false;
+
+	// keep only what extends the block's prefix; anything before it is already cached
+	std::vector<uint8_t> &data = getBlock( blockIndex ).mData;
+	if( ( data.size() >= blockOffset ) && ( data.size() < blockOffset + bytesRead ) )
+		data.insert( data.end(), &mScratch[data.size() - blockOffset], &mScratch[0] + bytesRead );
+
+	mTransferOffset += bytesRead;
+	return true;
+}
 
-	if( ! mEffectiveUrl ) {
-		curl_easy_getinfo( mCurl, CURLINFO_EFFECTIVE_URL, &mEffectiveUrl ); 
+IStreamUrl::Block& IStreamUrl::getBlock( uint64_t blockIndex ) const
+{
+	std::map<uint64_t,Block>::iterator blockIt = mBlocks.find( blockIndex );
+	if( blockIt == mBlocks.end() ) {
+		// evict the least recently used block, sparing the ones being read from and written to
+		const uint64_t readBlockIndex = mPosition / BLOCK_SIZE;
+		while( mBlocks.size() >= MAX_BLOCKS ) {
+			std::map<uint64_t,Block>::iterator oldestIt = mBlocks.end();
+			for( std::map<uint64_t,Block>::iterator it = mBlocks.begin(); it != mBlocks.end(); ++it ) {
+				if( ( it->first != readBlockIndex ) && ( ( oldestIt == mBlocks.end() ) || ( it->second.mLastUse < oldestIt->second.mLastUse ) ) )
+					oldestIt = it;
+			}
+			mBlocks.erase( oldestIt );
+		}
+		blockIt = mBlocks.insert( std::make_pair( blockIndex, Block() ) ).first;
+		blockIt->second.mData.reserve( BLOCK_SIZE );
 	}
-	
-	return std::string( mEffectiveUrl );
+
+	blockIt->second.mLastUse = ++mUseCounter;
+	return blockIt->second;
+}
+
+void IStreamUrl::IORead( void *dest, size_t size )
+{
+	uint8_t *destBytes = reinterpret_cast<uint8_t*>( dest );
+	while( size > 0 ) {
+		size_t bytesRead = readDataAvailable( destBytes, size );
+		if( bytesRead == 0 )
+			throw StreamExc();
+		destBytes += bytesRead;
+		size -= bytesRead;
+	}
+}
+
+size_t IStreamUrl::readDataAvailable( void *dest, size_t maxSize )
+{
+	size_t available = fillAt( mPosition );
+	if( available < maxSize )
+		maxSize = available;
+	if( maxSize == 0 )
+		return 0;
+
+	Block &block = getBlock( mPosition / BLOCK_SIZE );
+	memcpy( dest, &block.mData[(size_t)( mPosition % BLOCK_SIZE )], maxSize );
+	mPosition += maxSize;
+	return maxSize;
 }
 
 IStreamUrlRef loadUrlStream( const Url &url )
 {
 	try {
-		IStreamUrlRef result = IStreamUrl::createRef( url.str(), "", "" );
+		IStreamUrlRef result = IStreamUrl::createRef( url );
 		return result;
 	}
 	catch( ... ) {
@@ -0,0 +1,444 @@
+/*
+ Copyright (c) 2010, The Barbarian Group
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cinder/UrlCache.h"
+#include "cinder/Stream.h"
+#include "cinder/Utilities.h"
+
+#include <ctime>
+#include <cstdio>
+#include <cerrno>
+
+#if defined( CINDER_MSW )
+	#include <windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+namespace cinder {
+
+namespace {
+const uint32_t INDEX_MAGIC = 0x43556943; // "CiUC"
+const uint32_t INDEX_VERSION = 1;
+const char *INDEX_FILE_NAME = "index";
+
+// Returns false only if the file exists but couldn't be deleted
+bool deleteFile( const std::string &path )
+{
+#if defined( CINDER_MSW )
+	if( ::DeleteFileW( toUtf16( path ).c_str() ) )
+		return true;
+	DWORD error = ::GetLastError();
+	return ( error == ERROR_FILE_NOT_FOUND ) || ( error == ERROR_PATH_NOT_FOUND );
+#else
+	return ( ::unlink( path.c_str() ) == 0 ) || ( errno == ENOENT );
+#endif
+}
+
+bool replaceFile( const std::string &fromPath, const std::string &toPath )
+{
+#if defined( CINDER_MSW )
+	return ::MoveFileExW( toUtf16( fromPath ).c_str(), toUtf16( toPath ).c_str(), MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+	return ::rename( fromPath.c_str(), toPath.c_str() ) == 0;
+#endif
+}
+
+void writeString( OStreamRef stream, const std::string &s )
+{
+	stream->writeLittle( (uint32_t)s.size() );
+	// OStreamFile treats writing nothing as a failed write, and an entry without an ETag or Last-Modified has empty strings
+	if( ! s.empty() )
+		stream->writeData( s.data(), s.size() );
+}
+
+std::string readString( IStreamRef stream )
+{
+	uint32_t size;
+	stream->readLittle( &size );
+	std::string result;
+	stream->readFixedString( &result, size );
+	return result;
+}
+} // anonymous namespace
+
+UrlCacheRef		UrlCache::sDefault;
+boost::mutex	UrlCache::sDefaultMutex;
+
+UrlCacheRef UrlCache::createRef( const std::string &directory, uint64_t maxSize )
+{
+	return UrlCacheRef( new UrlCache( directory, maxSize ) );
+}
+
+UrlCache::UrlCache( const std::string &directory, uint64_t maxSize )
+	: mDirectory( directory ), mTotalSize( 0 ), mMaxSize( maxSize ), mMaxAge( 0 ), mAccessCounter( 0 ), mNextFileId( 0 ), mIndexDirty( false )
+{
+	createDirectories( mDirectory );
+	loadIndex();
+}
+
+UrlCache::~UrlCache()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	if( mIndexDirty ) {
+		try {
+			saveIndexLocked();
+		}
+		catch( ... ) {
+		}
+	}
+}
+
+void UrlCache::setDefault( UrlCacheRef cache )
+{
+	boost::mutex::scoped_lock lock( sDefaultMutex );
+	sDefault = cache;
+}
+
+UrlCacheRef UrlCache::getDefault()
+{
+	boost::mutex::scoped_lock lock( sDefaultMutex );
+	return sDefault;
+}
+
+Buffer UrlCache::fetchBuffer( const Url &url )
+{
+	const std::string key = url.str();
+
+	UrlTransfer::Options options;
+	bool haveCached = false;
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		std::map<std::string,Entry>::iterator entryIt = mEntries.find( key );
+		if( entryIt != mEntries.end() ) {
+			// a negative age means the clock has moved backwards since, so the entry's age is unknown and it's revalidated
+			const double age = difftime( time( 0 ), (time_t)entryIt->second.mValidatedTime );
+			if( ( mMaxAge > 0 ) && ( age >= 0 ) && ( age < mMaxAge ) ) {
+				Buffer result = mapEntryLocked( key, &entryIt->second );
+				if( result )
+					return result;
+			}
+			else {
+				haveCached = true;
+				if( ! entryIt->second.mETag.empty() )
+					options.header( "If-None-Match: " + entryIt->second.mETag );
+				if( ! entryIt->second.mLastModified.empty() )
+					options.header( "If-Modified-Since: " + entryIt->second.mLastModified );
+			}
+		}
+	}
+
+	UrlTransferRef transfer = fetchUrlStream( url, options );
+	long responseCode = transfer->waitForHeaders() ? transfer->getResponseCode() : 0;
+
+	if( haveCached && ( ( responseCode == 304 ) || ( responseCode == 0 ) || ( responseCode >= 500 ) ) ) {
+		// unchanged, or the server is unreachable and a stale copy beats nothing
+		{
+			boost::mutex::scoped_lock lock( mMutex );
+			std::map<std::string,Entry>::iterator entryIt = mEntries.find( key );
+			if( entryIt != mEntries.end() ) {
+				if( responseCode == 304 )
+					entryIt->second.mValidatedTime = (int64_t)time( 0 );
+				Buffer result = mapEntryLocked( key, &entryIt->second );
+				if( result ) {
+					transfer->cancel();
+					return result;
+				}
+			}
+		}
+		// the cached file has gone missing; mapEntryLocked() dropped the entry so this downloads unconditionally
+		if( responseCode == 304 )
+			return fetchBuffer( url );
+	}
+
+	if( responseCode != 200 ) {
+		// not cacheable, so hand back the response as-is
+		Buffer result( 16 * 1024 );
+		size_t dataSize = 0;
+		while( true ) {
+			if( dataSize == result.getAllocatedSize() )
+				result.resize( dataSize * 2 );
+			size_t bytesRead = transfer->read( reinterpret_cast<uint8_t*>( result.getData() ) + dataSize, result.getAllocatedSize() - dataSize );
+			if( bytesRead == 0 )
+				break;
+			dataSize += bytesRead;
+		}
+		if( transfer->hasFailed() )
+			throw UrlTransferExc( transfer->getError() );
+		result.setDataSize( dataSize );
+		return result;
+	}
+
+	std::string fileName;
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		char name[32];
+		sprintf( name, "%016llx.data", (unsigned long long)mNextFileId++ );
+		fileName = name;
+		mIndexDirty = true;
+	}
+
+	uint64_t size = 0;
+	{
+		OStreamFileRef file = writeFileStream( getPath( fileName ), false );
+		if( ! file )
+			throw UrlTransferExc( "Unable to create cache file " + getPath( fileName ) );
+		try {
+			std::vector<uint8_t> chunk( 64 * 1024 );
+			while( size_t bytesRead = transfer->read( &chunk[0], chunk.size() ) ) {
+				file->writeData( &chunk[0], bytesRead );
+				size += bytesRead;
+			}
+		}
+		catch( ... ) {
+			file.reset();
+			deleteFile( getPath( fileName ) );
+			throw;
+		}
+	}
+
+	if( transfer->hasFailed() || ( size == 0 ) ) {
+		deleteFile( getPath( fileName ) );
+		if( transfer->hasFailed() )
+			throw UrlTransferExc( transfer->getError() );
+		// an empty file can't be mapped, and there's nothing worth caching anyway
+		Buffer result( 1 );
+		result.setDataSize( 0 );
+		return result;
+	}
+
+	boost::mutex::scoped_lock lock( mMutex );
+	std::map<std::string,Entry>::iterator entryIt = mEntries.find( key );
+	if( entryIt != mEntries.end() )
+		removeEntryLocked( entryIt );
+
+	Entry &entry = mEntries[key];
+	entry.mFileName = fileName;
+	entry.mETag = transfer->getHeader( "ETag" );
+	entry.mLastModified = transfer->getHeader( "Last-Modified" );
+	entry.mSize = size;
+	entry.mLastAccess = ++mAccessCounter;
+	entry.mValidatedTime = (int64_t)time( 0 );
+	mTotalSize += size;
+	evictLocked( mMaxSize, key );
+
+	Buffer result = mapEntryLocked( key, &entry );
+	// a single response larger than the whole cache is still returned, but not kept
+	if( result && ( size > mMaxSize ) )
+		removeEntryLocked( mEntries.find( key ) );
+	saveIndexLocked();
+
+	if( ! result )
+		throw UrlTransferExc( "Unable to map cache file " + getPath( fileName ) );
+	return result;
+}
+
+bool UrlCache::contains( const Url &url ) const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mEntries.find( url.str() ) != mEntries.end();
+}
+
+void UrlCache::remove( const Url &url )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	std::map<std::string,Entry>::iterator entryIt = mEntries.find( url.str() );
+	if( entryIt != mEntries.end() ) {
+		removeEntryLocked( entryIt );
+		saveIndexLocked();
+	}
+}
+
+void UrlCache::clear()
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	while( ! mEntries.empty() )
+		removeEntryLocked( mEntries.begin() );
+	saveIndexLocked();
+}
+
+uint64_t UrlCache::getSize() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mTotalSize;
+}
+
+uint64_t UrlCache::getMaxSize() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mMaxSize;
+}
+
+void UrlCache::setMaxSize( uint64_t maxSize )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	mMaxSize = maxSize;
+	evictLocked( mMaxSize, "" );
+	if( mIndexDirty )
+		saveIndexLocked();
+}
+
+double UrlCache::getMaxAge() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mMaxAge;
+}
+
+void UrlCache::setMaxAge( double seconds )
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	mMaxAge = seconds;
+}
+
+Buffer UrlCache::mapEntryLocked( const std::string &url, Entry *entry )
+{
+	IStreamMmapRef stream = loadFileStreamMmap( getPath( entry->mFileName ) );
+	if( ( ! stream ) || ( stream->getDataSize() != entry->mSize ) ) { // deleted or truncated behind our back
+		removeEntryLocked( mEntries.find( url ) );
+		return Buffer();
+	}
+
+	// the access order is only saved along with the next change, rather than rewriting the index on every hit
+	entry->mLastAccess = ++mAccessCounter;
+	mIndexDirty = true;
+	return stream->getBuffer();
+}
+
+void UrlCache::removeEntryLocked( std::map<std::string,Entry>::iterator entryIt )
+{
+	mTotalSize -= entryIt->second.mSize;
+	deleteFileLocked( entryIt->second.mFileName );
+	mEntries.erase( entryIt );
+	mIndexDirty = true;
+}
+
+void UrlCache::evictLocked( uint64_t maxSize, const std::string &keepUrl )
+{
+	while( mTotalSize > maxSize ) {
+		std::map<std::string,Entry>::iterator oldestIt = mEntries.end();
+		for( std::map<std::string,Entry>::iterator entryIt = mEntries.begin(); entryIt != mEntries.end(); ++entryIt ) {
+			if( ( entryIt->first != keepUrl ) && ( ( oldestIt == mEntries.end() ) || ( entryIt->second.mLastAccess < oldestIt->second.mLastAccess ) ) )
+				oldestIt = entryIt;
+		}
+		if( oldestIt == mEntries.end() )
+			break;
+		removeEntryLocked( oldestIt );
+	}
+}
+
+void UrlCache::deleteFileLocked( const std::string &fileName )
+{
+	if( ! deleteFile( getPath( fileName ) ) )
+		mPendingDeletes.push_back( fileName );
+}
+
+std::string UrlCache::getPath( const std::string &fileName ) const
+{
+	return mDirectory + getPathSeparator() + fileName;
+}
+
+void UrlCache::loadIndex()
+{
+	IStreamRef stream = loadFileStream( getPath( INDEX_FILE_NAME ) );
+	if( ! stream ) {
+		// without an index any files left in the directory are unknown, so start numbering well clear of them
+		mNextFileId = (uint64_t)time( 0 ) << 16;
+		return;
+	}
+
+	try {
+		uint32_t magic, version;
+		stream->readLittle( &magic );
+		stream->readLittle( &version );
+		if( ( magic != INDEX_MAGIC ) || ( version != INDEX_VERSION ) )
+			throw StreamExc();
+		stream->readLittle( &mAccessCounter );
+		stream->readLittle( &mNextFileId );
+
+		uint32_t numEntries;
+		stream->readLittle( &numEntries );
+		for( uint32_t e = 0; e < numEntries; ++e ) {
+			std::string url = readString( stream );
+			Entry entry;
+			entry.mFileName = readString( stream );
+			entry.mETag = readString( stream );
+			entry.mLastModified = readString( stream );
+			stream->readLittle( &entry.mSize );
+			stream->readLittle( &entry.mLastAccess );
+			stream->readLittle( &entry.mValidatedTime );
+			mEntries[url] = entry;
+			mTotalSize += entry.mSize;
+		}
+
+		uint32_t numPendingDeletes;
+		stream->readLittle( &numPendingDeletes );
+		for( uint32_t p = 0; p < numPendingDeletes; ++p )
+			mPendingDeletes.push_back( readString( stream ) );
+	}
+	catch( ... ) { // an unreadable index just means a cold cache
+		mEntries.clear();
+		mPendingDeletes.clear();
+		mTotalSize = 0;
+		mNextFileId = (uint64_t)time( 0 ) << 16;
+		return;
+	}
+
+	// retry deleting files which were still in use last time
+	std::vector<std::string> pendingDeletes;
+	pendingDeletes.swap( mPendingDeletes );
+	for( std::vector<std::string>::const_iterator fileIt = pendingDeletes.begin(); fileIt != pendingDeletes.end(); ++fileIt )
+		deleteFileLocked( *fileIt );
+	mIndexDirty = pendingDeletes.size() != mPendingDeletes.size();
+}
+
+void UrlCache::saveIndexLocked()
+{
+	const std::string tempPath = getPath( std::string( INDEX_FILE_NAME ) + ".tmp" );
+	{
+		OStreamFileRef stream = writeFileStream( tempPath, false );
+		if( ! stream )
+			return;
+		stream->writeLittle( INDEX_MAGIC );
+		stream->writeLittle( INDEX_VERSION );
+		stream->writeLittle( mAccessCounter );
+		stream->writeLittle( mNextFileId );
+		stream->writeLittle( (uint32_t)mEntries.size() );
+		for( std::map<std::string,Entry>::const_iterator entryIt = mEntries.begin(); entryIt != mEntries.end(); ++entryIt ) {
+			writeString( stream, entryIt->first );
+			writeString( stream, entryIt->second.mFileName );
+			writeString( stream, entryIt->second.mETag );
+			writeString( stream, entryIt->second.mLastModified );
+			stream->writeLittle( entryIt->second.mSize );
+			stream->writeLittle( entryIt->second.mLastAccess );
+			stream->writeLittle( entryIt->second.mValidatedTime );
+		}
+		stream->writeLittle( (uint32_t)mPendingDeletes.size() );
+		for( std::vector<std::string>::const_iterator fileIt = mPendingDeletes.begin(); fileIt != mPendingDeletes.end(); ++fileIt )
+			writeString( stream, *fileIt );
+	}
+
+	// written aside and swapped in, so a crash mid-write leaves the previous index intact
+	if( replaceFile( tempPath, getPath( INDEX_FILE_NAME ) ) )
+		mIndexDirty = false;
+}
+
+} // namespace cinder
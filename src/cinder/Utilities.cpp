@@ -320,6 +320,14 @@ uint32_t swapEndian( uint32_t val ) {
 					 (((uint32_t) (val) & (uint32_t) 0xFF000000U) >> 24));
 }
 
+int64_t swapEndian( int64_t val ) {
+	return static_cast<int64_t>( swapEndian( static_cast<uint64_t>( val ) ) );
+}
+
+uint64_t swapEndian( uint64_t val ) {
+	return ( static_cast<uint64_t>( swapEndian( static_cast<uint32_t>( val ) ) ) << 32 ) | swapEndian( static_cast<uint32_t>( val >> 32 ) );
+}
+
 float swapEndian( float val ) { 
 	uint32_t temp = swapEndian( * reinterpret_cast<uint32_t*>( &val ) );
 	return *(reinterpret_cast<float*>( &temp ) );
@@ -339,24 +347,72 @@ double swapEndian( double val ) {
 	return s2.d;
 }
 
-void swapEndianBlock( uint16_t *blockPtr, size_t blockSizeInBytes )
+// The block swaps operate on plain unsigned words with no calls or branches in the loop body,
+// which lets the compiler turn them into byte shuffles over several elements at a time
+static void swapEndianBlock16( uint16_t *blockPtr, size_t count )
 {
-	size_t blockSize = blockSizeInBytes / sizeof(uint16_t);
+	for( size_t b = 0; b < count; b++ ) {
+		uint16_t v = blockPtr[b];
+		blockPtr[b] = (uint16_t)( ( v << 8 ) | ( v >> 8 ) );
+	}
+}
 
-	for( size_t b = 0; b < blockSize; b++ ) {
-		*blockPtr = swapEndian( *blockPtr );
-		blockPtr++;
+static void swapEndianBlock32( uint32_t *blockPtr, size_t count )
+{
+	for( size_t b = 0; b < count; b++ ) {
+		uint32_t v = blockPtr[b];
+		blockPtr[b] = ( v << 24 ) | ( ( v << 8 ) & 0x00FF0000U ) | ( ( v >> 8 ) & 0x0000FF00U ) | ( v >> 24 );
 	}
 }
 
+static void swapEndianBlock64( uint64_t *blockPtr, size_t count )
+{
+	for( size_t b = 0; b < count; b++ ) {
+		uint64_t v = blockPtr[b];
+		v = ( ( v << 8 ) & 0xFF00FF00FF00FF00ULL ) | ( ( v >> 8 ) & 0x00FF00FF00FF00FFULL );
+		v = ( ( v << 16 ) & 0xFFFF0000FFFF0000ULL ) | ( ( v >> 16 ) & 0x0000FFFF0000FFFFULL );
+		blockPtr[b] = ( v << 32 ) | ( v >> 32 );
+	}
+}
+
+void swapEndianBlock( int16_t *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock16( reinterpret_cast<uint16_t*>( blockPtr ), blockSizeInBytes / sizeof(int16_t) );
+}
+
+void swapEndianBlock( uint16_t *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock16( blockPtr, blockSizeInBytes / sizeof(uint16_t) );
+}
+
+void swapEndianBlock( int32_t *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock32( reinterpret_cast<uint32_t*>( blockPtr ), blockSizeInBytes / sizeof(int32_t) );
+}
+
+void swapEndianBlock( uint32_t *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock32( blockPtr, blockSizeInBytes / sizeof(uint32_t) );
+}
+
+void swapEndianBlock( int64_t *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock64( reinterpret_cast<uint64_t*>( blockPtr ), blockSizeInBytes / sizeof(int64_t) );
+}
+
+void swapEndianBlock( uint64_t *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock64( blockPtr, blockSizeInBytes / sizeof(uint64_t) );
+}
+
 void swapEndianBlock( float *blockPtr, size_t blockSizeInBytes )
 {
-	size_t blockSize = blockSizeInBytes / sizeof(float);
+	swapEndianBlock32( reinterpret_cast<uint32_t*>( blockPtr ), blockSizeInBytes / sizeof(float) );
+}
 
-	for( size_t b = 0; b < blockSize; b++ ) {
-		*(reinterpret_cast<uint32_t*>(blockPtr)) = swapEndian( *(reinterpret_cast<uint32_t*>(blockPtr)) );
-		blockPtr++;
-	}
+void swapEndianBlock( double *blockPtr, size_t blockSizeInBytes )
+{
+	swapEndianBlock64( reinterpret_cast<uint64_t*>( blockPtr ), blockSizeInBytes / sizeof(double) );
 }
 
 } // namespace cinder
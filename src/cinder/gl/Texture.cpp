@@ -23,6 +23,7 @@
 #include "cinder/gl/gl.h" // has to be first
 #include "cinder/ImageIo.h"
 #include "cinder/gl/Texture.h"
+#include "cinder/gl/Vbo.h"
 #include <stdio.h>
 
 using namespace std;
@@ -383,6 +384,47 @@ void Texture::init( ImageSourceRef imageSource, const Format &format )
 	}	
 
 	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+#if ! defined( CINDER_GLES )
+	// when we have pixel buffer objects, decode straight into driver memory to avoid an intermediate copy of the pixels
+	if( GLEE_ARB_pixel_buffer_object ) {
+		ImageIo::DataType dataType;
+		GLenum type;
+		switch( imageSource->getDataType() ) {
+			case ImageIo::UINT8: dataType = ImageIo::UINT8; type = GL_UNSIGNED_BYTE; break;
+			case ImageIo::UINT16: dataType = ImageIo::UINT16; type = GL_UNSIGNED_SHORT; break;
+			default: dataType = ImageIo::FLOAT32; type = GL_FLOAT; break;
+		}
+		int32_t rowBytes = mObj->mWidth * ImageIo::channelOrderNumChannels( channelOrder ) * ImageIo::dataTypeBytes( dataType );
+		Vbo pbo( GL_PIXEL_UNPACK_BUFFER_ARB );
+		pbo.bufferData( rowBytes * mObj->mHeight, NULL, GL_STREAM_DRAW );
+		uint8_t *pixels = pbo.map( GL_WRITE_ONLY );
+		if( pixels ) {
+			bool lost = false;
+			try {
+				imageSource->load( ImageTargetMemory::createRef( pixels, mObj->mWidth, mObj->mHeight, rowBytes, dataType, isGray ? ImageIo::CM_GRAY : ImageIo::CM_RGB, channelOrder ) );
+				pbo.unmap();
+			}
+			catch( VboFailedUnmapExc & ) {
+				lost = true;
+			}
+			catch( ... ) {
+				try { pbo.unmap(); } catch( VboFailedUnmapExc & ) {}
+				pbo.unbind();
+				throw;
+			}
+			// the buffer's contents were lost, as on a display mode change. The source has already been consumed and can't be loaded a second time.
+			if( lost ) {
+				pbo.unbind();
+				throw TextureDataExc( "Texture's pixel buffer was lost while loading the ImageSource" );
+			}
+			glTexImage2D( mObj->mTarget, 0, mObj->mInternalFormat, mObj->mWidth, mObj->mHeight, 0, dataFormat, type, 0 );
+			pbo.unbind();
+			return;
+		}
+		pbo.unbind();
+	}
+#endif
+
 	if( imageSource->getDataType() == ImageIo::UINT8 ) {
 		shared_ptr<ImageTargetGLTexture<uint8_t> > target = ImageTargetGLTexture<uint8_t>::createRef( this, channelOrder, isGray, imageSource->hasAlpha() );
 		imageSource->load( target );
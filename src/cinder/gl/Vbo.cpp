@@ -21,6 +21,7 @@
 */
 
 #include "cinder/gl/Vbo.h"
+#include <algorithm>
 #include <sstream>
 
 using std::vector;
@@ -28,6 +29,19 @@ using std::pair;
 
 namespace cinder { namespace gl {
 
+namespace {
+
+// Copies up to \a count of \a elements to every \a stride bytes of \a dest
+template<typename T>
+void copyStrided( const vector<T> &elements, size_t count, uint8_t *dest, size_t stride )
+{
+	count = std::min( count, elements.size() );
+	for( size_t i = 0; i < count; ++i, dest += stride )
+		*reinterpret_cast<T*>( dest ) = elements[i];
+}
+
+} // anonymous namespace
+
 //enum { CUSTOM_ATTR_FLOAT, CUSTOM_ATTR_FLOAT2, CUSTOM_ATTR_FLOAT3, CUSTOM_ATTR_FLOAT4, TOTAL_CUSTOM_ATTR_TYPES };
 int		VboMesh::Layout::sCustomAttrSizes[TOTAL_CUSTOM_ATTR_TYPES] = { 4, 8, 12, 16 };
 GLint	VboMesh::Layout::sCustomAttrNumComponents[TOTAL_CUSTOM_ATTR_TYPES] = { 1, 2, 3, 4 };
@@ -108,10 +122,17 @@ bool VboMesh::Layout::hasDynamicTexCoords() const
 VboMesh::VboMesh( const TriMesh &triMesh, Layout layout )
 	: mObj( shared_ptr<Obj>( new Obj ) )
 {
+	mObj->mLayout = layout;
 	if( layout.isDefaults() ) { // we need to start by preparing our layout
-		if( triMesh.hasNormals() )
+		// an interleaved mesh is expected to hold what should be drawn, except for tangents, which would need a custom attribute location
+		const uint32_t interleaved = triMesh.getInterleavedAttributes();
+		if( triMesh.isInterleaved() ? ( interleaved & TriMesh::INTERLEAVE_NORMALS ) : triMesh.hasNormals() )
 			mObj->mLayout.setStaticNormals();
-		if( triMesh.hasTexCoords() )
+		if( triMesh.isInterleaved() ? ( interleaved & TriMesh::INTERLEAVE_COLORS_RGB ) : triMesh.hasColorsRGB() )
+			mObj->mLayout.setStaticColorsRGB();
+		else if( triMesh.isInterleaved() ? ( interleaved & TriMesh::INTERLEAVE_COLORS_RGBA ) : triMesh.hasColorsRGBA() )
+			mObj->mLayout.setStaticColorsRGBA();
+		if( triMesh.isInterleaved() ? ( interleaved & TriMesh::INTERLEAVE_TEXCOORDS ) : triMesh.hasTexCoords() )
 			mObj->mLayout.setStaticTexCoords2d();
 		mObj->mLayout.setStaticIndices();
 		mObj->mLayout.setStaticPositions();
@@ -120,37 +141,40 @@ VboMesh::VboMesh( const TriMesh &triMesh, Layout layout )
 	mObj->mPrimitiveType = GL_TRIANGLES;
 	mObj->mNumIndices = triMesh.getNumIndices();
 	mObj->mNumVertices = triMesh.getNumVertices();
+	mObj->mIndexType = ( triMesh.hasShortIndices() ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
 
 	initializeBuffers( false );
 			
 	// upload the indices
-	getIndexVbo().bufferData( sizeof(uint32_t) * triMesh.getNumIndices(), &(triMesh.getIndices()[0]), (mObj->mLayout.hasStaticIndices()) ? GL_STATIC_DRAW : GL_STREAM_DRAW );
+	bufferIndices( triMesh.getIndices() );
 	
-	// upload the verts
+	// upload the verts, in a single copy if the mesh has already interleaved them the same way
+	const bool staticInterleaved = mObj->mBuffers[STATIC_BUFFER] && matchesInterleaved( triMesh );
+	if( staticInterleaved && ( mObj->mNumVertices > 0 ) )
+		mObj->mBuffers[STATIC_BUFFER].bufferSubData( 0, mObj->mStaticStride * mObj->mNumVertices, triMesh.getInterleavedData() );
+
+	const Layout &meshLayout = mObj->mLayout;
 	for( int buffer = STATIC_BUFFER; buffer <= DYNAMIC_BUFFER; ++buffer ) {
-		if( ! mObj->mBuffers[buffer] )
+		if( ( ! mObj->mBuffers[buffer] ) || ( ( buffer == STATIC_BUFFER ) && staticInterleaved ) )
 			continue;
 		
+		const int usage = ( buffer == STATIC_BUFFER ) ? STATIC : DYNAMIC;
+		const size_t stride = ( buffer == STATIC_BUFFER ) ? mObj->mStaticStride : mObj->mDynamicStride;
 		uint8_t *ptr = mObj->mBuffers[buffer].map( GL_WRITE_ONLY );
-		
-		bool copyPosition = ( buffer == STATIC_BUFFER ) ? mObj->mLayout.hasStaticPositions() : mObj->mLayout.hasDynamicPositions();
-		bool copyNormal = ( ( buffer == STATIC_BUFFER ) ? mObj->mLayout.hasStaticNormals() : mObj->mLayout.hasDynamicNormals() ) && triMesh.hasNormals();
-		bool copyTexCoord2D = ( ( buffer == STATIC_BUFFER ) ? mObj->mLayout.hasStaticTexCoords2d() : mObj->mLayout.hasDynamicTexCoords2d() ) && triMesh.hasTexCoords();
-		
-		for( size_t v = 0; v < mObj->mNumVertices; ++v ) {
-			if( copyPosition ) {
-				*(reinterpret_cast<Vec3f*>(ptr)) = triMesh.getVertices()[v];
-				ptr += sizeof( Vec3f );
-			}
-			if( copyNormal ) {
-				*(reinterpret_cast<Vec3f*>(ptr)) = triMesh.getNormals()[v];
-				ptr += sizeof( Vec3f );
-			}
-			if( copyTexCoord2D ) {
-				*(reinterpret_cast<Vec2f*>(ptr)) = triMesh.getTexCoords()[v];
-				ptr += sizeof( Vec2f );
-			}
-		}
+
+		// each attribute is copied in its own loop, at the offset initializeBuffers() gave it
+		if( meshLayout.mAttributes[ATTR_POSITIONS] == usage )
+			copyStrided( triMesh.getVertices(), mObj->mNumVertices, ptr + mObj->mPositionOffset, stride );
+		if( meshLayout.mAttributes[ATTR_NORMALS] == usage )
+			copyStrided( triMesh.getNormals(), mObj->mNumVertices, ptr + mObj->mNormalOffset, stride );
+		if( meshLayout.mAttributes[ATTR_COLORS_RGB] == usage )
+			copyStrided( triMesh.getColorsRGB(), mObj->mNumVertices, ptr + mObj->mColorRGBOffset, stride );
+		else if( meshLayout.mAttributes[ATTR_COLORS_RGBA] == usage )
+			copyStrided( triMesh.getColorsRGBA(), mObj->mNumVertices, ptr + mObj->mColorRGBAOffset, stride );
+		if( meshLayout.mAttributes[ATTR_TEXCOORDS2D_0] == usage )
+			copyStrided( triMesh.getTexCoords(), mObj->mNumVertices, ptr + mObj->mTexCoordOffset[0], stride );
+		if( ( buffer == STATIC_BUFFER ) && ( ! meshLayout.mCustomStatic.empty() ) && ( meshLayout.mCustomStatic[0].first == Layout::CUSTOM_ATTR_FLOAT4 ) )
+			copyStrided( triMesh.getTangents(), mObj->mNumVertices, ptr + meshLayout.mCustomStatic[0].second, stride );
 		
 		mObj->mBuffers[buffer].unmap();
 	}
@@ -165,6 +189,7 @@ VboMesh::VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum p
 	mObj->mPrimitiveType = primitiveType;
 	mObj->mNumIndices = numIndices;
 	mObj->mNumVertices = numVertices;
+	mObj->mIndexType = GL_UNSIGNED_INT;
 
 	initializeBuffers( true );
 	
@@ -175,13 +200,16 @@ VboMesh::VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum p
 	unbindBuffers();	
 }
 
-VboMesh::VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum primitiveType, Vbo *indexBuffer, Vbo *staticBuffer, Vbo *dynamicBuffer )
+VboMesh::VboMesh( size_t numVertices, size_t numIndices, Layout layout, GLenum primitiveType, Vbo *indexBuffer, Vbo *staticBuffer, Vbo *dynamicBuffer, GLenum indexType )
 	: mObj( shared_ptr<Obj>( new Obj ) )
 {
 	mObj->mLayout = layout;
 	mObj->mPrimitiveType = primitiveType;
 	mObj->mNumIndices = numIndices;
 	mObj->mNumVertices = numVertices;
+	if( ( indexType != GL_UNSIGNED_SHORT ) && ( indexType != GL_UNSIGNED_INT ) )
+		throw VboInvalidIndexTypeExc();
+	mObj->mIndexType = indexType;
 
 	if( indexBuffer ) {
 		mObj->mBuffers[INDEX_BUFFER] = *indexBuffer;
@@ -366,6 +394,36 @@ void VboMesh::initializeBuffers( bool staticDataPlanar )
 		mObj->mCustomDynamicLocations = vector<GLint>( mObj->mLayout.mCustomDynamic.size(), -1 );
 }
 
+// Returns whether the static buffer holds exactly the attributes of \a triMesh's interleaved vertex buffer, which puts them at the same offsets
+bool VboMesh::matchesInterleaved( const TriMesh &triMesh ) const
+{
+	const Layout &layout = mObj->mLayout;
+	if( ( ! triMesh.isInterleaved() ) || ( mObj->mStaticStride != triMesh.getInterleavedStride() ) )
+		return false;
+	for( size_t t = 0; t <= ATTR_MAX_TEXTURE_UNIT; ++t ) {
+		if( layout.hasStaticTexCoords3d( t ) || ( ( t > 0 ) && layout.hasStaticTexCoords2d( t ) ) )
+			return false;
+	}
+	if( ( layout.mCustomStatic.size() > 1 ) || ( ( layout.mCustomStatic.size() == 1 ) && ( layout.mCustomStatic[0].first != Layout::CUSTOM_ATTR_FLOAT4 ) ) )
+		return false;
+
+	uint32_t attributes = 0;
+	if( layout.hasStaticPositions() )
+		attributes |= TriMesh::INTERLEAVE_POSITIONS;
+	if( layout.hasStaticNormals() )
+		attributes |= TriMesh::INTERLEAVE_NORMALS;
+	if( layout.hasStaticColorsRGB() )
+		attributes |= TriMesh::INTERLEAVE_COLORS_RGB;
+	if( layout.hasStaticColorsRGBA() )
+		attributes |= TriMesh::INTERLEAVE_COLORS_RGBA;
+	if( layout.hasStaticTexCoords2d( 0 ) )
+		attributes |= TriMesh::INTERLEAVE_TEXCOORDS;
+	if( ! layout.mCustomStatic.empty() )
+		attributes |= TriMesh::INTERLEAVE_TANGENTS;
+
+	return attributes == triMesh.getInterleavedAttributes();
+}
+
 void VboMesh::enableClientStates() const
 {
 	if( mObj->mLayout.hasPositions() )
@@ -494,7 +552,15 @@ void VboMesh::unbindBuffers()
 
 void VboMesh::bufferIndices( const std::vector<uint32_t> &indices )
 {
-	mObj->mBuffers[INDEX_BUFFER].bufferData( sizeof(uint32_t) * indices.size(), &(indices[0]), (mObj->mLayout.hasStaticIndices()) ? GL_STATIC_DRAW : GL_STREAM_DRAW );
+	GLenum usage = ( mObj->mLayout.hasStaticIndices() ) ? GL_STATIC_DRAW : GL_STREAM_DRAW;
+	if( indices.empty() )
+		mObj->mBuffers[INDEX_BUFFER].bufferData( 0, NULL, usage );
+	else if( mObj->mIndexType == GL_UNSIGNED_SHORT ) {
+		vector<uint16_t> shortIndices( indices.begin(), indices.end() );
+		mObj->mBuffers[INDEX_BUFFER].bufferData( sizeof(uint16_t) * shortIndices.size(), &shortIndices[0], usage );
+	}
+	else
+		mObj->mBuffers[INDEX_BUFFER].bufferData( sizeof(uint32_t) * indices.size(), &indices[0], usage );
 }
 
 void VboMesh::bufferPositions( const std::vector<Vec3f> &positions )
@@ -611,4 +677,326 @@ VboMesh::VertexIter::Obj::~Obj()
 	mVbo.unbind();
 }
 
+
+struct VboMeshBatch::Obj {
+	struct Page {
+		Vbo			mVertices, mIndices;
+		size_t		mVertexCapacity, mIndexCapacity;
+		size_t		mNumVertices, mNumIndices;
+		GLenum		mIndexType;
+	};
+
+	// a range of a page's vertices and indices, which is either a single mesh or several adjacent ones
+	struct Range {
+		size_t		mPage;
+		size_t		mFirstVertex, mNumVertices;
+		size_t		mFirstIndex, mNumIndices;
+	};
+
+	static bool rangeLess( const Range &a, const Range &b ) { return ( a.mPage < b.mPage ) || ( ( a.mPage == b.mPage ) && ( a.mFirstIndex < b.mFirstIndex ) ); }
+
+	void	bindPage( size_t page )
+	{
+		if( mBoundPage == page )
+			return;
+		mPages[page].mVertices.bind();
+		mPages[page].mIndices.bind();
+		mStats.mBufferBinds += 2;
+
+		glVertexPointer( 3, GL_FLOAT, mStride, 0 );
+		++mStats.mPointerSetups;
+		if( mLayout.hasStaticNormals() ) {
+			glNormalPointer( GL_FLOAT, mStride, (const GLvoid*)mNormalOffset );
+			++mStats.mPointerSetups;
+		}
+		if( mLayout.hasStaticColorsRGB() || mLayout.hasStaticColorsRGBA() ) {
+			glColorPointer( mLayout.hasStaticColorsRGB() ? 3 : 4, GL_FLOAT, mStride, (const GLvoid*)mColorOffset );
+			++mStats.mPointerSetups;
+		}
+		if( mLayout.hasStaticTexCoords2d( 0 ) ) {
+			glClientActiveTexture( GL_TEXTURE0 );
+			glTexCoordPointer( 2, GL_FLOAT, mStride, (const GLvoid*)mTexCoordOffset );
+			++mStats.mPointerSetups;
+		}
+		mBoundPage = page;
+	}
+
+	void	drawRange( const Range &range )
+	{
+		if( range.mNumIndices == 0 )
+			return;
+		const Page &page = mPages[range.mPage];
+		bindPage( range.mPage );
+		const size_t indexSize = ( page.mIndexType == GL_UNSIGNED_SHORT ) ? sizeof(uint16_t) : sizeof(uint32_t);
+		glDrawRangeElements( GL_TRIANGLES, range.mFirstVertex, range.mFirstVertex + std::max<size_t>( range.mNumVertices, 1 ) - 1, range.mNumIndices, page.mIndexType,
+				(const GLvoid*)( indexSize * range.mFirstIndex ) );
+		++mStats.mDrawCalls;
+	}
+
+	VboMesh::Layout		mLayout;
+	size_t				mStride, mNormalOffset, mColorOffset, mTexCoordOffset;
+	size_t				mVerticesPerPage, mIndicesPerPage;
+	vector<Page>		mPages;
+	vector<Range>		mMeshes;
+	bool				mBound;
+	// the page whose pointers are set up, or NO_PAGE
+	size_t				mBoundPage;
+	Stats				mStats;
+
+	static const size_t NO_PAGE = static_cast<size_t>( -1 );
+};
+
+VboMeshBatch::VboMeshBatch( const VboMesh::Layout &layout, size_t verticesPerPage, size_t indicesPerPage )
+	: mObj( new Obj )
+{
+	// only static attributes that every page can set up the same way are supported
+	VboMesh::Layout supported;
+	supported.setStaticPositions();
+	if( layout.hasStaticNormals() )
+		supported.setStaticNormals();
+	if( layout.hasStaticColorsRGB() )
+		supported.setStaticColorsRGB();
+	else if( layout.hasStaticColorsRGBA() )
+		supported.setStaticColorsRGBA();
+	if( layout.hasStaticTexCoords2d( 0 ) )
+		supported.setStaticTexCoords2d( 0 );
+	for( int a = VboMesh::ATTR_POSITIONS; a < VboMesh::ATTR_TOTAL; ++a ) {
+		if( layout.mAttributes[a] != supported.mAttributes[a] )
+			throw VboMeshBatchInvalidLayoutExc();
+	}
+	if( ( ! layout.mCustomStatic.empty() ) || ( ! layout.mCustomDynamic.empty() ) )
+		throw VboMeshBatchInvalidLayoutExc();
+
+	mObj->mLayout = supported;
+	mObj->mStride = sizeof(Vec3f);
+	mObj->mNormalOffset = mObj->mColorOffset = mObj->mTexCoordOffset = 0;
+	if( supported.hasStaticNormals() ) {
+		mObj->mNormalOffset = mObj->mStride;
+		mObj->mStride += sizeof(Vec3f);
+	}
+	if( supported.hasStaticColorsRGB() || supported.hasStaticColorsRGBA() ) {
+		mObj->mColorOffset = mObj->mStride;
+		mObj->mStride += supported.hasStaticColorsRGB() ? sizeof(Color) : sizeof(ColorA);
+	}
+	if( supported.hasStaticTexCoords2d( 0 ) ) {
+		mObj->mTexCoordOffset = mObj->mStride;
+		mObj->mStride += sizeof(Vec2f);
+	}
+
+	mObj->mVerticesPerPage = verticesPerPage;
+	mObj->mIndicesPerPage = indicesPerPage;
+	mObj->mBound = false;
+	mObj->mBoundPage = Obj::NO_PAGE;
+}
+
+size_t VboMeshBatch::add( const TriMesh &triMesh )
+{
+	const size_t numVertices = triMesh.getNumVertices(), numIndices = triMesh.getNumIndices();
+
+	// the first shared page with room, or a new one. A mesh too large for a shared page gets its own.
+	size_t pageIndex = mObj->mPages.size();
+	const bool fitsPage = ( numVertices <= mObj->mVerticesPerPage ) && ( numIndices <= mObj->mIndicesPerPage );
+	for( size_t p = 0; fitsPage && ( p < mObj->mPages.size() ); ++p ) {
+		const Obj::Page &page = mObj->mPages[p];
+		if( ( page.mNumVertices + numVertices <= page.mVertexCapacity ) && ( page.mNumIndices + numIndices <= page.mIndexCapacity ) ) {
+			pageIndex = p;
+			break;
+		}
+	}
+	if( pageIndex == mObj->mPages.size() ) {
+		Obj::Page page;
+		page.mVertexCapacity = fitsPage ? mObj->mVerticesPerPage : numVertices;
+		page.mIndexCapacity = fitsPage ? mObj->mIndicesPerPage : numIndices;
+		page.mNumVertices = page.mNumIndices = 0;
+		page.mIndexType = ( page.mVertexCapacity <= 65536 ) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		page.mVertices = Vbo( GL_ARRAY_BUFFER );
+		page.mVertices.bufferData( mObj->mStride * page.mVertexCapacity, NULL, GL_STATIC_DRAW );
+		page.mIndices = Vbo( GL_ELEMENT_ARRAY_BUFFER );
+		page.mIndices.bufferData( ( ( page.mIndexType == GL_UNSIGNED_SHORT ) ? sizeof(uint16_t) : sizeof(uint32_t) ) * page.mIndexCapacity, NULL, GL_STATIC_DRAW );
+		mObj->mPages.push_back( page );
+	}
+	Obj::Page &page = mObj->mPages[pageIndex];
+
+	Obj::Range mesh;
+	mesh.mPage = pageIndex;
+	mesh.mFirstVertex = page.mNumVertices;
+	mesh.mNumVertices = numVertices;
+	mesh.mFirstIndex = page.mNumIndices;
+	mesh.mNumIndices = numIndices;
+
+	if( numVertices > 0 ) {
+		vector<uint8_t> vertices( mObj->mStride * numVertices );
+		copyStrided( triMesh.getVertices(), numVertices, &vertices[0], mObj->mStride );
+		if( mObj->mLayout.hasStaticNormals() )
+			copyStrided( triMesh.getNormals(), numVertices, &vertices[mObj->mNormalOffset], mObj->mStride );
+		if( mObj->mLayout.hasStaticColorsRGB() )
+			copyStrided( triMesh.getColorsRGB(), numVertices, &vertices[mObj->mColorOffset], mObj->mStride );
+		else if( mObj->mLayout.hasStaticColorsRGBA() )
+			copyStrided( triMesh.getColorsRGBA(), numVertices, &vertices[mObj->mColorOffset], mObj->mStride );
+		if( mObj->mLayout.hasStaticTexCoords2d( 0 ) )
+			copyStrided( triMesh.getTexCoords(), numVertices, &vertices[mObj->mTexCoordOffset], mObj->mStride );
+		page.mVertices.bufferSubData( mObj->mStride * mesh.mFirstVertex, vertices.size(), &vertices[0] );
+	}
+
+	// the indices are offset to the mesh's place in the page, which lets adjacent meshes be drawn with a single call
+	const vector<uint32_t> &indices = triMesh.getIndices();
+	if( ( numIndices > 0 ) && ( page.mIndexType == GL_UNSIGNED_SHORT ) ) {
+		vector<uint16_t> pageIndices( numIndices );
+		for( size_t i = 0; i < numIndices; ++i )
+			pageIndices[i] = static_cast<uint16_t>( indices[i] + mesh.mFirstVertex );
+		page.mIndices.bufferSubData( sizeof(uint16_t) * mesh.mFirstIndex, sizeof(uint16_t) * numIndices, &pageIndices[0] );
+	}
+	else if( numIndices > 0 ) {
+		vector<uint32_t> pageIndices( numIndices );
+		for( size_t i = 0; i < numIndices; ++i )
+			pageIndices[i] = static_cast<uint32_t>( indices[i] + mesh.mFirstVertex );
+		page.mIndices.bufferSubData( sizeof(uint32_t) * mesh.mFirstIndex, sizeof(uint32_t) * numIndices, &pageIndices[0] );
+	}
+
+	page.mNumVertices += numVertices;
+	page.mNumIndices += numIndices;
+	mObj->mMeshes.push_back( mesh );
+
+	// uploading rebound the buffers
+	VboMesh::unbindBuffers();
+	mObj->mBoundPage = Obj::NO_PAGE;
+	return mObj->mMeshes.size() - 1;
+}
+
+size_t VboMeshBatch::getNumMeshes() const
+{
+	return mObj->mMeshes.size();
+}
+
+size_t VboMeshBatch::getNumPages() const
+{
+	return mObj->mPages.size();
+}
+
+void VboMeshBatch::clear()
+{
+	mObj->mMeshes.clear();
+	mObj->mPages.clear();
+	mObj->mBoundPage = Obj::NO_PAGE;
+}
+
+void VboMeshBatch::bind()
+{
+	if( mObj->mBound )
+		return;
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	++mObj->mStats.mClientStateChanges;
+	if( mObj->mLayout.hasStaticNormals() ) {
+		glEnableClientState( GL_NORMAL_ARRAY );
+		++mObj->mStats.mClientStateChanges;
+	}
+	if( mObj->mLayout.hasStaticColorsRGB() || mObj->mLayout.hasStaticColorsRGBA() ) {
+		glEnableClientState( GL_COLOR_ARRAY );
+		++mObj->mStats.mClientStateChanges;
+	}
+	if( mObj->mLayout.hasStaticTexCoords2d( 0 ) ) {
+		glClientActiveTexture( GL_TEXTURE0 );
+		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+		++mObj->mStats.mClientStateChanges;
+	}
+
+	mObj->mBound = true;
+	mObj->mBoundPage = Obj::NO_PAGE;
+}
+
+void VboMeshBatch::unbind()
+{
+	if( ! mObj->mBound )
+		return;
+
+	glDisableClientState( GL_VERTEX_ARRAY );
+	++mObj->mStats.mClientStateChanges;
+	if( mObj->mLayout.hasStaticNormals() ) {
+		glDisableClientState( GL_NORMAL_ARRAY );
+		++mObj->mStats.mClientStateChanges;
+	}
+	if( mObj->mLayout.hasStaticColorsRGB() || mObj->mLayout.hasStaticColorsRGBA() ) {
+		glDisableClientState( GL_COLOR_ARRAY );
+		++mObj->mStats.mClientStateChanges;
+	}
+	if( mObj->mLayout.hasStaticTexCoords2d( 0 ) ) {
+		glClientActiveTexture( GL_TEXTURE0 );
+		glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+		++mObj->mStats.mClientStateChanges;
+	}
+	if( mObj->mBoundPage != Obj::NO_PAGE ) {
+		VboMesh::unbindBuffers();
+		mObj->mStats.mBufferBinds += 2;
+	}
+
+	mObj->mBound = false;
+	mObj->mBoundPage = Obj::NO_PAGE;
+}
+
+void VboMeshBatch::draw( size_t mesh )
+{
+	const bool wasBound = mObj->mBound;
+	bind();
+	mObj->drawRange( mObj->mMeshes[mesh] );
+	if( ! wasBound )
+		unbind();
+}
+
+void VboMeshBatch::draw( const std::vector<size_t> &meshes )
+{
+	if( meshes.empty() )
+		return;
+
+	vector<Obj::Range> ranges;
+	ranges.reserve( meshes.size() );
+	for( vector<size_t>::const_iterator meshIt = meshes.begin(); meshIt != meshes.end(); ++meshIt )
+		ranges.push_back( mObj->mMeshes[*meshIt] );
+	std::sort( ranges.begin(), ranges.end(), Obj::rangeLess );
+
+	const bool wasBound = mObj->mBound;
+	bind();
+	// a mesh's vertices and indices are allocated together, so meshes with adjacent indices have adjacent vertices as well
+	Obj::Range range = ranges[0];
+	for( size_t r = 1; r < ranges.size(); ++r ) {
+		if( ( ranges[r].mPage == range.mPage ) && ( ranges[r].mFirstIndex == range.mFirstIndex + range.mNumIndices ) ) {
+			range.mNumIndices += ranges[r].mNumIndices;
+			range.mNumVertices = ranges[r].mFirstVertex + ranges[r].mNumVertices - range.mFirstVertex;
+		}
+		else {
+			mObj->drawRange( range );
+			range = ranges[r];
+		}
+	}
+	mObj->drawRange( range );
+	if( ! wasBound )
+		unbind();
+}
+
+void VboMeshBatch::drawAll()
+{
+	const bool wasBound = mObj->mBound;
+	bind();
+	for( size_t p = 0; p < mObj->mPages.size(); ++p ) {
+		Obj::Range range;
+		range.mPage = p;
+		range.mFirstVertex = range.mFirstIndex = 0;
+		range.mNumVertices = mObj->mPages[p].mNumVertices;
+		range.mNumIndices = mObj->mPages[p].mNumIndices;
+		mObj->drawRange( range );
+	}
+	if( ! wasBound )
+		unbind();
+}
+
+const VboMeshBatch::Stats& VboMeshBatch::getStats() const
+{
+	return mObj->mStats;
+}
+
+void VboMeshBatch::resetStats()
+{
+	mObj->mStats = Stats();
+}
+
 } } // namespace cinder::gl
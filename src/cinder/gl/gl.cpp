@@ -784,6 +784,17 @@ void draw( const TriMesh &mesh )
 	else
 		glDisableClientState( GL_NORMAL_ARRAY );
 
+	if( mesh.hasColorsRGB() ) {
+		glColorPointer( 3, GL_FLOAT, 0, &(mesh.getColorsRGB()[0]) );
+		glEnableClientState( GL_COLOR_ARRAY );
+	}
+	else if( mesh.hasColorsRGBA() ) {
+		glColorPointer( 4, GL_FLOAT, 0, &(mesh.getColorsRGBA()[0]) );
+		glEnableClientState( GL_COLOR_ARRAY );
+	}
+	else
+		glDisableClientState( GL_COLOR_ARRAY );
+
 	if( mesh.hasTexCoords() ) {
 		glTexCoordPointer( 2, GL_FLOAT, 0, &(mesh.getTexCoords()[0]) );
 		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
@@ -794,6 +805,7 @@ void draw( const TriMesh &mesh )
 
 	glDisableClientState( GL_VERTEX_ARRAY );
 	glDisableClientState( GL_NORMAL_ARRAY );
+	glDisableClientState( GL_COLOR_ARRAY );
 	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
 }
 
@@ -809,6 +821,17 @@ void drawRange( const TriMesh &mesh, size_t startTriangle, size_t triangleCount
 	else
 		glDisableClientState( GL_NORMAL_ARRAY );
 
+	if( mesh.hasColorsRGB() ) {
+		glColorPointer( 3, GL_FLOAT, 0, &(mesh.getColorsRGB()[0]) );
+		glEnableClientState( GL_COLOR_ARRAY );
+	}
+	else if( mesh.hasColorsRGBA() ) {
+		glColorPointer( 4, GL_FLOAT, 0, &(mesh.getColorsRGBA()[0]) );
+		glEnableClientState( GL_COLOR_ARRAY );
+	}
+	else
+		glDisableClientState( GL_COLOR_ARRAY );
+
 	if( mesh.hasTexCoords() ) {
 		glTexCoordPointer( 2, GL_FLOAT, 0, &(mesh.getTexCoords()[0]) );
 		glEnableClientState( GL_TEXTURE_COORD_ARRAY );
@@ -820,6 +843,7 @@ void drawRange( const TriMesh &mesh, size_t startTriangle, size_t triangleCount
 
 	glDisableClientState( GL_VERTEX_ARRAY );
 	glDisableClientState( GL_NORMAL_ARRAY );
+	glDisableClientState( GL_COLOR_ARRAY );
 	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
 }
 
@@ -841,7 +865,7 @@ void drawRange( const VboMesh &vbo, size_t startIndex, size_t indexCount, int ve
 
 	vbo.enableClientStates();
 	vbo.bindAllData();
-	glDrawRangeElements( vbo.getPrimitiveType(), vertexStart, vertexEnd, indexCount, GL_UNSIGNED_INT, (GLvoid*)( sizeof(uint32_t) * startIndex ) );
+	glDrawRangeElements( vbo.getPrimitiveType(), vertexStart, vertexEnd, indexCount, vbo.getIndexType(), (GLvoid*)( vbo.getIndexSize() * startIndex ) );
 
 	gl::VboMesh::unbindBuffers();
 	vbo.disableClientStates();
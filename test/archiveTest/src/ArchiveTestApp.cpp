@@ -0,0 +1,159 @@
+#include "cinder/app/AppBasic.h"
+#include <cassert>
+#include <cstdlib>
+#include <map>
+using namespace ci;
+using namespace ci::app;
+
+#include "cinder/gl/gl.h"
+#include "cinder/Archive.h"
+#include "cinder/Stream.h"
+#include "cinder/Utilities.h"
+#include "cinder/Rand.h"
+
+// Packs a few generated files with tools/packAssets.py, which has to be runnable as "python", and reads them back through Archive
+class ArchiveTestApp : public AppBasic {
+ public:
+	void setup();
+	void draw();
+
+	void	writeAsset( const std::string &name, const std::string &contents );
+	Buffer	loadPack();
+	bool	isCorrupt( const Buffer &pack, const std::string &name );
+
+	void	testRoundTrip();
+	void	testCorrupt();
+
+	std::string							mAssetDir, mPackPath;
+	std::map<std::string,std::string>	mAssets;
+};
+
+void ArchiveTestApp::setup()
+{
+	mAssetDir = getHomeDirectory() + "archiveTestAssets";
+	mPackPath = getHomeDirectory() + "archiveTest.pack";
+
+	// text compresses well, so it's stored with zlib; noise doesn't, and a .png is never even tried
+	std::string text;
+	while( text.size() < 20000 )
+		text += "The quick brown fox jumps over the lazy dog. ";
+	std::string noise( 4096, 0 );
+	Rand rnd( 1 );
+	for( size_t i = 0; i < noise.size(); ++i )
+		noise[i] = static_cast<char>( rnd.nextInt( 256 ) );
+	writeAsset( "readme.txt", text );
+	writeAsset( "data/noise.bin", noise );
+	writeAsset( "images/fake.png", noise.substr( 0, 100 ) );
+
+	// __FILE__ is this source file, so the tools directory is three levels up from it
+	std::string packScript = getPathDirectory( __FILE__ ) + "/../../../tools/packAssets.py";
+	std::string command = "python \"" + packScript + "\" \"" + mPackPath + "\" \"" + mAssetDir + "\"";
+	int status = system( command.c_str() );
+	assert( status == 0 );
+
+	testRoundTrip();
+	testCorrupt();
+}
+
+void ArchiveTestApp::writeAsset( const std::string &name, const std::string &contents )
+{
+	OStreamFileRef out = writeFileStream( mAssetDir + "/" + name );
+	out->writeData( contents.data(), contents.size() );
+	mAssets[name] = contents;
+}
+
+Buffer ArchiveTestApp::loadPack()
+{
+	IStreamFileRef in = loadFileStream( mPackPath );
+	Buffer result( static_cast<size_t>( in->size() ) );
+	in->readData( result.getData(), result.getDataSize() );
+	return result;
+}
+
+// Returns whether opening \a pack and reading the entry \a name throws ArchiveExc
+bool ArchiveTestApp::isCorrupt( const Buffer &pack, const std::string &name )
+{
+	try {
+		ArchiveRef archive = Archive::createRef( pack );
+		archive->getBuffer( name );
+	}
+	catch( ArchiveExc & ) {
+		return true;
+	}
+	return false;
+}
+
+void ArchiveTestApp::testRoundTrip()
+{
+	console() << "Test Round Trip: ";
+	ArchiveRef archive = loadArchive( mPackPath );
+	assert( archive->getNumEntries() == mAssets.size() );
+	// the entries are sorted by name, just like the map
+	size_t index = 0;
+	for( std::map<std::string,std::string>::const_iterator assetIt = mAssets.begin(); assetIt != mAssets.end(); ++assetIt, ++index ) {
+		assert( archive->getEntryName( index ) == assetIt->first );
+		assert( archive->findEntry( assetIt->first ) == (int32_t)index );
+		assert( archive->getEntrySize( index ) == assetIt->second.size() );
+		Buffer byName = archive->getBuffer( assetIt->first ), byIndex = archive->getBuffer( index );
+		assert( std::string( reinterpret_cast<const char*>( byName.getData() ), byName.getDataSize() ) == assetIt->second );
+		assert( std::string( reinterpret_cast<const char*>( byIndex.getData() ), byIndex.getDataSize() ) == assetIt->second );
+	}
+	assert( archive->findEntry( "data\\noise.bin" ) == archive->findEntry( "data/noise.bin" ) );
+	assert( ! archive->contains( "missing.txt" ) );
+
+	// the text was compressed, so the whole pack is smaller than it alone
+	Buffer pack = loadPack();
+	assert( pack.getDataSize() < mAssets["readme.txt"].size() );
+
+	IStreamMemRef stream = archive->getStream( "data/noise.bin" );
+	std::string streamed( static_cast<size_t>( stream->size() ), 0 );
+	stream->readData( &streamed[0], streamed.size() );
+	assert( streamed == mAssets["data/noise.bin"] );
+	console() << "PASS" << std::endl;
+}
+
+void ArchiveTestApp::testCorrupt()
+{
+	console() << "Test Corrupt: ";
+	ArchiveRef archive = loadArchive( mPackPath );
+	bool threw = false;
+	try {
+		archive->getBuffer( archive->getNumEntries() );
+	}
+	catch( ArchiveExc & ) {
+		threw = true;
+	}
+	assert( threw );
+	threw = false;
+	try {
+		archive->getEntryName( 1000 );
+	}
+	catch( ArchiveExc & ) {
+		threw = true;
+	}
+	assert( threw );
+
+	// an entry count running past the end of the file
+	Buffer pack = loadPack();
+	uint8_t *header = reinterpret_cast<uint8_t*>( pack.getData() );
+	header[11] = 0x7F;
+	bool corrupt = isCorrupt( pack, "readme.txt" );
+	assert( corrupt );
+
+	// the compressed entry, last in sorted order, claiming more than its stored data could decompress to
+	pack = loadPack();
+	const int32_t readme = archive->findEntry( "readme.txt" );
+	uint8_t *record = reinterpret_cast<uint8_t*>( pack.getData() ) + 32 + readme * 32;
+	record[16 + 5] = 0x01;
+	corrupt = isCorrupt( pack, "readme.txt" );
+	assert( corrupt );
+	console() << "PASS" << std::endl;
+}
+
+void ArchiveTestApp::draw()
+{
+	gl::clear();
+}
+
+// This line tells Flint to actually create the application
+CINDER_APP_BASIC( ArchiveTestApp, RendererGL )
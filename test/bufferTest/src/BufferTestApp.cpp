@@ -1,15 +1,18 @@
 #include "cinder/app/AppBasic.h"
 #include <cassert>
+#include <cstring>
 using namespace ci;
 using namespace ci::app;
 
 #include "cinder/Rand.h"
 #include "cinder/Buffer.h"
+#include "cinder/Timer.h"
 
 // We'll create a new Flint Application by deriving from the BasicApp class
 class BufferTestApp : public AppBasic {
  public:
 	void setup();
+	void benchmarkCodecs();
 };
 
 void BufferTestApp::setup()
@@ -54,7 +57,74 @@ void BufferTestApp::setup()
 	}
 	console() << "PASS" << std::endl;
 	
+	console() << "Test Codec Round Trips: ";
+	CompressionCodec codecs[] = { CODEC_ZLIB, CODEC_LZ4, CODEC_LZ4_HC };
+	for( int c = 0; c < 3; ++c ) {
+		Buffer codecBuf = decompressBuffer( compressBuffer( startBuf, codecs[c] ) );
+		assert( codecBuf.getDataSize() == startBuf.getDataSize() );
+		assert( memcmp( codecBuf.getData(), startBuf.getData(), startBuf.getDataSize() ) == 0 );
+	}
+	console() << "PASS" << std::endl;
+	
+	// a header claiming far more than its codec could have produced from the data is rejected before anything is allocated
+	console() << "Test Forged Size: ";
+	for( int c = 0; c < 3; ++c ) {
+		Buffer forgedBuf = compressBuffer( startBuf, codecs[c] );
+		reinterpret_cast<uint8_t*>( forgedBuf.getData() )[14] = 0x10;
+		bool threw = false;
+		try {
+			decompressBuffer( forgedBuf );
+		}
+		catch( BufferDecompressionExc & ) {
+			threw = true;
+		}
+		assert( threw );
+	}
+	console() << "PASS" << std::endl;
+	
 	console() << "All Tests Pass!" << std::endl;
+
+	benchmarkCodecs();
+}
+
+// Compares throughput and ratio on data resembling a noisy RGBA Surface
+void BufferTestApp::benchmarkCodecs()
+{
+	const int width = 1024, height = 1024;
+	Buffer surfaceBuf( width * height * 4 );
+	uint8_t *pixels = (uint8_t *)surfaceBuf.getData();
+	Rand noise( 1 );
+	for( int y = 0; y < height; ++y ) {
+		for( int x = 0; x < width; ++x ) {
+			uint8_t *p = &pixels[( y * width + x ) * 4];
+			p[0] = ( x + noise.nextInt( 0, 4 ) ) & 0xFF;
+			p[1] = ( y / 4 ) & 0xFF;
+			p[2] = ( ( x ^ y ) >> 3 ) & 0xFF;
+			p[3] = 255;
+		}
+	}
+
+	const char *names[] = { "zlib 1", "zlib 6", "zlib 9", "lz4", "lz4 hc 4", "lz4 hc 9" };
+	CompressionCodec codecs[] = { CODEC_ZLIB, CODEC_ZLIB, CODEC_ZLIB, CODEC_LZ4, CODEC_LZ4_HC, CODEC_LZ4_HC };
+	int8_t levels[] = { 1, 6, 9, 0, 4, 9 };
+	const int iterations = 5;
+	const double megabytes = surfaceBuf.getDataSize() / ( 1024.0 * 1024.0 );
+	for( int c = 0; c < 6; ++c ) {
+		Buffer compressed;
+		Timer compressTimer( true );
+		for( int i = 0; i < iterations; ++i )
+			compressed = compressBuffer( surfaceBuf, codecs[c], levels[c] );
+		compressTimer.stop();
+
+		Timer decompressTimer( true );
+		for( int i = 0; i < iterations; ++i )
+			decompressBuffer( compressed );
+		decompressTimer.stop();
+
+		console() << names[c] << ": ratio " << surfaceBuf.getDataSize() / (double)compressed.getDataSize()
+			<< ", compress " << megabytes * iterations / compressTimer.getSeconds() << " MB/s"
+			<< ", decompress " << megabytes * iterations / decompressTimer.getSeconds() << " MB/s" << std::endl;
+	}
 }
 
 // This line tells Flint to actually create the application
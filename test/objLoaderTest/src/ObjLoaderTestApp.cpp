@@ -0,0 +1,84 @@
+#include "cinder/app/AppBasic.h"
+#include <cassert>
+#include <cstdio>
+#include <string>
+using namespace ci;
+using namespace ci::app;
+
+#include "cinder/ObjLoader.h"
+#include "cinder/Rand.h"
+#include "cinder/Timer.h"
+
+// Benchmarks ObjLoader on a large generated scan-like mesh
+class ObjLoaderTestApp : public AppBasic {
+ public:
+	void setup();
+
+	std::string	generateObj( int gridSize );
+};
+
+void ObjLoaderTestApp::setup()
+{
+	// ~2M triangles with positions, texture coordinates and normals
+	const int gridSize = 1000;
+	console() << "Generating OBJ: ";
+	std::string obj = generateObj( gridSize );
+	console() << obj.size() / ( 1024 * 1024 ) << " MB" << std::endl;
+
+	Timer serialTimer( true );
+	ObjLoader serialLoader( IStreamMem::createRef( obj.data(), obj.size() ), true, false );
+	serialTimer.stop();
+
+	Timer parallelTimer( true );
+	ObjLoader parallelLoader( IStreamMem::createRef( obj.data(), obj.size() ), true, true );
+	parallelTimer.stop();
+
+	Timer loadTimer( true );
+	TriMesh serialMesh;
+	serialLoader.load( &serialMesh );
+	loadTimer.stop();
+
+	TriMesh parallelMesh;
+	parallelLoader.load( &parallelMesh );
+
+	console() << "Test Serial And Parallel Match: ";
+	assert( serialMesh.getNumTriangles() == 2 * ( gridSize - 1 ) * ( gridSize - 1 ) );
+	assert( serialMesh.getVertices() == parallelMesh.getVertices() );
+	assert( serialMesh.getIndices() == parallelMesh.getIndices() );
+	console() << "PASS" << std::endl;
+
+	const double megabytes = obj.size() / ( 1024.0 * 1024.0 );
+	console() << "parse, serial: " << serialTimer.getSeconds() << "s (" << megabytes / serialTimer.getSeconds() << " MB/s)" << std::endl;
+	console() << "parse, parallel: " << parallelTimer.getSeconds() << "s (" << megabytes / parallelTimer.getSeconds() << " MB/s)" << std::endl;
+	console() << "load into TriMesh: " << loadTimer.getSeconds() << "s" << std::endl;
+}
+
+std::string ObjLoaderTestApp::generateObj( int gridSize )
+{
+	std::string result;
+	char line[128];
+	Rand rnd( 1 );
+	for( int y = 0; y < gridSize; ++y ) {
+		for( int x = 0; x < gridSize; ++x ) {
+			sprintf( line, "v %f %f %f\n", x * 0.01f, rnd.nextFloat( -0.001f, 0.001f ), y * 0.01f );
+			result += line;
+			sprintf( line, "vt %f %f\n", x / (float)gridSize, y / (float)gridSize );
+			result += line;
+			sprintf( line, "vn %f %f %f\n", rnd.nextFloat( -0.1f, 0.1f ), 1.0f, rnd.nextFloat( -0.1f, 0.1f ) );
+			result += line;
+		}
+	}
+
+	for( int y = 0; y < gridSize - 1; ++y ) {
+		for( int x = 0; x < gridSize - 1; ++x ) {
+			int a = y * gridSize + x + 1, b = a + 1, c = a + gridSize + 1, d = a + gridSize;
+			sprintf( line, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d );
+			result += line;
+		}
+	}
+
+	return result;
+}
+
+// This line tells Flint to actually create the application
+CINDER_APP_BASIC( ObjLoaderTestApp, RendererGL )
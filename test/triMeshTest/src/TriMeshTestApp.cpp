@@ -0,0 +1,347 @@
+#include "cinder/app/AppBasic.h"
+#include <cassert>
+#include <algorithm>
+using namespace ci;
+using namespace ci::app;
+
+#include "cinder/TriMesh.h"
+#include "cinder/TriMeshSimplifier.h"
+#include "cinder/TriMeshBvh.h"
+#include "cinder/Stream.h"
+#include "cinder/Rand.h"
+#include "cinder/Timer.h"
+
+// Exercises TriMesh's processing passes on a generated grid, CPU-only
+class TriMeshTestApp : public AppBasic {
+ public:
+	void setup();
+
+	TriMesh	generateShuffledGrid( int gridSize );
+	void	testOptimize();
+	void	testSimplify();
+	void	testNormals();
+	void	testInterleave();
+	void	testBvh();
+	void	testSerialize();
+
+	TriMesh	writeAndRead( const TriMesh &mesh, const TriMesh::WriteOptions &options );
+	bool	isReadRejected( const Buffer &data );
+};
+
+void TriMeshTestApp::setup()
+{
+	testOptimize();
+	testSimplify();
+	testNormals();
+	testInterleave();
+	testBvh();
+	testSerialize();
+}
+
+TriMesh TriMeshTestApp::generateShuffledGrid( int gridSize )
+{
+	TriMesh result;
+	for( int y = 0; y < gridSize; ++y ) {
+		for( int x = 0; x < gridSize; ++x ) {
+			result.appendVertex( Vec3f( x * 0.01f, 0, y * 0.01f ) );
+			result.appendNormal( Vec3f::yAxis() );
+			result.appendTexCoord( Vec2f( x / (float)gridSize, y / (float)gridSize ) );
+		}
+	}
+
+	// the triangles are shuffled to stand in for a mesh in arbitrary order
+	std::vector<int> indices;
+	for( int y = 0; y < gridSize - 1; ++y ) {
+		for( int x = 0; x < gridSize - 1; ++x ) {
+			int a = y * gridSize + x, b = a + 1, c = a + gridSize + 1, d = a + gridSize;
+			int quad[6] = { a, c, b, a, d, c };
+			indices.insert( indices.end(), quad, quad + 6 );
+		}
+	}
+	Rand rnd( 1 );
+	for( int t = (int)indices.size() / 3 - 1; t > 0; --t ) {
+		int other = rnd.nextInt( t + 1 );
+		std::swap_ranges( &indices[t * 3], &indices[t * 3 + 3], &indices[other * 3] );
+	}
+	for( size_t i = 0; i < indices.size(); i += 3 )
+		result.appendTriangle( indices[i], indices[i + 1], indices[i + 2] );
+
+	return result;
+}
+
+void TriMeshTestApp::testOptimize()
+{
+	TriMesh mesh = generateShuffledGrid( 1000 );
+	console() << "ACMR, shuffled: " << mesh.calcAcmr() << std::endl;
+
+	Timer timer( true );
+	mesh.optimizeVertexCache();
+	timer.stop();
+	console() << "ACMR, optimizeVertexCache(): " << mesh.calcAcmr() << " in " << timer.getSeconds() << "s" << std::endl;
+	const float cacheAcmr = mesh.calcAcmr();
+
+	mesh.optimizeOverdraw();
+	console() << "ACMR, optimizeOverdraw(): " << mesh.calcAcmr() << std::endl;
+	mesh.optimizeVertexFetch();
+
+	console() << "Test ACMR: ";
+	assert( cacheAcmr < 0.75f );
+	assert( mesh.calcAcmr() < cacheAcmr * 1.06f );
+	console() << "PASS" << std::endl;
+
+	// every triangle still has to be there, and vertices have to be referenced in order
+	console() << "Test Triangles Preserved: ";
+	const std::vector<uint32_t> &indices = mesh.getIndices();
+	uint32_t nextVertex = 0;
+	for( size_t i = 0; i < indices.size(); ++i ) {
+		assert( indices[i] <= nextVertex );
+		if( indices[i] == nextVertex )
+			++nextVertex;
+	}
+	double area = 0;
+	for( size_t t = 0; t < mesh.getNumTriangles(); ++t ) {
+		const Vec3f &v0 = mesh.getVertices()[indices[t*3]], &v1 = mesh.getVertices()[indices[t*3+1]], &v2 = mesh.getVertices()[indices[t*3+2]];
+		Vec3f normal = ( v1 - v0 ).cross( v2 - v0 );
+		assert( normal.y > 0 );
+		area += normal.length() / 2;
+	}
+	assert( math<double>::abs( area - 9.99 * 9.99 ) < 0.001 );
+	console() << "PASS" << std::endl;
+}
+
+void TriMeshTestApp::testSimplify()
+{
+	TriMesh mesh = generateShuffledGrid( 200 );
+	std::vector<size_t> targets;
+	targets.push_back( 10000 );
+	targets.push_back( 1000 );
+	targets.push_back( 2 );
+
+	Timer timer( true );
+	std::vector<TriMesh> lods = TriMeshSimplifier::generateLods( mesh, targets );
+	timer.stop();
+	console() << "generateLods(): " << mesh.getNumTriangles() << " triangles in " << timer.getSeconds() << "s" << std::endl;
+
+	// the grid is flat, so it should simplify all the way down to its corners without changing shape
+	console() << "Test LODs: ";
+	for( size_t l = 0; l < lods.size(); ++l ) {
+		assert( lods[l].getNumTriangles() <= targets[l] );
+		const std::vector<uint32_t> &indices = lods[l].getIndices();
+		double area = 0;
+		for( size_t t = 0; t < lods[l].getNumTriangles(); ++t ) {
+			const Vec3f &v0 = lods[l].getVertices()[indices[t*3]], &v1 = lods[l].getVertices()[indices[t*3+1]], &v2 = lods[l].getVertices()[indices[t*3+2]];
+			Vec3f normal = ( v1 - v0 ).cross( v2 - v0 );
+			assert( normal.y > 0 );
+			area += normal.length() / 2;
+		}
+		assert( math<double>::abs( area - 1.99 * 1.99 ) < 0.0001 );
+		assert( lods[l].getTexCoords().size() == lods[l].getNumVertices() );
+	}
+	assert( lods.back().getNumTriangles() == 2 );
+	console() << "PASS" << std::endl;
+}
+
+void TriMeshTestApp::testNormals()
+{
+	TriMesh mesh = generateShuffledGrid( 1000 );
+	Timer timer( true );
+	mesh.recalculateNormals();
+	timer.stop();
+	console() << "recalculateNormals(): " << timer.getSeconds() << "s" << std::endl;
+	timer.start();
+	mesh.recalculateTangents();
+	timer.stop();
+	console() << "recalculateTangents(): " << timer.getSeconds() << "s" << std::endl;
+
+	// texture coordinates increase along x and z, so the texture space is mirrored relative to the normal
+	console() << "Test Normals And Tangents: ";
+	for( size_t v = 0; v < mesh.getNumVertices(); ++v ) {
+		assert( mesh.getNormals()[v].distance( Vec3f::yAxis() ) < 0.0001f );
+		const Vec4f &tangent = mesh.getTangents()[v];
+		assert( Vec3f( tangent.x, tangent.y, tangent.z ).distance( Vec3f::xAxis() ) < 0.0001f );
+		assert( tangent.w == -1 );
+	}
+
+	TriMesh serialMesh = mesh, angleMesh = mesh;
+	serialMesh.recalculateNormals( false, false );
+	assert( serialMesh.getNormals() == mesh.getNormals() );
+	angleMesh.recalculateNormals( true );
+	assert( angleMesh.getNormals()[0].distance( Vec3f::yAxis() ) < 0.0001f );
+	console() << "PASS" << std::endl;
+}
+
+void TriMeshTestApp::testInterleave()
+{
+	TriMesh mesh = generateShuffledGrid( 100 );
+	mesh.recalculateTangents();
+	mesh.interleave( TriMesh::INTERLEAVE_POSITIONS | TriMesh::INTERLEAVE_TEXCOORDS | TriMesh::INTERLEAVE_TANGENTS | TriMesh::INTERLEAVE_COLORS_RGB );
+
+	// the mesh has no colors, so those are left out
+	console() << "Test Interleave: ";
+	assert( mesh.getInterleavedAttributes() == ( TriMesh::INTERLEAVE_POSITIONS | TriMesh::INTERLEAVE_TEXCOORDS | TriMesh::INTERLEAVE_TANGENTS ) );
+	assert( mesh.getInterleavedStride() == sizeof(Vec3f) + sizeof(Vec2f) + sizeof(Vec4f) );
+	const size_t texCoordOffset = mesh.getInterleavedOffset( TriMesh::INTERLEAVE_TEXCOORDS ), tangentOffset = mesh.getInterleavedOffset( TriMesh::INTERLEAVE_TANGENTS );
+	assert( ( texCoordOffset == sizeof(Vec3f) ) && ( tangentOffset == sizeof(Vec3f) + sizeof(Vec2f) ) );
+	const uint8_t *vertex = reinterpret_cast<const uint8_t*>( mesh.getInterleavedData() );
+	for( size_t v = 0; v < mesh.getNumVertices(); ++v, vertex += mesh.getInterleavedStride() ) {
+		assert( *reinterpret_cast<const Vec3f*>( vertex ) == mesh.getVertices()[v] );
+		assert( *reinterpret_cast<const Vec2f*>( vertex + texCoordOffset ) == mesh.getTexCoords()[v] );
+		assert( *reinterpret_cast<const Vec4f*>( vertex + tangentOffset ) == mesh.getTangents()[v] );
+	}
+
+	// changing the vertices leaves the interleaved copy out of date
+	mesh.recalculateNormals();
+	assert( ! mesh.isInterleaved() );
+	console() << "PASS" << std::endl;
+}
+
+void TriMeshTestApp::testBvh()
+{
+	TriMesh mesh = generateShuffledGrid( 1000 );
+	Timer timer( true );
+	TriMeshBvh bvh( mesh );
+	timer.stop();
+	console() << "TriMeshBvh: " << bvh.getNumTriangles() << " triangles in " << timer.getSeconds() << "s" << std::endl;
+
+	// the grid spans [0, 9.99] in x and z at y = 0, so a ray straight down hits it at a known point
+	console() << "Test Ray Casts: ";
+	Rand rnd( 1 );
+	const int numRays = 100000;
+	std::vector<Ray> rays;
+	for( int r = 0; r < numRays; ++r )
+		rays.push_back( Ray( Vec3f( rnd.nextFloat( 0.01f, 9.98f ), 1, rnd.nextFloat( 0.01f, 9.98f ) ), Vec3f( 0, -1, 0 ) ) );
+	timer.start();
+	TriMeshBvh::Hit hit;
+	for( int r = 0; r < numRays; ++r ) {
+		bool didHit = bvh.intersect( rays[r], &hit );
+		assert( didHit );
+		assert( math<float>::abs( hit.mDistance - 1 ) < 0.0001f );
+		assert( hit.mPosition.distance( rays[r].calcPosition( 1 ) ) < 0.0001f );
+		const uint32_t *triangle = &mesh.getIndices()[hit.mTriangle * 3];
+		Vec3f position = mesh.getVertices()[triangle[0]] * ( 1 - hit.mU - hit.mV ) + mesh.getVertices()[triangle[1]] * hit.mU + mesh.getVertices()[triangle[2]] * hit.mV;
+		assert( position.distance( hit.mPosition ) < 0.0001f );
+	}
+	timer.stop();
+	console() << "PASS (" << timer.getSeconds() / numRays * 1000000 << "us per ray)" << std::endl;
+
+	console() << "Test Any And All Hits: ";
+	bool anyHit = bvh.intersects( rays[0] );
+	assert( anyHit );
+	anyHit = bvh.intersects( rays[0], 0.5f );
+	assert( ! anyHit );
+	anyHit = bvh.intersects( Ray( Vec3f( 5, 1, 5 ), Vec3f( 0, 1, 0 ) ) );
+	assert( ! anyHit );
+	// a stack of triangles, added top down, is hit bottom up by a ray from below
+	TriMesh stack;
+	for( int layer = 0; layer < 3; ++layer ) {
+		stack.appendVertex( Vec3f( 0, 2.0f - layer, 0 ) );
+		stack.appendVertex( Vec3f( 1, 2.0f - layer, 0 ) );
+		stack.appendVertex( Vec3f( 0, 2.0f - layer, 1 ) );
+		stack.appendTriangle( layer * 3, layer * 3 + 1, layer * 3 + 2 );
+	}
+	std::vector<TriMeshBvh::Hit> hits;
+	size_t numHits = TriMeshBvh( stack ).intersectAll( Ray( Vec3f( 0.25f, -1, 0.25f ), Vec3f( 0, 1, 0 ) ), &hits );
+	assert( numHits == 3 );
+	assert( ( hits[0].mTriangle == 2 ) && ( hits[1].mTriangle == 1 ) && ( hits[2].mTriangle == 0 ) );
+	assert( hits[2].mDistance == 3 );
+	console() << "PASS" << std::endl;
+
+	console() << "Test Closest Point: ";
+	bool found = bvh.calcClosestPoint( Vec3f( 12, 3, 5 ), &hit );
+	assert( found );
+	assert( hit.mPosition.distance( Vec3f( 9.99f, 0, 5 ) ) < 0.0001f );
+	found = bvh.calcClosestPoint( Vec3f( 12, 3, 5 ), &hit, 3 );
+	assert( ! found );
+	console() << "PASS" << std::endl;
+}
+
+TriMesh TriMeshTestApp::writeAndRead( const TriMesh &mesh, const TriMesh::WriteOptions &options )
+{
+	OStreamMemRef out = OStreamMem::createRef();
+	mesh.write( out.get(), options );
+	TriMesh result;
+	result.read( IStreamMem::createRef( out->createBuffer() ).get() );
+	return result;
+}
+
+bool TriMeshTestApp::isReadRejected( const Buffer &data )
+{
+	try {
+		TriMesh mesh;
+		mesh.read( IStreamMem::createRef( data ).get() );
+	}
+	catch( TriMeshExcInvalidData & ) {
+		return true;
+	}
+	return false;
+}
+
+void TriMeshTestApp::testSerialize()
+{
+	TriMesh mesh = generateShuffledGrid( 100 );
+	mesh.recalculateTangents();
+	for( size_t v = 0; v < mesh.getNumVertices(); ++v )
+		mesh.appendColorRGBA( ColorA( v / (float)mesh.getNumVertices(), 0.5f, 0.25f, 1 ) );
+
+	console() << "Test Version 2 Round Trip: ";
+	const TriMesh::WriteOptions versions[3] = { TriMesh::WriteOptions(), TriMesh::WriteOptions().compression( CODEC_ZLIB ), TriMesh::WriteOptions().compression( CODEC_LZ4 ) };
+	for( int v = 0; v < 3; ++v ) {
+		TriMesh result = writeAndRead( mesh, versions[v] );
+		assert( result.getVertices() == mesh.getVertices() );
+		assert( result.getNormals() == mesh.getNormals() );
+		assert( result.getTexCoords() == mesh.getTexCoords() );
+		assert( result.getTangents() == mesh.getTangents() );
+		assert( result.getIndices() == mesh.getIndices() );
+		assert( result.getColorsRGBA().size() == mesh.getColorsRGBA().size() );
+		for( size_t c = 0; c < mesh.getColorsRGBA().size(); ++c ) {
+			const ColorA &a = result.getColorsRGBA()[c], &b = mesh.getColorsRGBA()[c];
+			assert( ( a.r == b.r ) && ( a.g == b.g ) && ( a.b == b.b ) && ( a.a == b.a ) );
+		}
+	}
+	console() << "PASS" << std::endl;
+
+	// version 1 has no colors or tangents
+	console() << "Test Version 1 Round Trip: ";
+	TriMesh result = writeAndRead( mesh, TriMesh::WriteOptions().version( 1 ) );
+	assert( result.getVertices() == mesh.getVertices() );
+	assert( result.getNormals() == mesh.getNormals() );
+	assert( result.getTexCoords() == mesh.getTexCoords() );
+	assert( result.getIndices() == mesh.getIndices() );
+	assert( result.getColorsRGBA().empty() && result.getTangents().empty() );
+	console() << "PASS" << std::endl;
+
+	// a file cut short, or one whose counts claim more than the file holds, has to throw rather than allocate
+	console() << "Test Corrupt Files: ";
+	for( int v = 0; v < 3; ++v ) {
+		OStreamMemRef out = OStreamMem::createRef();
+		mesh.write( out.get(), versions[v] );
+		Buffer data = out->createBuffer();
+		bool rejected = isReadRejected( Buffer( data.getData(), data.getDataSize() / 2 ) );
+		assert( rejected );
+		// the header's total size, at byte 8, is what every section is checked against, so it has to be checked against the stream
+		Buffer oversized( data.getDataSize() );
+		memcpy( oversized.getData(), data.getData(), data.getDataSize() );
+		reinterpret_cast<uint8_t*>( oversized.getData() )[13] = 0x01;
+		rejected = isReadRejected( oversized );
+		assert( rejected );
+		// the element count of the first section, positions, is at byte 4 of the first section record
+		uint8_t *count = reinterpret_cast<uint8_t*>( data.getData() ) + 32 + 4;
+		count[0] = count[1] = count[2] = 0xFF; count[3] = 0x0F;
+		rejected = isReadRejected( data );
+		assert( rejected );
+	}
+	// version 1 has no table of sizes, just four counts after the version number
+	OStreamMemRef out = OStreamMem::createRef();
+	mesh.write( out.get(), TriMesh::WriteOptions().version( 1 ) );
+	Buffer data = out->createBuffer();
+	bool rejected = isReadRejected( Buffer( data.getData(), data.getDataSize() - 1 ) );
+	assert( rejected );
+	uint8_t *numVertices = reinterpret_cast<uint8_t*>( data.getData() ) + 1;
+	numVertices[0] = numVertices[1] = numVertices[2] = numVertices[3] = 0xFF;
+	rejected = isReadRejected( data );
+	assert( rejected );
+	console() << "PASS" << std::endl;
+}
+
+// This line tells Flint to actually create the application
+CINDER_APP_BASIC( TriMeshTestApp, RendererGL )
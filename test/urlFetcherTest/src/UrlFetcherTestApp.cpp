@@ -0,0 +1,460 @@
+#include "cinder/app/AppBasic.h"
+#include <cassert>
+using namespace ci;
+using namespace ci::app;
+
+#include "cinder/gl/gl.h"
+#include "cinder/Url.h"
+#include "cinder/UrlCache.h"
+#include "cinder/Utilities.h"
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <map>
+
+using boost::asio::ip::tcp;
+
+// A minimal HTTP server on the loopback interface, so the tests don't depend on the network.
+// "/small" and "/large" are served whole. "/stall" sends its headers and then trickles a byte every 10ms until the client goes away.
+// "/oversized" claims a petabyte of Content-Length but sends only SMALL_SIZE bytes before closing the connection.
+// Anything under "/cached/" is SMALL_SIZE bytes with an ETag of its path, and a 304 for requests carrying that ETag in If-None-Match.
+// "/ranged" is LARGE_SIZE bytes and honors Range requests, and "/unranged" is the same but ignores them. "/ranged-nosize" is RANGE_END_SIZE bytes
+// and honors Range requests without revealing its size, answering a range past its end with a 416 and an error page.
+class LoopbackServer {
+ public:
+	LoopbackServer();
+	~LoopbackServer();
+
+	std::string		getUrl( const std::string &path ) const;
+	//! Returns how many requests for \a path have been answered, and how many of those with a 304
+	int				getNumRequests( const std::string &path ) const;
+	int				getNumNotModified( const std::string &path ) const;
+
+	static std::string	makeBody( size_t size );
+
+	static const size_t SMALL_SIZE = 1000;
+	static const size_t LARGE_SIZE = 4 * 1024 * 1024;
+	// sequential reads request ranges of 1 and then 2 blocks, so the second ends exactly here and the third starts past the end
+	static const size_t RANGE_END_SIZE = 3 * IStreamUrl::BLOCK_SIZE;
+
+ private:
+	void	acceptFn();
+	void	serve( shared_ptr<tcp::socket> socket );
+	void	serveRange( shared_ptr<tcp::socket> socket, const std::string &body, const std::string &range, bool revealSize );
+	bool	isDone() const;
+
+	boost::asio::io_service		mIoService;
+	tcp::acceptor				mAcceptor;
+	mutable boost::mutex		mMutex;
+	bool						mDone;
+	std::map<std::string,int>	mNumRequests, mNumNotModified;
+	boost::thread_group			mConnectionThreads;
+	shared_ptr<boost::thread>	mAcceptThread;
+};
+
+LoopbackServer::LoopbackServer()
+	: mAcceptor( mIoService, tcp::endpoint( boost::asio::ip::address_v4::loopback(), 0 ) ), mDone( false )
+{
+	mAcceptThread = shared_ptr<boost::thread>( new boost::thread( boost::bind( &LoopbackServer::acceptFn, this ) ) );
+}
+
+LoopbackServer::~LoopbackServer()
+{
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		mDone = true;
+	}
+	// wake up the blocking accept() with a connection of our own
+	tcp::socket wake( mIoService );
+	boost::system::error_code ec;
+	wake.connect( mAcceptor.local_endpoint(), ec );
+	mAcceptThread->join();
+	mConnectionThreads.join_all();
+}
+
+std::string LoopbackServer::getUrl( const std::string &path ) const
+{
+	std::ostringstream ss;
+	ss << "http://127.0.0.1:" << mAcceptor.local_endpoint().port() << path;
+	return ss.str();
+}
+
+std::string LoopbackServer::makeBody( size_t size )
+{
+	std::string result( size, 0 );
+	for( size_t i = 0; i < size; ++i )
+		result[i] = static_cast<char>( i * 7 + i / 251 );
+	return result;
+}
+
+int LoopbackServer::getNumRequests( const std::string &path ) const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	std::map<std::string,int>::const_iterator countIt = mNumRequests.find( path );
+	return ( countIt == mNumRequests.end() ) ? 0 : countIt->second;
+}
+
+int LoopbackServer::getNumNotModified( const std::string &path ) const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	std::map<std::string,int>::const_iterator countIt = mNumNotModified.find( path );
+	return ( countIt == mNumNotModified.end() ) ? 0 : countIt->second;
+}
+
+bool LoopbackServer::isDone() const
+{
+	boost::mutex::scoped_lock lock( mMutex );
+	return mDone;
+}
+
+void LoopbackServer::acceptFn()
+{
+	while( true ) {
+		shared_ptr<tcp::socket> socket( new tcp::socket( mIoService ) );
+		boost::system::error_code ec;
+		mAcceptor.accept( *socket, ec );
+		if( isDone() )
+			return;
+		if( ! ec )
+			mConnectionThreads.create_thread( boost::bind( &LoopbackServer::serve, this, socket ) );
+	}
+}
+
+void LoopbackServer::serve( shared_ptr<tcp::socket> socket )
+{
+	boost::system::error_code ec;
+	boost::asio::streambuf request;
+	boost::asio::read_until( *socket, request, "\r\n\r\n", ec );
+	if( ec )
+		return;
+	std::istream requestStream( &request );
+	std::string method, path, line;
+	requestStream >> method >> path;
+	std::getline( requestStream, line );
+	// header names are lowercased, as they're case-insensitive
+	std::map<std::string,std::string> headers;
+	while( std::getline( requestStream, line ) && ( line != "\r" ) ) {
+		std::string::size_type colon = line.find( ':' );
+		if( colon == std::string::npos )
+			continue;
+		std::string name = line.substr( 0, colon );
+		std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+		std::string::size_type valueStart = line.find_first_not_of( ' ', colon + 1 ), valueEnd = line.find_last_not_of( "\r" );
+		headers[name] = ( valueStart == std::string::npos ) ? std::string() : line.substr( valueStart, valueEnd + 1 - valueStart );
+	}
+	{
+		boost::mutex::scoped_lock lock( mMutex );
+		++mNumRequests[path];
+	}
+
+	std::string body, extraHeaders;
+	if( path.compare( 0, 8, "/cached/" ) == 0 ) {
+		const std::string etag = "\"" + path + "\"";
+		if( headers["if-none-match"] == etag ) {
+			{
+				boost::mutex::scoped_lock lock( mMutex );
+				++mNumNotModified[path];
+			}
+			std::string notModified = "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\nConnection: close\r\n\r\n";
+			boost::asio::write( *socket, boost::asio::buffer( notModified ), ec );
+			return;
+		}
+		body = makeBody( SMALL_SIZE );
+		extraHeaders = "ETag: " + etag + "\r\n";
+	}
+	else if( ( path == "/ranged" ) || ( path == "/ranged-nosize" ) ) {
+		body = makeBody( ( path == "/ranged" ) ? LARGE_SIZE : RANGE_END_SIZE );
+		if( ! headers["range"].empty() ) {
+			serveRange( socket, body, headers["range"], path == "/ranged" );
+			return;
+		}
+		extraHeaders = "Accept-Ranges: bytes\r\n";
+	}
+	else if( path == "/unranged" )
+		body = makeBody( LARGE_SIZE );
+	else if( path == "/small" )
+		body = makeBody( SMALL_SIZE );
+	else if( path == "/large" )
+		body = makeBody( LARGE_SIZE );
+	else if( path == "/oversized" ) {
+		std::string header = "HTTP/1.1 200 OK\r\nContent-Length: 1000000000000000\r\nConnection: close\r\n\r\n";
+		boost::asio::write( *socket, boost::asio::buffer( header + makeBody( SMALL_SIZE ) ), ec );
+		// the thread keeps its copy of the socket until the server goes away, so it has to be closed explicitly
+		socket->close( ec );
+		return;
+	}
+	else if( path == "/stall" ) {
+		std::string header = "HTTP/1.1 200 OK\r\nContent-Length: 1000000\r\nConnection: close\r\n\r\n";
+		boost::asio::write( *socket, boost::asio::buffer( header ), ec );
+		while( ( ! ec ) && ( ! isDone() ) ) {
+			boost::asio::write( *socket, boost::asio::buffer( "x", 1 ), ec );
+			boost::this_thread::sleep( boost::posix_time::milliseconds( 10 ) );
+		}
+		return;
+	}
+	else {
+		std::string notFound = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+		boost::asio::write( *socket, boost::asio::buffer( notFound ), ec );
+		return;
+	}
+
+	std::ostringstream header;
+	header << "HTTP/1.1 200 OK\r\nContent-Length: " << body.size() << "\r\n" << extraHeaders << "Connection: close\r\n\r\n";
+	boost::asio::write( *socket, boost::asio::buffer( header.str() ), ec );
+	if( ! ec )
+		boost::asio::write( *socket, boost::asio::buffer( body ), ec );
+}
+
+// Answers a request for \a range, "bytes=first-last", of \a body. The Content-Range gives the total size only if \a revealSize.
+void LoopbackServer::serveRange( shared_ptr<tcp::socket> socket, const std::string &body, const std::string &range, bool revealSize )
+{
+	unsigned long first = 0, last = 0;
+	sscanf( range.c_str(), "bytes=%lu-%lu", &first, &last );
+	std::ostringstream response;
+	if( first >= body.size() ) {
+		const std::string message = "<html><body>416 Range Not Satisfiable</body></html>";
+		response << "HTTP/1.1 416 Range Not Satisfiable\r\n";
+		if( revealSize )
+			response << "Content-Range: bytes */" << body.size() << "\r\n";
+		response << "Content-Length: " << message.size() << "\r\nConnection: close\r\n\r\n" << message;
+	}
+	else {
+		last = std::min<unsigned long>( last, body.size() - 1 );
+		response << "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " << first << "-" << last << "/";
+		if( revealSize )
+			response << body.size();
+		else
+			response << "*";
+		response << "\r\nContent-Length: " << ( last + 1 - first ) << "\r\nConnection: close\r\n\r\n" << body.substr( first, last + 1 - first );
+	}
+	boost::system::error_code ec;
+	boost::asio::write( *socket, boost::asio::buffer( response.str() ), ec );
+}
+
+// Runs UrlFetcher transfers against a LoopbackServer, ending with UrlFetcher::shutdown() while a transfer is still running
+class UrlFetcherTestApp : public AppBasic {
+ public:
+	void setup();
+	void draw();
+
+	void	testFetch();
+	void	testStreamEnd();
+	void	testOversizedLength();
+	void	testCache();
+	void	testRangedStream();
+	void	testRangeEnd();
+	void	testShutdown();
+
+	LoopbackServer	mServer;
+};
+
+void UrlFetcherTestApp::setup()
+{
+	testFetch();
+	testStreamEnd();
+	testOversizedLength();
+	testCache();
+	testRangedStream();
+	testRangeEnd();
+	testShutdown();
+}
+
+void UrlFetcherTestApp::testFetch()
+{
+	console() << "Test Fetch: ";
+	UrlTransferRef transfer = fetchUrl( Url( mServer.getUrl( "/small" ) ) );
+	Buffer buffer = transfer->getBuffer();
+	std::string expected = LoopbackServer::makeBody( LoopbackServer::SMALL_SIZE );
+	assert( buffer.getDataSize() == expected.size() );
+	assert( memcmp( buffer.getData(), expected.data(), expected.size() ) == 0 );
+	long responseCode = transfer->getResponseCode();
+	assert( responseCode == 200 );
+
+	UrlTransferRef missing = fetchUrl( Url( mServer.getUrl( "/missing" ) ) );
+	missing->wait();
+	responseCode = missing->getResponseCode();
+	assert( responseCode == 404 );
+	console() << "PASS" << std::endl;
+}
+
+// reads past the end of a stream which has been entirely consumed
+void UrlFetcherTestApp::testStreamEnd()
+{
+	console() << "Test Stream End: ";
+	UrlTransferRef transfer = fetchUrlStream( Url( mServer.getUrl( "/large" ) ), UrlTransfer::Options().maxBufferedBytes( 64 * 1024 ) );
+	std::string received;
+	char chunk[10000];
+	while( size_t bytesRead = transfer->read( chunk, sizeof(chunk) ) )
+		received.append( chunk, bytesRead );
+	assert( received == LoopbackServer::makeBody( LoopbackServer::LARGE_SIZE ) );
+	size_t bytesRead = transfer->read( chunk, sizeof(chunk) );
+	assert( bytesRead == 0 );
+	bytesRead = transfer->read( chunk, sizeof(chunk) );
+	assert( bytesRead == 0 );
+	console() << "PASS" << std::endl;
+}
+
+// the Content-Length can't be trusted to size the Buffer up front; the transfer has to fail cleanly when the connection closes early
+void UrlFetcherTestApp::testOversizedLength()
+{
+	console() << "Test Oversized Length: ";
+	UrlTransferRef transfer = fetchUrl( Url( mServer.getUrl( "/oversized" ) ) );
+	transfer->wait();
+	int64_t contentLength = transfer->getContentLength();
+	assert( contentLength == 1000000000000000LL );
+	bool failed = transfer->hasFailed();
+	assert( failed );
+	uint64_t bytesReceived = transfer->getBytesReceived();
+	assert( bytesReceived == LoopbackServer::SMALL_SIZE );
+	console() << "PASS" << std::endl;
+}
+
+void UrlFetcherTestApp::testCache()
+{
+	console() << "Test Cache Revalidation: ";
+	UrlCacheRef cache = UrlCache::createRef( getHomeDirectory() + "urlFetcherTestCache", LoopbackServer::SMALL_SIZE * 3 );
+	cache->clear();
+	const std::string expected = LoopbackServer::makeBody( LoopbackServer::SMALL_SIZE );
+	const Url url( mServer.getUrl( "/cached/a" ) );
+	Buffer buffer = cache->fetchBuffer( url );
+	assert( std::string( reinterpret_cast<const char*>( buffer.getData() ), buffer.getDataSize() ) == expected );
+	assert( cache->contains( url ) );
+
+	// with no max age every fetch asks the server, which answers with a 304 rather than the data
+	buffer = cache->fetchBuffer( url );
+	assert( std::string( reinterpret_cast<const char*>( buffer.getData() ), buffer.getDataSize() ) == expected );
+	assert( mServer.getNumRequests( "/cached/a" ) == 2 );
+	assert( mServer.getNumNotModified( "/cached/a" ) == 1 );
+	// the index is saved along with the entry, which has an ETag but no Last-Modified
+	buffer.reset();
+	cache = UrlCache::createRef( getHomeDirectory() + "urlFetcherTestCache", LoopbackServer::SMALL_SIZE * 3 );
+	assert( cache->contains( url ) );
+	console() << "PASS" << std::endl;
+
+	// within its max age an entry doesn't involve the server at all, and past it it's revalidated
+	console() << "Test Cache Max Age: ";
+	cache->setMaxAge( 60 );
+	buffer = cache->fetchBuffer( url );
+	assert( mServer.getNumRequests( "/cached/a" ) == 2 );
+	cache->setMaxAge( 1 );
+	boost::this_thread::sleep( boost::posix_time::milliseconds( 2100 ) );
+	buffer = cache->fetchBuffer( url );
+	assert( std::string( reinterpret_cast<const char*>( buffer.getData() ), buffer.getDataSize() ) == expected );
+	assert( mServer.getNumRequests( "/cached/a" ) == 3 );
+	assert( mServer.getNumNotModified( "/cached/a" ) == 2 );
+	cache->setMaxAge( 0 );
+	console() << "PASS" << std::endl;
+
+	// the cache holds three responses, so fetching three more evicts the least recently used one, "/cached/a"
+	console() << "Test Cache Eviction: ";
+	const char *paths[] = { "/cached/b", "/cached/c", "/cached/d" };
+	for( int p = 0; p < 3; ++p ) {
+		cache->fetchBuffer( Url( mServer.getUrl( paths[p] ) ) );
+		assert( cache->getSize() <= cache->getMaxSize() );
+	}
+	assert( ! cache->contains( url ) );
+	for( int p = 0; p < 3; ++p )
+		assert( cache->contains( Url( mServer.getUrl( paths[p] ) ) ) );
+	cache->setMaxSize( LoopbackServer::SMALL_SIZE );
+	assert( cache->getSize() == LoopbackServer::SMALL_SIZE );
+	assert( cache->contains( Url( mServer.getUrl( "/cached/d" ) ) ) );
+	cache->clear();
+	console() << "PASS" << std::endl;
+}
+
+// reads out of order from a server which honors Range requests, and from one which ignores them and sends everything each time
+void UrlFetcherTestApp::testRangedStream()
+{
+	console() << "Test Ranged Stream: ";
+	const std::string expected = LoopbackServer::makeBody( LoopbackServer::LARGE_SIZE );
+	const char *paths[] = { "/ranged", "/unranged" };
+	for( int p = 0; p < 2; ++p ) {
+		IStreamUrlRef stream = IStreamUrl::createRef( Url( mServer.getUrl( paths[p] ) ) );
+		long responseCode = stream->getResponseCode();
+		assert( responseCode == ( ( p == 0 ) ? 206 : 200 ) );
+		off_t size = stream->size();
+		assert( size == (off_t)expected.size() );
+
+		std::string data( 50000, 0 );
+		stream->seekAbsolute( 3000000 );
+		stream->readData( &data[0], data.size() );
+		assert( data == expected.substr( 3000000, data.size() ) );
+		stream->seekAbsolute( 10 );
+		stream->readData( &data[0], 100 );
+		assert( data.compare( 0, 100, expected, 10, 100 ) == 0 );
+
+		data.resize( expected.size() );
+		stream->seekAbsolute( 0 );
+		stream->readData( &data[0], data.size() );
+		assert( data == expected );
+		bool eof = stream->isEof();
+		assert( eof );
+		size_t bytesRead = stream->readDataAvailable( &data[0], 1 );
+		assert( bytesRead == 0 );
+	}
+	console() << "PASS" << std::endl;
+}
+
+// a server that doesn't give its size is read until a range comes back 416, whose error page mustn't end up in the data
+void UrlFetcherTestApp::testRangeEnd()
+{
+	console() << "Test Range End: ";
+	IStreamUrlRef stream = IStreamUrl::createRef( Url( mServer.getUrl( "/ranged-nosize" ) ) );
+	std::string received;
+	char chunk[10000];
+	while( size_t bytesRead = stream->readDataAvailable( chunk, sizeof(chunk) ) )
+		received.append( chunk, bytesRead );
+	assert( received == LoopbackServer::makeBody( LoopbackServer::RANGE_END_SIZE ) );
+	assert( mServer.getNumRequests( "/ranged-nosize" ) == 3 );
+	off_t size = stream->size();
+	assert( size == (off_t)LoopbackServer::RANGE_END_SIZE );
+
+	// other error responses throw rather than reading as data
+	IStreamUrlRef missing = IStreamUrl::createRef( Url( mServer.getUrl( "/missing" ) ) );
+	bool threw = false;
+	try {
+		missing->readDataAvailable( chunk, sizeof(chunk) );
+	}
+	catch( UrlTransferExc & ) {
+		threw = true;
+	}
+	assert( threw );
+	console() << "PASS" << std::endl;
+}
+
+void UrlFetcherTestApp::testShutdown()
+{
+	console() << "Test Shutdown: ";
+	UrlTransferRef stalled = fetchUrl( Url( mServer.getUrl( "/stall" ) ) );
+	long responseCode = stalled->getResponseCode();
+	assert( responseCode == 200 );
+	UrlTransfer::State state = stalled->getState();
+	assert( state == UrlTransfer::STATE_RUNNING );
+
+	// joins the fetch thread; the stalled transfer can't finish on its own
+	UrlFetcher::shutdown();
+	state = stalled->getState();
+	assert( state == UrlTransfer::STATE_CANCELLED );
+	assert( UrlFetcher::instance() == 0 );
+
+	bool threw = false;
+	try {
+		fetchUrl( Url( mServer.getUrl( "/small" ) ) );
+	}
+	catch( UrlTransferExc & ) {
+		threw = true;
+	}
+	assert( threw );
+	console() << "PASS" << std::endl;
+}
+
+void UrlFetcherTestApp::draw()
+{
+	gl::clear();
+}
+
+// This line tells Flint to actually create the application
+CINDER_APP_BASIC( UrlFetcherTestApp, RendererGL )
@@ -0,0 +1,185 @@
+#include "cinder/app/AppBasic.h"
+#include <cassert>
+using namespace ci;
+using namespace ci::app;
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/TriMesh.h"
+#include "cinder/Rand.h"
+#include "cinder/Timer.h"
+
+// Draws thousands of small meshes, each with its own draw call, as separate VboMeshes or from a VboMeshBatch. Press 'm' to switch between them.
+class VboBatchTestApp : public AppBasic {
+ public:
+	void setup();
+	void draw();
+
+	void keyDown( KeyEvent event );
+
+	TriMesh		generateTile( int tileX, int tileY, const Color &color );
+	std::vector<uint8_t>	readPixels();
+	void		drawVboMeshes();
+	void		drawBatch();
+	void		testBatch();
+
+	// per side, for 4096 meshes of 16 vertices, which just fill a single page
+	static const int TILES = 64;
+
+	std::vector<TriMesh>		mMeshes;
+	std::vector<gl::VboMesh>	mVboMeshes;
+	gl::VboMeshBatch			mBatch;
+	bool						mDrawBatch;
+	Timer						mTimer;
+	int							mFrames;
+};
+
+void VboBatchTestApp::setup()
+{
+	Rand rnd( 1 );
+	for( int y = 0; y < TILES; ++y ) {
+		for( int x = 0; x < TILES; ++x )
+			mMeshes.push_back( generateTile( x, y, Color( rnd.nextFloat(), rnd.nextFloat(), rnd.nextFloat() ) ) );
+	}
+
+	gl::VboMesh::Layout layout;
+	layout.setStaticIndices();
+	layout.setStaticPositions();
+	layout.setStaticColorsRGB();
+	mBatch = gl::VboMeshBatch( layout );
+	for( size_t m = 0; m < mMeshes.size(); ++m ) {
+		mVboMeshes.push_back( gl::VboMesh( mMeshes[m], layout ) );
+		mBatch.add( mMeshes[m] );
+	}
+
+	testBatch();
+
+	mDrawBatch = true;
+	mFrames = 0;
+	mTimer.start();
+}
+
+// A 3x3 grid of quads filling most of tile ( \a tileX, \a tileY ) of the window
+TriMesh VboBatchTestApp::generateTile( int tileX, int tileY, const Color &color )
+{
+	TriMesh result;
+	const int quads = 3;
+	for( int y = 0; y <= quads; ++y ) {
+		for( int x = 0; x <= quads; ++x ) {
+			result.appendVertex( Vec3f( tileX + 0.1f + 0.8f * x / quads, tileY + 0.1f + 0.8f * y / quads, 0 ) );
+			result.appendColorRGB( color );
+		}
+	}
+	for( int y = 0; y < quads; ++y ) {
+		for( int x = 0; x < quads; ++x ) {
+			int a = y * ( quads + 1 ) + x, b = a + 1, c = a + quads + 2, d = a + quads + 1;
+			result.appendTriangle( a, b, c );
+			result.appendTriangle( a, c, d );
+		}
+	}
+
+	return result;
+}
+
+std::vector<uint8_t> VboBatchTestApp::readPixels()
+{
+	std::vector<uint8_t> result( getWindowWidth() * getWindowHeight() * 4 );
+	glReadPixels( 0, 0, getWindowWidth(), getWindowHeight(), GL_RGBA, GL_UNSIGNED_BYTE, &result[0] );
+	return result;
+}
+
+void VboBatchTestApp::drawVboMeshes()
+{
+	gl::pushModelView();
+	gl::scale( Vec3f( getWindowWidth() / (float)TILES, getWindowHeight() / (float)TILES, 1 ) );
+	for( size_t m = 0; m < mVboMeshes.size(); ++m )
+		gl::draw( mVboMeshes[m] );
+	gl::popModelView();
+}
+
+void VboBatchTestApp::drawBatch()
+{
+	gl::pushModelView();
+	gl::scale( Vec3f( getWindowWidth() / (float)TILES, getWindowHeight() / (float)TILES, 1 ) );
+	mBatch.bind();
+	for( size_t m = 0; m < mMeshes.size(); ++m )
+		mBatch.draw( m );
+	mBatch.unbind();
+	gl::popModelView();
+}
+
+void VboBatchTestApp::testBatch()
+{
+	console() << "Test Single Page: ";
+	assert( mBatch.getNumMeshes() == mMeshes.size() );
+	assert( mBatch.getNumPages() == 1 );
+	console() << "PASS" << std::endl;
+
+	// each mesh drawn on its own sets up the page once
+	console() << "Test Same Pixels: ";
+	gl::clear();
+	drawVboMeshes();
+	std::vector<uint8_t> expected = readPixels();
+	gl::clear();
+	mBatch.resetStats();
+	drawBatch();
+	std::vector<uint8_t> batchPixels = readPixels();
+	assert( batchPixels == expected );
+	const gl::VboMeshBatch::Stats &stats = mBatch.getStats();
+	assert( stats.mDrawCalls == mMeshes.size() );
+	assert( stats.mBufferBinds == 4 );
+	console() << "PASS" << std::endl;
+
+	// meshes added one after another are adjacent in the page, so a list of them merges into a single call
+	console() << "Test Merged Draws: ";
+	std::vector<size_t> half, alternate;
+	for( size_t m = 0; m < mMeshes.size(); ++m ) {
+		if( m < mMeshes.size() / 2 )
+			half.push_back( mMeshes.size() / 2 - 1 - m );
+		if( m % 2 == 0 )
+			alternate.push_back( m );
+	}
+	mBatch.resetStats();
+	mBatch.draw( half );
+	assert( stats.mDrawCalls == 1 );
+	mBatch.resetStats();
+	mBatch.draw( alternate );
+	assert( stats.mDrawCalls == alternate.size() );
+	mBatch.resetStats();
+	mBatch.drawAll();
+	assert( stats.mDrawCalls == 1 );
+	console() << "PASS" << std::endl;
+}
+
+void VboBatchTestApp::keyDown( KeyEvent event )
+{
+	if( event.getChar() == 'm' ) {
+		mDrawBatch = ! mDrawBatch;
+		mFrames = 0;
+		mTimer.start();
+	}
+}
+
+void VboBatchTestApp::draw()
+{
+	gl::clear();
+	if( mDrawBatch ) {
+		mBatch.resetStats();
+		drawBatch();
+	}
+	else
+		drawVboMeshes();
+
+	if( ++mFrames == 60 ) {
+		mTimer.stop();
+		console() << ( mDrawBatch ? "VboMeshBatch: " : "VboMesh: " ) << mTimer.getSeconds() / mFrames * 1000 << "ms per frame";
+		if( mDrawBatch )
+			console() << ", " << mBatch.getStats().mBufferBinds << " binds, " << mBatch.getStats().mDrawCalls << " draws";
+		console() << std::endl;
+		mFrames = 0;
+		mTimer.start();
+	}
+}
+
+// This line tells Flint to actually create the application
+CINDER_APP_BASIC( VboBatchTestApp, RendererGL )
@@ -0,0 +1,110 @@
+# Packs a directory of assets into a single archive readable with cinder::Archive
+# python packAssets.py [--codec zlib|lz4|none] [--level 0-9] <output file> <asset directory>
+#
+# Entries are named by their path relative to the asset directory, using '/' as the separator.
+# Each entry is compressed only if that saves at least 10%, so images and other compressed formats are stored as-is
+# and can be read straight out of the mapped pack. lz4 needs the python lz4 module.
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b'CiPk'
+VERSION = 1
+HEADER_SIZE = 32
+RECORD_SIZE = 32
+ALIGNMENT = 16
+CODEC_STORED, CODEC_ZLIB, CODEC_LZ4 = 0, 1, 2
+MIN_SAVING = 0.9
+# already compressed, so not worth trying
+SKIP_EXTENSIONS = [ '.png', '.jpg', '.jpeg', '.gif', '.mp3', '.m4a', '.ogg', '.mov', '.mp4', '.zip', '.gz' ]
+
+def usage():
+	print( "usage: python packAssets.py [--codec zlib|lz4|none] [--level 0-9] <output file> <asset directory>" )
+	sys.exit( 1 )
+
+def compress( data, codec, level ):
+	if codec == CODEC_ZLIB:
+		return zlib.compress( data, level )
+	elif codec == CODEC_LZ4:
+		import lz4.block
+		return lz4.block.compress( data, mode = 'high_compression' if level > 6 else 'default', store_size = False )
+	return data
+
+def gatherFiles( root ):
+	result = []
+	for dirPath, dirs, files in os.walk( root ):
+		for skipped in [ '.svn', '.git' ]:
+			if skipped in dirs:
+				dirs.remove( skipped )
+		for name in files:
+			path = os.path.join( dirPath, name )
+			entryName = os.path.relpath( path, root ).replace( os.sep, '/' )
+			result.append( ( entryName.encode( 'utf-8' ), path ) )
+	# the reader binary searches on the raw bytes of the names
+	result.sort()
+	return result
+
+def align( offset ):
+	return ( offset + ALIGNMENT - 1 ) // ALIGNMENT * ALIGNMENT
+
+def main( args ):
+	codec, level = CODEC_ZLIB, 6
+	while args and args[0].startswith( '--' ):
+		if len( args ) < 2:
+			usage()
+		if args[0] == '--codec':
+			codec = { 'zlib': CODEC_ZLIB, 'lz4': CODEC_LZ4, 'none': CODEC_STORED }.get( args[1] )
+			if codec is None:
+				usage()
+		elif args[0] == '--level':
+			level = int( args[1] )
+		else:
+			usage()
+		args = args[2:]
+	if len( args ) != 2:
+		usage()
+	outputPath, root = args
+
+	files = gatherFiles( root )
+	names = b''
+	nameOffsets = []
+	for entryName, path in files:
+		if len( entryName ) > 0xFFFF:
+			print( "name too long: " + path )
+			sys.exit( 1 )
+		nameOffsets.append( len( names ) )
+		names += entryName
+
+	indexOffset = HEADER_SIZE
+	namesOffset = indexOffset + RECORD_SIZE * len( files )
+	dataOffset = align( namesOffset + len( names ) )
+
+	out = open( outputPath, 'wb' )
+	out.write( b'\0' * dataOffset )
+	records = []
+	totalSize, totalStored = 0, 0
+	for ( entryName, path ), nameOffset in zip( files, nameOffsets ):
+		data = open( path, 'rb' ).read()
+		entryCodec, payload = CODEC_STORED, data
+		if codec != CODEC_STORED and len( data ) > 0 and os.path.splitext( path )[1].lower() not in SKIP_EXTENSIONS:
+			compressed = compress( data, codec, level )
+			if len( compressed ) < len( data ) * MIN_SAVING:
+				entryCodec, payload = codec, compressed
+		out.write( payload )
+		# padded even after the last entry, so every offset lies within the file
+		out.write( b'\0' * ( align( len( payload ) ) - len( payload ) ) )
+		records.append( struct.pack( '<QQQIHBB', dataOffset, len( payload ), len( data ), nameOffset, len( entryName ), entryCodec, 0 ) )
+		dataOffset = align( dataOffset + len( payload ) )
+		totalSize += len( data )
+		totalStored += len( payload )
+
+	out.seek( 0 )
+	out.write( MAGIC + struct.pack( '<IIIQQ', VERSION, len( files ), 0, indexOffset, namesOffset ) )
+	out.write( b''.join( records ) )
+	out.write( names )
+	out.close()
+	print( "Packed %d files, %d bytes into %d bytes" % ( len( files ), totalSize, totalStored ) )
+
+if __name__ == '__main__':
+	main( sys.argv[1:] )